@@ -0,0 +1,79 @@
+#!/usr/bin/env python
+#
+# Copyright (c) 2000-2026 Baylor College of Medicine
+#
+# This software is issued under a joint BSD/GNU license. You may use the
+# source code in this file under either license. However, note that the
+# complete EMAN2 and SPARX software packages have some GPL dependencies,
+# so you are responsible for compliance with the licenses of these packages
+# if you opt to use BSD licensing. The warranty disclaimer below holds
+# in either instance.
+#
+# This complete copyright notice must be included in any revised version of the
+# source code. Additional authorship citations may be added, but existing
+# author citations must be preserved.
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  2111-1307 USA
+#
+#
+
+# Times MarchingCubes isosurface extraction on synthetic volumes, the way the
+# 3-D viewers use it: build once, then contour at a series of thresholds.
+# usage: isosurfacespeed.py [size ...]   (default 128 256)
+
+from EMAN2 import *
+import sys
+import time
+import random
+
+def synthetic_volumes(size):
+	"""Yields (name, volume) pairs of different surface complexity"""
+	yield "spherical waves",test_image_3d(1,(size,size,size))
+
+	vol=EMData(size,size,size)
+	vol.process_inplace("math.addnoise",{"noise":1.0})
+	vol.process_inplace("filter.lowpass.gauss",{"cutoff_abs":0.1})
+	vol.process_inplace("normalize")
+	yield "filtered noise",vol
+
+	random.seed(1)
+	vol=EMData(size,size,size)
+	vol.to_zero()
+	for i in range(32):
+		c=[random.uniform(size/6,size*5/6) for j in range(3)]
+		blob=EMData(size,size,size)
+		blob.process_inplace("testimage.puregaussian",{"x_sigma":size/32.0,"y_sigma":size/24.0,"z_sigma":size/20.0,"x_center":c[0],"y_center":c[1],"z_center":c[2]})
+		vol.add(blob)
+	vol.process_inplace("normalize")
+	yield "gaussian blobs",vol
+
+sizes=[int(i) for i in sys.argv[1:]] if len(sys.argv)>1 else [128,256]
+
+print("size\tvolume\t\tsetup(s)\tthreshold\tfirst(s)\trepeat(s)\ttriangles")
+for size in sizes:
+	for name,vol in synthetic_volumes(size):
+		t0=time.time()
+		mc=MarchingCubes(vol)
+		t1=time.time()
+		setup=t1-t0
+
+		for thr in (0.5,1.0,1.5,1.0):
+			mc.set_surface_value(thr)
+			t0=time.time()
+			d=mc.get_isosurface()
+			t1=time.time()
+			d=mc.get_isosurface()		# unchanged threshold, every brick is reused
+			t2=time.time()
+			print("%d\t%-16s%1.3f\t\t%1.2f\t\t%1.3f\t\t%1.3f\t\t%d"%(size,name,setup,thr,t1-t0,t2-t1,d["size"]//3))
@@ -30,12 +30,15 @@
  * */
 
 #include <ctime>
+#include <cfloat>
 #include <memory>
+#include <gsl/gsl_eigen.h>
 #include "emdata.h"
 #include "analyzer.h"
 #include "sparx/analyzer_sparx.h"
 #include "util.h"
 #include "cmp.h"
+#include "emthreads.h"
 #include "sparx/lapackblas.h"
 #include "sparx/varimax.h"
 
@@ -171,6 +174,29 @@ void KMeansAnalyzer::set_params(const Dict & new_params)
 	if (params.has_key("outlierclass")) outlierclass=params["outlierclass"];	
 }
 
+namespace {
+	// particles per chunk in the threaded loops, and bytes of centers kept
+	// in cache while a block of particles is compared against them
+	const size_t KM_GRAIN = 256;
+	const size_t KM_PBLOCK = 16;
+	const size_t KM_CBLOCK_BYTES = 1 << 18;
+
+	// squared euclidean distance, with independent partial sums so it vectorizes
+	inline float km_sqdist(const float *a, const float *b, size_t n) {
+		float s[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+		size_t i = 0;
+		for (; i + 8 <= n; i += 8) {
+			for (int k = 0; k < 8; k++) {
+				float d = a[i + k] - b[i + k];
+				s[k] += d * d;
+			}
+		}
+		float r = 0;
+		for (; i < n; i++) r += (a[i] - b[i]) * (a[i] - b[i]);
+		return r + ((s[0] + s[1]) + (s[2] + s[3])) + ((s[4] + s[5]) + (s[6] + s[7]));
+	}
+}
+
 vector<EMData *> KMeansAnalyzer::analyze()
 {
 if (ncls<=1) return vector<EMData *>();
@@ -184,6 +210,20 @@ if (mininclass<1) mininclass=1;
 
 int seedmode=params.set_default("seedmode",(int)0);
 
+// the particle data is used in place, get_data() may need to expand it first
+dim=images[0]->get_size();
+rows.resize(nptcl);
+assign.resize(nptcl);
+cendist.assign(nptcl,0.0f);
+lower.assign(nptcl,0.0f);
+boundcen.clear();
+boundpos.clear();
+for (int i=0; i<nptcl; i++) {
+	if (images[i]->get_size()!=dim) throw ImageDimensionException("kmeans requires images of the same size");
+	rows[i]=images[i]->get_data();
+	assign[i]=images[i]->get_attr_default("class_id",0);
+}
+
 // in outlier mode we don't use the bad center concept
 if (outlierclass==0) {
 	for (int i=0; i<nptcl; i++) images[i]->set_attr("is_ok_center",(int)5);  // if an image becomes part of too small a set, it will (eventually) be marked as a bad center
@@ -225,6 +265,7 @@ else if (seedmode==1) {
 		delete tmp;
 	}
 }
+else if (seedmode==2) seed_plusplus();
 
 if (calcsigmamean) {
 	for (int i=nclstot; i<nclstot*2; i++) centers[i]=new EMData(images[0]->get_xsize(),images[0]->get_ysize(),images[0]->get_zsize());
@@ -249,37 +290,102 @@ for (int i=0; i<maxiter; i++) {
 }
 update_centers(calcsigmamean);
 
+rows.clear();
+assign.clear();
+cendist.clear();
+lower.clear();
+boundcen.clear();
+boundpos.clear();
+
 return centers;
 }
 
+// k-means++ seeding, each new seed is drawn with probability proportional to
+// its squared distance from the closest seed already chosen
+void KMeansAnalyzer::seed_plusplus() {
+int nptcl=images.size();
+int nchunk=EMThreads::get_num_chunks(nptcl,KM_GRAIN);
+vector<float> mind(nptcl,1.0e38f);
+vector<double> part(nchunk);
+
+int c=Util::get_irand(0,nptcl-1);
+for (int k=0; k<ncls; k++) {
+	centers[k]=images[c]->copy();
+	if (k==ncls-1) break;
+
+	const float *cen=rows[c];
+	EMThreads::parallel_for(nptcl, [&](size_t b, size_t e, int chunk) {
+		double s=0;
+		for (size_t i=b; i<e; i++) {
+			float d=km_sqdist(rows[i],cen,dim);
+			if (d<mind[i]) mind[i]=d;
+			s+=mind[i];
+		}
+		part[chunk]=s;
+	}, KM_GRAIN);
+
+	double total=0;
+	for (int j=0; j<nchunk; j++) total+=part[j];
+	if (total<=0) {		// fewer distinct particles than classes
+		c=Util::get_irand(0,nptcl-1);
+		continue;
+	}
+	double r=Util::get_frand(0.0,total);
+	c=nptcl-1;
+	for (int i=0; i<nptcl; i++) {
+		r-=mind[i];
+		if (r<=0 && mind[i]>0) { c=i; break; }
+	}
+}
+}
+
 void KMeansAnalyzer::update_centers(int sigmas) {
 int nptcl=images.size();
 //int repr[ncls];
-vector<int> repr(ncls);
-
-for (int i=0; i<ncls; i++) {
-	centers[i]->to_zero();
-	if (sigmas) centers[i+ncls]->to_zero();
-	repr[i]=0;
-	centers[i]->set_attr("worst_ptcldist",0.0f);
-}
+vector<int> repr(ncls,0);
+vector<float> worst(ncls,0.0f);
+vector<int> worstn(ncls,-1);
+vector<char> use(nptcl,0);
 
-// compute new position for each center
+// find the particles contributing to each center
 for (int i=0; i<nptcl; i++) {
-	int cid=images[i]->get_attr("class_id");
+	int cid=assign[i];
+	if (cid>=ncls) continue;
 	// outlier mode disables is_ok_center functionality
 	if (outlierclass || (int)images[i]->get_attr("is_ok_center")>0) {
-		centers[cid]->add(*images[i]);
-		if (sigmas) centers[cid+ncls]->addsquare(*images[i]);
+		use[i]=1;
 		repr[cid]++;
-		float imdist=images[i]->get_attr("class_cendist");
-		if (imdist>(float)centers[cid]->get_attr("worst_ptcldist")) {
-			centers[cid]->set_attr("worst_ptcldist",imdist);
-			centers[cid]->set_attr("worst_ptcl",i);
+		if (cendist[i]>worst[cid]) {
+			worst[cid]=cendist[i];
+			worstn[cid]=i;
 		}
 	}
 }
 
+// compute new position for each center, split over pixels so each thread owns
+// the same slice of every center
+vector<float *> sum(ncls),sq(ncls,(float *)0);
+for (int i=0; i<ncls; i++) {
+	centers[i]->to_zero();
+	sum[i]=centers[i]->get_data();
+	if (sigmas) {
+		centers[i+ncls]->to_zero();
+		sq[i]=centers[i+ncls]->get_data();
+	}
+}
+EMThreads::parallel_for(dim, [&](size_t b, size_t e, int) {
+	for (int i=0; i<nptcl; i++) {
+		if (!use[i]) continue;
+		const float *r=rows[i];
+		float *s=sum[assign[i]];
+		for (size_t k=b; k<e; k++) s[k]+=r[k];
+		if (sigmas) {
+			float *q=sq[assign[i]];
+			for (size_t k=b; k<e; k++) q[k]+=r[k]*r[k];
+		}
+	}
+}, 4096);
+
 for (int i=0; i<ncls; i++) {
 	// If this class is too small, outlier class is never reseeded
 	if (repr[i]<mininclass && (outlierclass==0||i<nclstot-1)) {
@@ -287,8 +393,9 @@ for (int i=0; i<ncls; i++) {
 		// when it reaches zero the particle will no longer participate in determining the location of a center
 		if (outlierclass) {	// outliers are relegated to the outlier class permanently
 			for (int j=0; j<nptcl; j++) {
-				if ((int)images[j]->get_attr("class_id")==i) {
+				if (assign[j]==i) {
 					if (verbose) printf("outlier: %d\n",j);
+					assign[j]=nclstot-1;
 					images[j]->set_attr("class_id",nclstot-1);
 					//nchanged++;	// should happen automatically below
 				}
@@ -297,23 +404,33 @@ for (int i=0; i<ncls; i++) {
 		// if not using outlier class, we use "is_ok_center" concept to reduce influence of outliers
 		else {
 			for (int j=0; j<nptcl; j++) {
-				if ((int)images[j]->get_attr("class_id")==i) images[i]->set_attr("is_ok_center",(int)images[i]->get_attr("is_ok_center")-1);
+				if (assign[j]==i) images[j]->set_attr("is_ok_center",(int)images[j]->get_attr("is_ok_center")-1);
 			}
 		}
-		// Mark the center for reseeding
+		// Mark the center for reseeding, the distance bounds must not refer to it anymore
+		std::replace(boundcen.begin(),boundcen.end(),centers[i],(EMData *)0);
 		delete centers[i];
 		centers[i]=0;
 		repr[i]=0;
 	}
 	// finishes off the statistics we started computing above
 	else {
-		centers[i]->mult((float)1.0/(float)(repr[i]));
+		float *s=sum[i];
+		float norm=(float)1.0/(float)(repr[i]);
+		for (size_t k=0; k<dim; k++) s[k]*=norm;
+		centers[i]->update();
 		centers[i]->set_attr("ptcl_repr",repr[i]);
+		centers[i]->set_attr("worst_ptcldist",worst[i]);
+		if (worstn[i]>=0) centers[i]->set_attr("worst_ptcl",worstn[i]);
 		if (sigmas) {
-			centers[i+ncls]->mult((float)1.0/(float)(repr[i]));		// sum of squares over n
-			centers[i+ncls]->subsquare(*centers[i]);					// subtract the mean value squared
-			centers[i+ncls]->process("math.sqrt");					// square root
-			centers[i+ncls]->mult((float)1.0/(float)sqrt((float)repr[i]));		// divide by sqrt(N) to get std. dev. of mean
+			// standard deviation over sqrt(N) to get std. dev. of the mean
+			float *q=sq[i];
+			float snorm=(float)1.0/(float)sqrt((float)repr[i]);
+			for (size_t k=0; k<dim; k++) {
+				float v=q[k]*norm-s[k]*s[k];
+				q[k]=v>0?sqrt(v)*snorm:0.0f;
+			}
+			centers[i+ncls]->update();
 		}
 
 	}
@@ -339,7 +456,7 @@ if (i==ncls) return;
 // make a list of all particles which could be centers
 vector<int> goodcen;
 if (outlierclass) {
-	for (int i=0; i<nptcl; i++) { if ((int)images[i]->get_attr("class_id")!=nclstot-1) goodcen.push_back(i); }
+	for (int i=0; i<nptcl; i++) { if (assign[i]!=nclstot-1) goodcen.push_back(i); }
 }
 else {
 //	printf("c%d\n",outlierclass);
@@ -428,25 +545,110 @@ void KMeansAnalyzer::resort() {
 // Redetermine which class each particle belongs in
 void KMeansAnalyzer::reclassify() {
 int nptcl=images.size();
-
-//Cmp *c = Factory < Cmp >::get("sqeuclidean");
-for (int i=0; i<nptcl; i++) {
-	if (outlierclass && (int)images[i]->get_attr_default("class_id",0)==nclstot-1) continue;	// outliers are forever
-	float best=1.0e38f;
-	int bestn=0;
-	int lim=ncls;
-	if (outlierclass) lim=ncls-1;	// particles don't join the outliers based on distance
-	for (int j=0; j<lim; j++) {
-//		float d=c->cmp(images[i],centers[j]);
-		float d=qsqcmp(images[i],centers[j]);
-		if (d<best) { best=d; bestn=j; }
+int lim=ncls;
+if (outlierclass) lim=ncls-1;	// particles don't join the outliers based on distance
+
+// copy the centers together so a block of them stays in cache
+vector<float> cen((size_t)lim*dim);
+for (int j=0; j<lim; j++) std::copy(centers[j]->get_data(),centers[j]->get_data()+dim,cen.begin()+j*dim);
+
+// resort() and reseed() renumber the centers, so map the numbering the bounds
+// were computed with onto the current one, and find how far each center moved.
+// A new center has no previous position, which disables pruning this round.
+vector<int> newidx(boundcen.size(),-1);
+vector<float> drift(lim,FLT_MAX);
+float maxdrift=0;
+for (int j=0; j<lim; j++) {
+	for (size_t k=0; k<boundcen.size(); k++) {
+		if (boundcen[k]==centers[j]) {
+			newidx[k]=j;
+			drift[j]=sqrt(km_sqdist(&cen[j*dim],&boundpos[k*dim],dim));
+			break;
+		}
 	}
-	int oldn=images[i]->get_attr_default("class_id",0);
-	if (oldn!=bestn) nchanged++;
-	images[i]->set_attr("class_id",bestn);
-	images[i]->set_attr("class_cendist",best);		// store this for reseeding
+	maxdrift=std::max(maxdrift,drift[j]);
 }
-//delete c;
+
+// half the distance from each center to its nearest neighbor. A particle closer
+// than this to its own center can't be closer to any other one.
+vector<float> halfsep(lim,FLT_MAX);
+EMThreads::parallel_for(lim, [&](size_t b, size_t e, int) {
+	for (size_t j=b; j<e; j++) {
+		float m=FLT_MAX;
+		for (int k=0; k<lim; k++) {
+			if (k!=(int)j) m=std::min(m,km_sqdist(&cen[j*dim],&cen[k*dim],dim));
+		}
+		halfsep[j]=(m==FLT_MAX)?FLT_MAX:0.5f*sqrt(m);
+	}
+});
+
+size_t cblock=std::max((size_t)1,KM_CBLOCK_BYTES/(dim*sizeof(float)));
+vector<int> changed(EMThreads::get_num_chunks(nptcl,KM_GRAIN),0);
+
+EMThreads::parallel_for(nptcl, [&](size_t b, size_t e, int chunk) {
+	vector<size_t> todo;
+	vector<int> todoold;
+
+	for (size_t i=b; i<e; i++) {
+		if (outlierclass && assign[i]==nclstot-1) continue;	// outliers are forever
+		int oldn=assign[i];
+		if (!boundcen.empty()) oldn=(oldn>=0 && oldn<(int)newidx.size())?newidx[oldn]:-1;
+
+		// the bounds can only rule out a change of class
+		if (oldn>=0 && maxdrift<FLT_MAX) {
+			float d=km_sqdist(rows[i],&cen[oldn*dim],dim);
+			float l=lower[i]-maxdrift;
+			if (sqrt(d)<std::max(l,halfsep[oldn])) {
+				assign[i]=oldn;
+				cendist[i]=d;
+				lower[i]=l;
+				continue;
+			}
+		}
+		todo.push_back(i);
+		todoold.push_back(oldn);
+	}
+
+	// everything else is compared with all centers, a block of particles
+	// against a block of centers at a time
+	float best[KM_PBLOCK],second[KM_PBLOCK];
+	int bestn[KM_PBLOCK];
+	for (size_t t0=0; t0<todo.size(); t0+=KM_PBLOCK) {
+		size_t nt=std::min(KM_PBLOCK,todo.size()-t0);
+		for (size_t t=0; t<nt; t++) { best[t]=second[t]=FLT_MAX; bestn[t]=0; }
+
+		for (size_t c0=0; c0<(size_t)lim; c0+=cblock) {
+			size_t c1=std::min((size_t)lim,c0+cblock);
+			for (size_t t=0; t<nt; t++) {
+				const float *x=rows[todo[t0+t]];
+				for (size_t j=c0; j<c1; j++) {
+					float d=km_sqdist(x,&cen[j*dim],dim);
+					if (d<best[t]) { second[t]=best[t]; best[t]=d; bestn[t]=j; }
+					else if (d<second[t]) second[t]=d;
+				}
+			}
+		}
+
+		for (size_t t=0; t<nt; t++) {
+			size_t i=todo[t0+t];
+			if (todoold[t0+t]!=bestn[t]) changed[chunk]++;
+			assign[i]=bestn[t];
+			cendist[i]=best[t];
+			lower[i]=(second[t]==FLT_MAX)?FLT_MAX:sqrt(second[t]);
+		}
+	}
+
+	for (size_t i=b; i<e; i++) {
+		if (outlierclass && assign[i]==nclstot-1) continue;
+		images[i]->set_attr("class_id",assign[i]);
+		images[i]->set_attr("class_cendist",cendist[i]);		// store this for reseeding
+	}
+}, KM_GRAIN);
+
+for (size_t c=0; c<changed.size(); c++) nchanged+=changed[c];
+
+boundcen.assign(centers.begin(),centers.begin()+lim);
+boundpos.swap(cen);
 }
 
 #define covmat(i,j) covmat[ ((j)-1)*nx + (i)-1 ]
@@ -934,6 +1136,155 @@ vector<EMData*> varimax::analyze()
     return images;
 }
 
+namespace {
+	// rows per chunk in the threaded matrix products
+	const size_t SVD_GRAIN = 1024;
+
+	// out = X^T Y (a x b) for row major rows x a and rows x b matrices
+	void svd_crossprod(const float *X, int a, const float *Y, int b, size_t rows, vector<double> & out)
+	{
+		size_t ab=(size_t)a*b;
+		int nchunk=EMThreads::get_num_chunks(rows,SVD_GRAIN);
+		vector<double> part(nchunk*ab,0.0);
+
+		EMThreads::parallel_for(rows, [&](size_t r0, size_t r1, int chunk) {
+			double *o=&part[chunk*ab];
+			for (size_t r=r0; r<r1; r++) {
+				const float *x=X+r*a;
+				const float *y=Y+r*b;
+				for (int i=0; i<a; i++) {
+					double xi=x[i];
+					double *oi=o+(size_t)i*b;
+					for (int j=0; j<b; j++) oi[j]+=xi*y[j];
+				}
+			}
+		}, SVD_GRAIN);
+
+		out.assign(ab,0.0);
+		for (int c=0; c<nchunk; c++) {
+			for (size_t i=0; i<ab; i++) out[i]+=part[c*ab+i];
+		}
+	}
+
+	// out = X M for a row major rows x a matrix X and a x b matrix M, out must not overlap X
+	void svd_mult(const float *X, int a, const vector<double> & M, int b, size_t rows, float *out)
+	{
+		EMThreads::parallel_for(rows, [&](size_t r0, size_t r1, int) {
+			vector<double> acc(b);
+			for (size_t r=r0; r<r1; r++) {
+				std::fill(acc.begin(),acc.end(),0.0);
+				const float *x=X+r*a;
+				for (int i=0; i<a; i++) {
+					double xi=x[i];
+					const double *m=&M[(size_t)i*b];
+					for (int j=0; j<b; j++) acc[j]+=xi*m[j];
+				}
+				float *o=out+r*b;
+				for (int j=0; j<b; j++) o[j]=(float)acc[j];
+			}
+		}, SVD_GRAIN);
+	}
+
+	// Y = A Z, A holds n images of npix pixels one after another, Z is n x l and
+	// Y npix x l, both row major
+	void svd_images_mult(const float *A, size_t npix, int n, const vector<float> & Z, int l, vector<float> & Y)
+	{
+		Y.assign(npix*l,0.0f);
+		EMThreads::parallel_for(npix, [&](size_t p0, size_t p1, int) {
+			for (int j=0; j<n; j++) {
+				const float *aj=A+(size_t)j*npix;
+				const float *z=&Z[(size_t)j*l];
+				for (size_t p=p0; p<p1; p++) {
+					float v=aj[p];
+					float *y=&Y[p*l];
+					for (int c=0; c<l; c++) y[c]+=v*z[c];
+				}
+			}
+		}, SVD_GRAIN);
+	}
+
+	// Z = A^T Y, see svd_images_mult()
+	void svd_images_tmult(const float *A, size_t npix, int n, const vector<float> & Y, int l, vector<float> & Z)
+	{
+		Z.resize((size_t)n*l);
+		EMThreads::parallel_for(n, [&](size_t j0, size_t j1, int) {
+			vector<double> acc(l);
+			for (size_t j=j0; j<j1; j++) {
+				std::fill(acc.begin(),acc.end(),0.0);
+				const float *aj=A+j*npix;
+				for (size_t p=0; p<npix; p++) {
+					double v=aj[p];
+					const float *y=&Y[p*l];
+					for (int c=0; c<l; c++) acc[c]+=v*y[c];
+				}
+				for (int c=0; c<l; c++) Z[j*l+c]=(float)acc[c];
+			}
+		}, 16);
+	}
+
+	// eigenvalues (descending) and eigenvectors (columns of the row major n x n vec)
+	// of a symmetric n x n matrix
+	void svd_eigen(const vector<double> & G, int n, vector<double> & val, vector<double> & vec)
+	{
+		gsl_matrix *g=gsl_matrix_alloc(n,n);
+		gsl_matrix *v=gsl_matrix_alloc(n,n);
+		gsl_vector *ev=gsl_vector_alloc(n);
+		for (int i=0; i<n; i++) {
+			for (int j=0; j<n; j++) gsl_matrix_set(g,i,j,G[(size_t)i*n+j]);
+		}
+
+		gsl_eigen_symmv_workspace *w=gsl_eigen_symmv_alloc(n);
+		gsl_eigen_symmv(g,ev,v,w);
+		gsl_eigen_symmv_free(w);
+		gsl_eigen_symmv_sort(ev,v,GSL_EIGEN_SORT_VAL_DESC);
+
+		val.resize(n);
+		vec.resize((size_t)n*n);
+		for (int i=0; i<n; i++) {
+			val[i]=gsl_vector_get(ev,i);
+			for (int j=0; j<n; j++) vec[(size_t)i*n+j]=gsl_matrix_get(v,i,j);
+		}
+
+		gsl_vector_free(ev);
+		gsl_matrix_free(v);
+		gsl_matrix_free(g);
+	}
+
+	// number of leading eigenvalues which are not negligible
+	int svd_numerical_rank(const vector<double> & val)
+	{
+		int r=0;
+		while (r<(int)val.size() && val[r]>0 && val[r]>val[0]*1.0e-10) r++;
+		return r;
+	}
+
+	// orthonormalize the columns of the row major rows x ncol matrix Y, dropping
+	// directions with no energy. This works from the Gram matrix so all of the
+	// large products are threaded, and is done twice for full accuracy.
+	// returns the new number of columns
+	int svd_orthonormalize(vector<float> & Y, size_t rows, int ncol)
+	{
+		for (int pass=0; pass<2 && ncol>0; pass++) {
+			vector<double> G,val,vec;
+			svd_crossprod(Y.data(),ncol,Y.data(),ncol,rows,G);
+			svd_eigen(G,ncol,val,vec);
+
+			int keep=svd_numerical_rank(val);
+			vector<double> T((size_t)ncol*keep);
+			for (int i=0; i<ncol; i++) {
+				for (int j=0; j<keep; j++) T[(size_t)i*keep+j]=vec[(size_t)i*ncol+j]/sqrt(val[j]);
+			}
+
+			vector<float> Q(rows*keep);
+			svd_mult(Y.data(),ncol,T,keep,rows,Q.data());
+			Y.swap(Q);
+			ncol=keep;
+		}
+
+		return ncol;
+	}
+}
+
 int SVDAnalyzer::insert_image(EMData * image)
 {
 	if (mask==0)
@@ -943,10 +1294,26 @@ int SVDAnalyzer::insert_image(EMData * image)
 	size_t totpix=mask->get_xsize()*mask->get_ysize()*mask->get_zsize();
 	float  *d=image->get_data();
 	float *md=mask ->get_data();
-	for (size_t i=0,j=0; i<totpix; ++i) {
-		if (md[i]) {
-			gsl_matrix_set(A,j,nsofar,d[i]);
-			j++;
+
+	if (approx==1) {
+		if (nsofar>=nimg) throw InvalidValueException(nimg,"more images than nimg inserted");
+		float *a=&Af[(size_t)nsofar*pixels];
+		for (size_t i=0,j=0; i<totpix; ++i) {
+			if (md[i]) a[j++]=d[i];
+		}
+	}
+	else if (approx==2) {
+		for (size_t i=0,j=0; i<totpix; ++i) {
+			if (md[i]) buf[(j++)*chunk+nbuf]=d[i];
+		}
+		if (++nbuf==chunk) update_incremental();
+	}
+	else {
+		for (size_t i=0,j=0; i<totpix; ++i) {
+			if (md[i]) {
+				gsl_matrix_set(A,j,nsofar,d[i]);
+				j++;
+			}
 		}
 	}
 	nsofar++;
@@ -958,6 +1325,9 @@ int SVDAnalyzer::insert_image(EMData * image)
 #define eigvec(i,j) eigvec[(j)*ncov + (i)]
 vector<EMData*> SVDAnalyzer::analyze()
 {
+if (approx==1) return analyze_randomized();
+if (approx==2) return analyze_incremental();
+
 // Allocate the working space
 gsl_vector *work=gsl_vector_alloc(nimg);
 gsl_vector *S=gsl_vector_alloc(nimg);
@@ -1000,6 +1370,167 @@ mask=NULL;
 return ret;
 }
 
+// Randomized SVD (Halko, Martinsson & Tropp 2011, algorithm 4.4), an orthonormal
+// basis Q for the range of A is found with a few passes over the images, then
+// the small matrix B=Q^T A is decomposed exactly.
+vector<EMData*> SVDAnalyzer::analyze_randomized()
+{
+int n=nsofar;
+size_t npix=pixels;
+int l=std::min(nvec+oversample,std::min(n,pixels));
+const float *a=Af.data();
+
+// gaussian test matrix, images x l
+vector<float> Z((size_t)n*l);
+for (size_t i=0; i<Z.size(); i++) Z[i]=Util::get_gauss_rand(0.0f,1.0f);
+
+// Y=(A A^T)^q A Z, reorthonormalized after every product
+vector<float> Y;
+for (int it=0; l>0; it++) {
+	svd_images_mult(a,npix,n,Z,l,Y);
+	l=svd_orthonormalize(Y,npix,l);
+	if (it>=poweriter || l==0) break;
+	svd_images_tmult(a,npix,n,Y,l,Z);
+	l=svd_orthonormalize(Z,n,l);
+}
+
+vector<EMData*> ret;
+if (l>0) {
+	// B B^T = Q^T A A^T Q, its eigenvectors rotate Q onto the left singular vectors
+	svd_images_tmult(a,npix,n,Y,l,Z);
+	vector<double> G,val,vec;
+	svd_crossprod(Z.data(),l,Z.data(),l,n,G);
+	svd_eigen(G,l,val,vec);
+
+	int nv=std::min(nvec,svd_numerical_rank(val));
+	vector<double> R((size_t)l*nv),sval(nv);
+	for (int i=0; i<l; i++) {
+		for (int j=0; j<nv; j++) R[(size_t)i*nv+j]=vec[(size_t)i*l+j];
+	}
+	for (int j=0; j<nv; j++) sval[j]=sqrt(val[j]);
+
+	vector<float> basis(npix*nv);
+	svd_mult(Y.data(),l,R,nv,npix,basis.data());
+	ret=unpack_basis(basis,nv,sval);
+}
+
+vector<float>().swap(Af);
+mask=NULL;
+
+return ret;
+}
+
+// Fold the buffered images C into the rank r basis U S (Brand 2002). With L=U^T C
+// and the orthonormal basis J of the residual H=C-U L,
+//    [U S  C] = [U J] | S  L   |
+//                     | 0  J^T H |
+// so the new basis comes from the decomposition of the small middle matrix.
+void SVDAnalyzer::update_incremental()
+{
+int m=nbuf;
+if (m==0) return;
+size_t npix=pixels;
+
+vector<float> C;
+if (m<chunk) {
+	C.resize(npix*m);
+	for (size_t p=0; p<npix; p++) std::copy(&buf[p*chunk],&buf[p*chunk]+m,&C[p*m]);
+}
+else C=buf;
+
+vector<double> L;
+vector<float> H(C);
+if (rank>0) {
+	svd_crossprod(U.data(),rank,C.data(),m,npix,L);
+	vector<float> UL(npix*m);
+	svd_mult(U.data(),rank,L,m,npix,UL.data());
+	for (size_t i=0; i<H.size(); i++) H[i]-=UL[i];
+}
+
+vector<float> J(H);
+int mj=svd_orthonormalize(J,npix,m);
+vector<double> K;
+svd_crossprod(J.data(),mj,H.data(),m,npix,K);
+
+// the middle matrix, (rank+mj) x (rank+m)
+int nr=rank+mj, nc=rank+m;
+vector<double> M((size_t)nr*nc,0.0);
+for (int i=0; i<rank; i++) {
+	M[(size_t)i*nc+i]=S[i];
+	for (int j=0; j<m; j++) M[(size_t)i*nc+rank+j]=L[(size_t)i*m+j];
+}
+for (int i=0; i<mj; i++) {
+	for (int j=0; j<m; j++) M[(size_t)(rank+i)*nc+rank+j]=K[(size_t)i*m+j];
+}
+
+// its left singular vectors from M M^T
+vector<double> G((size_t)nr*nr,0.0),val,vec;
+for (int i=0; i<nr; i++) {
+	for (int j=i; j<nr; j++) {
+		double s=0;
+		for (int k=0; k<nc; k++) s+=M[(size_t)i*nc+k]*M[(size_t)j*nc+k];
+		G[(size_t)i*nr+j]=G[(size_t)j*nr+i]=s;
+	}
+}
+svd_eigen(G,nr,val,vec);
+int newrank=std::min(nvec+oversample,svd_numerical_rank(val));
+
+// U = [U J] V, truncated
+vector<float> W(npix*nr);
+for (size_t p=0; p<npix; p++) {
+	std::copy(&U[p*rank],&U[p*rank]+rank,&W[p*nr]);
+	std::copy(&J[p*mj],&J[p*mj]+mj,&W[p*nr+rank]);
+}
+vector<double> R((size_t)nr*newrank);
+for (int i=0; i<nr; i++) {
+	for (int j=0; j<newrank; j++) R[(size_t)i*newrank+j]=vec[(size_t)i*nr+j];
+}
+U.resize(npix*newrank);
+svd_mult(W.data(),nr,R,newrank,npix,U.data());
+S.resize(newrank);
+for (int j=0; j<newrank; j++) S[j]=sqrt(val[j]);
+
+rank=newrank;
+nbuf=0;
+}
+
+vector<EMData*> SVDAnalyzer::analyze_incremental()
+{
+update_incremental();
+vector<EMData*> ret=unpack_basis(U,rank,S);
+
+vector<float>().swap(U);
+vector<float>().swap(buf);
+S.clear();
+rank=0;
+mask=NULL;
+
+return ret;
+}
+
+// eigenimages from the columns of a row major pixels x ncol basis
+vector<EMData*> SVDAnalyzer::unpack_basis(const vector<float> & basis, int ncol, const vector<double> & sval)
+{
+vector<EMData*> ret;
+float *md=mask->get_data();
+size_t totpix=mask->get_xsize()*mask->get_ysize()*mask->get_zsize();
+for (int k=0; k<nvec && k<ncol; k++) {
+	EMData *img = new EMData;
+	img->set_size(mask->get_xsize(),mask->get_ysize(),mask->get_zsize());
+
+	float  *d=img->get_data();
+	for (size_t i=0,j=0; i<totpix; ++i) {
+		if (md[i]) {
+			d[i]=basis[j*ncol+k];
+			j++;
+		}
+	}
+	img->set_attr( "eigval", sval[k]);
+	ret.push_back(img);
+}
+return ret;
+}
+
 void SVDAnalyzer::set_params(const Dict & new_params)
 {
 	params = new_params;
@@ -1007,6 +1538,17 @@ void SVDAnalyzer::set_params(const Dict & new_params)
 	nvec = params["nvec"];
 	nimg = params["nimg"];
 
+	string mode="full";
+	if (params.has_key("mode")) mode=(string)params["mode"];
+	if (mode=="full") approx=0;
+	else if (mode=="randomized") approx=1;
+	else if (mode=="incremental") approx=2;
+	else throw InvalidParameterException("svd_gsl mode must be full, randomized or incremental");
+	oversample=params.set_default("oversample",10);
+	poweriter=params.set_default("poweriter",2);
+	chunk=params.set_default("chunk",256);
+	if (chunk<1) chunk=1;
+
 	// count pixels under mask
 	pixels=0;
 	size_t totpix=mask->get_xsize()*mask->get_ysize()*mask->get_zsize();
@@ -1014,7 +1556,13 @@ void SVDAnalyzer::set_params(const Dict & new_params)
 	for (size_t i=0; i<totpix; ++i) if (d[i]) ++pixels;
 
 	printf("%d,%d\n",pixels,nimg);
-	A=gsl_matrix_alloc(pixels,nimg);
+	if (approx==1) Af.resize((size_t)pixels*nimg);
+	else if (approx==2) {
+		buf.resize((size_t)pixels*chunk);
+		nbuf=0;
+		rank=0;
+	}
+	else A=gsl_matrix_alloc(pixels,nimg);
 	nsofar=0;
 }
 
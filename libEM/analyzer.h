@@ -223,7 +223,11 @@ namespace EMAN
 	 * returned result is a set of classification vectors
 	 * @author Steve Ludtke
 	 * @date 03/02/2008
+	 * Assignment and center updates are multithreaded (EMAN_NUM_THREADS), and
+	 * distance bounds let particles that cannot have changed class skip the full
+	 * search, so late iterations are much cheaper than the first.
 	 * @param verbose Display progress if set, more detail with larger numbers (9 max)
+	 * @param seedmode 0 - random element (default), 1 - max sum, min sum, linear, 2 - k-means++
 	 * @param ncls number of desired classes
 	 * @param maxiter maximum number of iterations
 	 * @param minchange Terminate if fewer than minchange members move in an iteration
@@ -236,7 +240,7 @@ namespace EMAN
 	class KMeansAnalyzer:public Analyzer
 	{
 	  public:
-		KMeansAnalyzer() : ncls(0),verbose(0),minchange(0),maxiter(100),mininclass(2),slowseed(0) {}
+		KMeansAnalyzer() : ncls(0),verbose(0),minchange(0),maxiter(100),mininclass(2),slowseed(0),calcsigmamean(0),outlierclass(0),dim(0) {}
 
 		virtual int insert_image(EMData *image) {
 			images.push_back(image);
@@ -266,7 +270,7 @@ namespace EMAN
 		{
 			TypeDict d;
 			d.put("verbose", EMObject::INT, "Display progress if set, more detail with larger numbers (9 max)");
-			d.put("seedmode",EMObject::INT, "How to generate initial seeds. 0 - random element (default), 1 - max sum, min sum, linear");
+			d.put("seedmode",EMObject::INT, "How to generate initial seeds. 0 - random element (default), 1 - max sum, min sum, linear, 2 - k-means++");
 			d.put("ncls", EMObject::INT, "number of desired classes");
 			d.put("maxiter", EMObject::INT, "maximum number of iterations (default=100)");
 			d.put("minchange", EMObject::INT, "Terminate if fewer than minchange members move in an iteration");
@@ -284,6 +288,7 @@ namespace EMAN
 		void reclassify();
 		void reseed();
 		void resort();
+		void seed_plusplus();
 
 		vector<EMData *> centers;
 		int ncls;	//number of current classes
@@ -297,24 +302,46 @@ namespace EMAN
 		int calcsigmamean;
 		int outlierclass;
 
+		// working state of analyze(). Particles are used in place through
+		// pointers to their data, and reclassify() keeps Hamerly style bounds
+		// so most particles only need the distance to their own center.
+		vector<float *> rows;		// data of each particle
+		size_t dim;					// pixels per particle
+		vector<int> assign;			// class of each particle
+		vector<float> cendist;		// squared distance to its center
+		vector<float> lower;		// lower bound on the distance to any other center
+		vector<EMData *> boundcen;	// centers the bounds were computed against
+		vector<float> boundpos;		// and their positions at that time
+
 	};
 
 	/**Singular Value Decomposition from GSL. Comparable to pca
+	 * The default full mode decomposes the complete pixels x images matrix, which
+	 * is O(nimg^3). For large stacks, mode "randomized" finds the leading
+	 * subspace with a few multithreaded passes over the stored images (Halko,
+	 * Martinsson & Tropp), and mode "incremental" never stores the images at all,
+	 * folding each chunk into a rank nvec+oversample basis as it is inserted.
+	 * Both return the leading left singular vectors as eigenimages with their
+	 * "eigval" like the full mode, to within the accuracy of the approximation.
 	 *@param mask mask image
 	 *@param nvec number of desired basis vectors
 	 *@param nimg total number of input images, required even with insert_image()
+	 *@param mode full (default), randomized or incremental
+	 *@param oversample extra basis vectors used by the approximate modes, default 10
+	 *@param poweriter power iterations in randomized mode, default 2
+	 *@param chunk images per update in incremental mode, default 256
 	 */
 	class SVDAnalyzer : public Analyzer
 	{
 	  public:
-		SVDAnalyzer() : mask(0), nvec(0), nimg(0), A(NULL) {}
+		SVDAnalyzer() : mask(0), nvec(0), nimg(0), approx(0), oversample(10), poweriter(2), chunk(256), nsofar(0), A(NULL), rank(0), nbuf(0) {}
 
 		virtual int insert_image(EMData * image);
 
 		virtual int insert_images_list(vector<EMData *> image_list) {
 			vector<EMData*>::const_iterator iter;
 			for(iter=image_list.begin(); iter!=image_list.end(); ++iter) {
-				images.push_back(*iter);
+				insert_image(*iter);
 			}
 			return 0;
 		}
@@ -344,6 +371,10 @@ namespace EMAN
 			d.put("mask", EMObject::EMDATA, "mask image");
 			d.put("nvec", EMObject::INT, "number of desired basis vectors");
 			d.put("nimg", EMObject::INT, "total number of input images, required even with insert_image()");
+			d.put("mode", EMObject::STRING, "full (default) - exact SVD, randomized - randomized range finder, incremental - streaming updates, the images are not kept");
+			d.put("oversample", EMObject::INT, "extra basis vectors used by the randomized and incremental modes, default 10");
+			d.put("poweriter", EMObject::INT, "number of power iterations in randomized mode, default 2");
+			d.put("chunk", EMObject::INT, "number of images per update in incremental mode, default 256");
 			return d;
 		}
 
@@ -354,10 +385,25 @@ namespace EMAN
 		int nvec;	//number of desired principal components
 		int pixels;	// pixels under the mask
 		int nimg; // number of input images
+		int approx;	// 0 full, 1 randomized, 2 incremental
+		int oversample;
+		int poweriter;
+		int chunk;
 
 		private:
+		vector<EMData*> analyze_randomized();
+		vector<EMData*> analyze_incremental();
+		void update_incremental();
+		vector<EMData*> unpack_basis(const vector<float> & basis, int ncol, const vector<double> & sval);
+
 		int nsofar;
 		gsl_matrix *A;
+		vector<float> Af;		// randomized mode, masked images one after another
+		vector<float> U;		// incremental mode, pixels x rank basis, row major
+		vector<double> S;		// and its singular values
+		int rank;
+		vector<float> buf;		// images waiting for the next update, pixels x chunk, row major
+		int nbuf;
 	};
 
 		
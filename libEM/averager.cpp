@@ -33,6 +33,7 @@
 #include "emdata.h"
 #include "xydata.h"
 #include "ctf.h"
+#include "emthreads.h"
 #include <cstring>
 #include "plugins/averager_template.h"
 
@@ -90,6 +91,15 @@ void Averager::add_image_list(const vector<EMData*> & image_list)
 	}
 }
 
+void Averager::add_image_stack(const EMDataStack & stack)
+{
+	for (int i = 0; i < stack.get_n(); i++) {
+		EMData *image = stack.get_image(i);
+		add_image(image);
+		delete image;
+	}
+}
+
 TomoAverager::TomoAverager()
 	: norm_image(0),nimg(0),overlap(0)
 {
@@ -284,6 +294,48 @@ void ImageAverager::add_image(EMData * image)
 	}
 }
 
+void ImageAverager::add_image_stack(const EMDataStack & stack)
+{
+	int n = stack.get_n();
+	if (n == 0) return;
+
+	// the first image goes through add_image, which sets up the result
+	EMData *first = stack.get_image(0);
+	add_image(first);
+	delete first;
+
+	if (n == 1) return;
+	if (ignore0 || !result || result->get_xsize() != stack.get_xsize() ||
+		result->get_ysize() != stack.get_ysize() || result->get_zsize() != stack.get_zsize()) {
+		for (int i = 1; i < n; i++) {
+			EMData *image = stack.get_image(i);
+			add_image(image);
+			delete image;
+		}
+		return;
+	}
+
+	// Sum down the stack one block of pixels at a time. Each pixel still
+	// accumulates the images in order, so the result matches add_image.
+	size_t image_size = stack.get_image_size();
+	const float *stack_data = stack.get_data();
+	float *result_data = result->get_data();
+	float *sigma_image_data = sigma_image ? sigma_image->get_data() : 0;
+
+	EMThreads::parallel_for(image_size, [&](size_t b, size_t e, int) {
+		for (int i = 1; i < n; i++) {
+			const float *image_data = stack_data + (size_t)i * image_size;
+			for (size_t j = b; j < e; ++j) {
+				float f = image_data[j];
+				result_data[j] += f;
+				if (sigma_image_data) sigma_image_data[j] += f * f;
+			}
+		}
+	}, 4096);
+
+	nimg += n - 1;
+}
+
 EMData * ImageAverager::finish()
 {
 	if (result && nimg > 1) {
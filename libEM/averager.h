@@ -34,6 +34,7 @@
 
 #include "emobject.h"
 #include "emdata.h"
+#include "emdatastack.h"
 
 #include <vector>
 using std::vector;
@@ -110,6 +111,13 @@ namespace EMAN
 		 */
 		virtual void add_image_list(const vector<EMData*> & images);
 
+		/** To add every image of an EMDataStack to the Averager.
+		 * The default adds a view of each image in turn; averagers
+		 * that can work on the stack buffer directly override it.
+		 * @param stack The images to be averaged.
+		 */
+		virtual void add_image_stack(const EMDataStack & stack);
+
 		/** Finish up the averaging and return the result.
 		 *
 		 * @return The averaged image.
@@ -169,6 +177,7 @@ namespace EMAN
 		ImageAverager();
 
 		void add_image( EMData * image);
+		void add_image_stack(const EMDataStack & stack);
 		EMData * finish();
 
 		string get_name() const
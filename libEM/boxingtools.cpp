@@ -32,6 +32,9 @@
 
 #include "boxingtools.h"
 #include "exception.h"
+#include "emthreads.h"
+#include "processor.h"
+#include "io/imageio.h"
 using namespace EMAN;
 
 
@@ -502,7 +505,7 @@ vector<float> BoxingTools::get_min_delta_profile(const EMData* const image, int
 	vector<float> profile(radius,0); // this sets the vectors size to radius, and the values to 0
 	int radius_squared = radius*radius;
 
-	static vector<float> squared_numbers;
+	static thread_local vector<float> squared_numbers;
 	if ( (unsigned int)(radius+1) > squared_numbers.size() ) {
 		for(int i = squared_numbers.size(); i <= radius; ++i) {
 			squared_numbers.push_back((float)(i*i));
@@ -677,7 +680,7 @@ bool BoxingTools::hi_brid(const EMData* const image, int x, int y, int radius,EM
 
 	int radius_squared = radius*radius;
 
-	static vector<float> squared_numbers;
+	static thread_local vector<float> squared_numbers;
 	if ( (unsigned int)(radius+1) > squared_numbers.size() ) {
 		for(int i = squared_numbers.size(); i <= radius; ++i) {
 			squared_numbers.push_back((float)(i*i));
@@ -897,3 +900,269 @@ Vec3f BoxingTools::get_color( const unsigned int index )
 	return colors[index];
 }
 
+
+/* Copy one box out of src. src holds planes [zoff, zoff+src->get_zsize()) of the full
+ * image, and c is the box center in full-image coordinates. */
+static EMData* cut_box(const EMData* const src, int zoff, const Vec3i& c, int boxsize, bool is3d, float fill)
+{
+	int nx = src->get_xsize(), ny = src->get_ysize(), nz = src->get_zsize();
+	int bz = is3d ? boxsize : 1;
+	int x0 = c[0] - boxsize/2, y0 = c[1] - boxsize/2, z0 = is3d ? c[2] - boxsize/2 - zoff : 0;
+
+	EMData* box = new EMData(boxsize, boxsize, bz);
+	float* dst = box->get_data();
+	const float* sdata = src->get_const_data();
+
+	for (int z = 0; z < bz; z++) {
+		int sz = z0 + z;
+
+		for (int y = 0; y < boxsize; y++) {
+			float* row = dst + ((size_t)z*boxsize + y)*boxsize;
+			int sy = y0 + y;
+
+			if (sz < 0 || sz >= nz || sy < 0 || sy >= ny) {
+				std::fill(row, row + boxsize, fill);
+				continue;
+			}
+
+			// split the row into the parts before, inside and after the image
+			int xa = std::min(boxsize, std::max(0, -x0));
+			int xb = std::max(xa, std::min(boxsize, nx - x0));
+			const float* srow = sdata + ((size_t)sz*ny + sy)*nx + x0;
+
+			std::fill(row, row + xa, fill);
+			std::copy(srow + xa, srow + xb, row + xa);
+			std::fill(row + xb, row + boxsize, fill);
+		}
+	}
+
+	box->update();
+	return box;
+}
+
+/* Set the pixels of a box read from a file which lie outside the image to fill.
+ * o is the box origin in image coordinates. */
+static void fill_outside(EMData* box, const Vec3i& o, int nx, int ny, int nz, float fill)
+{
+	int bx = box->get_xsize(), by = box->get_ysize(), bz = box->get_zsize();
+	int xa = std::min(bx, std::max(0, -o[0]));
+	int xb = std::max(xa, std::min(bx, nx - o[0]));
+	float* dst = box->get_data();
+
+	for (int z = 0; z < bz; z++) {
+		int sz = o[2] + z;
+
+		for (int y = 0; y < by; y++) {
+			float* row = dst + ((size_t)z*by + y)*bx;
+			int sy = o[1] + y;
+
+			if (sz < 0 || sz >= nz || sy < 0 || sy >= ny) {
+				std::fill(row, row + bx, fill);
+				continue;
+			}
+
+			std::fill(row, row + xa, fill);
+			std::fill(row + xb, row + bx, fill);
+		}
+	}
+
+	box->update();
+}
+
+/* The per-box processing options shared by the extraction routines */
+namespace {
+	struct BoxOptions {
+		int shrink;
+		string normproc;
+		bool invert;
+		float fill;
+
+		BoxOptions(Dict params) {
+			shrink = params.set_default("shrink", 1);
+			normproc = params.has_key("normproc") ? (string)params["normproc"] : string("");
+			invert = params.set_default("invert", false);
+			fill = params.set_default("fill", 0.0f);
+		}
+
+		/* Processors are not safe to run concurrently, so this is only
+		 * ever called from one thread */
+		void apply(EMData* box, const Vec3i& c, bool is3d) const {
+			if (shrink > 1) box->process_inplace("math.fft.resample", Dict("n", (float)shrink));
+			if (!normproc.empty()) box->process_inplace(normproc);
+			if (invert) box->mult(-1.0f);
+
+			vector<int> coord = {c[0], c[1]};
+			if (is3d) coord.push_back(c[2]);
+			box->set_attr("ptcl_source_coord", coord);
+		}
+	};
+}
+
+/* Order of the boxes for extraction, by z then y, so neighboring boxes read neighboring memory */
+static vector<size_t> box_order(const vector<Vec3i>& centers, bool is3d)
+{
+	vector<size_t> order(centers.size());
+	for (size_t i = 0; i < order.size(); i++) order[i] = i;
+
+	std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+		if (is3d && centers[a][2] != centers[b][2]) return centers[a][2] < centers[b][2];
+		return centers[a][1] < centers[b][1];
+	});
+
+	return order;
+}
+
+vector<EMData*> BoxingTools::extract_boxes(const EMData* const image, const vector<Vec3i>& centers,
+				int boxsize, const Dict& params)
+{
+	if (!image) throw NullPointerException("NULL image");
+	if (boxsize <= 0) throw InvalidValueException(boxsize, "boxsize must be positive");
+
+	bool is3d = image->get_zsize() > 1;
+	BoxOptions opt(params);
+	vector<size_t> order = box_order(centers, is3d);
+	vector<EMData*> ret(centers.size(), (EMData*)0);
+
+	try {
+		EMThreads::parallel_for_each(order.size(), [&](size_t i, int) {
+			size_t n = order[i];
+			ret[n] = cut_box(image, 0, centers[n], boxsize, is3d, opt.fill);
+		});
+
+		for (size_t n = 0; n < ret.size(); n++) opt.apply(ret[n], centers[n], is3d);
+	}
+	catch (...) {
+		for (auto b : ret) delete b;
+		throw;
+	}
+
+	return ret;
+}
+
+int BoxingTools::extract_boxes_to_file(const string& infile, int image_index, const vector<Vec3i>& centers,
+				int boxsize, const string& outfile, const Dict& params)
+{
+	if (boxsize <= 0) throw InvalidValueException(boxsize, "boxsize must be positive");
+
+	EMData hdr;
+	hdr.read_image(infile, image_index, true);
+	int nx = hdr.get_xsize(), ny = hdr.get_ysize(), nz = hdr.get_zsize();
+	bool is3d = nz > 1;
+	int bz = is3d ? boxsize : 1;
+
+	// Only these formats read a region without touching the rest of the image. Others
+	// may read whole frames into the buffer or reject regions overhanging the image,
+	// so their boxes are cut from the whole image (2-D) or from slabs of planes (3-D).
+	EMUtil::ImageType itype = EMUtil::get_image_type(infile);
+	bool byregion = itype == EMUtil::IMAGE_MRC || itype == EMUtil::IMAGE_HDF;
+
+	BoxOptions opt(params);
+	size_t batchmem = (size_t)(params.has_key("batchmem") ? (int)params["batchmem"] : 512) << 20;
+	size_t boxbytes = (size_t)boxsize*boxsize*bz*sizeof(float);
+	size_t perbatch = std::max((size_t)1, batchmem / boxbytes);
+	int maxplanes = std::max(boxsize, (int)std::min(batchmem / ((size_t)nx*ny*sizeof(float)), (size_t)nz));
+
+	vector<size_t> order = box_order(centers, is3d);
+	vector<EMData*> done(centers.size(), (EMData*)0);
+	size_t next_write = 0;
+
+	ImageIO* imageio = 0;
+	EMData whole;
+	if (byregion) {
+		imageio = EMUtil::get_imageio(infile, ImageIO::READ_ONLY);
+		if (!imageio) throw ImageFormatException("cannot create an image io");
+	}
+	else if (!is3d) whole.read_image(infile, image_index);
+
+	try {
+		size_t end = 0;
+		for (size_t pos = 0; pos < order.size(); pos = end) {
+			end = std::min(order.size(), pos + perbatch);
+
+			if (byregion) {
+				vector<Region> areas;
+				vector<float*> data;
+				vector<Vec3i> origins;
+
+				for (size_t i = pos; i < end; i++) {
+					const Vec3i& c = centers[order[i]];
+					Vec3i o(c[0] - boxsize/2, c[1] - boxsize/2, is3d ? c[2] - boxsize/2 : 0);
+					EMData* box = new EMData(boxsize, boxsize, bz);
+
+					done[order[i]] = box;
+					origins.push_back(o);
+					data.push_back(box->get_data());
+
+					if (is3d) areas.push_back(Region(o[0], o[1], o[2], boxsize, boxsize, boxsize));
+					else areas.push_back(Region(o[0], o[1], boxsize, boxsize));
+				}
+
+				// one sorted pass over the file for the whole batch
+				if (imageio->read_data_regions(data, image_index, areas)) {
+					throw ImageReadException(infile, "error reading particle boxes");
+				}
+
+				for (size_t i = pos; i < end; i++) fill_outside(done[order[i]], origins[i - pos], nx, ny, nz, opt.fill);
+			}
+			else {
+				const EMData* src = &whole;
+				EMData slab;
+				int z0 = 0;
+
+				if (is3d) {
+					// shorten the batch to the run of boxes whose z range fits in one slab
+					z0 = centers[order[pos]][2] - boxsize/2;
+					int z1 = z0 + boxsize;
+					size_t last = pos + 1;
+					while (last < end && centers[order[last]][2] - boxsize/2 + boxsize - z0 <= maxplanes) {
+						z1 = centers[order[last]][2] - boxsize/2 + boxsize;
+						last++;
+					}
+					end = last;
+					z0 = std::max(z0, 0);
+					z1 = std::min(z1, nz);
+
+					if (z1 <= z0) {
+						// entirely outside the volume, nothing to read
+						for (size_t i = pos; i < end; i++) {
+							done[order[i]] = new EMData(boxsize, boxsize, boxsize);
+							done[order[i]]->to_value(opt.fill);
+						}
+						src = 0;
+					}
+					else {
+						Region r(0, 0, z0, nx, ny, z1 - z0);
+						slab.read_image(infile, image_index, false, &r);
+						src = &slab;
+					}
+				}
+
+				if (src) {
+					EMThreads::parallel_for_each(end - pos, [&](size_t i, int) {
+						size_t n = order[pos + i];
+						done[n] = cut_box(src, z0, centers[n], boxsize, is3d, opt.fill);
+					});
+				}
+			}
+
+			for (size_t i = pos; i < end; i++) opt.apply(done[order[i]], centers[order[i]], is3d);
+
+			// write whatever is complete, in the original order
+			for (; next_write < done.size() && done[next_write]; next_write++) {
+				done[next_write]->set_attr("ptcl_source_image", infile);
+				done[next_write]->write_image(outfile, (int)next_write);
+				delete done[next_write];
+				done[next_write] = 0;
+			}
+		}
+	}
+	catch (...) {
+		if (imageio) EMUtil::close_imageio(infile, imageio);
+		for (size_t i = next_write; i < done.size(); i++) delete done[i];
+		throw;
+	}
+
+	if (imageio) EMUtil::close_imageio(infile, imageio);
+
+	return (int)next_write;
+}
@@ -106,6 +106,47 @@ namespace EMAN
 		};
 
 		static void set_mode( const CmpMode m ) { mode = m; }
+
+		/** Extract many particle boxes from an image in memory. Boxes are cut in
+		 * parallel, visiting the source in (z,y) order for locality, then processed
+		 * one at a time, and returned in the order of centers. Parts of a box outside the image are filled.
+		 *
+		 * Supported params:
+		 * - "shrink" (int) Fourier downsampling factor applied to each box, default 1
+		 * - "normproc" (string) name of a normalization processor applied to each box, default none
+		 * - "invert" (bool) multiply each box by -1, default false
+		 * - "fill" (float) value used outside the image, default 0
+		 *
+		 * @param image the micrograph or tomogram
+		 * @param centers box centers in pixels, z is ignored for 2-D images
+		 * @param boxsize box size in pixels before shrinking
+		 * @param params processing options, see above
+		 * @return one new image per center, owned by the caller
+		 */
+		static vector<EMData*> extract_boxes(const EMData* const image, const vector<Vec3i>& centers,
+						int boxsize, const Dict& params = Dict());
+
+		/** Extract many particle boxes from an image file and write them to a stack.
+		 * The boxes are sorted by z and y and read in batches. MRC and HDF files
+		 * use ImageIO::read_data_regions(), which fetches a whole batch in one pass
+		 * over the file. Other 2-D formats are read whole and cut, and other 3-D
+		 * formats are read in slabs of planes, so a tomogram never has to be held
+		 * in memory. Pixels outside the image are set to the fill value. Particles
+		 * are written to outfile in the order of centers, starting at image 0.
+		 *
+		 * In addition to the params of extract_boxes():
+		 * - "batchmem" (int) maximum memory in MB used for one batch of boxes or one slab, default 512
+		 *
+		 * @param infile the micrograph or tomogram file
+		 * @param image_index image number in infile
+		 * @param centers box centers in pixels, z is ignored for 2-D images
+		 * @param boxsize box size in pixels before shrinking
+		 * @param outfile the particle stack to write
+		 * @param params processing options
+		 * @return the number of particles written
+		 */
+		static int extract_boxes_to_file(const string& infile, int image_index, const vector<Vec3i>& centers,
+						int boxsize, const string& outfile, const Dict& params = Dict());
 	private:
 		// A vector to store the "seed" starting colors, which exist at the corners of the cube.
 		// Then the vector is grown as more colours are asked for.
@@ -35,6 +35,7 @@
 #include "plugins/cmp_template.h"
 #undef max
 #include <climits>
+#include <algorithm>
 
 #ifdef EMAN2_USING_CUDA
 // Only CCC, DOT  and CCC.TOMO are cuda enabled
@@ -450,6 +451,29 @@ float DotCmp::cmp(EMData* image, EMData* with) const
 		}
 	}
 #endif
+	if (!image->is_complex() && !with->is_complex() && !params.has_key("mask") &&
+		(image->get_half_storage() || with->get_half_storage())) {
+		// read half precision images block by block rather than expanding them
+		size_t totsize = (size_t)image->get_xsize() * image->get_ysize() * image->get_zsize();
+		const size_t block = 4096;
+		float xbuf[block], ybuf[block];
+		double result = 0.;
+		for (size_t i0 = 0; i0 < totsize; i0 += block) {
+			size_t n = std::min(block, totsize - i0);
+			const float *const xb = image->get_const_data_block(i0, n, xbuf);
+			const float *const yb = with->get_const_data_block(i0, n, ybuf);
+			for (size_t i = 0; i < n; i++) result += xb[i]*yb[i];
+		}
+		if (normalize) {
+			double square_sum1 = image->get_attr("square_sum");
+			double square_sum2 = with->get_attr("square_sum");
+			result /= sqrt(square_sum1*square_sum2);
+		}
+		else result /= totsize;
+		EXITFUNC;
+		return (float) (negative*result);
+	}
+
 	const float *const x_data = image->get_const_data();
 	const float *const y_data = with->get_const_data();
 
@@ -0,0 +1,103 @@
+/*
+ * This software is issued under a joint BSD/GNU license. You may use the
+ * source code in this file under either license. However, note that the
+ * complete EMAN2 and SPARX software packages have some GPL dependencies,
+ * so you are responsible for compliance with the licenses of these packages
+ * if you opt to use BSD licensing. The warranty disclaimer below holds
+ * in either instance.
+ *
+ * This complete copyright notice must be included in any revised version of the
+ * source code. Additional authorship citations may be added, but existing
+ * author citations must be preserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA 
+ */
+
+#include "embuffer.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+
+using namespace EMAN;
+
+std::atomic<int> ExternalBuffer::live(0);
+
+namespace {
+	struct Block {
+		size_t nbytes;
+		ExternalBuffer::Release release;
+	};
+
+	std::mutex registry_mutex;
+	std::multimap<const void *, Block> registry;	// several images may share one block
+
+	bool take_block(const void *ptr, Block & blk) {
+		std::lock_guard<std::mutex> lock(registry_mutex);
+		std::multimap<const void *, Block>::iterator it = registry.find(ptr);
+		if (it == registry.end()) return false;
+		blk = it->second;
+		registry.erase(it);
+		return true;
+	}
+}
+
+void ExternalBuffer::add(void *ptr, size_t nbytes, const Release & release)
+{
+	Block blk = { nbytes, release };
+	{
+		std::lock_guard<std::mutex> lock(registry_mutex);
+		registry.insert(std::make_pair(ptr, blk));
+	}
+	live.fetch_add(1, std::memory_order_release);
+}
+
+bool ExternalBuffer::contains(const void *ptr)
+{
+	if (!ptr || !active()) return false;
+
+	std::lock_guard<std::mutex> lock(registry_mutex);
+	return registry.find(ptr) != registry.end();
+}
+
+bool ExternalBuffer::release(void *ptr)
+{
+	Block blk;
+	if (!ptr || !take_block(ptr, blk)) return false;
+
+	live.fetch_sub(1, std::memory_order_release);
+	if (blk.release) blk.release();
+	return true;
+}
+
+void *ExternalBuffer::to_heap(void *ptr, size_t new_size)
+{
+	Block blk;
+	if (!ptr || !take_block(ptr, blk)) return 0;
+
+	void *heap = malloc(new_size);
+	if (!heap) {
+		// keep the block so the caller sees a normal realloc failure
+		std::lock_guard<std::mutex> lock(registry_mutex);
+		registry.insert(std::make_pair(ptr, blk));
+		return 0;
+	}
+
+	memcpy(heap, ptr, blk.nbytes < new_size ? blk.nbytes : new_size);
+	live.fetch_sub(1, std::memory_order_release);
+	if (blk.release) blk.release();
+	return heap;
+}
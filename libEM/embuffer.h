@@ -0,0 +1,78 @@
+/*
+ * This software is issued under a joint BSD/GNU license. You may use the
+ * source code in this file under either license. However, note that the
+ * complete EMAN2 and SPARX software packages have some GPL dependencies,
+ * so you are responsible for compliance with the licenses of these packages
+ * if you opt to use BSD licensing. The warranty disclaimer below holds
+ * in either instance.
+ *
+ * This complete copyright notice must be included in any revised version of the
+ * source code. Additional authorship citations may be added, but existing
+ * author citations must be preserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA 
+ */
+
+#ifndef eman__embuffer_h__
+#define eman__embuffer_h__ 1
+
+#include <cstddef>
+#include <atomic>
+#include <functional>
+
+namespace EMAN
+{
+	/** ExternalBuffer lets an EMData use pixel memory owned by something else,
+	 * typically a NumPy array, without copying it. The owner registers the
+	 * block together with a release function; when the EMData frees its data
+	 * through EMUtil::em_free the release function is called instead of free().
+	 * If the image is resized, EMUtil::em_realloc copies the data to the heap
+	 * and releases the external block, so the image never writes past it.
+	 */
+	class ExternalBuffer
+	{
+	  public:
+		typedef std::function<void()> Release;
+
+		/** Register an externally owned block. The same block may be registered
+		 * more than once, once for each image using it.
+		 * @param ptr start of the block, used as the EMData rdata
+		 * @param nbytes size of the block
+		 * @param release called exactly once when the block is no longer used */
+		static void add(void *ptr, size_t nbytes, const Release & release);
+
+		/** @return true if ptr is a registered external block */
+		static bool contains(const void *ptr);
+
+		/** Call the release function of ptr and forget it.
+		 * @return false if ptr is not a registered external block */
+		static bool release(void *ptr);
+
+		/** Copy min(new_size, block size) bytes of ptr into a new heap block,
+		 * then release ptr. Used by EMUtil::em_realloc.
+		 * @return the new heap block, or 0 if ptr is not registered or the
+		 * allocation failed */
+		static void *to_heap(void *ptr, size_t new_size);
+
+		/** @return true if any external block is registered. Keeps the common
+		 * path through em_free lock free. */
+		static bool active() { return live.load(std::memory_order_acquire) > 0; }
+
+	  private:
+		static std::atomic<int> live;
+	};
+}
+
+#endif	//eman__embuffer_h__
@@ -74,7 +74,7 @@ EMData::EMData() :
 #ifdef FFT_CACHING
 	fftcache(0),
 #endif //FFT_CACHING
-		attr_dict(), rdata(0), supp(0), flags(0), changecount(0), nx(0), ny(0), nz(0), nxy(0), nxyz(0), xoff(0), yoff(0),
+		attr_dict(), rdata(0), supp(0), hdata(0), halfmode(0), flags(0), changecount(0), nx(0), ny(0), nz(0), nxy(0), nxyz(0), xoff(0), yoff(0),
 		zoff(0), all_translation(),	path(""), pathnum(0), rot_fp(0)
 
 {
@@ -105,7 +105,7 @@ EMData::EMData(const string& filename, int image_index) :
 #ifdef FFT_CACHING
 	fftcache(0),
 #endif //FFT_CACHING
-		attr_dict(), rdata(0), supp(0), flags(0), changecount(0), nx(0), ny(0), nz(0), nxy(0), nxyz(0), xoff(0), yoff(0), zoff(0),
+		attr_dict(), rdata(0), supp(0), hdata(0), halfmode(0), flags(0), changecount(0), nx(0), ny(0), nz(0), nxy(0), nxyz(0), xoff(0), yoff(0), zoff(0),
 		all_translation(),	path(filename), pathnum(image_index), rot_fp(0)
 {
 	ENTERFUNC;
@@ -138,7 +138,7 @@ EMData::EMData(const EMData& that) :
 #ifdef FFT_CACHING
 	fftcache(0),
 #endif //FFT_CACHING
-		attr_dict(that.attr_dict), rdata(0), supp(0), flags(that.flags), changecount(that.changecount), nx(that.nx), ny(that.ny), nz(that.nz),
+		attr_dict(that.attr_dict), rdata(0), supp(0), hdata(0), halfmode(0), flags(that.flags), changecount(that.changecount), nx(that.nx), ny(that.ny), nz(that.nz),
 		nxy(that.nx*that.ny), nxyz((size_t)that.nx*that.ny*that.nz), xoff(that.xoff), yoff(that.yoff), zoff(that.zoff),all_translation(that.all_translation),	path(that.path),
 		pathnum(that.pathnum), rot_fp(0)
 {
@@ -151,6 +151,13 @@ EMData::EMData(const EMData& that) :
 		rdata = (float*)EMUtil::em_malloc(num_bytes);
 		EMUtil::em_memcpy(rdata, data, num_bytes);
 	}
+	else if (that.hdata && num_bytes != 0)
+	{
+		// copies of a half precision image stay half precision
+		hdata = (unsigned short*)EMUtil::em_malloc(nxyz*sizeof(unsigned short));
+		EMUtil::em_memcpy(hdata, that.hdata, nxyz*sizeof(unsigned short));
+		halfmode = that.halfmode;
+	}
 #ifdef EMAN2_USING_CUDA
 	if (EMData::usecuda == 1 && num_bytes != 0 && that.cudarwdata != 0) {
 		//cout << "That copy constructor" << endl;
@@ -187,6 +194,13 @@ EMData& EMData::operator=(const EMData& that)
 			set_size(that.nx,that.ny,that.nz);
 			EMUtil::em_memcpy(rdata, data, num_bytes);
 		}
+		else if (that.hdata && num_bytes != 0)
+		{
+			set_size(that.nx,that.ny,that.nz,true);
+			hdata = (unsigned short*)EMUtil::em_malloc(nxyz*sizeof(unsigned short));
+			EMUtil::em_memcpy(hdata, that.hdata, nxyz*sizeof(unsigned short));
+			halfmode = that.halfmode;
+		}
 
 		flags = that.flags;
 
@@ -210,6 +224,7 @@ EMData& EMData::operator=(const EMData& that)
 #endif //EMAN2_USING_CUDA
 
 		changecount = that.changecount;
+		clear_volume_summary();
 
 		if (that.rot_fp != 0) rot_fp = new EMData(*(that.rot_fp));
 		else rot_fp = 0;
@@ -225,7 +240,7 @@ EMData::EMData(int nx, int ny, int nz, bool is_real) :
 #ifdef FFT_CACHING
 	fftcache(0),
 #endif //FFT_CACHING
-		attr_dict(), rdata(0), supp(0), flags(0), changecount(0), nx(0), ny(0), nz(0), nxy(0), nxyz(0), xoff(0), yoff(0), zoff(0),
+		attr_dict(), rdata(0), supp(0), hdata(0), halfmode(0), flags(0), changecount(0), nx(0), ny(0), nz(0), nxy(0), nxyz(0), xoff(0), yoff(0), zoff(0),
 		all_translation(),	path(""), pathnum(0), rot_fp(0)
 {
 	ENTERFUNC;
@@ -280,7 +295,7 @@ EMData::EMData(float* data, const int x, const int y, const int z, const Dict& a
 #ifdef FFT_CACHING
 	fftcache(0),
 #endif //FFT_CACHING
-		attr_dict(attr_dict), rdata(data), supp(0), flags(0), changecount(0), nx(x), ny(y), nz(z), nxy(x*y), nxyz((size_t)x*y*z), xoff(0),
+		attr_dict(attr_dict), rdata(data), supp(0), hdata(0), halfmode(0), flags(0), changecount(0), nx(x), ny(y), nz(z), nxy(x*y), nxyz((size_t)x*y*z), xoff(0),
 		yoff(0), zoff(0), all_translation(), path(""), pathnum(0), rot_fp(0)
 {
 	ENTERFUNC;
@@ -305,7 +320,7 @@ EMData::EMData(float* data, float* cudadata, const int x, const int y, const int
 #ifdef FFT_CACHING
 	fftcache(0),
 #endif //FFT_CACHING
-		attr_dict(attr_dict), rdata(data), supp(0), flags(0), changecount(0), nx(x), ny(y), nz(z), nxy(x*y), nxyz((size_t)x*y*z), xoff(0),
+		attr_dict(attr_dict), rdata(data), supp(0), hdata(0), halfmode(0), flags(0), changecount(0), nx(x), ny(y), nz(z), nxy(x*y), nxyz((size_t)x*y*z), xoff(0),
 		yoff(0), zoff(0), all_translation(), path(""), pathnum(0), rot_fp(0)
 {
 	ENTERFUNC;
@@ -334,6 +349,7 @@ EMData::~EMData()
 #ifdef FFT_CACHING
 	if (fftcache!=0) { delete fftcache; fftcache=0;}
 #endif //FFT_CACHING
+	clear_volume_summary();
 	free_memory();
 
 #ifdef EMAN2_USING_CUDA
@@ -1868,11 +1884,10 @@ EMData *EMData::make_rotational_footprint_cmc( bool unwrap) {
 		return new EMData(*rot_fp);
 	}
 
-	static EMData obj_filt;
-	static int updsize = 0;		// for threadsafety
+	// one cached filter per thread, so concurrent callers never resize it under each other
+	static thread_local EMData obj_filt;
 	EMData* filt = &obj_filt;
 	filt->set_complex(true);
-	int delfilt = 0;
 
 	// The filter object is nothing more than a cached high pass filter
 	// Ultimately it is used an argument to the EMData::mult(EMData,prevent_complex_multiplication (bool))
@@ -1880,21 +1895,10 @@ EMData *EMData::make_rotational_footprint_cmc( bool unwrap) {
 	// set to true, which is used for speed reasons.
 	if (filt->get_xsize() != nx+2-(nx%2) || filt->get_ysize() != ny ||
 		   filt->get_zsize() != nz ) {
-		// In case of a threading conflict, this will ignore the cache for this specific computation
-		if (updsize) {
-			delfilt=1;
-			printf("FAILSAFE!!!!\n");
-			filt=new EMData(nx+2-(nx%2), ny, nz);
-			filt->to_one();
-			filt->process_inplace("filter.highpass.gauss", Dict("cutoff_abs", 1.5f/nx));
-		}
-		else {
-			updsize=1;
-			filt->set_size(nx+2-(nx%2), ny, nz);
-			filt->to_one();
+		filt->set_size(nx+2-(nx%2), ny, nz);
+		filt->to_one();
 
-			filt->process_inplace("filter.highpass.gauss", Dict("cutoff_abs", 1.5f/nx));
-		}
+		filt->process_inplace("filter.highpass.gauss", Dict("cutoff_abs", 1.5f/nx));
 	}
 
 	EMData *ccf = this->calc_mutual_correlation(this, true,filt);
@@ -1902,8 +1906,6 @@ EMData *EMData::make_rotational_footprint_cmc( bool unwrap) {
 	ccf->sub(ccf->get_edge_mean());
 	EMData *result = ccf->unwrap();
 	delete ccf; ccf = 0;
-	updsize=0;
-	if (delfilt) delete filt;
 
 	EXITFUNC;
 	if ( unwrap == true)
@@ -1973,7 +1975,7 @@ EMData *EMData::make_rotational_footprint_e1( bool unwrap)
 		return new EMData(*rot_fp);
 	}
 
-	static EMData obj_filt;
+	static thread_local EMData obj_filt;
 	EMData* filt = &obj_filt;
 	filt->set_complex(true);
 // 	Region filt_region;
@@ -1984,7 +1986,7 @@ EMData *EMData::make_rotational_footprint_e1( bool unwrap)
 
 	int cs = (((nx * 7 / 4) & 0xfffff8) - nx) / 2; // this pads the image to 1 3/4 * size with result divis. by 8
 
-	static EMData big_clip;
+	static thread_local EMData big_clip;
 	int big_x = nx+2*cs;
 	int big_y = ny+2*cs;
 	int big_z = 1;
@@ -2038,7 +2040,7 @@ EMData *EMData::make_rotational_footprint_e1( bool unwrap)
 	EMData *mc = big_clip.calc_mutual_correlation(&big_clip, true,filt);
  	mc->sub(mc->get_edge_mean());
 
-	static EMData sml_clip;
+	static thread_local EMData sml_clip;
 	int sml_x = nx * 3 / 2;
 	int sml_y = ny * 3 / 2;
 	int sml_z = 1;
@@ -3160,9 +3162,8 @@ void EMData::update_stat() const
 		EXITFUNC;
 		return;
 	}
-	if (rdata==0) return;
+	if (rdata==0 && hdata==0) return;
 
-	float* data = get_data();
 	float max = -FLT_MAX;
 	float min = -max;
 
@@ -3179,14 +3180,22 @@ void EMData::update_stat() const
 
 	size_t size = (size_t)nx*ny*nz;
 
-	for (size_t i = 0; i < size; i += step) {
-		float v = data[i];
-		max = Util::get_max(max, v);
-		min = Util::get_min(min, v);
-		sum += v;
-		square_sum += v * (double)(v);
-		if (v != 0) n_nonzero++;
-		if (isint && v!=floor(v)) isint=0;
+	// read in blocks so half precision storage is not expanded
+	const size_t block = 4096;
+	float buf[block];
+	for (size_t i0 = 0; i0 < size; i0 += block) {
+		size_t n = std::min(block, size - i0);
+		const float* data = get_const_data_block(i0, n, buf);
+
+		for (size_t i = 0; i < n; i += step) {
+			float v = data[i];
+			max = Util::get_max(max, v);
+			min = Util::get_min(min, v);
+			sum += v;
+			square_sum += v * (double)(v);
+			if (v != 0) n_nonzero++;
+			if (isint && v!=floor(v)) isint=0;
+		}
 	}
 
 	size_t n     = size / step;
@@ -54,6 +54,7 @@ using std::map;
 using std::ostream;
 
 #include <utility>
+#include <mutex>
 using std::pair;
 
 namespace EMAN
@@ -63,6 +64,7 @@ namespace EMAN
 	class XYData;
 	class Transform;
 	class GLUtil;
+	class VolumeSummary;
 	class EMBytes: public std::string {};
 
 	typedef boost::multi_array_ref<float, 2> MArray2D;
@@ -856,6 +858,10 @@ namespace EMAN
 		};
 
 		void update_stat() const;
+		/** Delete the cached VolumeSummary, called from update() */
+		void clear_volume_summary() const;
+		/** Replace half precision storage with a float copy of the data, see set_half_storage() */
+		void expand_half() const;
 		void save_byteorder_to_dict(ImageIO * imageio);
 
 	private:
@@ -865,6 +871,12 @@ namespace EMAN
 		mutable float *rdata;
 		/** supplementary data array */
 		float *supp;
+		/** pixel data as 16-bit values while half precision storage is active; rdata is 0 then */
+		mutable unsigned short *hdata;
+		/** HalfStorage mode of hdata */
+		int halfmode;
+		/** Serializes expand_half() between threads reading a half precision image */
+		mutable std::mutex half_mutex;
 
 		/** CTF data
 		 * All CTF data become attribute ctf(vector<float>) in attr_dict  --Grant Tang*/
@@ -890,6 +902,11 @@ namespace EMAN
 		/** This is a cached rotational footprint, can save much time */
 		mutable EMData* rot_fp;
 
+		/** Cached brick statistics, one per brick size, see get_volume_summary(). Deleted by update() */
+		mutable vector<VolumeSummary *> summaries;
+		/** Guards creation and deletion of the summaries */
+		mutable std::mutex summary_mutex;
+
 #ifdef FFT_CACHING
 		mutable EMData *fftcache;
 #endif
@@ -39,6 +39,7 @@ using namespace EMAN;
 // debug only
 #include <iostream>
 #include <cstring>
+#include <algorithm>
 
 using std::cout;
 using std::endl;
@@ -48,6 +49,9 @@ using std::endl;
 #include "cuda/cuda_cmp.h"
 #endif // EMAN2_USING_CUDA
 
+// pixels converted per step when a kernel reads another image's data in blocks
+static const size_t DATA_BLOCK = 4096;
+
 void EMData::free_memory()
 {
 	ENTERFUNC;
@@ -56,6 +60,11 @@ void EMData::free_memory()
 		rdata = 0;
 	}
 
+	if (hdata) {
+		EMUtil::em_free(hdata);
+		hdata = 0;
+	}
+
 	if (supp) {
 		EMUtil::em_free(supp);
 		supp = 0;
@@ -83,6 +92,10 @@ void EMData::free_rdata()
 		EMUtil::em_free(rdata);
 		rdata = 0;
 	}
+	if (hdata) {
+		EMUtil::em_free(hdata);
+		hdata = 0;
+	}
 	EXITFUNC;
 }
 
@@ -394,12 +407,17 @@ void EMData::add(const EMData & image)
 	}
 	else {
 
-		const float *src_data = image.get_data();
 		size_t size = nxyz;
 		float* data = get_data();
-
-		for (size_t i = 0; i < size; i++) {
-			data[i] += src_data[i];
+		float buf[DATA_BLOCK];
+
+		for (size_t i0 = 0; i0 < size; i0 += DATA_BLOCK) {
+			size_t n = std::min(DATA_BLOCK, size - i0);
+			const float *src_data = image.get_const_data_block(i0, n, buf);
+			float *dst = data + i0;
+			for (size_t i = 0; i < n; i++) {
+				dst[i] += src_data[i];
+			}
 		}
 		update();
 	}
@@ -419,12 +437,17 @@ void EMData::addsquare(const EMData & image)
 	}
 	else {
 
-		const float *src_data = image.get_data();
 		size_t size = nxyz;
 		float* data = get_data();
-
-		for (size_t i = 0; i < size; i++) {
-			data[i] += src_data[i]*src_data[i];
+		float buf[DATA_BLOCK];
+
+		for (size_t i0 = 0; i0 < size; i0 += DATA_BLOCK) {
+			size_t n = std::min(DATA_BLOCK, size - i0);
+			const float *src_data = image.get_const_data_block(i0, n, buf);
+			float *dst = data + i0;
+			for (size_t i = 0; i < n; i++) {
+				dst[i] += src_data[i]*src_data[i];
+			}
 		}
 		update();
 	}
@@ -444,12 +467,17 @@ void EMData::subsquare(const EMData & image)
 	}
 	else {
 
-		const float *src_data = image.get_data();
 		size_t size = nxyz;
 		float* data = get_data();
-
-		for (size_t i = 0; i < size; i++) {
-			data[i] -= src_data[i]*src_data[i];
+		float buf[DATA_BLOCK];
+
+		for (size_t i0 = 0; i0 < size; i0 += DATA_BLOCK) {
+			size_t n = std::min(DATA_BLOCK, size - i0);
+			const float *src_data = image.get_const_data_block(i0, n, buf);
+			float *dst = data + i0;
+			for (size_t i = 0; i < n; i++) {
+				dst[i] -= src_data[i]*src_data[i];
+			}
 		}
 		update();
 	}
@@ -516,12 +544,17 @@ void EMData::sub(const EMData & em)
 		throw ImageFormatException( "not support sub between real image and complex image");
 	}
 	else {
-		const float *src_data = em.get_data();
 		size_t size = nxyz;
 		float* data = get_data();
-
-		for (size_t i = 0; i < size; i++) {
-			data[i] -= src_data[i];
+		float buf[DATA_BLOCK];
+
+		for (size_t i0 = 0; i0 < size; i0 += DATA_BLOCK) {
+			size_t n = std::min(DATA_BLOCK, size - i0);
+			const float *src_data = em.get_const_data_block(i0, n, buf);
+			float *dst = data + i0;
+			for (size_t i = 0; i < n; i++) {
+				dst[i] -= src_data[i];
+			}
 		}
 		update();
 	}
@@ -570,13 +603,18 @@ void EMData::mult(const EMData & em, bool prevent_complex_multiplication)
 	}
 	else
 	{
-		const float *src_data = em.get_data();
 		size_t size = nxyz;
 		float* data = get_data();
 		if( is_real() || prevent_complex_multiplication )
 		{
-			for (size_t i = 0; i < size; i++) {
-				data[i] *= src_data[i];
+			float buf[DATA_BLOCK];
+			for (size_t i0 = 0; i0 < size; i0 += DATA_BLOCK) {
+				size_t n = std::min(DATA_BLOCK, size - i0);
+				const float *src_data = em.get_const_data_block(i0, n, buf);
+				float *dst = data + i0;
+				for (size_t i = 0; i < n; i++) {
+					dst[i] *= src_data[i];
+				}
 			}
 		}
 		else mult_ri(em);
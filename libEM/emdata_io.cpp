@@ -99,6 +99,8 @@ void EMData::_read_image(ImageIO *imageio, int img_index, bool nodata,
 			else {
 				if (rdata) EMUtil::em_free(rdata);
 				rdata=0;
+				if (hdata) EMUtil::em_free(hdata);
+				hdata=0;
 			}
 		}
 }
@@ -33,6 +33,7 @@
 #include "ctf.h"
 #include "portable_fileio.h"
 #include "io/imageio.h"
+#include "volumesummary.h"
 
 #include <cstring>
 #include <sstream>
@@ -774,26 +775,20 @@ float EMData::get_circle_mean()
 {
 	ENTERFUNC;
 
-	static bool busy = false;
-	static EMData *mask = 0;
+	// the mask is cached per thread rather than guarded by a spin flag
+	static thread_local EMData mask;
 
-	while (busy);
-	busy = true;
-
-	if (!mask || !EMUtil::is_same_size(this, mask)) {
-		if (!mask) {
-			mask = new EMData();
-		}
-		mask->set_size(nx, ny, nz);
-		mask->to_one();
+	if (!EMUtil::is_same_size(this, &mask)) {
+		mask.set_size(nx, ny, nz);
+		mask.to_one();
 
 		float radius = (float)(ny / 2 - 2);
-		mask->process_inplace("mask.sharp", Dict("inner_radius", radius - 1,
+		mask.process_inplace("mask.sharp", Dict("inner_radius", radius - 1,
 									   "outer_radius", radius + 1));
 
 	}
 	double n = 0,s=0;
-	float *d = mask->get_data();
+	float *d = mask.get_data();
 	float * data = get_data();
 	size_t size = (size_t)nx*ny*nz;
 	for (size_t i = 0; i < size; ++i) {
@@ -802,7 +797,6 @@ float EMData::get_circle_mean()
 
 
 	float result = (float)(s/n);
-	busy = false;
 
 	EXITFUNC;
 	return result;
@@ -868,6 +862,8 @@ void EMData::set_size(int x, int y, int z, bool noalloc)
 		return;
 	}
 	
+	if (hdata) expand_half();	// realloc keeps the existing data, so it must be float
+
 	if (rdata != 0) {
 		rdata = (float*)EMUtil::em_realloc(rdata,size);
 	} else {
@@ -1014,13 +1010,17 @@ EMObject EMData::get_attr(const string & key) const
 		float mean = attr_dict["mean"];
 		float sigma = attr_dict["sigma"];
 
-		float *data = get_data();
+		float buf[4096];
 		double kurtosis_sum = 0;
 
-		for (size_t k = 0; k < size; ++k) {
-			float t = (data[k] - mean) / sigma;
-			float tt = t * t;
-			kurtosis_sum += tt * tt;
+		for (size_t k0 = 0; k0 < size; k0 += 4096) {
+			size_t n = std::min((size_t)4096, size - k0);
+			const float *data = get_const_data_block(k0, n, buf);
+			for (size_t k = 0; k < n; ++k) {
+				float t = (data[k] - mean) / sigma;
+				float tt = t * t;
+				kurtosis_sum += tt * tt;
+			}
 		}
 
 		float kurtosis = (float)(kurtosis_sum / size - 3.0);
@@ -1030,11 +1030,15 @@ EMObject EMData::get_attr(const string & key) const
 		float mean = attr_dict["mean"];
 		float sigma = attr_dict["sigma"];
 
-		float *data = get_data();
+		float buf[4096];
 		double skewness_sum = 0;
-		for (size_t k = 0; k < size; ++k) {
-			float t = (data[k] - mean) / sigma;
-			skewness_sum +=  t * t * t;
+		for (size_t k0 = 0; k0 < size; k0 += 4096) {
+			size_t n = std::min((size_t)4096, size - k0);
+			const float *data = get_const_data_block(k0, n, buf);
+			for (size_t k = 0; k < n; ++k) {
+				float t = (data[k] - mean) / sigma;
+				skewness_sum +=  t * t * t;
+			}
 		}
 		float skewness = (float)(skewness_sum / size);
 		return skewness;
@@ -1161,7 +1165,7 @@ EMObject EMData::get_attr_default(const string & key, const EMObject & em_obj) c
 
 Dict EMData::get_attr_dict() const
 {
-	if(rdata) {
+	if(rdata || hdata) {
 		update_stat();
 	}
 
@@ -1219,7 +1223,7 @@ void EMData::set_attr(const string & key, EMObject val)
 		return;
 	}
 
-	if(rdata) {	//skip following for header only image
+	if(rdata || hdata) {	//skip following for header only image
 		/* Ignore 'read only' attribute. */
 		if(key == "sigma" ||
 			key == "sigma_nonzero" ||
@@ -1290,6 +1294,103 @@ void EMData::scale_pixel(float scale) const
 	}
 }
 
+void EMData::set_half_storage(int mode)
+{
+	ENTERFUNC;
+
+	if (mode != HALF_NONE && mode != HALF_FLOAT16 && mode != HALF_BFLOAT16) {
+		throw InvalidValueException(mode, "unknown half precision storage mode");
+	}
+	if (mode == get_half_storage()) {
+		EXITFUNC;
+		return;
+	}
+
+	float *data = get_data();	// expands any existing 16-bit data
+	if (mode == HALF_NONE || data == 0) {
+		EXITFUNC;
+		return;
+	}
+	if (is_complex()) {
+		throw ImageFormatException("half precision storage is only supported for real images");
+	}
+
+	unsigned short *half = (unsigned short*)EMUtil::em_malloc(nxyz*sizeof(unsigned short));
+	if (half == 0) {
+		throw BadAllocException("Cannot allocate half precision storage");
+	}
+	bool bfloat16 = (mode == HALF_BFLOAT16);
+	EMUtil::float_to_half(data, half, nxyz, bfloat16);
+
+	// Round the float copy the same way so the cached statistics describe what is stored
+	EMUtil::half_to_float(half, data, nxyz, bfloat16);
+	update();
+	update_stat();
+
+	EMUtil::em_free(rdata);
+	rdata = 0;
+	hdata = half;
+	halfmode = mode;
+
+	EXITFUNC;
+}
+
+void EMData::expand_half() const
+{
+	std::lock_guard<std::mutex> lock(half_mutex);
+	if (hdata == 0) return;	// expanded by another thread while we waited
+
+	float *data = (float*)EMUtil::em_malloc(nxyz*sizeof(float));
+	if (data == 0) {
+		throw BadAllocException("Cannot allocate memory to expand half precision data");
+	}
+	EMUtil::half_to_float(hdata, data, nxyz, halfmode == HALF_BFLOAT16);
+	EMUtil::em_free(hdata);
+	hdata = 0;
+	rdata = data;
+}
+
+const float * EMData::get_const_data_block(size_t offset, size_t n, float * buf) const
+{
+	if (hdata) {
+		EMUtil::half_to_float(hdata + offset, buf, n, halfmode == HALF_BFLOAT16);
+		return buf;
+	}
+	return get_data() + offset;
+}
+
+const VolumeSummary * EMData::get_volume_summary(int brick_size) const
+{
+	ENTERFUNC;
+	if (brick_size == 0) brick_size = VolumeSummary::DEFAULT_BRICK_SIZE;
+
+	std::lock_guard<std::mutex> lock(summary_mutex);
+	const VolumeSummary *ret = 0;
+	for (size_t i = 0; i < summaries.size(); i++) {
+		IntSize size = summaries[i]->get_image_size();
+		if (size[0] != nx || size[1] != ny || size[2] != nz) {
+			// resized without update(), none of them apply
+			for (size_t j = 0; j < summaries.size(); j++) delete summaries[j];
+			summaries.clear();
+			break;
+		}
+		if (summaries[i]->get_brick_size() == brick_size) ret = summaries[i];
+	}
+	if (ret == 0) {
+		summaries.push_back(new VolumeSummary(this, brick_size));
+		ret = summaries.back();
+	}
+	EXITFUNC;
+	return ret;
+}
+
+void EMData::clear_volume_summary() const
+{
+	std::lock_guard<std::mutex> lock(summary_mutex);
+	for (size_t i = 0; i < summaries.size(); i++) delete summaries[i];
+	summaries.clear();
+}
+
 //vector<float> EMData::get_data_pickle() const
 EMBytes EMData::get_data_pickle() const
 {
@@ -1323,6 +1424,74 @@ void EMData::set_supp_pickle(int)
 	this->supp = 0;
 }
 
+string EMData::to_shared(const string & name)
+{
+	ENTERFUNC;
+
+	float *data = get_data();
+	if (data == 0) {
+		throw ImageFormatException("cannot share an image with no data");
+	}
+
+	string shmname = SharedMemory::name_of(data);
+	if (shmname.empty()) {
+		shmname = name;
+		float *shm = SharedMemory::create(shmname, nx, ny, nz);
+		EMUtil::em_memcpy(shm, data, nxyz*sizeof(float));
+		EMUtil::em_free(rdata);
+		rdata = shm;
+	}
+
+	EXITFUNC;
+	return shmname;
+}
+
+EMData *EMData::copy_to_shared(const string & name) const
+{
+	ENTERFUNC;
+
+	const float *data = get_data();
+	if (data == 0) {
+		throw ImageFormatException("cannot share an image with no data");
+	}
+
+	string shmname = name;
+	float *shm = SharedMemory::create(shmname, nx, ny, nz);
+	EMUtil::em_memcpy(shm, data, nxyz*sizeof(float));
+
+	EMData *ret = new EMData();
+	ret->set_size(nx, ny, nz, true);
+	ret->rdata = shm;
+	ret->update();
+
+	EXITFUNC;
+	return ret;
+}
+
+void EMData::attach_shared(const string & name, bool writable)
+{
+	ENTERFUNC;
+
+	int x = 0, y = 0, z = 0;
+	float *shm = SharedMemory::attach(name, x, y, z, writable);
+
+	free_rdata();
+	if (supp) {
+		EMUtil::em_free(supp);
+		supp = 0;
+	}
+	set_size(x, y, z, true);
+	rdata = shm;
+	update();
+
+	EXITFUNC;
+}
+
+string EMData::get_shared_name() const
+{
+	return rdata ? SharedMemory::name_of(rdata) : string();
+}
+
 float EMData::get_amplitude_thres(float thres)
 {
 
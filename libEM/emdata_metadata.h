@@ -64,6 +64,7 @@ EMData *get_fft_phase();
 #ifdef EMAN2_USING_CUDA
 inline float *get_data() const
 {
+	if (hdata) expand_half();
 	if(rdata == 0){
 		rdata = (float*)malloc(num_bytes);
 		cudadirtybit = 1;
@@ -75,7 +76,7 @@ inline float *get_data() const
 	return rdata;
 }
 #else
-inline float *get_data() const { return rdata; }
+inline float *get_data() const { if (hdata) expand_half(); return rdata; }
 #endif
 
 /** Get the image pixel density data in a 1D float array - const version of get_data
@@ -83,6 +84,53 @@ inline float *get_data() const { return rdata; }
  */
 inline const float * get_const_data() const { return get_data(); }
 
+/** 16-bit pixel storage modes, see set_half_storage() */
+enum HalfStorage
+{
+	HALF_NONE = 0,
+	HALF_FLOAT16 = 1,	// IEEE 754 half precision, as in MRC mode 12
+	HALF_BFLOAT16 = 2	// bfloat16, float exponent range with 8 bits of mantissa
+};
+
+/** Keep the pixel data of a real image in 16-bit form, halving its memory footprint.
+ * The data are rounded to the nearest representable value and the float array is
+ * freed. Any call which needs float data, get_data() included, converts the whole
+ * image back to float and ends half storage, so call this again once done with it.
+ * add(), sub(), mult(), addsquare(), subsquare(), dot() and do_fft() read a
+ * half precision argument directly without expanding it, as do the statistics
+ * returned by get_attr(). Any other get_data() call, even a read-only one, drops the
+ * image back to float for good. Expansion is serialized, so threads may share a half
+ * precision image, but get_const_data_block() must not run while one of them expands it.
+ * @param mode a HalfStorage value, HALF_NONE converts back to float
+ * @exception InvalidValueException if mode is unknown
+ * @exception ImageFormatException if the image is complex
+ */
+void set_half_storage(int mode);
+
+/** @return the HalfStorage mode the pixel data are currently kept in */
+inline int get_half_storage() const { return hdata ? halfmode : HALF_NONE; }
+
+/** Get n consecutive pixel values starting at offset as floats, without expanding
+ * half precision storage.
+ * @param offset index of the first pixel
+ * @param n number of pixels
+ * @param buf scratch space for n floats, used when the data are held in 16-bit form
+ * @return a pointer to the values, either into the image data or to buf
+ */
+const float * get_const_data_block(size_t offset, size_t n, float * buf) const;
+
+/** Get the VolumeSummary of this image, a pyramid of per-brick min/max/mean/sigma
+ * used to skip regions that cannot reach a threshold. It is computed on first use
+ * and cached until update() is called, so it is shared by every caller in between.
+ * Concurrent callers are serialized on the image, and the first one computes the
+ * summary. update() must not run while another thread is using the summary.
+ * @param brick_size level 0 brick edge length in voxels, 0 for the default. Each
+ * brick size is cached separately.
+ * @exception ImageFormatException if the image is complex
+ * @return the summary, owned by the image and deleted by the next update()
+ */
+const VolumeSummary * get_volume_summary(int brick_size = 0) const;
+
 /**  Set the data explicitly
 * data pointer must be allocated using malloc!
 * @param data a pointer to the pixel data which is stored in memory. Takes possession
@@ -92,6 +140,7 @@ inline const float * get_const_data() const { return get_data(); }
 */
 inline void set_data(float* data, const int x, const int y, const int z) {
 	if (rdata) { EMUtil::em_free(rdata); rdata = 0; }
+	if (hdata) { EMUtil::em_free(hdata); hdata = 0; }
 #ifdef EMAN2_USING_CUDA
 	//cout << "set data" << endl;
 //	free_cuda_memory();
@@ -104,6 +153,7 @@ inline void set_data(float* data, const int x, const int y, const int z) {
 }
 
 inline void set_data(float* data) {
+	if (hdata) { EMUtil::em_free(hdata); hdata = 0; }
 	rdata = data;
 }
 
@@ -139,6 +189,7 @@ inline void update()
 {
 	flags |= EMDATA_NEEDUPD;
 	changecount++;
+	clear_volume_summary();
 #ifdef FFT_CACHING
 	if (fftcache!=0) { delete fftcache; fftcache=0; }
 #endif //FFT_CACHING
@@ -972,6 +1023,40 @@ int get_supp_pickle() const;
 
 void set_supp_pickle(int i);
 
+/** Move the image data into a named POSIX shared memory segment, so other
+ * processes on this host can map it with attach_shared() instead of
+ * receiving a copy. The segment is unlinked when this image's data is freed.
+ * Resizing the image moves the data back to ordinary memory.
+ * @param name segment name, generated if empty
+ * @exception BadAllocException if the segment cannot be created
+ * @return the segment name
+ */
+string to_shared(const string & name = "");
+
+/** Copy the image data into a new shared memory segment, leaving this
+ * image's data where it is. The copy is owned by the returned image, which
+ * has no header; the segment is unlinked when that image is deleted.
+ * @param name segment name, generated if empty
+ * @exception BadAllocException if the segment cannot be created
+ * @return a new image holding the segment
+ */
+EMData *copy_to_shared(const string & name = "") const;
+
+/** Replace the image data with a mapping of a shared memory segment created
+ * by to_shared() in another process. The image takes the segment's
+ * dimensions; the header is not changed. By default the mapping is
+ * copy-on-write, so changes to this image stay in this process.
+ * @param name segment name returned by to_shared()
+ * @param writable map the segment shared, so writes are seen by every
+ * process that maps it
+ * @exception ImageReadException if the segment cannot be mapped
+ */
+void attach_shared(const string & name, bool writable = false);
+
+/** @return the shared memory segment name if the data is in shared memory
+ * and mapped shared, otherwise an empty string */
+string get_shared_name() const;
+
 vector<Vec3i> mask_contig_region(const float& val, const Vec3i& seed);
 
 /** return the FFT amplitude which is greater than thres %
@@ -95,7 +95,15 @@ EMData *EMData::do_fft() const
 
 		float *d = dat->get_data();
 		//std::cout<<" do_fft "<<rdata[5]<<"  "<<d[5]<<std::endl;
-		EMfft::real_to_complex_nd(get_data(), d, nxreal, ny, nz);
+		if (hdata) {
+			// stage half precision input in a scratch buffer so this image stays compact
+			float *staged = (float*)EMUtil::em_malloc(nxyz*sizeof(float));
+			if (staged == 0) throw BadAllocException("Cannot allocate FFT input buffer");
+			EMUtil::half_to_float(hdata, staged, nxyz, halfmode == HALF_BFLOAT16);
+			EMfft::real_to_complex_nd(staged, d, nxreal, ny, nz);
+			EMUtil::em_free(staged);
+		}
+		else EMfft::real_to_complex_nd(get_data(), d, nxreal, ny, nz);
 
 		dat->update();
 		dat->set_fftpad(true);
@@ -0,0 +1,233 @@
+/*
+ * This software is issued under a joint BSD/GNU license. You may use the
+ * source code in this file under either license. However, note that the
+ * complete EMAN2 and SPARX software packages have some GPL dependencies,
+ * so you are responsible for compliance with the licenses of these packages
+ * if you opt to use BSD licensing. The warranty disclaimer below holds
+ * in either instance.
+ *
+ * This complete copyright notice must be included in any revised version of the
+ * source code. Additional authorship citations may be added, but existing
+ * author citations must be preserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA 
+ */
+
+#include "emdatastack.h"
+#include "emdata.h"
+#include "embuffer.h"
+#include "imageio.h"
+
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+using namespace EMAN;
+
+namespace {
+	const size_t stack_alignment = 64;
+
+	float *aligned_alloc_floats(size_t count)
+	{
+		size_t bytes = count * sizeof(float);
+		if (bytes == 0) bytes = stack_alignment;
+#ifdef _WIN32
+		return static_cast<float *>(_aligned_malloc(bytes, stack_alignment));
+#else
+		void *p = 0;
+		if (posix_memalign(&p, stack_alignment, bytes) != 0) return 0;
+		return static_cast<float *>(p);
+#endif
+	}
+
+	void aligned_free_floats(float *p)
+	{
+#ifdef _WIN32
+		_aligned_free(p);
+#else
+		free(p);
+#endif
+	}
+
+	void strip_size(Dict & header)
+	{
+		header.erase("nx");
+		header.erase("ny");
+		header.erase("nz");
+	}
+}
+
+EMDataStack::EMDataStack(int n_, int x, int y, int z)
+	: n(n_), nx(x), ny(y), nz(z), nxyz((size_t)x*y*z), headers(n_ > 0 ? n_ : 0)
+{
+	if (n < 0) throw InvalidValueException(n, "stack size < 0");
+	if (nx <= 0) throw InvalidValueException(nx, "x size <= 0");
+	if (ny <= 0) throw InvalidValueException(ny, "y size <= 0");
+	if (nz <= 0) throw InvalidValueException(nz, "z size <= 0");
+
+	float *buf = aligned_alloc_floats((size_t)n * nxyz);
+	if (buf == 0) throw BadAllocException("Cannot allocate image stack");
+	memset(buf, 0, (size_t)n * nxyz * sizeof(float));
+	data = std::shared_ptr<float>(buf, aligned_free_floats);
+
+	for (int i = 0; i < n; i++) {
+		headers[i]["apix_x"] = 1.0f;
+		headers[i]["apix_y"] = 1.0f;
+		headers[i]["apix_z"] = 1.0f;
+	}
+}
+
+EMDataStack *EMDataStack::read_images(const string & filename, vector<int> img_indices)
+{
+	ENTERFUNC;
+
+	if (img_indices.empty()) {
+		int nimg = EMUtil::get_image_count(filename);
+		for (int i = 0; i < nimg; i++) img_indices.push_back(i);
+	}
+
+	ImageIO *imageio = EMUtil::get_imageio(filename, ImageIO::READ_ONLY);
+	if (!imageio) throw ImageFormatException("cannot create an image io");
+
+	EMDataStack *stack = 0;
+	try {
+		for (size_t k = 0; k < img_indices.size(); k++) {
+			Dict header;
+			int idx = img_indices[k];
+			if (imageio->read_header(header, idx, 0, false)) {
+				throw ImageReadException(filename, "imageio read header failed");
+			}
+
+			int x = header["nx"], y = header["ny"], z = header["nz"];
+			if (stack == 0) {
+				stack = new EMDataStack((int)img_indices.size(), x, y, z);
+			}
+			else if (x != stack->nx || y != stack->ny || z != stack->nz) {
+				throw ImageDimensionException("images in a stack must all be the same size");
+			}
+
+			strip_size(header);
+			header["source_path"] = filename;
+			header["source_n"] = idx;
+			if (imageio->is_complex_mode()) {
+				header["is_complex"] = 1;
+				header["is_fftpad"] = 1;
+			}
+			stack->headers[k] = header;
+
+			if (imageio->read_data(stack->get_image_data((int)k), idx, 0, false)) {
+				throw ImageReadException(filename, "imageio read data failed");
+			}
+		}
+	}
+	catch (...) {
+		EMUtil::close_imageio(filename, imageio);
+		delete stack;
+		throw;
+	}
+
+	EMUtil::close_imageio(filename, imageio);
+	if (stack == 0) stack = new EMDataStack(0, 1, 1, 1);
+
+	EXITFUNC;
+	return stack;
+}
+
+EMDataStack *EMDataStack::from_images(const vector<EMData *> & images)
+{
+	if (images.empty()) return new EMDataStack(0, 1, 1, 1);
+	if (!images[0]) throw NullPointerException("NULL image in stack");
+
+	EMDataStack *stack = new EMDataStack((int)images.size(), images[0]->get_xsize(),
+										 images[0]->get_ysize(), images[0]->get_zsize());
+	try {
+		for (size_t i = 0; i < images.size(); i++) stack->set_image((int)i, images[i]);
+	}
+	catch (...) {
+		delete stack;
+		throw;
+	}
+	return stack;
+}
+
+void EMDataStack::check_index(int i) const
+{
+	if (i < 0 || i >= n) throw OutofRangeException(0, n - 1, i, "image index");
+}
+
+float *EMDataStack::get_image_data(int i) const
+{
+	check_index(i);
+	return data.get() + (size_t)i * nxyz;
+}
+
+const Dict & EMDataStack::get_header(int i) const
+{
+	check_index(i);
+	return headers[i];
+}
+
+void EMDataStack::set_header(int i, const Dict & header)
+{
+	check_index(i);
+	headers[i] = header;
+	strip_size(headers[i]);
+}
+
+EMData *EMDataStack::get_image(int i) const
+{
+	float *ptr = get_image_data(i);
+
+	// the view holds a reference to the buffer, dropped when it frees its data
+	std::shared_ptr<float> keep = data;
+	ExternalBuffer::add(ptr, nxyz * sizeof(float), [keep]() {});
+
+	EMData *image = new EMData(ptr, nx, ny, nz, headers[i]);
+
+	// the EMData constructor resets the sampling to 1
+	const char *apix[] = { "apix_x", "apix_y", "apix_z" };
+	for (int k = 0; k < 3; k++) {
+		if (headers[i].has_key(apix[k])) image->set_attr(apix[k], headers[i][apix[k]]);
+	}
+	return image;
+}
+
+vector<EMData *> EMDataStack::get_images() const
+{
+	vector<EMData *> images;
+	images.reserve(n);
+	for (int i = 0; i < n; i++) images.push_back(get_image(i));
+	return images;
+}
+
+void EMDataStack::set_image(int i, const EMData * image)
+{
+	check_index(i);
+	if (!image) throw NullPointerException("NULL image in stack");
+	if (image->get_xsize() != nx || image->get_ysize() != ny || image->get_zsize() != nz) {
+		throw ImageDimensionException("images in a stack must all be the same size");
+	}
+
+	float *dst = get_image_data(i);
+	const float *src = image->get_data();
+	if (src != dst) memcpy(dst, src, nxyz * sizeof(float));
+
+	headers[i] = image->get_attr_dict();
+	strip_size(headers[i]);
+	headers[i].erase("changecount");
+}
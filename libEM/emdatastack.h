@@ -0,0 +1,113 @@
+/*
+ * This software is issued under a joint BSD/GNU license. You may use the
+ * source code in this file under either license. However, note that the
+ * complete EMAN2 and SPARX software packages have some GPL dependencies,
+ * so you are responsible for compliance with the licenses of these packages
+ * if you opt to use BSD licensing. The warranty disclaimer below holds
+ * in either instance.
+ *
+ * This complete copyright notice must be included in any revised version of the
+ * source code. Additional authorship citations may be added, but existing
+ * author citations must be preserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA 
+ */
+
+#ifndef eman__emdatastack_h__
+#define eman__emdatastack_h__ 1
+
+#include "emobject.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+namespace EMAN
+{
+	class EMData;
+
+	/** EMDataStack holds N images of the same size in one contiguous, 64-byte
+	 * aligned buffer, with image i starting at get_data() + i*nx*ny*nz. Each
+	 * image has its own header Dict, but there is no EMData object per image
+	 * until one is asked for.
+	 *
+	 * get_image() returns an EMData which uses the stack's memory directly.
+	 * Writes to it are seen in the stack, and the buffer stays allocated while
+	 * any such view exists, even after the stack itself is deleted. Resizing
+	 * a view moves its data off the stack.
+	 */
+	class EMDataStack
+	{
+	  public:
+		/** Make a zero-filled stack of n images of size nx*ny*nz */
+		EMDataStack(int n, int nx, int ny, int nz = 1);
+
+		EMDataStack(const EMDataStack &) = delete;
+		EMDataStack & operator=(const EMDataStack &) = delete;
+
+		/** Read images from an image stack file straight into a new stack.
+		 * All images read must be the same size.
+		 * @param filename image stack file
+		 * @param img_indices images to read, all images if empty
+		 * @exception ImageReadException if the file cannot be read
+		 * @exception ImageDimensionException if the images differ in size
+		 * @return the new stack, owned by the caller */
+		static EMDataStack *read_images(const string & filename, vector<int> img_indices = vector<int>());
+
+		/** Make a stack holding copies of a list of same size images */
+		static EMDataStack *from_images(const vector<EMData *> & images);
+
+		int get_n() const { return n; }
+		int get_xsize() const { return nx; }
+		int get_ysize() const { return ny; }
+		int get_zsize() const { return nz; }
+
+		/** @return the number of floats in one image */
+		size_t get_image_size() const { return nxyz; }
+
+		/** @return the start of the whole buffer */
+		float *get_data() const { return data.get(); }
+
+		/** @return the start of image i */
+		float *get_image_data(int i) const;
+
+		/** @return the header of image i, without nx/ny/nz */
+		const Dict & get_header(int i) const;
+		void set_header(int i, const Dict & header);
+
+		/** Get an EMData view of image i sharing the stack's memory.
+		 * @return a new EMData, owned by the caller */
+		EMData *get_image(int i) const;
+
+		/** @return views of every image, owned by the caller */
+		vector<EMData *> get_images() const;
+
+		/** Copy an image's data and header into slot i */
+		void set_image(int i, const EMData * image);
+
+	  private:
+		void check_index(int i) const;
+
+		int n, nx, ny, nz;
+		size_t nxyz;
+		std::shared_ptr<float> data;
+		vector<Dict> headers;
+	};
+}
+
+#endif	//eman__emdatastack_h__
@@ -168,6 +168,10 @@ void EMfft::EMfftw3_cache::destroy_plans()
 			fftwplans[i] = NULL;
 		}
 	}
+	int mrt = Util::MUTEX_LOCK(&fft_mutex);
+	for (size_t i = 0; i < retired.size(); ++i) fftwf_destroy_plan(retired[i]);
+	retired.clear();
+	mrt = Util::MUTEX_UNLOCK(&fft_mutex);
 }
 
 fftwf_plan EMfft::EMfftw3_cache::get_plan(const int rank_in, const int x, const int y, const int z, const int r2c_flag, const int ip_flag, fftwf_complex* complex_data, float* real_data )
@@ -190,8 +194,9 @@ fftwf_plan EMfft::EMfftw3_cache::get_plan(const int rank_in, const int x, const
 	int i;
 	for (i=0; i<num_plans; i++) {
 		if (plan_dims[i][0]==x && plan_dims[i][1]==y && plan_dims[i][2]==z && rank[i]==rank_in && r2c[i]==r2c_flag && ip[i]==ip_flag) {
+			fftwf_plan cached = fftwplans[i];
 			mrt = Util::MUTEX_UNLOCK(&fft_mutex);
-			return fftwplans[i];
+			return cached;
 		}
 	}
 	
@@ -231,9 +236,11 @@ fftwf_plan EMfft::EMfftw3_cache::get_plan(const int rank_in, const int x, const
 		}
 		}
 
+	// The plan falling off the end may still be running in another thread (get_plan
+	// hands out plans without holding the lock), so it is retired rather than destroyed
 	if (fftwplans[EMFFTW3_CACHE_SIZE-1] != NULL )
 	{
-		fftwf_destroy_plan(fftwplans[EMFFTW3_CACHE_SIZE-1]);
+		retired.push_back(fftwplans[EMFFTW3_CACHE_SIZE-1]);
 		fftwplans[EMFFTW3_CACHE_SIZE-1] = NULL;
 	}
 					
@@ -264,7 +271,7 @@ fftwf_plan EMfft::EMfftw3_cache::get_plan(const int rank_in, const int x, const
 // 	++num_added;
 // 	cout << "I have created " << num_added << " plans" << endl;
 	mrt = Util::MUTEX_UNLOCK(&fft_mutex);
-	return fftwplans[0];
+	return plan;
 
 }
 
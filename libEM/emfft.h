@@ -36,6 +36,7 @@
 
 #include <fftw3.h>
 #include<complex>
+#include<vector>
  
 namespace EMAN
 {
@@ -122,6 +123,9 @@ namespace EMAN
 			fftwf_plan fftwplans[EMFFTW3_CACHE_SIZE];
 			// Store whether or not the plan was inplace
 			int ip[EMFFTW3_CACHE_SIZE];
+			// Plans pushed out of the cache. Another thread may still be executing one
+			// of these, so they are only destroyed by destroy_plans()
+			std::vector<fftwf_plan> retired;
 		};
 
 		static EMfftw3_cache plan_cache;
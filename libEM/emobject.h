@@ -33,6 +33,7 @@
 #define eman__object__h__ 1
 
 #include <map>
+#include <mutex>
 using std::map;
 
 #include <set>
@@ -748,9 +749,10 @@ namespace EMAN
 	template <class T>
 	void Factory<T>::init()
 	{
-		if (!my_instance) {
-			my_instance = new Factory<T>();
-		}
+		// Factories are first touched from whichever thread asks for an object,
+		// so construction must happen exactly once even with the GIL released.
+		static std::once_flag created;
+		std::call_once(created, []() { my_instance = new Factory<T>(); });
 	}
 
 	template <class T> 
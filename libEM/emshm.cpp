@@ -0,0 +1,283 @@
+/*
+ * This software is issued under a joint BSD/GNU license. You may use the
+ * source code in this file under either license. However, note that the
+ * complete EMAN2 and SPARX software packages have some GPL dependencies,
+ * so you are responsible for compliance with the licenses of these packages
+ * if you opt to use BSD licensing. The warranty disclaimer below holds
+ * in either instance.
+ *
+ * This complete copyright notice must be included in any revised version of the
+ * source code. Additional authorship citations may be added, but existing
+ * author citations must be preserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA 
+ */
+
+#include "emshm.h"
+#include "exception.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <map>
+#include <mutex>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+using namespace EMAN;
+
+std::atomic<int> SharedMemory::live(0);
+
+#ifndef _WIN32
+namespace {
+	const char shm_magic[8] = "EMSHM01";
+
+	/** Segment header. Padded to 64 bytes so the pixel area stays aligned
+	 * for SIMD loads. */
+	struct ShmHeader {
+		char magic[8];
+		int nx, ny, nz;
+		int pad0;
+		size_t nbytes;
+		char pad1[32];
+	};
+
+	struct ShmSegment {
+		string name;
+		void *base;
+		size_t maplen;
+		bool owner;
+		bool shared;	// false for a private copy-on-write mapping
+	};
+
+	std::mutex registry_mutex;
+	std::map<const void *, ShmSegment> registry;
+	std::atomic<unsigned int> name_counter(0);
+
+	float *pixels(void *base) {
+		return reinterpret_cast<float *>(static_cast<char *>(base) + sizeof(ShmHeader));
+	}
+
+	void add_segment(float *data, const ShmSegment & seg) {
+		std::lock_guard<std::mutex> lock(registry_mutex);
+		registry[data] = seg;
+	}
+
+	/** Remove ptr from the registry.
+	 * @return false if it was not registered */
+	bool take_segment(const void *ptr, ShmSegment & seg) {
+		std::lock_guard<std::mutex> lock(registry_mutex);
+		std::map<const void *, ShmSegment>::iterator it = registry.find(ptr);
+		if (it == registry.end()) return false;
+		seg = it->second;
+		registry.erase(it);
+		return true;
+	}
+
+	void unmap_segment(const ShmSegment & seg) {
+		munmap(seg.base, seg.maplen);
+		if (seg.owner) shm_unlink(seg.name.c_str());
+	}
+}
+
+static_assert(sizeof(ShmHeader) == 64, "shared memory header must be 64 bytes");
+
+bool SharedMemory::is_supported()
+{
+	return true;
+}
+
+float *SharedMemory::create(string & name, int nx, int ny, int nz)
+{
+	if (nx <= 0 || ny <= 0 || nz <= 0) {
+		throw InvalidValueException(nx, "shared memory image dimensions must be positive");
+	}
+
+	size_t nbytes = (size_t)nx * ny * nz * sizeof(float);
+	size_t maplen = sizeof(ShmHeader) + nbytes;
+	bool generated = name.empty();
+
+	int fd = -1;
+	for (int tries = 0; fd < 0 && tries < 16; tries++) {
+		if (generated) {
+			char buf[64];
+			snprintf(buf, sizeof(buf), "/eman2.%d.%u", (int)getpid(), name_counter.fetch_add(1));
+			name = buf;
+		}
+		else if (name[0] != '/') {
+			name = "/" + name;
+		}
+
+		fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+		if (fd < 0 && (errno != EEXIST || !generated)) break;
+	}
+	if (fd < 0) {
+		throw BadAllocException("cannot create shared memory segment " + name + ": " + strerror(errno));
+	}
+
+	if (ftruncate(fd, maplen) != 0) {
+		int err = errno;
+		close(fd);
+		shm_unlink(name.c_str());
+		throw BadAllocException("cannot size shared memory segment " + name + ": " + strerror(err));
+	}
+
+	void *base = mmap(0, maplen, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (base == MAP_FAILED) {
+		int err = errno;
+		shm_unlink(name.c_str());
+		throw BadAllocException("cannot map shared memory segment " + name + ": " + strerror(err));
+	}
+
+	ShmHeader *hdr = static_cast<ShmHeader *>(base);
+	memset(hdr, 0, sizeof(ShmHeader));
+	memcpy(hdr->magic, shm_magic, sizeof(shm_magic));
+	hdr->nx = nx;
+	hdr->ny = ny;
+	hdr->nz = nz;
+	hdr->nbytes = nbytes;
+
+	ShmSegment seg = { name, base, maplen, true, true };
+	float *data = pixels(base);
+	add_segment(data, seg);
+	live.fetch_add(1, std::memory_order_release);
+	return data;
+}
+
+float *SharedMemory::attach(const string & name_in, int & nx, int & ny, int & nz, bool writable)
+{
+	string name = name_in;
+	if (name.empty()) {
+		throw InvalidValueException(0, "empty shared memory segment name");
+	}
+	if (name[0] != '/') name = "/" + name;
+
+	int fd = shm_open(name.c_str(), writable ? O_RDWR : O_RDONLY, 0);
+	if (fd < 0) {
+		throw ImageReadException(name, string("cannot open shared memory segment: ") + strerror(errno));
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(ShmHeader)) {
+		close(fd);
+		throw ImageReadException(name, "not an EMAN2 shared memory segment");
+	}
+
+	size_t maplen = st.st_size;
+	// a private mapping of a read-only descriptor may still be written;
+	// the touched pages are copied into this process
+	void *base = mmap(0, maplen, PROT_READ | PROT_WRITE, writable ? MAP_SHARED : MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (base == MAP_FAILED) {
+		throw ImageReadException(name, string("cannot map shared memory segment: ") + strerror(errno));
+	}
+
+	const ShmHeader *hdr = static_cast<const ShmHeader *>(base);
+	if (memcmp(hdr->magic, shm_magic, sizeof(shm_magic)) != 0 ||
+		hdr->nx <= 0 || hdr->ny <= 0 || hdr->nz <= 0 ||
+		hdr->nbytes != (size_t)hdr->nx * hdr->ny * hdr->nz * sizeof(float) ||
+		sizeof(ShmHeader) + hdr->nbytes > maplen) {
+		munmap(base, maplen);
+		throw ImageReadException(name, "not an EMAN2 shared memory segment");
+	}
+
+	nx = hdr->nx;
+	ny = hdr->ny;
+	nz = hdr->nz;
+
+	ShmSegment seg = { name, base, maplen, false, writable };
+	float *data = pixels(base);
+	add_segment(data, seg);
+	live.fetch_add(1, std::memory_order_release);
+	return data;
+}
+
+string SharedMemory::name_of(const void *ptr)
+{
+	if (!ptr || !active()) return string();
+
+	std::lock_guard<std::mutex> lock(registry_mutex);
+	std::map<const void *, ShmSegment>::const_iterator it = registry.find(ptr);
+	return it == registry.end() || !it->second.shared ? string() : it->second.name;
+}
+
+bool SharedMemory::release(void *ptr)
+{
+	ShmSegment seg;
+	if (!ptr || !take_segment(ptr, seg)) return false;
+
+	unmap_segment(seg);
+	live.fetch_sub(1, std::memory_order_release);
+	return true;
+}
+
+void *SharedMemory::to_heap(void *ptr, size_t new_size)
+{
+	ShmSegment seg;
+	if (!ptr || !take_segment(ptr, seg)) return 0;
+
+	void *heap = malloc(new_size);
+	if (heap) {
+		size_t nbytes = static_cast<const ShmHeader *>(seg.base)->nbytes;
+		memcpy(heap, ptr, nbytes < new_size ? nbytes : new_size);
+		unmap_segment(seg);
+		live.fetch_sub(1, std::memory_order_release);
+	}
+	else {
+		// leave the segment in place so the caller sees a normal realloc failure
+		add_segment(static_cast<float *>(ptr), seg);
+	}
+	return heap;
+}
+
+#else	//_WIN32
+
+bool SharedMemory::is_supported()
+{
+	return false;
+}
+
+float *SharedMemory::create(string &, int, int, int)
+{
+	throw InvalidCallException("shared memory images are not supported on this platform");
+}
+
+float *SharedMemory::attach(const string &, int &, int &, int &, bool)
+{
+	throw InvalidCallException("shared memory images are not supported on this platform");
+}
+
+string SharedMemory::name_of(const void *)
+{
+	return string();
+}
+
+bool SharedMemory::release(void *)
+{
+	return false;
+}
+
+void *SharedMemory::to_heap(void *, size_t)
+{
+	return 0;
+}
+
+#endif	//_WIN32
@@ -0,0 +1,99 @@
+/*
+ * This software is issued under a joint BSD/GNU license. You may use the
+ * source code in this file under either license. However, note that the
+ * complete EMAN2 and SPARX software packages have some GPL dependencies,
+ * so you are responsible for compliance with the licenses of these packages
+ * if you opt to use BSD licensing. The warranty disclaimer below holds
+ * in either instance.
+ *
+ * This complete copyright notice must be included in any revised version of the
+ * source code. Additional authorship citations may be added, but existing
+ * author citations must be preserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA 
+ */
+
+#ifndef eman__emshm_h__
+#define eman__emshm_h__ 1
+
+#include <cstddef>
+#include <string>
+#include <atomic>
+
+using std::string;
+
+namespace EMAN
+{
+	/** SharedMemory manages named POSIX shared memory segments used to hold
+	 * EMData pixel data, so images can be handed to other processes on the
+	 * same host without copying them through a pipe or a file. A segment
+	 * holds a small header with the image dimensions followed by the pixels.
+	 *
+	 * The process that creates a segment owns its name and unlinks it when
+	 * the memory is released; processes that attach only unmap it. Memory
+	 * handed out here is released through EMUtil::em_free, so an EMData
+	 * whose rdata lives in a segment needs no special handling elsewhere.
+	 */
+	class SharedMemory
+	{
+	  public:
+		/** Create a new segment large enough for an nx*ny*nz float image.
+		 * @param name segment name; if empty a unique name is generated and
+		 * returned here
+		 * @return pointer to the pixel area, owned by this process */
+		static float *create(string & name, int nx, int ny, int nz);
+
+		/** Map an existing segment created by another process. By default the
+		 * mapping is private copy-on-write: this process may modify its pixels
+		 * freely, but the changes are not seen by the creator or by other
+		 * processes attached to the segment.
+		 * @param name segment name
+		 * @param nx, ny, nz set to the dimensions stored in the segment
+		 * @param writable map the segment shared, so writes go back to the
+		 * creating process
+		 * @return pointer to the pixel area */
+		static float *attach(const string & name, int & nx, int & ny, int & nz, bool writable = false);
+
+		/** @return the segment name if ptr is the pixel area of a segment
+		 * mapped shared, otherwise an empty string. A private attach may
+		 * have diverged from the segment, so it has no name. */
+		static string name_of(const void *ptr);
+
+		/** Unmap the segment whose pixel area is ptr, unlinking it if this
+		 * process created it.
+		 * @return false if ptr is not a shared memory segment */
+		static bool release(void *ptr);
+
+		/** If ptr is a shared memory segment, copy min(new_size, segment size)
+		 * bytes into a new heap block, release the segment and return the
+		 * heap block. Used by EMUtil::em_realloc, so a resized image leaves
+		 * shared memory.
+		 * @return the new heap block, or 0 if ptr is not a segment or the
+		 * allocation failed */
+		static void *to_heap(void *ptr, size_t new_size);
+
+		/** @return true if any segment is currently mapped. This is a cheap
+		 * check that keeps the common path through em_free lock free. */
+		static bool active() { return live.load(std::memory_order_acquire) > 0; }
+
+		/** @return true if shared memory segments are supported on this platform */
+		static bool is_supported();
+
+	  private:
+		static std::atomic<int> live;
+	};
+}
+
+#endif	//eman__emshm_h__
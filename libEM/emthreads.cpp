@@ -0,0 +1,190 @@
+/*
+ * This software is issued under a joint BSD/GNU license. You may use the
+ * source code in this file under either license. However, note that the
+ * complete EMAN2 and SPARX software packages have some GPL dependencies,
+ * so you are responsible for compliance with the licenses of these packages
+ * if you opt to use BSD licensing. The warranty disclaimer below holds
+ * in either instance.
+ *
+ * This complete copyright notice must be included in any revised version of the
+ * source code. Additional authorship citations may be added, but existing
+ * author citations must be preserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA 
+ */
+
+#include "emthreads.h"
+
+#include <cstdlib>
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#ifndef _WIN32
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+using namespace EMAN;
+
+thread_local bool EMThreads::in_worker = false;
+
+namespace {
+	std::atomic<int> num_threads(0);
+
+	int env_int(const char *name)
+	{
+		const char *env = getenv(name);
+		return env ? atoi(env) : 0;
+	}
+
+	int default_num_threads()
+	{
+		int n = env_int("EMAN_NUM_THREADS");
+		if (n > 0) return n;
+
+		n = (int)std::thread::hardware_concurrency();
+#if defined(__linux__)
+		// respect taskset/cgroup cpu restrictions
+		cpu_set_t cpus;
+		if (sched_getaffinity(0, sizeof(cpus), &cpus) == 0 && CPU_COUNT(&cpus) > 0) n = CPU_COUNT(&cpus);
+#endif
+		if (n < 1) n = 1;
+
+		// Under MPI every rank on the node would otherwise start a thread per cpu
+		const char *local_size[] = { "OMPI_COMM_WORLD_LOCAL_SIZE", "MPI_LOCALNRANKS", "MV2_COMM_WORLD_LOCAL_SIZE", "SLURM_NTASKS_PER_NODE" };
+		for (size_t i = 0; i < sizeof(local_size)/sizeof(local_size[0]); i++) {
+			int ranks = env_int(local_size[i]);
+			if (ranks > 0) return std::max(1, n / ranks);
+		}
+		if (env_int("OMPI_COMM_WORLD_SIZE") > 1 || env_int("PMI_SIZE") > 1) return 1;
+
+		return n;
+	}
+
+	/** Worker threads kept between parallel calls. One call uses the pool at a time. */
+	struct Pool
+	{
+		std::mutex busy;		// held by the thread whose job is running
+		std::mutex m;
+		std::condition_variable wake, done;
+		std::vector<std::thread> threads;
+		const std::function<void(int)> *job = 0;
+		int nchunk = 0;
+		std::atomic<int> next{0};
+		int running = 0;		// workers that have not finished the current job
+		unsigned long generation = 0;
+
+		void worker()
+		{
+			unsigned long seen = 0;
+			for (;;) {
+				const std::function<void(int)> *f;
+				int n;
+				{
+					std::unique_lock<std::mutex> lock(m);
+					wake.wait(lock, [&] { return generation != seen; });
+					seen = generation;
+					f = job;
+					n = nchunk;
+				}
+				for (int c = next++; c < n; c = next++) (*f)(c);
+				{
+					std::lock_guard<std::mutex> lock(m);
+					if (--running == 0) done.notify_one();
+				}
+			}
+		}
+
+		void run(int n, const std::function<void(int)> &f)
+		{
+			{
+				std::lock_guard<std::mutex> lock(m);
+				while ((int)threads.size() < n - 1) threads.emplace_back(&Pool::worker, this);
+				job = &f;
+				nchunk = n;
+				next = 0;
+				running = (int)threads.size();
+				generation++;
+			}
+			wake.notify_all();
+
+			for (int c = next++; c < n; c = next++) f(c);
+
+			std::unique_lock<std::mutex> lock(m);
+			done.wait(lock, [&] { return running == 0; });
+			job = 0;
+		}
+	};
+
+	// Never deleted, so workers blocked at exit do not hold up static destruction
+	std::atomic<Pool *> pool(0);
+
+#ifndef _WIN32
+	// A forked child has none of the parent's threads, so it must start its own pool
+	void forget_pool_in_child() { pool.store(0); }
+#endif
+
+	Pool *get_pool()
+	{
+#ifndef _WIN32
+		static int registered = pthread_atfork(0, 0, forget_pool_in_child);
+		(void)registered;
+#endif
+		Pool *p = pool.load();
+		if (p) return p;
+
+		Pool *made = new Pool;
+		if (pool.compare_exchange_strong(p, made)) return made;
+		delete made;
+		return p;
+	}
+}
+
+void EMThreads::run_on_pool(int nchunk, const std::function<void(int)> &work)
+{
+	Pool *p = get_pool();
+	std::unique_lock<std::mutex> lock(p->busy, std::try_to_lock);
+	if (!lock.owns_lock()) {
+		for (int c = 0; c < nchunk; c++) work(c);
+		return;
+	}
+	p->run(nchunk, work);
+}
+
+int EMThreads::get_num_threads()
+{
+	int n = num_threads.load();
+	if (n <= 0) {
+		n = default_num_threads();
+		num_threads.store(n);
+	}
+	return n;
+}
+
+void EMThreads::set_num_threads(int n)
+{
+	num_threads.store(n > 0 ? n : 0);
+}
+
+int EMThreads::get_num_chunks(size_t n, size_t grain)
+{
+	if (in_worker || n == 0) return 1;
+	if (grain == 0) grain = 1;
+
+	size_t maxchunk = (n + grain - 1) / grain;
+	return (int)std::max((size_t)1, std::min((size_t)get_num_threads(), maxchunk));
+}
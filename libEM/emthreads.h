@@ -0,0 +1,146 @@
+/*
+ * This software is issued under a joint BSD/GNU license. You may use the
+ * source code in this file under either license. However, note that the
+ * complete EMAN2 and SPARX software packages have some GPL dependencies,
+ * so you are responsible for compliance with the licenses of these packages
+ * if you opt to use BSD licensing. The warranty disclaimer below holds
+ * in either instance.
+ *
+ * This complete copyright notice must be included in any revised version of the
+ * source code. Additional authorship citations may be added, but existing
+ * author citations must be preserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA 
+ */
+
+#ifndef eman__emthreads_h__
+#define eman__emthreads_h__ 1
+
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <vector>
+
+namespace EMAN
+{
+	/** EMThreads provides the small amount of shared-memory parallelism used by
+	 * the multithreaded libEM kernels. Work is always run to completion before
+	 * returning, and the calling thread takes part in the work. A parallel call
+	 * made from inside a worker runs serially, so kernels can call each other
+	 * without oversubscribing the machine.
+	 *
+	 * The worker threads are started on first use and kept in a pool, so a
+	 * parallel call costs a wakeup rather than a thread start. If the pool is
+	 * busy with a call from another thread, the chunks run on the calling
+	 * thread instead. The chunking is the same either way.
+	 */
+	class EMThreads
+	{
+	  public:
+		/** @return the number of threads used by parallel kernels. This defaults
+		 * to the EMAN_NUM_THREADS environment variable if set. Otherwise it is
+		 * the number of CPUs this process may run on, divided among the MPI
+		 * ranks on the node when running under MPI. */
+		static int get_num_threads();
+
+		/** Set the number of threads used by parallel kernels.
+		 * @param n 0 restores the default, 1 disables threading */
+		static void set_num_threads(int n);
+
+		/** @return the number of chunks parallel_for() will split n items into,
+		 * never less than 1. Use this to size per-chunk accumulators. */
+		static int get_num_chunks(size_t n, size_t grain = 1);
+
+		/** @return true if called from inside a parallel_for/parallel_for_each worker */
+		static bool in_parallel() { return in_worker; }
+
+		/** Statically partition [0,n) into get_num_chunks(n,grain) contiguous
+		 * ranges and call f(begin, end, chunk) for each, in parallel.
+		 * Exceptions thrown by f are rethrown in the calling thread. */
+		template<class F>
+		static void parallel_for(size_t n, F f, size_t grain = 1);
+
+		/** Call f(i, chunk) for every i in [0,n), handing out items dynamically.
+		 * Use this when the cost of items varies a lot. chunk is in
+		 * [0,get_num_chunks(n)) and may be used to index per-thread scratch. */
+		template<class F>
+		static void parallel_for_each(size_t n, F f);
+
+	  private:
+		template<class F>
+		static void run_chunks(int nchunk, F f);
+
+		/** Call work(c) for every c in [0,nchunk) on the pool and the calling thread */
+		static void run_on_pool(int nchunk, const std::function<void(int)> &work);
+
+		static thread_local bool in_worker;
+	};
+
+	template<class F>
+	void EMThreads::run_chunks(int nchunk, F f)
+	{
+		std::vector<std::exception_ptr> errors(nchunk);
+		auto work = [&f, &errors](int c) {
+			bool was = in_worker;
+			in_worker = true;
+			try { f(c); }
+			catch (...) { errors[c] = std::current_exception(); }
+			in_worker = was;
+		};
+
+		run_on_pool(nchunk, work);
+
+		for (auto & e : errors) {
+			if (e) std::rethrow_exception(e);
+		}
+	}
+
+	template<class F>
+	void EMThreads::parallel_for(size_t n, F f, size_t grain)
+	{
+		if (n == 0) return;
+		int nchunk = get_num_chunks(n, grain);
+		if (nchunk == 1) {
+			f((size_t)0, n, 0);
+			return;
+		}
+
+		size_t step = n / nchunk, rem = n % nchunk;
+		run_chunks(nchunk, [&](int c) {
+			size_t begin = c * step + ((size_t)c < rem ? c : rem);
+			size_t end = begin + step + ((size_t)c < rem ? 1 : 0);
+			f(begin, end, c);
+		});
+	}
+
+	template<class F>
+	void EMThreads::parallel_for_each(size_t n, F f)
+	{
+		if (n == 0) return;
+		int nchunk = get_num_chunks(n);
+		if (nchunk == 1) {
+			for (size_t i = 0; i < n; i++) f(i, 0);
+			return;
+		}
+
+		std::atomic<size_t> next(0);
+		run_chunks(nchunk, [&](int c) {
+			for (size_t i = next++; i < n; i = next++) f(i, c);
+		});
+	}
+}
+
+#endif	//eman__emthreads_h__
@@ -34,16 +34,22 @@
 	#define MAXPATHLEN (MAX_PATH*4)
 #else
 #include <sys/param.h>
+#include <unistd.h>
 #endif	// WIN32
 
 #include <utility>
+#include <algorithm>
+#include <cerrno>
+#include <mutex>
 
 #include "io/all_imageio.h"
+#include "io/half-2.2.0/include/half.hpp"
 #include "portable_fileio.h"
 #include "emcache.h"
 #include "emdata.h"
 #include "ctf.h"
 #include "emassert.h"
+#include "emthreads.h"
 #include "exception.h"
 
 
@@ -59,10 +65,10 @@ EMUtil::ImageType EMUtil::get_image_ext_type(const string & file_ext)
 {
 	ENTERFUNC;
 
-	static bool initialized = false;
+	static std::once_flag initialized;
 	static map < string, ImageType > imagetypes;
 
-	if (!initialized) {
+	std::call_once(initialized, []() {
 		imagetypes["rec"] = IMAGE_MRC;
 		imagetypes["mrc"] = IMAGE_MRC;
 		imagetypes["MRC"] = IMAGE_MRC;
@@ -201,17 +207,19 @@ EMUtil::ImageType EMUtil::get_image_ext_type(const string & file_ext)
 		imagetypes["ser"] = IMAGE_SER;
 		imagetypes["SER"] = IMAGE_SER;
 
+		imagetypes["emz"] = IMAGE_EMZ;
+		imagetypes["EMZ"] = IMAGE_EMZ;
+
 		imagetypes["eer"] = IMAGE_EER;
 //		imagetypes["eer"] = IMAGE_EER2X;
 //		imagetypes["eer"] = IMAGE_EER4X;
-
-		initialized = true;
-	}
+	});
 
 	ImageType result = IMAGE_UNKNOWN;
 
-	if (imagetypes.find(file_ext) != imagetypes.end()) {
-		result = imagetypes[file_ext];
+	map < string, ImageType >::const_iterator it = imagetypes.find(file_ext);
+	if (it != imagetypes.end()) {
+		result = it->second;
 	}
 
 	EXITFUNC;
@@ -379,6 +387,11 @@ EMUtil::ImageType EMUtil::fast_get_image_type(const string & filename,
 			return IMAGE_SER;
 		}
 		break;
+	case IMAGE_EMZ:
+		if (EmzIO::is_valid(first_block)) {
+			return IMAGE_EMZ;
+		}
+		break;
 	case IMAGE_IMAGIC:
 		if (ImagicIO::is_valid(first_block)) {
 			return IMAGE_IMAGIC;
@@ -518,6 +531,9 @@ EMUtil::ImageType EMUtil::get_image_type(const string & in_filename)
 	else if(SerIO::is_valid(first_block)) {
 		image_type = IMAGE_SER;
 	}
+	else if(EmzIO::is_valid(first_block)) {
+		image_type = IMAGE_EMZ;
+	}
 	else if (ImagicIO::is_valid(first_block)) {
 		image_type = IMAGE_IMAGIC;
 	}
@@ -705,6 +721,9 @@ ImageIO *EMUtil::get_imageio(const string & filename, int rw,
 	case IMAGE_SER:
 		imageio = new SerIO(filename, rw_mode);
 		break;
+	case IMAGE_EMZ:
+		imageio = new EmzIO(filename, rw_mode);
+		break;
 	default:
 		break;
 	}
@@ -821,6 +840,9 @@ const char *EMUtil::get_imagetype_name(ImageType t)
 	case IMAGE_SER:
 		return "SER";
 		break;
+	case IMAGE_EMZ:
+		return "EMZ";
+		break;
 	case IMAGE_UNKNOWN:
 		return "unknown";
 	}
@@ -933,46 +955,177 @@ double EMUtil::mode_size_product(size_t factor, size_t mode_size)
 	return product;
 }
 
-void EMUtil::process_region_io(void *vdata, FILE * file,
-							   int rw_mode, int image_index,
-							   size_t mode_size, int nx, int ny, int nz,
-							   const Region * area, bool need_flip,
-							   ImageType imgtype, int pre_row, int post_row)
-{
-	Assert(vdata != 0);
-	Assert(file != 0);
-	Assert(rw_mode == ImageIO::READ_ONLY ||
-		   rw_mode == ImageIO::READ_WRITE ||
-		   rw_mode == ImageIO::WRITE_ONLY);
+namespace {
+	/* Geometry of one region within one image in a raw binary image file, as
+	 * worked out by get_region_layout(). All byte counts include the packed
+	 * 4-bit MRC "half" mode handled by mode_size_product(). */
+	struct RegionLayout {
+		int dx0, dy0, dz0;		// first pixel written in memory
+		int fx0, fy0, fz0;		// first pixel read in the file
+		int xlen, ylen, zlen;	// number of pixels transferred
+		size_t memory_sec_size, img_row_size, area_row_size, memory_row_size;
+		size_t x_pre_gap, x_post_gap, y_pre_gap, y_post_gap;
+	};
+
+	/* One contiguous piece of a file and where it goes in memory. Offsets are
+	 * 64 bit everywhere, off_t is only 32 bits wide on Windows. */
+	struct IOSpan {
+		int64_t offset;
+		size_t len;
+		unsigned char *dest;
+		int slice;				// image/slice number, for error messages
+
+		bool operator<(const IOSpan & s) const { return offset < s.offset; }
+	};
+
+	// spans closer together than this are read with one call, the gap being discarded
+	const size_t SPAN_MAX_GAP  = 1 << 16;
+	// upper limit on the size of a single coalesced read
+	const size_t SPAN_MAX_READ = 1 << 24;
+
+	/* 64 bit stream position, portable_ftell() returns off_t */
+	int64_t tell64(FILE * file)
+	{
+#ifdef _WIN32
+		return _ftelli64(file);
+#else
+		return portable_ftell(file);
+#endif
+	}
 
-	if (mode_size == 0) throw UnexpectedBehaviorException("The mode size was 0?");
+	void seek64(FILE * file, int64_t offset)
+	{
+#ifdef _WIN32
+		_fseeki64(file, offset, SEEK_SET);
+#else
+		portable_fseek(file, (off_t)offset, SEEK_SET);
+#endif
+	}
 
-	const size_t mode_size_half = 11111111;
+	/* Read len bytes at absolute offset. Returns the number of bytes read. */
+	size_t read_at(FILE * file, void *buf, size_t len, int64_t offset)
+	{
+#ifdef _WIN32
+		seek64(file, offset);
+		return fread(buf, 1, len, file);
+#else
+		int fd = fileno(file);
+		size_t done = 0;
 
-	unsigned char * cdata = (unsigned char *)vdata;
+		while (done < len) {
+			ssize_t n = pread(fd, (char *)buf + done, len - done, (off_t)(offset + done));
 
-	int dx0 = 0; // data x0
-	int dy0 = 0; // data y0
-	int dz0 = 0; // data z0
+			if (n < 0 && errno == EINTR) continue;
+			if (n <= 0) break;
 
-	int fx0 = 0; // file x0
-	int fy0 = 0; // file y0
-	int fz0 = nz > 1 ? 0 : image_index; // file z0
+			done += n;
+		}
 
-	int xlen = 0;
-	int ylen = 0;
-	int zlen = 0;
+		return done;
+#endif
+	}
 
-	get_region_dims(area, nx, &xlen, ny, &ylen, nz, &zlen);
+	/* Same message as the old row by row reader gave */
+	void premature_eof(FILE * file, const vector<IOSpan> & spans, size_t first, size_t last,
+					   int64_t begin, size_t got)
+	{
+		size_t k = first;
 
-	bool debug = (getenv("DEBUG_IO") != NULL);
+		while (k + 1 < last && spans[k].offset + (int64_t)spans[k].len <= begin + (int64_t)got) k++;
+
+		fseek(file, 0, SEEK_END);
+
+		cout << "Reached premature end-of-file reading "
+			 << "region from image/slice number " << spans[k].slice
+			 << " of file with " << tell64(file) << " bytes." << endl;
+
+		throw ImageReadException("Unknownfilename", "incomplete data read");
+	}
+
+	/* Read a set of spans from the file in ascending file order. Spans separated
+	 * by small gaps are fetched with a single read into a staging buffer, and
+	 * runs which are contiguous both on disk and in memory are read in place. */
+	void read_spans(FILE * file, vector<IOSpan> & spans)
+	{
+		if (spans.empty()) return;
+
+		std::sort(spans.begin(), spans.end());
+
+		// a seek writes out anything stdio still holds for a stream opened
+		// for update, so the positioned reads below see it
+		portable_fseek(file, 0, SEEK_CUR);
+
+		vector<unsigned char> stage;
+		size_t i = 0;
+
+		while (i < spans.size()) {
+			int64_t begin = spans[i].offset;
+			int64_t end = begin + spans[i].len;
+			bool in_place = true;
+			size_t j = i + 1;
+
+			for (; j < spans.size(); j++) {
+				const IOSpan & s = spans[j];
+
+				if (s.offset < end || (size_t)(s.offset - end) > SPAN_MAX_GAP) break;
+				if ((size_t)(s.offset + s.len - begin) > SPAN_MAX_READ) break;
+
+				in_place = in_place && s.offset == end && s.dest == spans[j-1].dest + spans[j-1].len;
+				end = s.offset + s.len;
+			}
+
+			size_t len = end - begin;
+
+			if (in_place) {
+				size_t got = read_at(file, spans[i].dest, len, begin);
+
+				if (got != len) premature_eof(file, spans, i, j, begin, got);
+			}
+			else {
+				stage.resize(len);
+
+				size_t got = read_at(file, stage.data(), len, begin);
+
+				if (got != len) premature_eof(file, spans, i, j, begin, got);
+
+				for (size_t k = i; k < j; k++) {
+					memcpy(spans[k].dest, &stage[spans[k].offset - begin], spans[k].len);
+				}
+			}
+
+			i = j;
+		}
+	}
+}
+
+/* Work out which part of the file and of memory a region read/write touches.
+ * Returns false if there is nothing to transfer. */
+static bool get_region_layout(RegionLayout & L, int image_index,
+							  size_t mode_size, int nx, int ny, int nz,
+							  const Region * area, bool need_flip,
+							  int pre_row, int post_row, bool debug)
+{
+	const size_t mode_size_half = 11111111;
+
+	L.dx0 = 0; // data x0
+	L.dy0 = 0; // data y0
+	L.dz0 = 0; // data z0
+
+	L.fx0 = 0; // file x0
+	L.fy0 = 0; // file y0
+	L.fz0 = nz > 1 ? 0 : image_index; // file z0
+
+	L.xlen = 0;
+	L.ylen = 0;
+	L.zlen = 0;
+
+	int & dx0 = L.dx0, & dy0 = L.dy0, & dz0 = L.dz0;
+	int & fx0 = L.fx0, & fy0 = L.fy0, & fz0 = L.fz0;
+	int & xlen = L.xlen, & ylen = L.ylen, & zlen = L.zlen;
+
+	EMUtil::get_region_dims(area, nx, &xlen, ny, &ylen, nz, &zlen);
 
 	if (debug) {
-		printf ("-------------- process_region_io --------------\n");
-		printf ("rw, indx, modsiz, nx, ny, nz = %d %d %ld %d %d %d\n",
-					rw_mode, image_index, mode_size, nx, ny, nz);
-		printf ("flip, imtyp, prerow, postrow = %d %d %d %d\n",
-					(int) need_flip, (int) imgtype, pre_row, post_row);
 		printf ("xlen, ylen, zlen = %d %d %d\n", xlen, ylen, zlen);
 
 		if (area != NULL) {
@@ -1037,7 +1190,7 @@ void EMUtil::process_region_io(void *vdata, FILE * file,
 		if ((fz0 + zlen)> nz && nz > 1) zlen = nz-fz0;
 
 		// This is fine - the region was entirely outside the image
-		if ( xlen <= 0 || ylen <= 0 || zlen <= 0 ) return;
+		if ( xlen <= 0 || ylen <= 0 || zlen <= 0 ) return false;
 
 		if (mode_size == mode_size_half) {
 			// Have an area with 8 bit packed MRC format
@@ -1066,7 +1219,7 @@ void EMUtil::process_region_io(void *vdata, FILE * file,
 			}
 
 			if (error) {
-				return;
+				return false;
 			}
 		}
 	}
@@ -1074,7 +1227,7 @@ void EMUtil::process_region_io(void *vdata, FILE * file,
 	if (xlen <= 0) {
 		cout << "Xlen was too small " << xlen << endl;
 
-		return;
+		return false;
 	}
 
 	Vec3i size;
@@ -1083,59 +1236,172 @@ void EMUtil::process_region_io(void *vdata, FILE * file,
 	else size = Vec3d(nx,ny,nz);
 
 	//size_t area_sec_size = ylen    * mode_size_product(xlen,    mode_size);
-	size_t memory_sec_size = size[1] * mode_size_product(size[0], mode_size);
-	size_t img_row_size    = mode_size_product(nx,      mode_size) +
+	L.memory_sec_size = size[1] * EMUtil::mode_size_product(size[0], mode_size);
+	L.img_row_size    = EMUtil::mode_size_product(nx,      mode_size) +
 									 pre_row + post_row;
-	size_t area_row_size   = mode_size_product(xlen,    mode_size);
-	size_t memory_row_size = mode_size_product(size[0], mode_size);
+	L.area_row_size   = EMUtil::mode_size_product(xlen,    mode_size);
+	L.memory_row_size = EMUtil::mode_size_product(size[0], mode_size);
 
-	if ( area_row_size <= 0 ) {
+	if ( L.area_row_size <= 0 ) {
 		cout << "Xlen was too small " << xlen << " mode_size " << mode_size << endl;
 
-		return;
+		return false;
 	}
 
-	size_t x_pre_gap  = mode_size_product(fx0, mode_size);
-	size_t x_post_gap = mode_size_product(nx - fx0 - xlen, mode_size);
+	L.x_pre_gap  = EMUtil::mode_size_product(fx0, mode_size);
+	L.x_post_gap = EMUtil::mode_size_product(nx - fx0 - xlen, mode_size);
 
-	size_t y_pre_gap  = fy0 * img_row_size;
-	size_t y_post_gap = (ny - fy0 - ylen) * img_row_size;
+	L.y_pre_gap  = fy0 * L.img_row_size;
+	L.y_post_gap = (ny - fy0 - ylen) * L.img_row_size;
 
-	if (x_pre_gap  < 0) x_pre_gap  = 0;
-	if (x_post_gap < 0) x_post_gap = 0;
+	size_t extra = L.img_row_size - (L.x_pre_gap + L.area_row_size + L.x_post_gap);
 
-	size_t extra = img_row_size - (x_pre_gap + area_row_size + x_post_gap);
-
-	if (extra > 0) x_post_gap += extra;
-
-	portable_fseek(file, img_row_size * ny * fz0, SEEK_CUR);
-
-	float nxlendata[1];
-	int floatsize = (int) sizeof(float);
-	nxlendata[0] = (float)(nx * floatsize);
+	if (extra > 0) L.x_post_gap += extra;
 
 	if (debug) {
 		printf ("fz0, dz0, xlen, ylen, zlen = %d %d %d %d %d\n",
 					fz0, dz0, xlen, ylen, zlen);
-		printf ("x_pre_gap, x_post_gap, y_pre_gap, y_post_gap = %d %d %d %d\n",
-					x_pre_gap, x_post_gap, y_pre_gap, y_post_gap);
+		printf ("x_pre_gap, x_post_gap, y_pre_gap, y_post_gap = %ld %ld %ld %ld\n",
+					L.x_pre_gap, L.x_post_gap, L.y_pre_gap, L.y_post_gap);
 		printf ("mem_sec_siz, img_row_siz, are_row_siz, mem_row_siz = %ld %ld %ld %ld\n",
-					memory_sec_size, img_row_size, area_row_size, memory_row_size);
+					L.memory_sec_size, L.img_row_size, L.area_row_size, L.memory_row_size);
 		printf ("-----------------------------------------------\n");
 	}
 
-	for (int k = dz0; k < (dz0+zlen); k++) {
+	return true;
+}
+
+/* Memory row for file row j of a region, including the imagic y flip */
+static inline int region_memory_row(const RegionLayout & L, int j, bool need_flip)
+{
+	int jj = j;
+
+	if (need_flip) {
+		jj = (L.dy0+L.ylen) - 1 - j;
+
+		// region considerations add complications
+		// in the flipping scenario (imagic format)
+		if (L.dy0 > 0) {
+			jj += L.dy0;
+		}
+	}
+
+	return jj;
+}
+
+/* Append the file spans making up a region, with the image starting at base.
+ * The file position is advanced exactly as the row by row write loop in
+ * process_region_io() does, so anything it writes reads back identically.
+ * Returns the offset just past the last section touched. */
+static int64_t add_region_spans(vector<IOSpan> & spans, const RegionLayout & L,
+							  unsigned char * cdata, int64_t base, size_t mode_size,
+							  int ny, int pre_row, int post_row, bool need_flip)
+{
+	size_t dxoff = (size_t) EMUtil::mode_size_product(L.dx0, mode_size);
+	int64_t pos = base + (int64_t)L.img_row_size * ny * L.fz0;
+
+	for (int k = L.dz0; k < (L.dz0+L.zlen); k++) {
+		size_t k2 = k*L.memory_sec_size;
+
+		pos += L.y_pre_gap;
+
+		for (int j = L.dy0; j < (L.dy0+L.ylen); j++) {
+			int jj = region_memory_row(L, j, need_flip);
+
+			pos += pre_row + L.x_pre_gap;
+
+			IOSpan s;
+			s.offset = pos;
+			s.len = L.area_row_size;
+			s.dest = &cdata[k2 + jj * L.memory_row_size + dxoff];
+			s.slice = k;
+
+			pos += L.area_row_size + L.x_post_gap + post_row;
+
+			// rows which are adjacent both on disk and in memory merge into one span
+			if (!spans.empty()) {
+				IOSpan & last = spans.back();
+
+				if (last.offset + (int64_t)last.len == s.offset && last.dest + last.len == s.dest) {
+					last.len += s.len;
+					continue;
+				}
+			}
+
+			spans.push_back(s);
+		}
+
+		pos += L.y_post_gap;
+	}
+
+	return pos;
+}
+
+void EMUtil::process_region_io(void *vdata, FILE * file,
+							   int rw_mode, int image_index,
+							   size_t mode_size, int nx, int ny, int nz,
+							   const Region * area, bool need_flip,
+							   ImageType imgtype, int pre_row, int post_row)
+{
+	Assert(vdata != 0);
+	Assert(file != 0);
+	Assert(rw_mode == ImageIO::READ_ONLY ||
+		   rw_mode == ImageIO::READ_WRITE ||
+		   rw_mode == ImageIO::WRITE_ONLY);
+
+	if (mode_size == 0) throw UnexpectedBehaviorException("The mode size was 0?");
+
+	unsigned char * cdata = (unsigned char *)vdata;
+
+	bool debug = (getenv("DEBUG_IO") != NULL);
+
+	if (debug) {
+		printf ("-------------- process_region_io --------------\n");
+		printf ("rw, indx, modsiz, nx, ny, nz = %d %d %ld %d %d %d\n",
+					rw_mode, image_index, mode_size, nx, ny, nz);
+		printf ("flip, imtyp, prerow, postrow = %d %d %d %d\n",
+					(int) need_flip, (int) imgtype, pre_row, post_row);
+	}
+
+	RegionLayout L;
+
+	if (!get_region_layout(L, image_index, mode_size, nx, ny, nz, area,
+						   need_flip, pre_row, post_row, debug)) return;
+
+	// Reads don't walk the file row by row, the row pieces are gathered and
+	// fetched with a few large positioned reads. The stream is left where the
+	// sequential version would have left it.
+	if (rw_mode == ImageIO::READ_ONLY) {
+		int64_t base = tell64(file);
+
+		vector<IOSpan> spans;
+		int64_t end = add_region_spans(spans, L, cdata, base, mode_size, ny,
+									 pre_row, post_row, need_flip);
+		read_spans(file, spans);
+
+		seek64(file, end);
+
+		return;
+	}
+
+	portable_fseek(file, L.img_row_size * ny * L.fz0, SEEK_CUR);
+
+	float nxlendata[1];
+	int floatsize = (int) sizeof(float);
+	nxlendata[0] = (float)(nx * floatsize);
+
+	for (int k = L.dz0; k < (L.dz0+L.zlen); k++) {
 		// k is image/slice number, starting from 0
-		if (y_pre_gap > 0) {
-			portable_fseek(file, y_pre_gap, SEEK_CUR);
+		if (L.y_pre_gap > 0) {
+			portable_fseek(file, L.y_pre_gap, SEEK_CUR);
 		}
 
 		//long k2 = k * area_sec_size;
-		long k2 = k*memory_sec_size;
+		long k2 = k*L.memory_sec_size;
 
-		for (int j = dy0; j < (dy0+ylen); j++) {
+		for (int j = L.dy0; j < (L.dy0+L.ylen); j++) {
 			if (pre_row > 0) {
-				if (imgtype == IMAGE_ICOS && rw_mode != ImageIO::READ_ONLY && !area) {
+				if (imgtype == IMAGE_ICOS && !area) {
 					fwrite(nxlendata, floatsize, 1, file);
 				}
 				else {
@@ -1143,55 +1409,24 @@ void EMUtil::process_region_io(void *vdata, FILE * file,
 				}
 			}
 
-			if (x_pre_gap > 0) {
-				portable_fseek(file, x_pre_gap, SEEK_CUR);
-			}
-
-			int jj = j;
-
-			if (need_flip) {
-				jj = (dy0+ylen) - 1 - j;
-
-				// region considerations add complications
-				// in the flipping scenario (imagic format)
-				if (dy0 > 0) {
-					jj += dy0;
-				}
+			if (L.x_pre_gap > 0) {
+				portable_fseek(file, L.x_pre_gap, SEEK_CUR);
 			}
 
-			if (rw_mode == ImageIO::READ_ONLY) {
-				if (fread(&cdata[k2 + jj * memory_row_size +
-						  (size_t) mode_size_product(dx0, mode_size)],
-						  area_row_size, 1, file) != 1) {
+			int jj = region_memory_row(L, j, need_flip);
 
-//					cout << jj << " " << k2 << " " << memory_row_size
-//						  << " " << dx0 << " "
-//						  << mode_size << " " << area_row_size << " "
-//						  << cdata << ftell(file) << "done" << endl;
-
-					cout << "Reached premature end-of-file reading "
-						  << "region from image/slice number " << k
-						  << " of file with " << ftell(file)
-						  << " bytes." << endl;
-
-					throw ImageReadException("Unknownfilename",
-													 "incomplete data read");
-				}
-			}
-			else {
-				if (fwrite(&cdata[k2 + jj * memory_row_size +
-							(size_t) mode_size_product(dx0, mode_size)],
-						   area_row_size, 1, file) != 1) {
-					throw ImageWriteException("", "incomplete data write");
-				}
+			if (fwrite(&cdata[k2 + jj * L.memory_row_size +
+						(size_t) mode_size_product(L.dx0, mode_size)],
+					   L.area_row_size, 1, file) != 1) {
+				throw ImageWriteException("", "incomplete data write");
 			}
 
-			if (x_post_gap > 0) {
-				portable_fseek(file, x_post_gap, SEEK_CUR);
+			if (L.x_post_gap > 0) {
+				portable_fseek(file, L.x_post_gap, SEEK_CUR);
 			}
 
 			if (post_row > 0) {
-				if (imgtype == IMAGE_ICOS && rw_mode != ImageIO::READ_ONLY && !area) {
+				if (imgtype == IMAGE_ICOS && !area) {
 					fwrite(nxlendata, floatsize, 1, file);
 				}
 				else {
@@ -1200,12 +1435,48 @@ void EMUtil::process_region_io(void *vdata, FILE * file,
 			}
 		}
 
-		if (y_post_gap > 0) {
-			portable_fseek(file, y_post_gap, SEEK_CUR);
+		if (L.y_post_gap > 0) {
+			portable_fseek(file, L.y_post_gap, SEEK_CUR);
 		}
 	}
 }
 
+void EMUtil::process_regions_io(const vector<void *> & vdata, FILE * file,
+								int image_index, size_t mode_size,
+								int nx, int ny, int nz,
+								const vector<Region> & areas, bool need_flip,
+								int pre_row, int post_row)
+{
+	Assert(file != 0);
+
+	if (vdata.size() != areas.size()) {
+		throw InvalidParameterException("process_regions_io: need one buffer per region");
+	}
+
+	if (mode_size == 0) throw UnexpectedBehaviorException("The mode size was 0?");
+
+	bool debug = (getenv("DEBUG_IO") != NULL);
+	int64_t base = tell64(file);
+	int64_t end = base;
+
+	vector<IOSpan> spans;
+
+	for (size_t i = 0; i < areas.size(); i++) {
+		Assert(vdata[i] != 0);
+
+		RegionLayout L;
+
+		if (!get_region_layout(L, image_index, mode_size, nx, ny, nz, &areas[i],
+							   need_flip, pre_row, post_row, debug)) continue;
+
+		end = std::max(end, add_region_spans(spans, L, (unsigned char *)vdata[i], base,
+											 mode_size, ny, pre_row, post_row, need_flip));
+	}
+
+	read_spans(file, spans);
+	seek64(file, end);
+}
+
 void EMUtil::dump_dict(const Dict & dict)
 {
 	vector < string > keys = dict.keys();
@@ -1729,33 +2000,58 @@ void EMUtil::getRenderMinMax(float * data, const int nx, const int ny,
 	if (rendermax <= rendermin || Util::is_nan(rendermin) || Util::is_nan(rendermax) ||
 		fabs(rendermin) > use_num_std_devs || fabs(rendermax) > use_num_std_devs) haslim=0;
 		
-	double m = 0.0f, s = 0.0f;
-	size_t nint=0,n0=0,n1=0;	// count the number of integers, zeroes and ones
 	size_t size = (size_t)nx*ny*nz;
-	float min = data[0], max = data[0];
 	int bitval = 1<<renderbits;
 
 	// we compute image statistics. If this were designed right, we'd have the actual image instead of just
 	// the data pointer and wouldn't need to do this (other than maybe the integer counting)
 	// However, this also saves us from the problem of modified min/max values based on passed in rendermin/max
-	for (size_t i = 0; i < size; ++i) {
-		float val=data[i];
-		if (haslim) {
-			if (val<rendermin) val=rendermin;
-			if (val>rendermax) val=rendermax;
+	// The pass is split into fixed blocks that are summed in order afterwards, so the sums, and
+	// the limits chosen below, do not depend on the number of threads.
+	struct RenderStats {
+		double m = 0.0, s = 0.0;
+		size_t nint = 0, n0 = 0, n1 = 0;	// count the number of integers, zeroes and ones
+		float min, max;
+	};
+
+	const size_t block = 1 << 16;
+	vector<RenderStats> part((size + block - 1) / block);
+	EMThreads::parallel_for_each(part.size(), [&](size_t b, int) {
+		size_t begin = b * block, end = std::min(begin + block, size);
+		RenderStats st;
+		st.min = st.max = data[0];		// min/max are seeded with the unclamped first pixel
+
+		for (size_t i = begin; i < end; ++i) {
+			float val=data[i];
+			if (haslim) {
+				if (val<rendermin) val=rendermin;
+				if (val>rendermax) val=rendermax;
+			}
+			st.m += val;
+			st.s += val*val;
+			if (val==0.0f) st.n0++;
+			else if (val==1.0f) st.n1++;
+			if (val==float(int(val))) st.nint++;
+
+			st.min = val < st.min ? val : st.min;
+			st.max = val > st.max ? val : st.max;
 		}
-		m += val;
-		s += val*val;
-		if (val==0.0f) n0++;
-		else if (val==1.0f) n1++;
-		if (val==float(int(val))) nint++;
+		part[b] = st;
+	});
 
-		min = val < min ? val : min;
-		max = val > max ? val : max;
-//			if (!Util::goodf(&data[i])) printf("NAN in image at pixel %ld\n",i);
+	double m = 0.0f, s = 0.0f;
+	size_t nint=0,n0=0,n1=0;
+	float min = part[0].min, max = part[0].max;
+	for (const auto &st : part) {
+		m += st.m;
+		s += st.s;
+		nint += st.nint;
+		n0 += st.n0;
+		n1 += st.n1;
+		min = st.min < min ? st.min : min;
+		max = st.max > max ? st.max : max;
 	}
 
-
 	float mnz = m/(size-n0);	// mean, excluding zeroes
 	float snz = sqrt(s/(size-n0)-mnz*mnz);	// sigma, excluding zeroes
 	m /= (float)(size);
@@ -1833,6 +2129,53 @@ void EMUtil::getRenderMinMax(float * data, const int nx, const int ny,
 	if (debug) printf ("out of RenderMinMax, rmin = %g, rmax = %g, rbits = %d\n", rendermin, rendermax, renderbits);
 }
 
+namespace {
+	const size_t HALF_GRAIN = 1 << 16;
+
+	inline unsigned short float_to_bfloat16(float f)
+	{
+		unsigned int u;
+		memcpy(&u, &f, sizeof(u));
+		if ((u & 0x7fffffff) > 0x7f800000) return (unsigned short)((u >> 16) | 0x40);	// keep NaN quiet
+		u += 0x7fff + ((u >> 16) & 1);
+		return (unsigned short)(u >> 16);
+	}
+
+	inline float bfloat16_to_float(unsigned short h)
+	{
+		unsigned int u = (unsigned int)h << 16;
+		float f;
+		memcpy(&f, &u, sizeof(f));
+		return f;
+	}
+}
+
+void EMUtil::float_to_half(const float * src, unsigned short * dst, size_t n, bool bfloat16)
+{
+	EMThreads::parallel_for(n, [=](size_t begin, size_t end, int) {
+		if (bfloat16) {
+			for (size_t i = begin; i < end; i++) dst[i] = float_to_bfloat16(src[i]);
+		}
+		else {
+			for (size_t i = begin; i < end; i++) {
+				dst[i] = (unsigned short)half_float::detail::float2half<std::round_to_nearest>(src[i]);
+			}
+		}
+	}, HALF_GRAIN);
+}
+
+void EMUtil::half_to_float(const unsigned short * src, float * dst, size_t n, bool bfloat16)
+{
+	EMThreads::parallel_for(n, [=](size_t begin, size_t end, int) {
+		if (bfloat16) {
+			for (size_t i = begin; i < end; i++) dst[i] = bfloat16_to_float(src[i]);
+		}
+		else {
+			for (size_t i = begin; i < end; i++) dst[i] = half_float::detail::half2float<float>(src[i]);
+		}
+	}, HALF_GRAIN);
+}
+
 #ifdef USE_HDF5
 EMObject EMUtil::read_hdf_attribute(const string & filename, const string & key, int image_index)
 {
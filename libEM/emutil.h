@@ -35,6 +35,8 @@
 #include <cstring>
 #include "emobject.h"
 #include "emassert.h"
+#include "embuffer.h"
+#include "emshm.h"
 
 using std::string;
 using std::vector;
@@ -141,7 +143,8 @@ namespace EMAN
 			IMAGE_DF3,
 			IMAGE_OMAP,
 			IMAGE_SITUS,
-			IMAGE_SER
+			IMAGE_SER,
+			IMAGE_EMZ
 		};
 
 		static EMData *vertical_acf(const EMData * image, int maxdy);
@@ -251,6 +254,31 @@ namespace EMAN
 									  bool need_flip = false, ImageType imgtype=IMAGE_UNKNOWN,
 									  int pre_row = 0, int post_row = 0);
 
+		/** Read many regions of the same image from a binary image file in
+		 * a single pass. The rows of all regions are sorted by file offset and
+		 * read with a few large positioned reads, so extracting many small
+		 * boxes from a large micrograph or tomogram doesn't cost one seek
+		 * per row. The file must be positioned at the start of the image
+		 * data, as for process_region_io().
+		 * @param cdata One output buffer per region, each sized for its region.
+		 * @param file The image file pointer.
+		 * @param image_index Image index.
+		 * @param mode_size Pixel size.
+		 * @param nx Image x size.
+		 * @param ny Image y size.
+		 * @param nz Image z size.
+		 * @param areas The regions to read.
+		 * @param need_flip Do we need flip the image?
+		 * @param pre_row File size needed to be skipped before each row.
+		 * @param post_row File size needed to be skipped after each row.
+		 * @exception ImageReadException If the read has some error.
+		 */
+		static void process_regions_io(const vector<void *> & cdata, FILE * file,
+									   int image_index, size_t mode_size, int nx,
+									   int ny, int nz, const vector<Region> & areas,
+									   bool need_flip = false,
+									   int pre_row = 0, int post_row = 0);
+
 
 		/**
 		 * Works for regions that are outside the image data dimension area.
@@ -324,6 +352,24 @@ namespace EMAN
 		 * @param[in] nz z dimension size
 		 * */
 		static void getRenderMinMax(float * data, const int nx, const int ny, float & rendermin, float & rendermax, int &renderbits, const int nz = 1);
+
+		/** Convert a float array to 16-bit storage values, rounding to nearest even.
+		 *
+		 * @param[in] src float data
+		 * @param[out] dst 16-bit values, n of them
+		 * @param[in] n number of values
+		 * @param[in] bfloat16 use bfloat16 (8-bit exponent) instead of IEEE 754 half precision
+		 * */
+		static void float_to_half(const float * src, unsigned short * dst, size_t n, bool bfloat16 = false);
+
+		/** Expand 16-bit storage values produced by float_to_half() back to float.
+		 *
+		 * @param[in] src 16-bit values
+		 * @param[out] dst float data, n of them
+		 * @param[in] n number of values
+		 * @param[in] bfloat16 src holds bfloat16 rather than IEEE 754 half precision values
+		 * */
+		static void half_to_float(const unsigned short * src, float * dst, size_t n, bool bfloat16 = false);
 		
 #ifdef USE_HDF5
 		/** Retrive a single attribute value from a HDF5 image file.
@@ -372,12 +418,20 @@ namespace EMAN
 		}
 
 		inline static void* em_realloc(void* data,const size_t new_size) {
+			if (SharedMemory::active() && !SharedMemory::name_of(data).empty()) {
+				return SharedMemory::to_heap(data, new_size);
+			}
+			if (ExternalBuffer::active() && ExternalBuffer::contains(data)) {
+				return ExternalBuffer::to_heap(data, new_size);
+			}
 			return realloc(data, new_size);
 		}
 		inline static void em_memset(void* data, const int value, const size_t size) {
 			memset(data, value, size);
 		}
 		inline static void em_free(void*data) {
+			if (SharedMemory::active() && SharedMemory::release(data)) return;
+			if (ExternalBuffer::active() && ExternalBuffer::release(data)) return;
 			free(data);
 		}
 
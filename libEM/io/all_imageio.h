@@ -77,6 +77,7 @@
 #include "omapio.h"
 #include "situsio.h"
 #include "serio.h"
+#include "emzio.h"
 
 #ifdef ENABLE_V4L2
 	#include "v4l2io.h"
@@ -0,0 +1,1068 @@
+/*
+ * This software is issued under a joint BSD/GNU license. You may use the
+ * source code in this file under either license. However, note that the
+ * complete EMAN2 and SPARX software packages have some GPL dependencies,
+ * so you are responsible for compliance with the licenses of these packages
+ * if you opt to use BSD licensing. The warranty disclaimer below holds
+ * in either instance.
+ *
+ * This complete copyright notice must be included in any revised version of the
+ * source code. Additional authorship citations may be added, but existing
+ * author citations must be preserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA 
+ */
+
+#include <cstring>
+#include <algorithm>
+
+#include "emzio.h"
+#include "portable_fileio.h"
+#include "geometry.h"
+#include "transform.h"
+#include "emthreads.h"
+#include "util.h"
+
+using namespace EMAN;
+
+const char *EmzIO::MAGIC = "EMZSTACK";
+
+namespace {
+	const int FILE_HEADER_BYTES = 64;
+	const int RECORD_HEADER_BYTES = 40;
+	const int INDEX_HEADER_BYTES = 16;
+	const char RECORD_MAGIC[] = "EMZR";
+	const char INDEX_MAGIC[] = "EMZI";
+
+	// Rice coder parameters: residuals are coded in groups sharing one
+	// predictor choice and one k, quotients >= RICE_ESCAPE are sent raw
+	const int RICE_GROUP = 64;
+	const unsigned int RICE_ESCAPE = 24;
+	const int RICE_RAW_BITS = 17;
+
+	// attribute type tags, independent of EMObject::ObjectType
+	enum AttrType {
+		ATTR_BOOL = 1, ATTR_INT, ATTR_UINT, ATTR_FLOAT, ATTR_DOUBLE, ATTR_STRING, ATTR_CTF,
+		ATTR_FLOATARRAY, ATTR_INTARRAY, ATTR_STRINGARRAY, ATTR_TRANSFORM, ATTR_TRANSFORMARRAY
+	};
+
+	/*
+	 * little endian serialization
+	 */
+	void put_u32(vector<char> & b, uint32_t v)
+	{
+		for (int i = 0; i < 4; i++) b.push_back((char)(v >> (8 * i)));
+	}
+
+	void put_u64(vector<char> & b, uint64_t v)
+	{
+		for (int i = 0; i < 8; i++) b.push_back((char)(v >> (8 * i)));
+	}
+
+	void put_f32(vector<char> & b, float f)
+	{
+		uint32_t v;
+		memcpy(&v, &f, sizeof(v));
+		put_u32(b, v);
+	}
+
+	void put_f64(vector<char> & b, double d)
+	{
+		uint64_t v;
+		memcpy(&v, &d, sizeof(v));
+		put_u64(b, v);
+	}
+
+	void put_str(vector<char> & b, const string & s)
+	{
+		put_u32(b, (uint32_t)s.size());
+		b.insert(b.end(), s.begin(), s.end());
+	}
+
+	void set_u32(char * p, uint32_t v)
+	{
+		for (int i = 0; i < 4; i++) p[i] = (char)(v >> (8 * i));
+	}
+
+	void set_u64(char * p, uint64_t v)
+	{
+		for (int i = 0; i < 8; i++) p[i] = (char)(v >> (8 * i));
+	}
+
+	uint32_t get_u32(const char * p)
+	{
+		const unsigned char *u = (const unsigned char *)p;
+		return (uint32_t)u[0] | ((uint32_t)u[1] << 8) | ((uint32_t)u[2] << 16) | ((uint32_t)u[3] << 24);
+	}
+
+	uint64_t get_u64(const char * p)
+	{
+		return (uint64_t)get_u32(p) | ((uint64_t)get_u32(p + 4) << 32);
+	}
+
+	float get_f32(const char * p)
+	{
+		uint32_t v = get_u32(p);
+		float f;
+		memcpy(&f, &v, sizeof(f));
+		return f;
+	}
+
+	/** Sequential reader over a serialized buffer, throws on overrun */
+	class Reader
+	{
+	  public:
+		Reader(const char * begin, size_t n) : p(begin), end(begin + n) {}
+
+		const char * take(size_t n)
+		{
+			if ((size_t)(end - p) < n) throw ImageFormatException("truncated EMZ record");
+			const char *r = p;
+			p += n;
+			return r;
+		}
+		uint32_t u32() { return get_u32(take(4)); }
+		uint64_t u64() { return get_u64(take(8)); }
+		float f32() { return get_f32(take(4)); }
+		double f64()
+		{
+			uint64_t v = u64();
+			double d;
+			memcpy(&d, &v, sizeof(d));
+			return d;
+		}
+		string str()
+		{
+			uint32_t n = u32();
+			return string(take(n), n);
+		}
+		bool done() const { return p == end; }
+
+	  private:
+		const char *p;
+		const char *end;
+	};
+
+	bool skip_attr(const string & key)
+	{
+		// dimensions live in the record header, and like HdfIO2 the rendering
+		// limits must not be carried over from a previously read image
+		return key == "nx" || key == "ny" || key == "nz" ||
+			key == "render_min" || key == "render_max" || key == "render_bits" ||
+			key == "stored_rendermin" || key == "stored_rendermax" || key == "stored_renderbits";
+	}
+
+	void put_attrs(vector<char> & b, const Dict & dict)
+	{
+		vector<string> keys = dict.keys();
+
+		for (size_t i = 0; i < keys.size(); i++) {
+			if (skip_attr(keys[i])) continue;
+
+			EMObject obj = dict[keys[i]];
+			vector<char> v;
+
+			switch (obj.get_type()) {
+			case EMObject::BOOL:
+				v.push_back(ATTR_BOOL);
+				v.push_back((bool)obj ? 1 : 0);
+				break;
+			case EMObject::SHORT:
+				v.push_back(ATTR_INT);
+				put_u32(v, (uint32_t)(int)(short)obj);
+				break;
+			case EMObject::INT:
+				v.push_back(ATTR_INT);
+				put_u32(v, (uint32_t)(int)obj);
+				break;
+			case EMObject::UNSIGNEDINT:
+				v.push_back(ATTR_UINT);
+				put_u32(v, (unsigned int)obj);
+				break;
+			case EMObject::FLOAT:
+				v.push_back(ATTR_FLOAT);
+				put_f32(v, (float)obj);
+				break;
+			case EMObject::DOUBLE:
+				v.push_back(ATTR_DOUBLE);
+				put_f64(v, (double)obj);
+				break;
+			case EMObject::STRING:
+				v.push_back(ATTR_STRING);
+				put_str(v, (const char *)obj);
+				break;
+			case EMObject::CTF:
+				v.push_back(ATTR_CTF);
+				put_str(v, (const char *)obj);
+				break;
+			case EMObject::FLOATARRAY:
+			{
+				vector<float> fv = obj;
+				v.push_back(ATTR_FLOATARRAY);
+				put_u32(v, (uint32_t)fv.size());
+				for (size_t j = 0; j < fv.size(); j++) put_f32(v, fv[j]);
+				break;
+			}
+			case EMObject::INTARRAY:
+			{
+				vector<int> iv = obj;
+				v.push_back(ATTR_INTARRAY);
+				put_u32(v, (uint32_t)iv.size());
+				for (size_t j = 0; j < iv.size(); j++) put_u32(v, (uint32_t)iv[j]);
+				break;
+			}
+			case EMObject::STRINGARRAY:
+			{
+				vector<string> sv = obj;
+				v.push_back(ATTR_STRINGARRAY);
+				put_u32(v, (uint32_t)sv.size());
+				for (size_t j = 0; j < sv.size(); j++) put_str(v, sv[j]);
+				break;
+			}
+			case EMObject::TRANSFORM:
+			{
+				Transform *t = obj;
+				vector<float> m = t->get_matrix();
+				delete t;
+				v.push_back(ATTR_TRANSFORM);
+				for (size_t j = 0; j < 12; j++) put_f32(v, m[j]);
+				break;
+			}
+			case EMObject::TRANSFORMARRAY:
+			{
+				vector<Transform> tv = obj;
+				v.push_back(ATTR_TRANSFORMARRAY);
+				put_u32(v, (uint32_t)tv.size());
+				for (size_t j = 0; j < tv.size(); j++) {
+					vector<float> m = tv[j].get_matrix();
+					for (size_t k = 0; k < 12; k++) put_f32(v, m[k]);
+				}
+				break;
+			}
+			default:
+				LOGWARN("EMZ: attribute '%s' of this type is not stored", keys[i].c_str());
+				continue;
+			}
+
+			put_str(b, keys[i]);
+			b.insert(b.end(), v.begin(), v.end());
+		}
+	}
+
+	void get_attrs(Reader & r, Dict & dict)
+	{
+		while (!r.done()) {
+			string key = r.str();
+			int type = (unsigned char)*r.take(1);
+
+			switch (type) {
+			case ATTR_BOOL:
+				dict[key] = EMObject(*r.take(1) != 0);
+				break;
+			case ATTR_INT:
+				dict[key] = EMObject((int)r.u32());
+				break;
+			case ATTR_UINT:
+				dict[key] = EMObject((unsigned int)r.u32());
+				break;
+			case ATTR_FLOAT:
+				dict[key] = EMObject(r.f32());
+				break;
+			case ATTR_DOUBLE:
+				dict[key] = EMObject(r.f64());
+				break;
+			case ATTR_STRING:
+				dict[key] = EMObject(r.str());
+				break;
+			case ATTR_CTF:
+			{
+				EMObject obj(r.str());
+				obj.force_CTF();
+				dict[key] = obj;
+				break;
+			}
+			case ATTR_FLOATARRAY:
+			{
+				vector<float> fv(r.u32());
+				for (size_t j = 0; j < fv.size(); j++) fv[j] = r.f32();
+				dict[key] = EMObject(fv);
+				break;
+			}
+			case ATTR_INTARRAY:
+			{
+				vector<int> iv(r.u32());
+				for (size_t j = 0; j < iv.size(); j++) iv[j] = (int)r.u32();
+				dict[key] = EMObject(iv);
+				break;
+			}
+			case ATTR_STRINGARRAY:
+			{
+				vector<string> sv(r.u32());
+				for (size_t j = 0; j < sv.size(); j++) sv[j] = r.str();
+				dict[key] = EMObject(sv);
+				break;
+			}
+			case ATTR_TRANSFORM:
+			{
+				vector<float> m(12);
+				for (size_t j = 0; j < 12; j++) m[j] = r.f32();
+				Transform t;
+				t.set_matrix(m);
+				dict[key] = EMObject(&t);
+				break;
+			}
+			case ATTR_TRANSFORMARRAY:
+			{
+				vector<Transform> tv(r.u32());
+				vector<float> m(12);
+				for (size_t j = 0; j < tv.size(); j++) {
+					for (size_t k = 0; k < 12; k++) m[k] = r.f32();
+					tv[j].set_matrix(m);
+				}
+				dict[key] = EMObject(tv);
+				break;
+			}
+			default:
+				throw ImageFormatException("unknown attribute type in EMZ record");
+			}
+		}
+	}
+
+	/*
+	 * Rice coding of quantized pixel values. Each group of RICE_GROUP values is
+	 * predicted either from the previous pixel (zigzag coded difference) or from
+	 * the group minimum, whichever gives the smaller residuals, and coded with
+	 * the k that suits their mean. Bits are packed LSB first.
+	 */
+	class BitWriter
+	{
+	  public:
+		explicit BitWriter(vector<char> & o) : out(o), acc(0), nbits(0) {}
+
+		void put(uint32_t v, int n)
+		{
+			acc |= (uint64_t)v << nbits;
+			nbits += n;
+			while (nbits >= 8) {
+				out.push_back((char)(acc & 0xff));
+				acc >>= 8;
+				nbits -= 8;
+			}
+		}
+
+		void finish()
+		{
+			if (nbits > 0) out.push_back((char)(acc & 0xff));
+			acc = 0;
+			nbits = 0;
+		}
+
+	  private:
+		vector<char> & out;
+		uint64_t acc;
+		int nbits;
+	};
+
+	class BitReader
+	{
+	  public:
+		BitReader(const char * begin, size_t n) :
+			p((const unsigned char *)begin), end((const unsigned char *)begin + n), acc(0), nbits(0) {}
+
+		uint32_t get(int n)
+		{
+			if (n == 0) return 0;
+			if (nbits < n) refill();
+			uint32_t v = (uint32_t)(acc & ((1ULL << n) - 1));
+			acc >>= n;
+			nbits -= n;
+			return v;
+		}
+
+		/** count and consume leading one bits, stopping after limit of them */
+		uint32_t ones(uint32_t limit)
+		{
+			if (nbits < (int)limit + 1) refill();
+			uint32_t t = 0;
+			uint64_t a = acc;
+			while (t < limit && (a & 1)) {
+				a >>= 1;
+				t++;
+			}
+			int used = (t < limit) ? t + 1 : t;	// also drop the terminating zero
+			acc >>= used;
+			nbits -= used;
+			return t;
+		}
+
+	  private:
+		void refill()
+		{
+			while (nbits <= 56) {
+				acc |= (uint64_t)(p < end ? *p++ : 0) << nbits;
+				nbits += 8;
+			}
+		}
+
+		const unsigned char *p;
+		const unsigned char *end;
+		uint64_t acc;
+		int nbits;
+	};
+
+	inline uint32_t zigzag(int d) { return d >= 0 ? (uint32_t)d << 1 : ((uint32_t)(-d) << 1) - 1; }
+	inline int unzigzag(uint32_t z) { return (z & 1) ? -(int)((z + 1) >> 1) : (int)(z >> 1); }
+
+	void rice_put(BitWriter & bw, uint32_t v, int k)
+	{
+		uint32_t q = v >> k;
+		if (q < RICE_ESCAPE) {
+			bw.put((1u << q) - 1, q + 1);	// q ones and a zero
+			bw.put(v & ((1u << k) - 1), k);
+		}
+		else {
+			bw.put((1u << RICE_ESCAPE) - 1, RICE_ESCAPE);
+			bw.put(v, RICE_RAW_BITS);
+		}
+	}
+
+	uint32_t rice_get(BitReader & br, int k)
+	{
+		uint32_t q = br.ones(RICE_ESCAPE);
+		if (q >= RICE_ESCAPE) return br.get(RICE_RAW_BITS);
+		return (q << k) | br.get(k);
+	}
+
+	int rice_k(uint64_t sum, int n)
+	{
+		int k = 0;
+		while (k < 16 && ((uint64_t)n << (k + 1)) <= sum) k++;
+		return k;
+	}
+
+	void rice_encode(const unsigned short * v, size_t n, vector<char> & out)
+	{
+		BitWriter bw(out);
+		uint32_t res[RICE_GROUP];
+		int prev = 0;
+
+		for (size_t g = 0; g < n; g += RICE_GROUP) {
+			int m = (int)std::min((size_t)RICE_GROUP, n - g);
+			uint64_t dsum = 0, bsum = 0;
+			int vmin = v[g];
+			for (int i = 0; i < m; i++) {
+				int p = i ? v[g + i - 1] : prev;
+				dsum += zigzag(v[g + i] - p);
+				vmin = std::min(vmin, (int)v[g + i]);
+			}
+			for (int i = 0; i < m; i++) bsum += v[g + i] - vmin;
+
+			bool delta = dsum < bsum;
+			bw.put(delta ? 1 : 0, 1);
+			if (delta) {
+				for (int i = 0; i < m; i++) res[i] = zigzag(v[g + i] - (i ? v[g + i - 1] : prev));
+			}
+			else {
+				bw.put(vmin, 16);
+				for (int i = 0; i < m; i++) res[i] = v[g + i] - vmin;
+			}
+			int k = rice_k(delta ? dsum : bsum, m);
+			bw.put(k, 5);
+			for (int i = 0; i < m; i++) rice_put(bw, res[i], k);
+			prev = v[g + m - 1];
+		}
+		bw.finish();
+	}
+
+	void rice_decode(const char * in, size_t nbytes, unsigned short * v, size_t n)
+	{
+		BitReader br(in, nbytes);
+		int prev = 0;
+
+		for (size_t g = 0; g < n; g += RICE_GROUP) {
+			int m = (int)std::min((size_t)RICE_GROUP, n - g);
+			bool delta = br.get(1) != 0;
+			int vmin = delta ? 0 : (int)br.get(16);
+			int k = br.get(5);
+			for (int i = 0; i < m; i++) {
+				uint32_t r = rice_get(br, k);
+				if (delta) prev = prev + unzigzag(r);
+				else prev = vmin + (int)r;
+				v[g + i] = (unsigned short)prev;
+			}
+		}
+	}
+}
+
+EmzIO::EmzIO(const string & fname, IOMode rw)
+:	ImageIO(fname, rw), nimg(0), is_new_file(false), file_end(0), pending_index(-1)
+{
+}
+
+EmzIO::~EmzIO()
+{
+	if (file) {
+		if (rw_mode != READ_ONLY) {
+			if (pending_index >= 0) write_pending_header();
+			write_file_header();
+		}
+		fclose(file);
+		file = 0;
+	}
+}
+
+void EmzIO::init()
+{
+	ENTERFUNC;
+
+	if (initialized) {
+		return;
+	}
+
+	initialized = true;
+	file = sfopen(filename, rw_mode, &is_new_file);
+
+	portable_fseek(file, 0, SEEK_END);
+	file_end = portable_ftell(file);
+	if (file_end == 0) is_new_file = true;
+
+	if (is_new_file) {
+		file_end = FILE_HEADER_BYTES;
+		write_file_header();
+		EXITFUNC;
+		return;
+	}
+
+	char buf[FILE_HEADER_BYTES];
+	portable_fseek(file, 0, SEEK_SET);
+	if (fread(buf, FILE_HEADER_BYTES, 1, file) != 1) {
+		throw ImageReadException(filename, "EMZ header");
+	}
+	if (!is_valid(buf)) {
+		throw ImageReadException(filename, "invalid EMZ file");
+	}
+	if (get_u32(buf + 8) != 1) {
+		throw ImageReadException(filename, "unsupported EMZ version");
+	}
+
+	nimg = (int)get_u32(buf + 12);
+	int64_t next = (int64_t)get_u64(buf + 16);
+	offsets.resize(nimg);
+	lengths.resize(nimg);
+
+	// walk the index chain, one read per INDEX_ENTRIES images
+	vector<char> blk(INDEX_HEADER_BYTES + (size_t)INDEX_ENTRIES * 16);
+	for (int first = 0; first < nimg; first += INDEX_ENTRIES) {
+		if (next <= 0 || next >= file_end) {
+			throw ImageReadException(filename, "EMZ index truncated");
+		}
+		portable_fseek(file, next, SEEK_SET);
+		if (fread(blk.data(), blk.size(), 1, file) != 1 || memcmp(blk.data(), INDEX_MAGIC, 4) != 0) {
+			throw ImageReadException(filename, "EMZ index block");
+		}
+		index_blocks.push_back(next);
+
+		int n = std::min(INDEX_ENTRIES, nimg - first);
+		for (int i = 0; i < n; i++) {
+			const char *e = blk.data() + INDEX_HEADER_BYTES + i * 16;
+			offsets[first + i] = (int64_t)get_u64(e);
+			lengths[first + i] = (int64_t)get_u64(e + 8);
+		}
+		next = (int64_t)get_u64(blk.data() + 8);
+	}
+
+	EXITFUNC;
+}
+
+bool EmzIO::is_valid(const void *first_block)
+{
+	ENTERFUNC;
+	bool result = false;
+
+	if (first_block) {
+		result = memcmp(first_block, MAGIC, 8) == 0;
+	}
+
+	EXITFUNC;
+	return result;
+}
+
+int EmzIO::get_nimg()
+{
+	init();
+	return nimg;
+}
+
+void EmzIO::write_file_header()
+{
+	vector<char> buf(FILE_HEADER_BYTES, 0);
+	memcpy(buf.data(), MAGIC, 8);
+	set_u32(buf.data() + 8, 1);
+	set_u32(buf.data() + 12, (uint32_t)nimg);
+	set_u64(buf.data() + 16, index_blocks.empty() ? 0 : (uint64_t)index_blocks[0]);
+	set_u32(buf.data() + 24, INDEX_ENTRIES);
+	set_u32(buf.data() + 28, (uint32_t)BLOCK_PIXELS);
+
+	portable_fseek(file, 0, SEEK_SET);
+	if (fwrite(buf.data(), buf.size(), 1, file) != 1) {
+		throw ImageWriteException(filename, "EMZ header");
+	}
+}
+
+void EmzIO::write_count()
+{
+	char buf[12];
+	set_u32(buf, (uint32_t)nimg);
+	set_u64(buf + 4, index_blocks.empty() ? 0 : (uint64_t)index_blocks[0]);
+
+	portable_fseek(file, 12, SEEK_SET);
+	if (fwrite(buf, sizeof(buf), 1, file) != 1) {
+		throw ImageWriteException(filename, "EMZ header");
+	}
+}
+
+void EmzIO::put_record_header(vector<char> & rec, const RecordHeader & hdr)
+{
+	rec.insert(rec.end(), RECORD_MAGIC, RECORD_MAGIC + 4);
+	put_u32(rec, hdr.nx);
+	put_u32(rec, hdr.ny);
+	put_u32(rec, hdr.nz);
+	put_u32(rec, hdr.codec);
+	put_u32(rec, (uint32_t)hdr.renderbits);
+	put_f32(rec, hdr.rendermin);
+	put_f32(rec, hdr.rendermax);
+	put_u32(rec, hdr.nblocks);
+	put_u32(rec, hdr.attr_bytes);
+}
+
+void EmzIO::fill_gap(int image_index, int nx, int ny, int nz)
+{
+	if (image_index <= nimg) return;
+
+	RecordHeader hdr;
+	hdr.nx = nx;
+	hdr.ny = ny;
+	hdr.nz = nz;
+	hdr.codec = CODEC_BLANK;
+	hdr.renderbits = 0;
+	hdr.rendermin = hdr.rendermax = 0;
+	hdr.nblocks = 0;
+	hdr.attr_bytes = 0;
+
+	vector<char> rec;
+	put_record_header(rec, hdr);
+
+	int64_t offset = append(rec);
+	for (int i = nimg; i < image_index; i++) set_entry(i, offset, rec.size());
+}
+
+int64_t EmzIO::append(const vector<char> & buf)
+{
+	int64_t offset = file_end;
+
+	portable_fseek(file, offset, SEEK_SET);
+	if (fwrite(buf.data(), buf.size(), 1, file) != 1) {
+		throw ImageWriteException(filename, "EMZ record");
+	}
+	file_end += buf.size();
+
+	return offset;
+}
+
+void EmzIO::set_entry(int image_index, int64_t offset, int64_t length)
+{
+	while ((int)index_blocks.size() <= image_index / INDEX_ENTRIES) {
+		vector<char> blk(INDEX_HEADER_BYTES + (size_t)INDEX_ENTRIES * 16, 0);
+		memcpy(blk.data(), INDEX_MAGIC, 4);
+		int64_t pos = append(blk);
+
+		if (!index_blocks.empty()) {
+			char link[8];
+			set_u64(link, (uint64_t)pos);
+			portable_fseek(file, index_blocks.back() + 8, SEEK_SET);
+			fwrite(link, 8, 1, file);
+		}
+		index_blocks.push_back(pos);
+	}
+
+	char entry[16];
+	set_u64(entry, (uint64_t)offset);
+	set_u64(entry + 8, (uint64_t)length);
+	portable_fseek(file, index_blocks[image_index / INDEX_ENTRIES] + INDEX_HEADER_BYTES +
+				   (int64_t)(image_index % INDEX_ENTRIES) * 16, SEEK_SET);
+	if (fwrite(entry, 16, 1, file) != 1) {
+		throw ImageWriteException(filename, "EMZ index");
+	}
+
+	if (image_index >= nimg) {
+		nimg = image_index + 1;
+		offsets.resize(nimg);
+		lengths.resize(nimg);
+	}
+	offsets[image_index] = offset;
+	lengths[image_index] = length;
+}
+
+int EmzIO::load_record(int image_index, RecordHeader & hdr, Dict * dict, int64_t & data_offset)
+{
+	char buf[RECORD_HEADER_BYTES];
+
+	portable_fseek(file, offsets[image_index], SEEK_SET);
+	if (fread(buf, RECORD_HEADER_BYTES, 1, file) != 1 || memcmp(buf, RECORD_MAGIC, 4) != 0) {
+		throw ImageReadException(filename, "EMZ record header");
+	}
+
+	hdr.nx = (int)get_u32(buf + 4);
+	hdr.ny = (int)get_u32(buf + 8);
+	hdr.nz = (int)get_u32(buf + 12);
+	hdr.codec = (int)get_u32(buf + 16);
+	hdr.renderbits = (int)get_u32(buf + 20);
+	hdr.rendermin = get_f32(buf + 24);
+	hdr.rendermax = get_f32(buf + 28);
+	hdr.nblocks = (int)get_u32(buf + 32);
+	hdr.attr_bytes = get_u32(buf + 36);
+
+	if (dict && hdr.attr_bytes > 0) {
+		vector<char> attrs(hdr.attr_bytes);
+		if (fread(attrs.data(), attrs.size(), 1, file) != 1) {
+			throw ImageReadException(filename, "EMZ attributes");
+		}
+		Reader r(attrs.data(), attrs.size());
+		get_attrs(r, *dict);
+	}
+
+	data_offset = offsets[image_index] + RECORD_HEADER_BYTES + hdr.attr_bytes;
+	return 0;
+}
+
+int EmzIO::read_header(Dict & dict, int image_index, const Region * area, bool)
+{
+	ENTERFUNC;
+
+	check_read_access(image_index);
+
+	RecordHeader hdr;
+	int64_t data_offset;
+	load_record(image_index, hdr, &dict, data_offset);
+	check_region(area, IntSize(hdr.nx, hdr.ny, hdr.nz), false, false);
+
+	int xlen = 0, ylen = 0, zlen = 0;
+	EMUtil::get_region_dims(area, hdr.nx, &xlen, hdr.ny, &ylen, hdr.nz, &zlen);
+
+	dict["nx"] = xlen;
+	dict["ny"] = ylen;
+	dict["nz"] = zlen;
+
+	if (hdr.codec == CODEC_RICE) {
+		dict["datatype"] = (int)(hdr.renderbits <= 8 ? EMUtil::EM_UCHAR : EMUtil::EM_USHORT);
+		dict["stored_rendermin"] = hdr.rendermin;
+		dict["stored_rendermax"] = hdr.rendermax;
+		dict["stored_renderbits"] = hdr.renderbits;
+	}
+	else {
+		dict["datatype"] = (int)EMUtil::EM_FLOAT;
+	}
+
+	EXITFUNC;
+	return 0;
+}
+
+int EmzIO::write_header(const Dict & dict, int image_index, const Region * area,
+						EMUtil::EMDataType filestoragetype, bool)
+{
+	ENTERFUNC;
+
+	check_write_access(rw_mode, image_index);
+	if (area) {
+		throw ImageWriteException(filename, "EMZ does not support region writing");
+	}
+	if (image_index == -1) {
+		image_index = nimg;
+	}
+
+	// a header written without data is an attribute-only update
+	if (pending_index >= 0) {
+		write_pending_header();
+	}
+
+	pending_index = image_index;
+	pending_dict = dict;
+
+	EMUtil::getRenderLimits(dict, rendermin, rendermax, renderbits);
+	if (filestoragetype == EMUtil::EM_UCHAR) {
+		renderbits = (renderbits <= 0 || renderbits > 8) ? 8 : renderbits;
+	}
+	else if (filestoragetype == EMUtil::EM_USHORT) {
+		renderbits = (renderbits <= 0) ? 16 : renderbits;
+	}
+	else if (filestoragetype != EMUtil::EM_COMPRESSED) {
+		renderbits = 0;
+	}
+	if (renderbits > 16) {
+		throw ImageWriteException(filename, "EMZ files may not use more than 16 bits. For native float, set 0 bits.");
+	}
+
+	EXITFUNC;
+	return 0;
+}
+
+void EmzIO::write_pending_header()
+{
+	int image_index = pending_index;
+	pending_index = -1;
+
+	vector<char> attrs;
+	put_attrs(attrs, pending_dict);
+
+	vector<char> rec;
+	RecordHeader hdr;
+	vector<char> payload;
+
+	if (image_index < nimg) {
+		// keep the existing pixel data, only the attributes change
+		int64_t data_offset;
+		load_record(image_index, hdr, 0, data_offset);
+		payload.resize(offsets[image_index] + lengths[image_index] - data_offset);
+		portable_fseek(file, data_offset, SEEK_SET);
+		if (!payload.empty() && fread(payload.data(), payload.size(), 1, file) != 1) {
+			throw ImageReadException(filename, "EMZ record data");
+		}
+	}
+	else {
+		hdr.nx = pending_dict["nx"];
+		hdr.ny = pending_dict["ny"];
+		hdr.nz = pending_dict["nz"];
+		hdr.codec = CODEC_BLANK;
+		hdr.renderbits = 0;
+		hdr.rendermin = hdr.rendermax = 0;
+		hdr.nblocks = 0;
+	}
+	hdr.attr_bytes = (uint32_t)attrs.size();
+
+	put_record_header(rec, hdr);
+	rec.insert(rec.end(), attrs.begin(), attrs.end());
+	rec.insert(rec.end(), payload.begin(), payload.end());
+
+	fill_gap(image_index, hdr.nx, hdr.ny, hdr.nz);
+	int64_t offset = append(rec);
+	set_entry(image_index, offset, rec.size());
+	write_count();
+}
+
+int EmzIO::write_data(float *data, int image_index, const Region * area,
+					  EMUtil::EMDataType, bool)
+{
+	ENTERFUNC;
+
+	check_write_access(rw_mode, image_index, 0, data);
+	if (area) {
+		throw ImageWriteException(filename, "EMZ does not support region writing");
+	}
+	if (image_index == -1) {
+		image_index = (pending_index >= 0) ? pending_index : nimg;
+	}
+	if (pending_index != image_index) {
+		throw ImageWriteException(filename, "EMZ image data must follow its header");
+	}
+	pending_index = -1;
+
+	int nx = pending_dict["nx"];
+	int ny = pending_dict["ny"];
+	int nz = pending_dict["nz"];
+	size_t size = (size_t)nx * ny * nz;
+	int nblocks = (int)((size + BLOCK_PIXELS - 1) / BLOCK_PIXELS);
+
+	EMUtil::getRenderMinMax(data, nx, ny, rendermin, rendermax, renderbits, nz);
+	int codec = (renderbits > 0) ? CODEC_RICE : CODEC_FLOAT;
+
+	// encode the blocks independently, in parallel
+	vector< vector<char> > blocks(nblocks);
+	if (codec == CODEC_RICE) {
+		auto [rendered, rendertrunc] = getRenderedDataAndRendertrunc<unsigned short>(data, size);
+		pending_dict["stored_truncated"] = (int)rendertrunc;
+		const unsigned short *rd = rendered.data();
+
+		EMThreads::parallel_for_each(nblocks, [&](size_t b, int) {
+			size_t first = b * BLOCK_PIXELS;
+			rice_encode(rd + first, std::min(BLOCK_PIXELS, size - first), blocks[b]);
+		});
+	}
+	else {
+		pending_dict.erase("stored_truncated");
+		EMThreads::parallel_for_each(nblocks, [&](size_t b, int) {
+			size_t first = b * BLOCK_PIXELS;
+			size_t n = std::min(BLOCK_PIXELS, size - first);
+			blocks[b].reserve(n * sizeof(float));
+			for (size_t i = 0; i < n; i++) put_f32(blocks[b], data[first + i]);
+		});
+	}
+
+	vector<char> attrs;
+	put_attrs(attrs, pending_dict);
+
+	size_t payload = 0;
+	for (int b = 0; b < nblocks; b++) payload += blocks[b].size();
+
+	RecordHeader hdr;
+	hdr.nx = nx;
+	hdr.ny = ny;
+	hdr.nz = nz;
+	hdr.codec = codec;
+	hdr.renderbits = (codec == CODEC_RICE ? renderbits : 0);
+	hdr.rendermin = rendermin;
+	hdr.rendermax = rendermax;
+	hdr.nblocks = nblocks;
+	hdr.attr_bytes = (uint32_t)attrs.size();
+
+	vector<char> rec;
+	rec.reserve(RECORD_HEADER_BYTES + attrs.size() + nblocks * 4 + payload);
+	put_record_header(rec, hdr);
+	rec.insert(rec.end(), attrs.begin(), attrs.end());
+	for (int b = 0; b < nblocks; b++) put_u32(rec, (uint32_t)blocks[b].size());
+	for (int b = 0; b < nblocks; b++) rec.insert(rec.end(), blocks[b].begin(), blocks[b].end());
+
+	fill_gap(image_index, nx, ny, nz);
+	int64_t offset = append(rec);
+	set_entry(image_index, offset, rec.size());
+	write_count();
+
+	EXITFUNC;
+	return 0;
+}
+
+int EmzIO::read_data(float *data, int image_index, const Region * area, bool)
+{
+	ENTERFUNC;
+
+	check_read_access(image_index, data);
+
+	RecordHeader hdr;
+	int64_t data_offset;
+	load_record(image_index, hdr, 0, data_offset);
+	check_region(area, IntSize(hdr.nx, hdr.ny, hdr.nz), false, false);
+
+	int nx = hdr.nx, ny = hdr.ny, nz = hdr.nz;
+	size_t nxy = (size_t)nx * ny;
+	size_t size = nxy * nz;
+
+	int x0 = 0, y0 = 0, z0 = 0;
+	int xlen = 0, ylen = 0, zlen = 0;
+	EMUtil::get_region_origins(area, &x0, &y0, &z0, nz);
+	EMUtil::get_region_dims(area, nx, &xlen, ny, &ylen, nz, &zlen);
+
+	if (hdr.codec == CODEC_BLANK) {
+		std::fill(data, data + (size_t)xlen * ylen * zlen, 0.0f);
+		EXITFUNC;
+		return 0;
+	}
+
+	// pixel range of the file image covered by the region
+	int zb = std::max(z0, 0), ze = std::min(z0 + zlen, nz);
+	int yb = std::max(y0, 0), ye = std::min(y0 + ylen, ny);
+	int xb = std::max(x0, 0), xe = std::min(x0 + xlen, nx);
+	bool empty = (zb >= ze || yb >= ye || xb >= xe);
+
+	int b0 = 0, b1 = hdr.nblocks;
+	if (area && !empty) {
+		b0 = (int)(((size_t)zb * nxy + (size_t)yb * nx) / BLOCK_PIXELS);
+		b1 = (int)(((size_t)(ze - 1) * nxy + (size_t)ye * nx - 1) / BLOCK_PIXELS) + 1;
+	}
+
+	vector<char> table((size_t)hdr.nblocks * 4);
+	vector<int64_t> start(hdr.nblocks + 1, 0);
+	portable_fseek(file, data_offset, SEEK_SET);
+	if (!table.empty() && fread(table.data(), table.size(), 1, file) != 1) {
+		throw ImageReadException(filename, "EMZ block table");
+	}
+	for (int b = 0; b < hdr.nblocks; b++) start[b + 1] = start[b] + get_u32(table.data() + 4 * b);
+
+	// read only the blocks we need, in a single request
+	vector<char> payload;
+	if (!empty && b1 > b0) {
+		payload.resize(start[b1] - start[b0]);
+		portable_fseek(file, data_offset + table.size() + start[b0], SEEK_SET);
+		if (!payload.empty() && fread(payload.data(), payload.size(), 1, file) != 1) {
+			throw ImageReadException(filename, "EMZ record data");
+		}
+	}
+
+	// without a region the blocks decode straight into data
+	size_t first = (size_t)b0 * BLOCK_PIXELS;
+	vector<float> tmp;
+	float *dst = data;
+	if (area) {
+		tmp.resize(empty ? 0 : std::min(size, (size_t)b1 * BLOCK_PIXELS) - first);
+		dst = tmp.data();
+	}
+
+	float RUMAX = (1 << hdr.renderbits) - 1.0f;
+	float scale = (hdr.renderbits > 0) ? (hdr.rendermax - hdr.rendermin) / RUMAX : 0.0f;
+	int codec = hdr.codec;
+
+	if (!empty) {
+		EMThreads::parallel_for_each(b1 - b0, [&](size_t i, int) {
+			size_t b = b0 + i;
+			size_t n = std::min(BLOCK_PIXELS, size - b * BLOCK_PIXELS);
+			const char *in = payload.data() + (start[b] - start[b0]);
+			float *out = dst + (b * BLOCK_PIXELS - first);
+
+			if (codec == CODEC_RICE) {
+				vector<unsigned short> v(n);
+				rice_decode(in, start[b + 1] - start[b], v.data(), n);
+				for (size_t j = 0; j < n; j++) out[j] = v[j] * scale + hdr.rendermin;
+			}
+			else {
+				if ((size_t)(start[b + 1] - start[b]) != n * sizeof(float)) {
+					throw ImageReadException(filename, "EMZ block size");
+				}
+				for (size_t j = 0; j < n; j++) out[j] = get_f32(in + 4 * j);
+			}
+		});
+	}
+
+	if (area) {
+		// copy out the region, pixels outside the image are zero
+		std::fill(data, data + (size_t)xlen * ylen * zlen, 0.0f);
+		for (int z = zb; z < ze; z++) {
+			for (int y = yb; y < ye; y++) {
+				const float *src = dst + ((size_t)z * nxy + (size_t)y * nx + xb - first);
+				float *out = data + ((size_t)(z - z0) * ylen + (y - y0)) * xlen + (xb - x0);
+				std::copy(src, src + (xe - xb), out);
+			}
+		}
+	}
+
+	EXITFUNC;
+	return 0;
+}
+
+void EmzIO::flush()
+{
+	if (rw_mode != READ_ONLY) {
+		if (pending_index >= 0) write_pending_header();
+		write_file_header();
+	}
+	fflush(file);
+}
+
+bool EmzIO::is_complex_mode()
+{
+	return false;
+}
+
+bool EmzIO::is_image_big_endian()
+{
+	return false;
+}
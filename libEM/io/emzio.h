@@ -0,0 +1,121 @@
+/*
+ * This software is issued under a joint BSD/GNU license. You may use the
+ * source code in this file under either license. However, note that the
+ * complete EMAN2 and SPARX software packages have some GPL dependencies,
+ * so you are responsible for compliance with the licenses of these packages
+ * if you opt to use BSD licensing. The warranty disclaimer below holds
+ * in either instance.
+ *
+ * This complete copyright notice must be included in any revised version of the
+ * source code. Additional authorship citations may be added, but existing
+ * author citations must be preserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA 
+ */
+
+#ifndef eman__emzio_h__
+#define eman__emzio_h__ 1
+
+#include "imageio.h"
+#include "renderer.h"
+
+#include <cstdint>
+
+namespace EMAN
+{
+	/** EMZ is an indexed, compressed image stack written by EMAN. It is meant
+	 * for large particle stacks kept on slow or remote storage, where reading
+	 * fewer bytes matters more than decoding time.
+	 *
+	 * Each image is stored as an independent record: a small fixed header, the
+	 * image attributes and the pixel data split into blocks of BLOCK_PIXELS
+	 * pixels. When render_bits is set (or the image is written as
+	 * EM_COMPRESSED) the pixels are quantized as for HDF5 and each block is
+	 * compressed losslessly with an adaptive Rice coder, otherwise the floats are
+	 * stored as-is. Blocks are encoded and decoded in parallel, and a region read
+	 * only decodes the blocks it overlaps.
+	 *
+	 * The file starts with a 64 byte header, followed by records and index
+	 * blocks. Index blocks hold the offset and length of up to INDEX_ENTRIES
+	 * records and are chained, so finding an image costs one table lookup and
+	 * appending an image writes the new record plus one index entry, then the
+	 * image count in the file header, so a stack that is cut short still reads
+	 * back up to its last complete image. Images skipped when writing past the
+	 * end share one blank record which carries only their size.
+	 *
+	 * Rewriting an image or its header appends a new record and repoints its
+	 * entry. The old record is left as dead space and is never reclaimed; there
+	 * is no compaction, so a stack that is rewritten often should be copied to
+	 * a new file to recover the space. All values are little endian.
+	 */
+	class EmzIO : public ImageIO, public Renderer
+	{
+	  public:
+		explicit EmzIO(const string & fname, IOMode rw_mode = READ_ONLY);
+		~EmzIO();
+
+		DEFINE_IMAGEIO_FUNC;
+		static bool is_valid(const void *first_block);
+
+		bool is_single_image_format() const
+		{
+			return false;
+		}
+		int get_nimg();
+
+		/// pixels per independently compressed block
+		static const size_t BLOCK_PIXELS = 1 << 14;
+		/// records described by each index block
+		static const int INDEX_ENTRIES = 4096;
+
+	  private:
+		/** fixed part of every record */
+		struct RecordHeader
+		{
+			int nx, ny, nz;
+			int codec;
+			int renderbits;
+			float rendermin, rendermax;
+			int nblocks;
+			uint32_t attr_bytes;
+		};
+
+		enum Codec { CODEC_FLOAT = 0, CODEC_RICE = 1, CODEC_BLANK = 2 };
+
+		static const char *MAGIC;
+
+		int nimg;
+		bool is_new_file;
+		vector<int64_t> offsets;		// record offset and length of each image
+		vector<int64_t> lengths;
+		vector<int64_t> index_blocks;	// file offsets of the chained index blocks
+		int64_t file_end;
+
+		// header written by write_header(), waiting for write_data()
+		int pending_index;
+		Dict pending_dict;
+
+		int load_record(int image_index, RecordHeader & hdr, Dict * dict, int64_t & data_offset);
+		int64_t append(const vector<char> & buf);
+		void set_entry(int image_index, int64_t offset, int64_t length);
+		void write_file_header();
+		void write_count();
+		void write_pending_header();
+		void fill_gap(int image_index, int nx, int ny, int nz);
+		static void put_record_header(vector<char> & rec, const RecordHeader & hdr);
+	};
+}
+
+#endif	//eman__emzio_h__
@@ -45,6 +45,22 @@ ImageIO::~ImageIO()
 {
 }
 
+int ImageIO::read_data_regions(const vector<float *> & data, int image_index,
+								const vector<Region> & areas)
+{
+	if (data.size() != areas.size()) {
+		throw InvalidParameterException("read_data_regions: need one array per region");
+	}
+
+	for (size_t i = 0; i < areas.size(); i++) {
+		if (read_data(data[i], image_index, &areas[i], areas[i].get_ndim() == 3)) {
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
 int ImageIO::read_ctf(Ctf &, int)
 {
 	return 1;
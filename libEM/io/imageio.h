@@ -177,6 +177,20 @@ namespace EMAN
 		virtual int read_data(float *data, int image_index = 0,
 							  const Region * area = 0, bool is_3d = false) = 0;
 
+		/** Read several regions of one image. Formats stored as raw
+		 * binary override this to fetch all the regions in one pass over
+		 * the file; the default reads them one at a time with read_data().
+		 *
+		 * @param data One array per region, each large enough to hold
+		 *        its whole region. Pixels of a region which lie outside
+		 *        the image are undefined on return.
+		 * @param image_index The index of the image to read.
+		 * @param areas The regions to read.
+		 * @return 0 if OK; 1 if error.
+		 */
+		virtual int read_data_regions(const vector<float *> & data, int image_index,
+									  const vector<Region> & areas);
+
 		/** Read the data from an image as an 8 bit array, regardless of format.
 		 *
 		 * @param data An array to store the data. It should be
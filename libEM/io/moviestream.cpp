@@ -0,0 +1,258 @@
+/*
+ * This software is issued under a joint BSD/GNU license. You may use the
+ * source code in this file under either license. However, note that the
+ * complete EMAN2 and SPARX software packages have some GPL dependencies,
+ * so you are responsible for compliance with the licenses of these packages
+ * if you opt to use BSD licensing. The warranty disclaimer below holds
+ * in either instance.
+ *
+ * This complete copyright notice must be included in any revised version of the
+ * source code. Additional authorship citations may be added, but existing
+ * author citations must be preserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA 
+ */
+
+#include "moviestream.h"
+#include "emdata.h"
+#include "emthreads.h"
+#include "imageio.h"
+
+using namespace EMAN;
+
+// pixels per thread in the per-frame correction and summation loops
+static const size_t FRAME_GRAIN = 1 << 16;
+
+MovieStream::MovieStream(const string & fname)
+	: filename(fname), imageio(0), nx(0), ny(0), nframes(0), zframes(false),
+	  next(0), binning(1.0f), gain_divide(false)
+{
+	imageio = EMUtil::get_imageio(filename, ImageIO::READ_ONLY);
+	if (!imageio) throw ImageFormatException("cannot create an image io");
+
+	Dict hdr;
+	if (imageio->read_header(hdr, 0)) {
+		EMUtil::close_imageio(filename, imageio);
+		throw ImageReadException(filename, "imageio read header failed");
+	}
+
+	nx = hdr["nx"];
+	ny = hdr["ny"];
+	int nz = hdr["nz"];
+	nframes = imageio->get_nimg();
+
+	if (nframes <= 1 && nz > 1) {
+		zframes = true;
+		nframes = nz;
+	}
+}
+
+MovieStream::~MovieStream()
+{
+	if (imageio) EMUtil::close_imageio(filename, imageio);
+}
+
+static vector<float> image_to_vector(const EMData * img, int nx, int ny)
+{
+	if (img->get_xsize() != nx || img->get_ysize() != ny || img->get_zsize() != 1) {
+		throw ImageDimensionException("reference image size doesn't match the movie frames");
+	}
+
+	const float * d = img->get_const_data();
+	return vector<float>(d, d + (size_t)nx*ny);
+}
+
+void MovieStream::set_gain(const EMData * g, bool divide)
+{
+	gain.clear();
+	gain_divide = divide;
+	if (!g) return;
+
+	gain = image_to_vector(g, nx, ny);
+	if (divide) {
+		for (auto & v : gain) v = v == 0.0f ? 0.0f : 1.0f/v;
+	}
+}
+
+void MovieStream::set_dark(const EMData * d)
+{
+	dark.clear();
+	if (d) dark = image_to_vector(d, nx, ny);
+}
+
+void MovieStream::set_defects(const EMData * mask)
+{
+	defect_pix.clear();
+	defect_src.clear();
+	if (!mask) return;
+
+	vector<float> m = image_to_vector(mask, nx, ny);
+	const int maxr = 64;
+
+	for (int y = 0; y < ny; y++) {
+		for (int x = 0; x < nx; x++) {
+			if (m[x + (size_t)y*nx] == 0.0f) continue;
+
+			// search outward in square rings for the closest good pixel. Every
+			// pixel on ring r is at least r away, so once something is found the
+			// search continues only while a later ring could still hold a closer one
+			size_t best = (size_t)x + (size_t)y*nx;
+			int bestd = -1;
+
+			for (int r = 1; r <= maxr && (bestd < 0 || r*r < bestd); r++) {
+				for (int dy = -r; dy <= r; dy++) {
+					for (int dx = -r; dx <= r; dx++) {
+						if (std::abs(dx) != r && std::abs(dy) != r) continue;
+
+						int xx = x + dx, yy = y + dy;
+						if (xx < 0 || yy < 0 || xx >= nx || yy >= ny) continue;
+						if (m[xx + (size_t)yy*nx] != 0.0f) continue;
+
+						int d = dx*dx + dy*dy;
+						if (bestd < 0 || d < bestd) {
+							bestd = d;
+							best = xx + (size_t)yy*nx;
+						}
+					}
+				}
+			}
+
+			if (bestd < 0) continue;		// nothing good nearby, leave it alone
+
+			defect_pix.push_back(x + (size_t)y*nx);
+			defect_src.push_back(best);
+		}
+	}
+}
+
+void MovieStream::seek(int n)
+{
+	if (n < 0 || n > nframes) throw OutofRangeException(0, nframes, n, "frame number");
+	next = n;
+}
+
+void MovieStream::read_raw(int n, float * data)
+{
+	Dict hdr;
+	int err;
+
+	if (zframes) {
+		Region r(0, 0, n, nx, ny, 1);
+		imageio->read_header(hdr, 0, &r, true);
+		err = imageio->read_data(data, 0, &r, true);
+	}
+	else {
+		imageio->read_header(hdr, n);
+		err = imageio->read_data(data, n);
+	}
+
+	if (err) throw ImageReadException(filename, "reading movie frame failed");
+}
+
+void MovieStream::correct(float * data) const
+{
+	const float * g = gain.empty() ? 0 : gain.data();
+	const float * d = dark.empty() ? 0 : dark.data();
+
+	if (g || d) {
+		EMThreads::parallel_for((size_t)nx*ny, [&](size_t begin, size_t end, int) {
+			if (d) for (size_t i = begin; i < end; i++) data[i] -= d[i];
+			if (g) for (size_t i = begin; i < end; i++) data[i] *= g[i];
+		}, FRAME_GRAIN);
+	}
+
+	// sources are always good pixels, so the order of replacement doesn't matter
+	for (size_t i = 0; i < defect_pix.size(); i++) data[defect_pix[i]] = data[defect_src[i]];
+}
+
+bool MovieStream::read_frame(float * data)
+{
+	if (next >= nframes) return false;
+
+	read_raw(next++, data);
+	correct(data);
+
+	return true;
+}
+
+EMData * MovieStream::read_sum(int n)
+{
+	if (next >= nframes || n <= 0) return 0;
+
+	int first = next;
+	int last = std::min(nframes, next + n);
+	size_t size = (size_t)nx*ny;
+
+	EMData * sum = new EMData(nx, ny, 1);
+	float * sdata = sum->get_data();
+	vector<float> frame(size);
+
+	try {
+		for (int i = first; i < last; i++) {
+			read_frame(frame.data());
+
+			if (i == first) {
+				std::copy(frame.begin(), frame.end(), sdata);
+				continue;
+			}
+
+			EMThreads::parallel_for(size, [&](size_t begin, size_t end, int) {
+				for (size_t j = begin; j < end; j++) sdata[j] += frame[j];
+			}, FRAME_GRAIN);
+		}
+
+		sum->update();
+
+		if (binning > 1.0f) sum->process_inplace("math.fft.resample", Dict("n", binning));
+	}
+	catch (...) {
+		delete sum;
+		throw;
+	}
+
+	sum->set_attr("source_path", filename);
+	sum->set_attr("movie_frames", vector<int>{first, last});
+
+	return sum;
+}
+
+vector<EMData*> MovieStream::read_groups(const vector<int> & groups)
+{
+	vector<EMData*> ret;
+
+	try {
+		for (auto n : groups) {
+			if (n <= 0) throw ImageReadException(filename, "movie frame groups must not be empty");
+
+			EMData * s = read_sum(n);
+			if (!s) break;
+			ret.push_back(s);
+		}
+	}
+	catch (...) {
+		for (auto s : ret) delete s;
+		throw;
+	}
+
+	return ret;
+}
+
+vector<EMData*> MovieStream::sum_groups(int groupsize)
+{
+	if (groupsize <= 0) throw InvalidValueException(groupsize, "group size must be positive");
+
+	seek(0);
+	return read_groups(vector<int>((nframes + groupsize - 1) / groupsize, groupsize));
+}
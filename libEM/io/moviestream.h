@@ -0,0 +1,123 @@
+/*
+ * This software is issued under a joint BSD/GNU license. You may use the
+ * source code in this file under either license. However, note that the
+ * complete EMAN2 and SPARX software packages have some GPL dependencies,
+ * so you are responsible for compliance with the licenses of these packages
+ * if you opt to use BSD licensing. The warranty disclaimer below holds
+ * in either instance.
+ *
+ * This complete copyright notice must be included in any revised version of the
+ * source code. Additional authorship citations may be added, but existing
+ * author citations must be preserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA 
+ */
+
+#ifndef eman__moviestream_h__
+#define eman__moviestream_h__ 1
+
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+namespace EMAN
+{
+	class EMData;
+	class ImageIO;
+
+	/** MovieStream reads the frames of a movie (MRC stack or volume, TIFF, EER, ...)
+	 * sequentially into a single reused buffer, applying dark subtraction, gain
+	 * correction and defect replacement in the read loop. Frames are summed into
+	 * groups, which may then be Fourier-binned, so no per-frame EMData is ever
+	 * created.
+	 *
+	 * Typical use:
+	 * @code
+	 * MovieStream ms("movie.tif");
+	 * ms.set_gain(gain);
+	 * vector<EMData*> groups = ms.sum_groups(4);
+	 * @endcode
+	 */
+	class MovieStream
+	{
+	  public:
+		explicit MovieStream(const string & filename);
+		~MovieStream();
+
+		int get_nframes() const { return nframes; }
+		int get_xsize() const { return nx; }
+		int get_ysize() const { return ny; }
+
+		/** Set the gain reference. Each frame is multiplied by it, or divided
+		 * by it if divide is set. Pixels with zero gain are set to zero when dividing.
+		 * A null gain removes any gain correction. */
+		void set_gain(const EMData * gain, bool divide = false);
+
+		/** Set a dark reference, subtracted from each frame before gain correction.
+		 * A null image removes dark subtraction. */
+		void set_dark(const EMData * dark);
+
+		/** Set a defect mask. Nonzero pixels are bad and are replaced by the
+		 * nearest good pixel (Euclidean distance, up to 64 pixels away) after gain correction. A null mask removes defect correction. */
+		void set_defects(const EMData * mask);
+
+		/** Fourier downsampling factor applied to each summed group, default 1 (none) */
+		void set_binning(float bin) { binning = bin; }
+
+		/** Continue reading from frame n, default is to start at 0 */
+		void seek(int n);
+
+		/** Read the next frame, corrected, into data, which must hold nx*ny floats.
+		 * @return false if there are no frames left */
+		bool read_frame(float * data);
+
+		/** Sum the next n frames (fewer at the end of the movie), correct and bin
+		 * the result. @return a new image owned by the caller, or null if there
+		 * are no frames left */
+		EMData * read_sum(int n);
+
+		/** Sum consecutive groups of frames, groups[i] being the number of frames
+		 * in group i, starting at the current frame. Stops early when the movie
+		 * runs out of frames; a group size of zero or less is an error. */
+		vector<EMData*> read_groups(const vector<int> & groups);
+
+		/** Sum the whole movie in groups of groupsize frames, starting at frame 0 */
+		vector<EMData*> sum_groups(int groupsize);
+
+	  private:
+		MovieStream(const MovieStream &);
+		MovieStream & operator=(const MovieStream &);
+
+		void read_raw(int n, float * data);
+		void correct(float * data) const;
+
+		string filename;
+		ImageIO * imageio;
+		int nx, ny, nframes;
+		bool zframes;			// frames are the z planes of a single volume
+		int next;
+		float binning;
+
+		bool gain_divide;
+		vector<float> gain;
+		vector<float> dark;
+		vector<size_t> defect_pix;	// bad pixels
+		vector<size_t> defect_src;	// and the good pixels replacing them
+	};
+}
+
+#endif	//eman__moviestream_h__
@@ -1041,15 +1041,6 @@ int MrcIO::read_data(float *rdata, int image_index, const Region * area, bool)
 		return 1;
 	}
 
-	signed char *    scdata = (signed char *)    rdata;
-	unsigned char *  cdata  = (unsigned char *)  rdata;
-	short *          sdata  = (short *)          rdata;
-	unsigned short * usdata = (unsigned short *) rdata;
-	half *           hdata  = (half *)          rdata;
-
-	size_t size = 0;
-	int xlen = 0, ylen = 0, zlen = 0;
-
 	check_region(area, FloatSize(mrch.nx, mrch.ny, mrch.nz), is_new_file, false);
 	portable_fseek(file, sizeof(MrcHeader)+mrch.nsymbt, SEEK_SET);
 
@@ -1064,13 +1055,78 @@ int MrcIO::read_data(float *rdata, int image_index, const Region * area, bool)
 		modesize = mode_size;
 	}
 
-	EMUtil::process_region_io(cdata, file, READ_ONLY,
+	EMUtil::process_region_io(rdata, file, READ_ONLY,
 							  image_index, modesize,
 							  mrch.nx, mrch.ny, mrch.nz, area);
 
+	int xlen = 0, ylen = 0, zlen = 0;
+
 	EMUtil::get_region_dims(area, mrch.nx, &xlen, mrch.ny, &ylen, mrch.nz, &zlen);
 
-	size = (size_t)xlen * ylen * zlen;
+	convert_region(rdata, xlen, ylen, zlen);
+
+	EXITFUNC;
+
+	return 0;
+}
+
+int MrcIO::read_data_regions(const vector<float *> & data, int image_index,
+							 const vector<Region> & areas)
+{
+	ENTERFUNC;
+
+	if (! (isFEI || is_stack)) {
+		image_index = 0;
+	}
+
+	check_read_access(image_index);
+
+	// transposed and complex files need the whole image, read_data() deals with them
+	if (is_transpose || is_complex_mode()) {
+		return ImageIO::read_data_regions(data, image_index, areas);
+	}
+
+	if (data.size() != areas.size()) {
+		throw InvalidParameterException("read_data_regions: need one array per region");
+	}
+
+	for (size_t i = 0; i < areas.size(); i++) {
+		if (! data[i]) {
+			throw NullPointerException("image data is NULL");
+		}
+
+		check_region(&areas[i], FloatSize(mrch.nx, mrch.ny, mrch.nz), is_new_file, false);
+	}
+
+	portable_fseek(file, sizeof(MrcHeader)+mrch.nsymbt, SEEK_SET);
+
+	size_t modesize = (mrch.mode == MRC_UHEX ? 11111111 : mode_size);
+
+	EMUtil::process_regions_io(vector<void *>(data.begin(), data.end()), file,
+							   image_index, modesize, mrch.nx, mrch.ny, mrch.nz, areas);
+
+	for (size_t i = 0; i < areas.size(); i++) {
+		int xlen = 0, ylen = 0, zlen = 0;
+
+		EMUtil::get_region_dims(&areas[i], mrch.nx, &xlen, mrch.ny, &ylen, mrch.nz, &zlen);
+
+		convert_region(data[i], xlen, ylen, zlen);
+	}
+
+	EXITFUNC;
+
+	return 0;
+}
+
+void MrcIO::convert_region(float *rdata, int xlen, int ylen, int zlen)
+{
+	signed char *    scdata = (signed char *)    rdata;
+	unsigned char *  cdata  = (unsigned char *)  rdata;
+	short *          sdata  = (short *)          rdata;
+	unsigned short * usdata = (unsigned short *) rdata;
+	half *           hdata  = (half *)          rdata;
+
+	size_t size = (size_t)xlen * ylen * zlen;
 
 	if (mrch.mode != MRC_UCHAR  &&  mrch.mode != MRC_CHAR  &&
 	    mrch.mode != MRC_UHEX) {
@@ -1142,10 +1198,6 @@ int MrcIO::read_data(float *rdata, int image_index, const Region * area, bool)
 		Util::flip_complex_phase(rdata, size);
 		Util::rotate_phase_origin(rdata, xlen, ylen, zlen);
 	}
-
-	EXITFUNC;
-
-	return 0;
 }
 
 template<class T>
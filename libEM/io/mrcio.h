@@ -50,6 +50,9 @@ namespace EMAN
 
 		DEFINE_IMAGEIO_FUNC;
 
+		int read_data_regions(const vector<float *> & data, int image_index,
+							  const vector<Region> & areas);
+
 		int read_ctf(Ctf & ctf, int image_index = 0);
 		void write_ctf(const Ctf & ctf, int image_index = 0);
 
@@ -367,6 +370,9 @@ namespace EMAN
 		//utility function to transpose x and y dimension in case the source mrc image is mapc=2,mapr=1
 		int transpose(float *data, int nx, int ny, int nz) const;
 
+		/** Convert a region read in the file's own pixel format to floats, in place. */
+		void convert_region(float *rdata, int xlen, int ylen, int zlen);
+
 		template<class T>
 		auto write_compressed(float *data, size_t size, int image_index, const Region* area);
 	};
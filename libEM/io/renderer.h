@@ -4,6 +4,7 @@
 #include <cmath>
 #include <vector>
 #include "emutil.h"
+#include "emthreads.h"
 
 namespace EMAN {
 
@@ -56,6 +57,9 @@ namespace EMAN {
 	protected:
 		Renderer() =default;
 
+		/// minimum number of pixels handed to each thread when quantizing
+		static constexpr size_t RENDER_GRAIN = 1 << 16;
+
 		int renderbits = 16;
 		int renderlevel = 1;
 		float rendermax = 0.0;
@@ -85,23 +89,38 @@ namespace EMAN {
 				RMAX = (1 << (renderbits - 1)) - 1;
 			}
 
+			// The loop body is branch-free so it vectorizes, and the image is
+			// split across threads. Chunks are independent, so the result does
+			// not depend on the number of threads.
+			const float rmin  = rendermin;
+			const float rmax  = rendermax;
+			const float range = rendermax - rendermin;
+			const float scale = RMAX - RMIN;
+
 			std::vector<T> rendered_data(size);
+			std::vector<size_t> counts(EMThreads::get_num_chunks(size, RENDER_GRAIN), 0);
+
+			EMThreads::parallel_for(size, [&](size_t begin, size_t end, int chunk) {
+				T *out = rendered_data.data();
+				size_t n = 0;
+
+				for (size_t i = begin; i < end; ++i) {
+					float v  = data[i];
+					bool  hi = v > rmax;
+					bool  lo = v < rmin;
+					float r  = std::round((v - rmin) / range * scale + RMIN);
+
+					r = hi ? RMAX : r;
+					r = lo ? RMIN : r;
+					out[i] = (T)r;
+					n += (hi | lo);
+				}
+				counts[chunk] = n;
+			}, RENDER_GRAIN);
+
 			size_t count = 0;
+			for (auto c : counts) count += c;
 
-			for (size_t i = 0; i < size; ++i) {
-				if (data[i] < rendermin) {
-					rendered_data[i] = T(RMIN);
-					count++;
-				}
-				else if (data[i] > rendermax) {
-					rendered_data[i] = T(RMAX);
-					count++;
-				}
-				else
-					rendered_data[i] = (T)roundf(  (data[i] - rendermin)
-					                             / (rendermax - rendermin)
-					                             * (RMAX - RMIN) + RMIN);
-			}
 			return std::make_tuple(rendered_data, count);
 		}
 		else
@@ -35,6 +35,7 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <cstdio>
+#include <mutex>
 
 #ifdef WIN32
 #include <time.h>
@@ -79,9 +80,8 @@ Log *Log::instance = 0;
 
 Log *Log::logger()
 {
-	if (!instance) {
-		instance = new Log();
-	}
+	static std::once_flag created;
+	std::call_once(created, []() { instance = new Log(); });
 	return instance;
 }
 
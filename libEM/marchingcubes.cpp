@@ -49,6 +49,10 @@ using namespace EMAN;
 #include "transform.h"
 #include "emobject.h"
 #include "vec3.h"
+#include "emthreads.h"
+#include "volumesummary.h"
+#include <cfloat>
+#include <unordered_map>
 
 //a2fVertexOffset lists the positions, relative to vertex0, of each of the 8 vertices of a cube
 static const int a2fVertexOffset[8][3] =
@@ -58,45 +62,6 @@ static const int a2fVertexOffset[8][3] =
 };
 
 
-static const int a2fPosXOffset[4][3] =
-{
-	{2, 0, 0},{2, 1, 0},
-	{2, 0, 1},{2, 1, 1}
-};
-
-static const int a2fPosYOffset[4][3] =
-{
-	{1, 2, 0},{0, 2, 0},
- 	{1, 2, 1},{0, 2, 1}
-};
-
-static const int a2fPosZOffset[4][3] =
-{
-	{0, 0, 2},{1, 0, 2},
-	{1, 1, 2},{0, 1, 2}
-};
-
-static const int a2fPosXPosYOffset[2][3] =
-{
-	{2, 2, 0},{2, 2, 1}
-};
-
-static const int a2fPosXPosZOffset[2][3] =
-{
- 	{2, 0, 2},{2, 1, 2}
-};
-
-static const int a2fPosYPosZOffset[2][3] =
-{
-	{1, 2, 2},{0, 2, 2}
-};
-
-
-static const int a2fPosXPosZPosYOffset[3] =
-{
-	2, 2, 2
-};
-
 //a2fVertexOffset lists the positions, relative to vertex0, of each of the 8 vertices of a cube
 static const int a2OddXOffset[8] =
 {
@@ -529,10 +494,11 @@ float* ColorRGBGenerator::getRGBColor(int x, int y, int z)
 }
 
 MarchingCubes::MarchingCubes()
-	: _isodl(0), needtobind(1)
+	: _isodl(0), brick_level(-2), brick_change(0), needtobind(1)
 {
 
-if ((int(glGetString(GL_VERSION)[0])-48)>2){
+const GLubyte *glversion = glGetString(GL_VERSION);	// 0 without a current context, e.g. when run headless
+if (glversion && (int(glversion[0])-48)>2){
 	rgbgenerator = ColorRGBGenerator();
 
 // #ifdef _WIN32
@@ -547,9 +513,10 @@ if ((int(glGetString(GL_VERSION)[0])-48)>2){
 }
 
 MarchingCubes::MarchingCubes(EMData * em)
-	: _isodl(0)
+	: _isodl(0), brick_level(-2), brick_change(0)
 {
-if ((int(glGetString(GL_VERSION)[0])-48)>2){
+const GLubyte *glversion = glGetString(GL_VERSION);
+if (glversion && (int(glversion[0])-48)>2){
 	rgbgenerator = ColorRGBGenerator();
 
 // #ifdef _WIN32
@@ -567,64 +534,32 @@ else{
 
 
 
-void MarchingCubes::clear_min_max_vals()
-{
-	for (vector<EMData*>::iterator it = minvals.begin(); it != minvals.end(); ++it)
-	{
-		if ( (*it) != 0 ) delete *it;
-	}
-	minvals.clear();
-
-	for (vector<EMData*>::iterator it = maxvals.begin(); it != maxvals.end(); ++it)
-	{
-		if ( (*it) != 0 ) delete *it;
-	}
-	maxvals.clear();
-}
-
-bool MarchingCubes::calculate_min_max_vals()
+void MarchingCubes::calculate_level_sizes()
 {
 
-	if (_emdata == NULL ) throw NullPointerException("Error, cannot generate search tree if the overriding EMData object is NULL");
-
-	clear_min_max_vals();
+	if (_emdata == NULL ) throw NullPointerException("Error, cannot generate sampling levels if the overriding EMData object is NULL");
 
 	int nx = _emdata->get_xsize();
 	int ny = _emdata->get_ysize();
 	int nz = _emdata->get_zsize();
 
-	// Create the binary min max tree
+	// Each level halves the one below, as math.minshrink/math.maxshrink with n=2 would
+	level_sizes.clear();
 	while ( nx > 1 || ny > 1 || nz > 1 )
 	{
-		int size = minvals.size();
-
-		if ( size == 0 ){
-			Dict a;
-			// Setting search to 3 at the bottom level is most important.
-			// FIXME - d.woolford add comments heere
-			a["search"] = 3;
-			minvals.push_back(_emdata->process("math.minshrink",a));
-			maxvals.push_back(_emdata->process("math.maxshrink",a));
-		}else {
-			minvals.push_back(minvals[size-1]->process("math.minshrink"));
-			maxvals.push_back(maxvals[size-1]->process("math.maxshrink"));
-		}
-
-		nx = minvals[size]->get_xsize();
-		ny = minvals[size]->get_ysize();
-		nz = minvals[size]->get_zsize();
+		nx = nx > 1 ? nx/2 : 1;
+		ny = ny > 1 ? ny/2 : 1;
+		nz = nz > 1 ? nz/2 : 1;
+		level_sizes.push_back(IntSize(nx, ny, nz));
 #if MARCHING_CUBES_DEBUG
 		cout << "dims are " << nx << " " << ny << " " << nz << endl;
 #endif
 	}
 
 	drawing_level = -1;
-
-	return true;
 }
 
 MarchingCubes::~MarchingCubes() {
-	clear_min_max_vals();
 
 //if ((int(glGetString(GL_VERSION)[0])-48)>2){
 // #ifdef _WIN32
@@ -649,6 +584,15 @@ Dict MarchingCubes::get_isosurface()
 	return d;
 }
 
+vector<int> MarchingCubes::get_surface_counts()
+{
+	calculate_surface();
+	vector<int> ret(2);
+	ret[0] = pp.elem()/3;
+	ret[1] = ff.elem()/3;
+	return ret;
+}
+
 void MarchingCubes::surface_face_z()
 {
 	float* f = pp.get_data();
@@ -684,7 +628,9 @@ void MarchingCubes::set_data(EMData* data)
 {
 	if ( data->get_zsize() == 1 ) throw ImageDimensionException("The z dimension of the image must be greater than 1");
 	_emdata = data;
-	calculate_min_max_vals();
+	calculate_level_sizes();
+	bricks.clear();
+	brick_level = -2;
 	rgbgenerator.set_data(data);
 }
 
@@ -696,120 +642,156 @@ void MarchingCubes::set_surface_value(const float value) {
 
 }
 
-void MarchingCubes::calculate_surface() {
+// Bricks are this many cubes on a side
+static const int MC_BRICK_SIZE = 32;
 
-	if ( _emdata == 0 ) throw NullPointerException("Error, attempt to generate isosurface, but the emdata image object has not been set");
-	if ( minvals.size() == 0 || maxvals.size() == 0 ) throw NotExistingObjectException("Vector of EMData pointers", "Error, the min and max val search trees have not been created");
+// true if some corner in the range is inside the surface and some is outside, using the test in march_brick()
+static inline bool brick_has_surface(float minval, float maxval, float surf)
+{
+	if (surf >= 0) return minval <= surf && maxval > surf;
+	return maxval >= surf && minval < surf;
+}
 
-	point_map.clear();
-	pp.clear();
-	nn.clear();
-	ff.clear();
-	vv.clear();
+template<typename T>
+static inline void release_vector(vector<T> &v)
+{
+	vector<T>().swap(v);
+}
 
-#if MARCHING_CUBES_DEBUG
-	int time0 = clock();
-#endif
+void MarchingCubes::get_level_grid(int &sx, int &sy, int &sz, int &gx, int &gy, int &gz)
+{
+	gx = _emdata->get_xsize();
+	gy = _emdata->get_ysize();
+	gz = _emdata->get_zsize();
+	sx = sy = sz = 1;
+
+	if ( drawing_level != -1 ) {
+		const IntSize &e = level_sizes[drawing_level];
+		sx = gx/e[0];
+		sy = gy/e[1];
+		sz = gz/e[2];
+		gx = e[0];
+		gy = e[1];
+		gz = e[2];
+	}
+}
 
-	float min = minvals[minvals.size()-1]->get_value_at(0,0,0);
-	float max = maxvals[minvals.size()-1]->get_value_at(0,0,0);
-	if ( min < _surf_value &&  max > _surf_value) draw_cube(0,0,0,minvals.size()-1);
+void MarchingCubes::build_bricks()
+{
+	int sx, sy, sz, gx, gy, gz;
+	get_level_grid(sx, sy, sz, gx, gy, gz);
+
+	bricks.clear();
+	for (int z = 0; z < gz-1; z += MC_BRICK_SIZE) {
+		for (int y = 0; y < gy-1; y += MC_BRICK_SIZE) {
+			for (int x = 0; x < gx-1; x += MC_BRICK_SIZE) {
+				Brick b;
+				b.x0 = x;
+				b.y0 = y;
+				b.z0 = z;
+				b.x1 = std::min(x+MC_BRICK_SIZE, gx-1);
+				b.y1 = std::min(y+MC_BRICK_SIZE, gy-1);
+				b.z1 = std::min(z+MC_BRICK_SIZE, gz-1);
+				b.valid = false;
+				b.surf = 0;
+				bricks.push_back(b);
+			}
+		}
+	}
 
-#if MARCHING_CUBES_DEBUG
-	int time1 = clock();
-	cout << "It took " << (time1-time0) << " " << (float)(time1-time0)/CLOCKS_PER_SEC << " to traverse the search tree and generate polygons" << endl;
-	cout << "... using surface value " << _surf_value << endl;
-#endif
+	// the corners of the cubes in [x0,x1) run from x0 to x1 inclusive. At coarser
+	// levels only every sx'th voxel is used, so the summary range is an upper bound.
+	const VolumeSummary *summary = _emdata->get_volume_summary();
+	for (vector<Brick>::iterator it = bricks.begin(); it != bricks.end(); ++it) {
+		summary->get_range(sx*it->x0, sy*it->y0, sz*it->z0, sx*it->x1, sy*it->y1, sz*it->z1, it->minval, it->maxval);
+	}
+
+	brick_level = drawing_level;
+	brick_change = _emdata->get_changecount();
 }
 
-void MarchingCubes::draw_cube(const int x, const int y, const int z, const int cur_level ) {
+void MarchingCubes::calculate_surface() {
 
-	if ( cur_level == drawing_level )
-	{
-		EMData* e;
-		if ( drawing_level == - 1 ) e = _emdata;
-		else e = minvals[drawing_level];
-		if ( x < (e->get_xsize()-1) && y < (e->get_ysize()-1) && z < (e->get_zsize()-1))
-			marching_cube(x,y,z, cur_level);
-	}
-	else
-	{
-		EMData* e;
-		if ( cur_level > 0 ) {
-			int xsize = minvals[cur_level-1]->get_xsize();
-			int ysize = minvals[cur_level-1]->get_ysize();
-			int zsize = minvals[cur_level-1]->get_zsize();
-			e = minvals[cur_level-1];
-			for(int i=0; i<8; ++i )	{
-				int xx = 2*x+a2fVertexOffset[i][0];
-				if ( xx >= xsize ) continue;
-				int yy = 2*y+a2fVertexOffset[i][1];
-				if ( yy >= ysize ) continue;
-				int zz = 2*z+a2fVertexOffset[i][2];
-				if ( zz >= zsize ) continue;
-
-				float min = minvals[cur_level-1]->get_value_at(xx,yy,zz);
-				float max = maxvals[cur_level-1]->get_value_at(xx,yy,zz);
-				if ( min < _surf_value &&  max > _surf_value)
-					draw_cube(xx,yy,zz,cur_level-1);
-			}
-		}
-		else {
-			e = _emdata;
-			for(int i=0; i<8; ++i )	{
-					draw_cube(2*x+a2fVertexOffset[i][0],2*y+a2fVertexOffset[i][1],2*z+a2fVertexOffset[i][2],cur_level-1);
-			}
-		}
+	if ( _emdata == 0 ) throw NullPointerException("Error, attempt to generate isosurface, but the emdata image object has not been set");
+	if ( level_sizes.size() == 0 ) throw NotExistingObjectException("Vector of level sizes", "Error, the sampling levels have not been calculated");
 
-		if ( x == (minvals[cur_level]->get_xsize()-1) ) {
-			if ( e->get_xsize() > 2*x ){
-				for(int i=0; i<4; ++i )	{
-					draw_cube(2*x+a2fPosXOffset[i][0],2*y+a2fPosXOffset[i][1],2*z+a2fPosXOffset[i][2],cur_level-1);
-				}
-			}
-			if ( y == (minvals[cur_level]->get_ysize()-1) ) {
-				if ( e->get_ysize() > 2*y ) {
-					for(int i=0; i<2; ++i )	{
-						draw_cube(2*x+a2fPosXPosYOffset[i][0],2*y+a2fPosXPosYOffset[i][1],2*z+a2fPosXPosYOffset[i][2],cur_level-1);
-					}
-				}
-				if (  z == (minvals[cur_level]->get_zsize()-1) ){
-					if ( e->get_zsize() > 2*z ) {
-						draw_cube(2*x+2,2*y+2,2*z+2,cur_level-1);
-					}
-				}
-			}
-			if ( z == (minvals[cur_level]->get_zsize()-1) ) {
-				if ( e->get_zsize() > 2*z ) {
-					for(int i=0; i<2; ++i )	{
-						draw_cube(2*x+a2fPosXPosZOffset[i][0],2*y+a2fPosXPosZOffset[i][1],2*z+a2fPosXPosZOffset[i][2],cur_level-1);
-					}
-				}
-			}
-		}
-		if ( y == (minvals[cur_level]->get_ysize()-1) ) {
-			if ( e->get_ysize() > 2*y ) {
-				for(int i=0; i<4; ++i )	{
-					draw_cube(2*x+a2fPosYOffset[i][0],2*y+a2fPosYOffset[i][1],2*z+a2fPosYOffset[i][2],cur_level-1);
-				}
-			}
-			if ( z == (minvals[cur_level]->get_ysize()-1) ) {
-				if ( e->get_zsize() > 2*z ) {
-					for(int i=0; i<2; ++i )	{
-						draw_cube(2*x+a2fPosYPosZOffset[i][0],2*y+a2fPosYPosZOffset[i][1],2*z+a2fPosYPosZOffset[i][2],cur_level-1);
-					}
-				}
+#if MARCHING_CUBES_DEBUG
+	int time0 = clock();
+#endif
+
+	// new voxel values invalidate every brick's range and mesh
+	if ( brick_level != drawing_level || brick_change != _emdata->get_changecount() ) build_bricks();
+
+	// Only bricks the surface passes through are marched, and those already marched at this value are kept
+	vector<size_t> todo;
+	for (size_t i = 0; i < bricks.size(); ++i) {
+		Brick &b = bricks[i];
+		if ( !brick_has_surface(b.minval, b.maxval, _surf_value) ) {
+			if ( !b.pts.empty() || !b.faces.empty() ) {
+				release_vector(b.pts);
+				release_vector(b.nrm);
+				release_vector(b.vox);
+				release_vector(b.edges);
+				release_vector(b.boundary);
+				release_vector(b.faces);
 			}
+			b.valid = true;
+			b.surf = _surf_value;
 		}
-		if ( z == (minvals[cur_level]->get_zsize()-1) ) {
-			if ( e->get_zsize() > 2*z ) {
-				for(int i=0; i<4; ++i )	{
-					draw_cube(2*x+a2fPosZOffset[i][0],2*y+a2fPosZOffset[i][1],2*z+a2fPosZOffset[i][2],cur_level-1);
+		else if ( !b.valid || b.surf != _surf_value ) todo.push_back(i);
+	}
+
+	const float *data = _emdata->get_data();
+	EMThreads::parallel_for_each(todo.size(), [&](size_t t, int) {
+		march_brick(bricks[todo[t]], data);
+	});
+
+	// Stitch the bricks together in order. Only vertices on a brick surface can be shared.
+	size_t nverts = 0, nfaces = 0, nboundary = 0;
+	for (size_t i = 0; i < bricks.size(); ++i) {
+		nverts += bricks[i].pts.size();
+		nfaces += bricks[i].faces.size();
+		for (size_t v = 0; v < bricks[i].boundary.size(); ++v) nboundary += bricks[i].boundary[v];
+	}
+
+	pp.clear(std::max(nverts, (size_t)1024));
+	nn.clear(std::max(nverts, (size_t)1024));
+	vv.clear(std::max(nverts, (size_t)1024));
+	ff.clear(std::max(nfaces, (size_t)1024));
+
+	std::unordered_map<unsigned long long, unsigned int> shared;
+	shared.reserve(nboundary);
+	vector<unsigned int> remap;
+	unsigned int count = 0;
+	for (size_t i = 0; i < bricks.size(); ++i) {
+		const Brick &b = bricks[i];
+		size_t nv = b.pts.size()/3;
+		remap.resize(nv);
+		for (size_t v = 0; v < nv; ++v) {
+			if ( b.boundary[v] ) {
+				std::pair<std::unordered_map<unsigned long long, unsigned int>::iterator, bool> ins = shared.insert(std::make_pair(b.edges[v], count));
+				if ( !ins.second ) {
+					unsigned int idx = ins.first->second;
+					nn[3*idx] += b.nrm[3*v];
+					nn[3*idx+1] += b.nrm[3*v+1];
+					nn[3*idx+2] += b.nrm[3*v+2];
+					remap[v] = idx;
+					continue;
 				}
 			}
+			remap[v] = count++;
+			pp.push_back_3(&b.pts[3*v]);
+			nn.push_back_3(&b.nrm[3*v]);
+			vv.push_back_3(&b.vox[3*v]);
 		}
-
+		for (size_t f = 0; f < b.faces.size(); ++f) ff.push_back(3*remap[b.faces[f]]);
 	}
+
+#if MARCHING_CUBES_DEBUG
+	int time1 = clock();
+	cout << "It took " << (time1-time0) << " " << (float)(time1-time0)/CLOCKS_PER_SEC << " to march " << todo.size() << " of " << bricks.size() << " bricks and generate polygons" << endl;
+	cout << "... using surface value " << _surf_value << endl;
+#endif
 }
 
 void MarchingCubes::get_normal(Vector3 &normal, int fX, int fY, int fZ)
@@ -831,13 +813,6 @@ float MarchingCubes::get_offset(float fValue1, float fValue2, float fValueDesire
         return (fValueDesired - fValue1)/fDelta;
 }
 
-int MarchingCubes::get_edge_num(int x, int y, int z, int edge) {
-	// edge direction is right, down, back (x, y, z)
-	unsigned int index = 0;
-	index = (x << 22) | (y << 12) | (z << 2) | edge;
-	return index;
-}
-
 void MarchingCubes::color_vertices()
 {
 	cc.clear();
@@ -850,136 +825,128 @@ void MarchingCubes::color_vertices()
 	rgbgenerator.setNeedToRecolor(false);
 }
 
-void MarchingCubes::marching_cube(int fX, int fY, int fZ, int cur_level)
+void MarchingCubes::march_brick(Brick &brick, const float *data)
 {
-//	extern int aiCubeEdgeFlags[256];
-//	extern int a2iTriangleConnectionTable[256][16];
-
-	int iCorner, iVertex, iVertexTest, iEdge, iTriangle, iFlagIndex, iEdgeFlags;
-	float fOffset;
-	Vector3 sColor;
-	float afCubeValue[8];
-	float asEdgeVertex[12][3];
-	int pointIndex[12];
-
-	int fxScale = 1, fyScale = 1, fzScale = 1;
-	if ( cur_level != -1 )
-	{
-		fxScale = _emdata->get_xsize()/minvals[cur_level]->get_xsize();
-		fyScale = _emdata->get_ysize()/minvals[cur_level]->get_ysize();
-		fzScale = _emdata->get_zsize()/minvals[cur_level]->get_zsize();
-		for(iVertex = 0; iVertex < 8; iVertex++)
-		{
-			afCubeValue[iVertex] = _emdata->get_value_at( fxScale*(fX + a2fVertexOffset[iVertex][0]),
-						fyScale*(fY + a2fVertexOffset[iVertex][1]), fzScale*(fZ + a2fVertexOffset[iVertex][2]));
-		}
-	}
-	else
-	{
+	int sx, sy, sz, gx, gy, gz;
+	get_level_grid(sx, sy, sz, gx, gy, gz);
+	size_t nx = _emdata->get_xsize();
+	size_t nxy = nx*_emdata->get_ysize();
+	float surf = _surf_value;
+
+	brick.pts.clear();
+	brick.nrm.clear();
+	brick.vox.clear();
+	brick.edges.clear();
+	brick.boundary.clear();
+	brick.faces.clear();
+
+	// vertices are shared between the cubes around an edge, found by edge id
+	std::unordered_map<unsigned long long, unsigned int> point_map;
+
+	for (int fZ = brick.z0; fZ < brick.z1; ++fZ) {
+	for (int fY = brick.y0; fY < brick.y1; ++fY) {
+	for (int fX = brick.x0; fX < brick.x1; ++fX) {
+		int iCorner, iVertex, iVertexTest, iEdge, iTriangle, iFlagIndex, iEdgeFlags;
+		float fOffset;
+		float afCubeValue[8];
+		float asEdgeVertex[12][3];
+		unsigned long long pointIndex[12];
+
 		//Make a local copy of the values at the cube's corners
 		for(iVertex = 0; iVertex < 8; iVertex++)
 		{
-			afCubeValue[iVertex] = _emdata->get_value_at( fX + a2fVertexOffset[iVertex][0],
-					fY + a2fVertexOffset[iVertex][1], fZ + a2fVertexOffset[iVertex][2]);
-		}
-	}
-
-	//Find which vertices are inside of the surface and which are outside
-	iFlagIndex = 0;
-	for(iVertexTest = 0; iVertexTest < 8; iVertexTest++)
-	{
-		if (_surf_value >= 0 ){
-			if(afCubeValue[iVertexTest] <= _surf_value)
-				iFlagIndex |= 1<<iVertexTest;
-		}
-		else {
-			if(afCubeValue[iVertexTest] >= _surf_value)
-				iFlagIndex |= 1<<iVertexTest;
+			afCubeValue[iVertex] = data[(size_t)sx*(fX + a2fVertexOffset[iVertex][0]) +
+					(size_t)sy*(fY + a2fVertexOffset[iVertex][1])*nx + (size_t)sz*(fZ + a2fVertexOffset[iVertex][2])*nxy];
 		}
-	}
-
-	//Find which edges are intersected by the surface
-	iEdgeFlags = aiCubeEdgeFlags[iFlagIndex];
 
-	//If the cube is entirely inside or outside of the surface, then there will be no intersections
-	if(iEdgeFlags == 0) return;
-
-	//Find the point of intersection of the surface with each edge
-	//Then find the normal to the surface at those points
-	for(iEdge = 0; iEdge < 12; iEdge++)
-	{
-		//if there is an intersection on this edge
-		if(iEdgeFlags & (1<<iEdge))
+		//Find which vertices are inside of the surface and which are outside
+		iFlagIndex = 0;
+		for(iVertexTest = 0; iVertexTest < 8; iVertexTest++)
 		{
-			fOffset = get_offset(afCubeValue[ a2iEdgeConnection[iEdge][0] ],
-								 afCubeValue[ a2iEdgeConnection[iEdge][1] ], _surf_value);
-
-			if ( cur_level == -1 ){
-				asEdgeVertex[iEdge][0] = fX + (a2fVertexOffset[ a2iEdgeConnection[iEdge][0] ][0]  +  fOffset * a2fEdgeDirection[iEdge][0]) + 0.5f;
-				asEdgeVertex[iEdge][1] = fY + (a2fVertexOffset[ a2iEdgeConnection[iEdge][0] ][1]  +  fOffset * a2fEdgeDirection[iEdge][1]) + 0.5f;
-				asEdgeVertex[iEdge][2] = fZ + (a2fVertexOffset[ a2iEdgeConnection[iEdge][0] ][2]  +  fOffset * a2fEdgeDirection[iEdge][2]) + 0.5f;
-			} else {
-				asEdgeVertex[iEdge][0] = fxScale*(fX + (a2fVertexOffset[ a2iEdgeConnection[iEdge][0] ][0]  +  fOffset * a2fEdgeDirection[iEdge][0])) + 0.5f;
-				asEdgeVertex[iEdge][1] = fyScale*(fY + (a2fVertexOffset[ a2iEdgeConnection[iEdge][0] ][1]  +  fOffset * a2fEdgeDirection[iEdge][1])) + 0.5f;
-				asEdgeVertex[iEdge][2] = fzScale*(fZ + (a2fVertexOffset[ a2iEdgeConnection[iEdge][0] ][2]  +  fOffset * a2fEdgeDirection[iEdge][2])) + 0.5f;
+			if (surf >= 0 ){
+				if(afCubeValue[iVertexTest] <= surf)
+					iFlagIndex |= 1<<iVertexTest;
+			}
+			else {
+				if(afCubeValue[iVertexTest] >= surf)
+					iFlagIndex |= 1<<iVertexTest;
 			}
-
-			pointIndex[iEdge] = get_edge_num(fX+edgeLookUp[iEdge][0], fY+edgeLookUp[iEdge][1], fZ+edgeLookUp[iEdge][2], edgeLookUp[iEdge][3]);
 		}
-	}
 
-	//Save voxel coords for later color processing
-	int vox[3] = {fX, fY, fZ};
+		//Find which edges are intersected by the surface
+		iEdgeFlags = aiCubeEdgeFlags[iFlagIndex];
 
-	//Draw the triangles that were found.  There can be up to five per cube
-	for(iTriangle = 0; iTriangle < 5; iTriangle++)
-	{
-		if(a2iTriangleConnectionTable[iFlagIndex][3*iTriangle] < 0)
-			break;
+		//If the cube is entirely inside or outside of the surface, then there will be no intersections
+		if(iEdgeFlags == 0) continue;
 
-		float pts[3][3];
-		for(iCorner = 0; iCorner < 3; iCorner++)
+		//Find the point of intersection of the surface with each edge
+		for(iEdge = 0; iEdge < 12; iEdge++)
 		{
-			iVertex = a2iTriangleConnectionTable[iFlagIndex][3*iTriangle+iCorner];
-			memcpy(&pts[iCorner][0],  &asEdgeVertex[iVertex][0], 3*sizeof(float));
-		}
-
+			//if there is an intersection on this edge
+			if(iEdgeFlags & (1<<iEdge))
+			{
+				fOffset = get_offset(afCubeValue[ a2iEdgeConnection[iEdge][0] ],
+									 afCubeValue[ a2iEdgeConnection[iEdge][1] ], surf);
 
+				asEdgeVertex[iEdge][0] = sx*(fX + (a2fVertexOffset[ a2iEdgeConnection[iEdge][0] ][0]  +  fOffset * a2fEdgeDirection[iEdge][0])) + 0.5f;
+				asEdgeVertex[iEdge][1] = sy*(fY + (a2fVertexOffset[ a2iEdgeConnection[iEdge][0] ][1]  +  fOffset * a2fEdgeDirection[iEdge][1])) + 0.5f;
+				asEdgeVertex[iEdge][2] = sz*(fZ + (a2fVertexOffset[ a2iEdgeConnection[iEdge][0] ][2]  +  fOffset * a2fEdgeDirection[iEdge][2])) + 0.5f;
 
-		float v1[3] = {pts[1][0]-pts[0][0],pts[1][1]-pts[0][1],pts[1][2]-pts[0][2]};
-		float v2[3] = {pts[2][0]-pts[1][0],pts[2][1]-pts[1][1],pts[2][2]-pts[1][2]};
-
-		float n[3] = { v1[1]*v2[2] - v1[2]*v2[1], v1[2]*v2[0] - v1[0]*v2[2], v1[0]*v2[1] - v1[1]*v2[0] };
+				pointIndex[iEdge] = get_edge_num(fX+edgeLookUp[iEdge][0], fY+edgeLookUp[iEdge][1], fZ+edgeLookUp[iEdge][2], edgeLookUp[iEdge][3], gy, gz);
+			}
+		}
 
+		//Save voxel coords for later color processing
+		int vox[3] = {fX, fY, fZ};
 
-		for(iCorner = 0; iCorner < 3; iCorner++)
+		//Draw the triangles that were found.  There can be up to five per cube
+		for(iTriangle = 0; iTriangle < 5; iTriangle++)
 		{
-			// Without vertex normalization
-// 			iVertex = a2iTriangleConnectionTable[iFlagIndex][3*iTriangle+iCorner];
-// 			int ss = pp.elem();
-// 			pp.push_back_3(&pts[iCorner][0]);
-// 			nn.push_back_3(&n[0]);
-// 			ff.push_back(ss);
-
-//			With vertex normalization
-			iVertex = a2iTriangleConnectionTable[iFlagIndex][3*iTriangle+iCorner];
-			map<int,int>::iterator it = point_map.find(pointIndex[iVertex]);
-			if ( it == point_map.end() ){
-				vv.push_back_3(&vox[0]);
-				int ss = pp.elem();
-				pp.push_back_3(&pts[iCorner][0]);
-				nn.push_back_3(&n[0]);
-				ff.push_back(ss);
-				point_map[pointIndex[iVertex]] = ss;
-			} else {
-				int idx = it->second;
-				ff.push_back(idx);
-				nn[idx] += n[0];
-				nn[idx+1] += n[1];
-				nn[idx+2] += n[2];
+			if(a2iTriangleConnectionTable[iFlagIndex][3*iTriangle] < 0)
+				break;
+
+			float pts[3][3];
+			for(iCorner = 0; iCorner < 3; iCorner++)
+			{
+				iVertex = a2iTriangleConnectionTable[iFlagIndex][3*iTriangle+iCorner];
+				memcpy(&pts[iCorner][0],  &asEdgeVertex[iVertex][0], 3*sizeof(float));
+			}
+
+			float v1[3] = {pts[1][0]-pts[0][0],pts[1][1]-pts[0][1],pts[1][2]-pts[0][2]};
+			float v2[3] = {pts[2][0]-pts[1][0],pts[2][1]-pts[1][1],pts[2][2]-pts[1][2]};
+
+			float n[3] = { v1[1]*v2[2] - v1[2]*v2[1], v1[2]*v2[0] - v1[0]*v2[2], v1[0]*v2[1] - v1[1]*v2[0] };
+
+			// With vertex normalization
+			for(iCorner = 0; iCorner < 3; iCorner++)
+			{
+				iVertex = a2iTriangleConnectionTable[iFlagIndex][3*iTriangle+iCorner];
+				std::unordered_map<unsigned long long, unsigned int>::iterator it = point_map.find(pointIndex[iVertex]);
+				if ( it == point_map.end() ){
+					unsigned int idx = brick.pts.size()/3;
+					int ex = fX+edgeLookUp[iVertex][0], ey = fY+edgeLookUp[iVertex][1], ez = fZ+edgeLookUp[iVertex][2];
+					brick.pts.insert(brick.pts.end(), &pts[iCorner][0], &pts[iCorner][0]+3);
+					brick.nrm.insert(brick.nrm.end(), n, n+3);
+					brick.vox.insert(brick.vox.end(), vox, vox+3);
+					brick.edges.push_back(pointIndex[iVertex]);
+					brick.boundary.push_back(ex == brick.x0 || ex == brick.x1 || ey == brick.y0 || ey == brick.y1 || ez == brick.z0 || ez == brick.z1);
+					brick.faces.push_back(idx);
+					point_map[pointIndex[iVertex]] = idx;
+				} else {
+					unsigned int idx = it->second;
+					brick.faces.push_back(idx);
+					brick.nrm[3*idx] += n[0];
+					brick.nrm[3*idx+1] += n[1];
+					brick.nrm[3*idx+2] += n[2];
+				}
 			}
 		}
 	}
+	}
+	}
+
+	brick.surf = surf;
+	brick.valid = true;
 }
 
 
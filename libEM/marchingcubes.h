@@ -283,7 +283,8 @@ namespace EMAN
 		virtual ~MarchingCubes();
 
 		/** Sets Voxel data for Isosurface implementation
-		* Calls calculate_min_max_vals which generates the tree of data
+		* Calls calculate_level_sizes which sets up the sampling levels. Value
+		* ranges come from the image's cached VolumeSummary
 		* @param data the emdata object to be rendered in 3D
 		* @exception ImageDimensionException if the image z dimension is 1
 		*/
@@ -302,9 +303,8 @@ namespace EMAN
 		/** Set sampling rates
 		* A smaller value means a finer sampling.
 		* The finest sampling level is -1
-		* Sampling values increment in steps of 1, and a single increment
-		* is interpreted as one step up or down the tree stored in minvals
-		* and maxvals
+		* Sampling values increment in steps of 1, and each step up halves
+		* the number of samples along each axis
 		* @param rate the tree level to render
 		 */
 		void set_sampling(const int rate) { drawing_level = rate; }
@@ -316,7 +316,7 @@ namespace EMAN
 
 		/** Get the range of feasible sampling rates
 		*/
-		int get_sampling_range() { return minvals.size()-1; }
+		int get_sampling_range() { return level_sizes.size()-1; }
 
 		/** Color the vertices
 		 */
@@ -328,6 +328,11 @@ namespace EMAN
 		*/
 		Dict get_isosurface();
 
+		/** March the surface for the current value and sampling, as get_isosurface() does
+		* @return the number of vertices and the number of triangles in the surface
+		*/
+		vector<int> get_surface_counts();
+
 		void surface_face_z();
 		
 		/** Functions to control colroing mode
@@ -366,52 +371,61 @@ namespace EMAN
 		}
 		
 	private:
-		map<int, int> point_map;
 		unsigned long _isodl;
 		GLuint buffer[4];
 
-		/** Calculate the min and max value trees
-		* Stores minimum and maximum cube neighborhood values in a tree structure
+		/** Calculate the grid size of each sampling level
 		* @exception NullPointerException if _emdata is null... this should not happen but is left for clarity for
 		* programmers
 		*/
-		bool calculate_min_max_vals();
-		
-	
-		/** Clear the minimum and maximum value search trees
-		* Frees memory in the minvals and maxvals
-		*/
-		void clear_min_max_vals();
+		void calculate_level_sizes();
 
-		/// Vectors for storing the search trees
-		vector<EMData*> minvals, maxvals;
+		/// Number of samples along x, y and z at each sampling level, finest first
+		vector<IntSize> level_sizes;
 
 		/// The "sampling rate"
 		int drawing_level;
 
-		/** The main cube drawing function
-		* To start the process of generate triangles call with draw_cube(0,0,0,minvals.size()-1)
-		* Once cur_level becomes drawing_level marching_cube is called
-		* @param x the current x value, relative to cur_level
-		* @param y the current y value, relative to cur_level
-		* @param z the current z value, relative to cur_level
-		* @param cur_level the current tree traversal level
-		*
+		/** A block of cubes that is marched independently of the others, and the
+		 * piece of the surface it produced. Vertices are kept with the id of the
+		 * edge they lie on, so the pieces can be stitched back together.
+		 */
+		struct Brick {
+			int x0, y0, z0, x1, y1, z1;	// cubes [x0,x1) x [y0,y1) x [z0,z1) of the current level
+			float minval, maxval;		// range of the voxels the cubes use
+			bool valid;			// the mesh below is current for surf
+			float surf;
+			vector<float> pts, nrm;
+			vector<int> vox;
+			vector<unsigned long long> edges;
+			vector<char> boundary;		// vertex is on the brick surface, so a neighbor may share it
+			vector<unsigned int> faces;	// indices into pts/3
+		};
+
+		/// Bricks covering the current level, and the level and image changecount they were laid out for
+		vector<Brick> bricks;
+		int brick_level;
+		int brick_change;
+
+		/** Lay out bricks for the current drawing_level and find their value ranges
+		* from the image's VolumeSummary. Called again whenever the image data changes.
 		*/
-		void draw_cube(const int x, const int y, const int z, const int cur_level );
+		void build_bricks();
 
+		/** Get the voxel stride and the grid of cube corners for the current drawing_level
+		*/
+		void get_level_grid(int &sx, int &sy, int &sz, int &gx, int &gy, int &gz);
 
-		/** Function for managing cases where a triangles can potentially be rendered
-		* Called by draw_cube. Generates vertices, normals, and keeps track of common points
-		* @param fX the current x coordinate, relative to cur_level
-		* @param fY the current y coordinate, relative to cur_level
-		* @param fZ the current z coordinate, relative to cur_level
-		* @param cur_level
+		/** March every cube in a brick, filling its mesh
+		* @param brick the brick to fill
+		* @param data the voxel data of _emdata
 		*/
-		void marching_cube(int fX, int fY, int fZ, const int cur_level);
+		void march_brick(Brick &brick, const float *data);
 
 		/** Calculate and generate the entire set of vertices and normals using current states
-		 * Calls draw_cube(0,0,0,minvals.size()-1)
+		 * Bricks whose value range crosses the surface are marched in parallel, and only
+		 * when they have not already been marched at this surface value. The pieces are
+		 * then merged, joining vertices on shared edges.
 		*/
 		void calculate_surface();
 		
@@ -425,10 +439,17 @@ namespace EMAN
 		 */
 		float get_offset(float fValue1, float fValue2, float fValueDesired);
 
-		/** Get edge num
-		* needs better commenting
+		/** Get a unique id for a cube edge
+		* @param x the x coordinate of the edge start
+		* @param y the y coordinate of the edge start
+		* @param z the z coordinate of the edge start
+		* @param edge the edge direction, 0, 1 or 2 for x, y or z
+		* @param gy the number of corners along y
+		* @param gz the number of corners along z
 		*/
-		int get_edge_num(int x, int y, int z, int edge);
+		static inline unsigned long long get_edge_num(int x, int y, int z, int edge, int gy, int gz) {
+			return ((((unsigned long long)x * gy + y) * gz + z) << 2) | edge;
+		}
 
 		/** Find the gradient of the scalar field at a point. This gradient can
 		 * be used as a very accurate vertx normal for lighting calculations.
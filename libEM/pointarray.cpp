@@ -33,8 +33,11 @@
 #include "pointarray.h"
 #include "util.h"
 #include "vec3.h"
+#include "emthreads.h"
 #include <vector>
 #include <cstring>
+#include <map>
+#include <memory>
 #include <boost/random.hpp>
 
 #ifdef __APPLE__
@@ -111,6 +114,7 @@ PointArray::PointArray()
 	adihed=0;
 	
 	map=gradx=grady=gradz=0;
+	gradchange=0;
 }
 
 PointArray::PointArray( int nn)
@@ -122,6 +126,7 @@ PointArray::PointArray( int nn)
 	aang=0;
 	adihed=0;
 	map=gradx=grady=gradz=0;
+	gradchange=0;
 }
 
 PointArray::~PointArray()
@@ -947,7 +952,8 @@ void PointArray::sim_updategeom() {
 	if (!aang) aang=(double *)malloc(sizeof(double)*n);
 	if (!adihed) adihed=(double *)malloc(sizeof(double)*n);
 	
-	for (size_t ii=0; ii<n; ii++) {
+	EMThreads::parallel_for(n, [&](size_t first, size_t last, int) {
+	for (size_t ii=first; ii<last; ii++) {
 		// how expensive is % ?  Worth replacing ?
 		int ib=4*((ii+n-1)%n);		// point before i with wraparound
 		int ibb=4*((ii+n-2)%n);	// 2 points before i with wraparound
@@ -983,22 +989,218 @@ void PointArray::sim_updategeom() {
 //		if (std::isnan(ang[ii])) ang[ii]=0;
 		
 	}
+	}, 256);
 }
 
 double PointArray::sim_potential() {
 	double ret=0;
 	sim_updategeom();
 	
+	// per point terms are computed in parallel, then summed in order so the result does not depend on the thread count
+	vector<double> pot(n);
 	if (map &&mapc) {
-		for (size_t i=0; i<n; i++) ret+=sim_pointpotential(adist[i],aang[i],adihed[i])-mapc*map->sget_value_at_interp(points[i*4]/apix+centx,points[i*4+1]/apix+centy,points[i*4+2]/apix+centz);
+		map->get_data();	// expand any compact storage before the threads read it
+		EMThreads::parallel_for(n, [&](size_t first, size_t last, int) {
+			for (size_t i=first; i<last; i++) pot[i]=sim_pointpotential(adist[i],aang[i],adihed[i])-mapc*map->sget_value_at_interp(points[i*4]/apix+centx,points[i*4+1]/apix+centy,points[i*4+2]/apix+centz);
+		}, 256);
 	}
 	else {
-		for (size_t i=0; i<n; i++) ret+=sim_pointpotential(adist[i],aang[i],adihed[i]);
+		for (size_t i=0; i<n; i++) pot[i]=sim_pointpotential(adist[i],aang[i],adihed[i]);
 	}
+	for (size_t i=0; i<n; i++) ret+=pot[i];
 
 	return ret/n;
 }
 
+void PointArray::sim_update_gradient_maps() {
+	if (!map) return;
+	if (gradx && grady && gradz && gradchange==map->get_changecount()) return;
+
+	EMData *grad[3];
+	int nx=map->get_xsize(), ny=map->get_ysize(), nz=map->get_zsize();
+	const float *m=map->get_data();
+	size_t nxy=(size_t)nx*ny;
+	for (int c=0; c<3; c++) {
+		grad[c]=new EMData();
+		grad[c]->set_size(nx,ny,nz);
+	}
+	float *gx=grad[0]->get_data(), *gy=grad[1]->get_data(), *gz=grad[2]->get_data();
+
+	// central differences in pixel units, one sided at the edges
+	EMThreads::parallel_for((size_t)nz, [&](size_t first, size_t last, int) {
+		for (int z=(int)first; z<(int)last; z++) {
+			int z0=z>0?z-1:z, z1=z<nz-1?z+1:z;
+			for (int y=0; y<ny; y++) {
+				int y0=y>0?y-1:y, y1=y<ny-1?y+1:y;
+				for (int x=0; x<nx; x++) {
+					int x0=x>0?x-1:x, x1=x<nx-1?x+1:x;
+					size_t i=x+y*(size_t)nx+z*nxy;
+					gx[i]=x1>x0?(m[x1+y*(size_t)nx+z*nxy]-m[x0+y*(size_t)nx+z*nxy])/(x1-x0):0.0f;
+					gy[i]=y1>y0?(m[x+y1*(size_t)nx+z*nxy]-m[x+y0*(size_t)nx+z*nxy])/(y1-y0):0.0f;
+					gz[i]=z1>z0?(m[x+y*(size_t)nx+z1*nxy]-m[x+y*(size_t)nx+z0*nxy])/(z1-z0):0.0f;
+				}
+			}
+		}
+	});
+
+	for (int c=0; c<3; c++) grad[c]->update();
+	if (gradx!=0) delete gradx;
+	if (grady!=0) delete grady;
+	if (gradz!=0) delete gradz;
+	gradx=grad[0];
+	grady=grad[1];
+	gradz=grad[2];
+	gradchange=map->get_changecount();
+}
+
+namespace {
+	inline void sim_sub(const double *a, const double *b, double *r) { r[0]=a[0]-b[0]; r[1]=a[1]-b[1]; r[2]=a[2]-b[2]; }
+	inline double sim_dot(const double *a, const double *b) { return a[0]*b[0]+a[1]*b[1]+a[2]*b[2]; }
+	inline void sim_cross(const double *a, const double *b, double *r) {
+		r[0]=a[1]*b[2]-a[2]*b[1];
+		r[1]=a[2]*b[0]-a[0]*b[2];
+		r[2]=a[0]*b[1]-a[1]*b[0];
+	}
+	inline void sim_axpy(double s, const double *a, double *r) { r[0]+=s*a[0]; r[1]+=s*a[1]; r[2]+=s*a[2]; }
+}
+
+double PointArray::sim_potential_gradient(vector<Vec3f> & grad) {
+	grad.assign(n,Vec3f(0,0,0));
+	if (n==0) return 0.0;
+
+	if (!adist) adist=(double *)malloc(sizeof(double)*n);
+	if (!aang) aang=(double *)malloc(sizeof(double)*n);
+	if (!adihed) adihed=(double *)malloc(sizeof(double)*n);
+
+	bool usemap=map && mapc;
+	if (usemap) {
+		sim_update_gradient_maps();
+		map->get_data();
+	}
+
+	// term i depends on points i-2, i-1, i and i+1; its derivatives go to tg[12*i .. 12*i+11] in that order.
+	// The point's own map and close contact derivatives go to own, and each point's nearest neighbor
+	// picks up the opposite of the close contact term in a serial pass below.
+	vector<double> pot(n), tg(12*n,0.0), own(3*n,0.0), pen(3*n,0.0);
+	vector<long> nearest(n,-1);
+
+	EMThreads::parallel_for(n, [&](size_t first, size_t last, int) {
+		for (size_t i=first; i<last; i++) {
+			const double *p0=points+4*((i+n-2)%n), *p1=points+4*((i+n-1)%n), *p2=points+4*i, *p3=points+4*((i+1)%n);
+			double *g0=&tg[12*i], *g1=g0+3, *g2=g0+6, *g3=g0+9;
+			double a[3],b[3],c[3];
+			sim_sub(p1,p0,a);
+			sim_sub(p2,p1,b);
+			sim_sub(p3,p2,c);
+			double lb=sqrt(sim_dot(b,b)), lc=sqrt(sim_dot(c,c));
+
+			// bond length
+			double dist=lb;
+			if (lb>0) {
+				double f=2.0*distc*(dist-dist0)/lb;
+				sim_axpy(f,b,g2);
+				sim_axpy(-f,b,g1);
+			}
+
+			// bond angle, d(ang^2)/dcos=-2 ang/sin(ang)
+			double ang=0;
+			if (lb>0 && lc>0) {
+				double cs=sim_dot(b,c)/(lb*lc);
+				if (cs>1.0) cs=1.0;
+				if (cs<-1.0) cs=-1.0;
+				ang=acos(cs);
+				double sn=sin(ang);
+				double f=-2.0*angc*(sn>1e-6?ang/sn:(ang<M_PI/2.0?1.0:ang/1e-6));
+				double db[3],dc[3];
+				for (int k=0; k<3; k++) {
+					db[k]=c[k]/(lb*lc)-cs*b[k]/(lb*lb);
+					dc[k]=b[k]/(lb*lc)-cs*c[k]/(lc*lc);
+				}
+				sim_axpy(-f,db,g1);
+				sim_axpy(f,db,g2);
+				sim_axpy(-f,dc,g2);
+				sim_axpy(f,dc,g3);
+			}
+
+			// dihedral, using the Blondel & Karplus form of the gradient, which has no singularity at 0 or pi
+			double dihed=0;
+			double n1[3],n2[3];
+			sim_cross(a,b,n1);
+			sim_cross(b,c,n2);
+			double nn1=sim_dot(n1,n1), nn2=sim_dot(n2,n2);
+			if (nn1>0 && nn2>0 && lb>0) {
+				double cs=sim_dot(n1,n2)/sqrt(nn1*nn2);
+				if (cs>1.0) cs=1.0;
+				if (cs<-1.0) cs=-1.0;
+				dihed=acos(cs);
+
+				// dihed is unsigned, so flip the signed gradient by the sign of the torsion
+				double n12[3];
+				sim_cross(n1,n2,n12);
+				double sgn=sim_dot(n12,b)<0?-1.0:1.0;
+				double f=sgn*2.0*dihedc*(dihed-dihed0);
+				double fg=sim_dot(a,b)/(nn1*lb), hg=-sim_dot(c,b)/(nn2*lb);	// (F.G)/(|A|^2|G|), (H.G)/(|B|^2|G|)
+				sim_axpy(-f*lb/nn1,n1,g0);
+				sim_axpy(f*(lb/nn1+fg),n1,g1);
+				sim_axpy(-f*hg,n2,g1);
+				sim_axpy(f*hg,n2,g2);
+				sim_axpy(-f*fg,n1,g2);
+				sim_axpy(-f*lb/nn2,n2,g2);
+				sim_axpy(f*lb/nn2,n2,g3);
+			}
+			adist[i]=dist;
+			aang[i]=ang;
+			adihed[i]=dihed;
+			pot[i]=sim_pointpotential(dist,ang,dihed);
+
+			// close contact penalty against the nearest other point
+			double mindist=10000;
+			for (size_t j=0; j<n; j++) {
+				if (j==i) continue;
+				double d[3];
+				sim_sub(p2,points+4*j,d);
+				double jdst=sqrt(sim_dot(d,d));
+				if (jdst<mindist) {
+					mindist=jdst;
+					nearest[i]=j;
+				}
+			}
+			if (mindist<mindistc && mindist>0) {
+				pot[i]+=distpenc/mindist;
+				double d[3];
+				sim_sub(p2,points+4*nearest[i],d);
+				sim_axpy(-distpenc/(mindist*mindist*mindist),d,&pen[3*i]);
+			}
+			else nearest[i]=-1;
+
+			if (usemap) {
+				float x=points[i*4]/apix+centx, y=points[i*4+1]/apix+centy, z=points[i*4+2]/apix+centz;
+				pot[i]-=mapc*map->sget_value_at_interp(x,y,z);
+				own[3*i]-=mapc*gradx->sget_value_at_interp(x,y,z)/apix;
+				own[3*i+1]-=mapc*grady->sget_value_at_interp(x,y,z)/apix;
+				own[3*i+2]-=mapc*gradz->sget_value_at_interp(x,y,z)/apix;
+			}
+		}
+	}, 64);
+
+	// gather the terms touching each point
+	EMThreads::parallel_for(n, [&](size_t first, size_t last, int) {
+		for (size_t k=first; k<last; k++) {
+			for (int c=0; c<3; c++)
+				grad[k][c]=tg[12*((k+2)%n)+c]+tg[12*((k+1)%n)+3+c]+tg[12*k+6+c]+tg[12*((k+n-1)%n)+9+c]+own[3*k+c]+pen[3*k+c];
+		}
+	}, 256);
+
+	double ret=0;
+	for (size_t i=0; i<n; i++) {
+		ret+=pot[i];
+		if (nearest[i]>=0) {
+			for (int c=0; c<3; c++) grad[nearest[i]][c]-=pen[3*i+c];
+		}
+	}
+	return ret;
+}
+
 // potential for a single point. Note that if a point moves, it will impact energies +-2 from its position. This function computes only for the point i
 double PointArray::sim_potentiald(int ind) {
 	if (!adist) sim_updategeom();		// wasteful, but only once
@@ -1140,11 +1342,14 @@ Vec3f PointArray::sim_descent(int i) {
 void PointArray::sim_minstep(double maxshift) { 
 	vector<Vec3f> shifts;
 	
+	// the whole chain moves along the analytic gradient, scaled to the 0.01 step sim_descent() uses
+	sim_potential_gradient(shifts);
+	for (size_t i=0; i<n; i++) shifts[i]*=-0.01f;
+
 	double max=0.0;
 	double mean=0.0;
 	for (size_t i=0; i<n; i++) {
-		if (oldshifts.size()==n) shifts.push_back((sim_descent(i)+oldshifts[i])/2.0);
-		else shifts.push_back(sim_descent(i));
+		if (oldshifts.size()==n) shifts[i]=(shifts[i]+oldshifts[i])/2.0;
 		float len=shifts[i].length();
 		if (len>max) max=len;
 		mean+=len;
@@ -1322,6 +1527,7 @@ void PointArray::sim_set_pot_parms(double pdist0,double pdistc,double pangc, dou
 		if (gradx!=0) delete gradx;
 		if (grady!=0) delete grady;
 		if (gradz!=0) delete gradz;
+		gradx=grady=gradz=0;
 		
 		map=pmap;
 		apix=map->get_attr("apix_x");
@@ -2273,6 +2479,129 @@ void PointArray::sort_by_axis(int axis)
 }
 
 
+GaussianTable::GaussianTable(double w, double a, double nm)
+	: width(w), apix(a), norm(nm)
+{
+	double min_table_val = 1e-7;
+	double max_table_x = sqrt(-log(min_table_val));	// for exp(-x*x)
+	double table_step_size = 0.001;	// number of steps for each pixel
+
+	int table_size = int (max_table_x * width / (apix * table_step_size) * 1.25);
+	if (table_size < 0) table_size = 0;
+	table.resize(table_size);
+	for (int i = 0; i < table_size; i++) {
+		double x = -i * table_step_size * apix / width;
+		table[i] = exp(-x * x) / norm;
+	}
+
+	gbox = int (max_table_x * width / apix);	// local box half size in pixels to consider for each point
+	if (gbox <= 0)
+		gbox = 1;
+}
+
+namespace {
+	/** One Gaussian to splat, centre in pixel coordinates */
+	struct SplatPoint {
+		double xc, yc, zc, fval;
+		const GaussianTable *table;
+	};
+
+	/** Returns a table for (width, apix, norm), reusing the last one this
+	 * thread built when the parameters match. Repeated projections inside
+	 * refinement loops then skip rebuilding it. */
+	std::shared_ptr<const GaussianTable> cached_gaussian_table(double width, double apix, double norm = 1.0)
+	{
+		thread_local std::shared_ptr<const GaussianTable> last;
+		if (!last || !last->matches(width, apix, norm)) {
+			last = std::make_shared<const GaussianTable>(width, apix, norm);
+		}
+		return last;
+	}
+
+	/** Add the Gaussians in pts to the nx*ny*nz image pd (nz=1 for 2-D).
+	 * The slowest axis is cut into tiles and each point is binned into the
+	 * tiles its box overlaps. Tiles are filled in parallel, each by one
+	 * thread, so no two threads write the same pixel. Within a tile points
+	 * are added in their original order, so each pixel sums in the same
+	 * order as a serial loop over the points. Each Gaussian is evaluated
+	 * separably, looking up its x values once per row. */
+	void splat_points(float *pd, int nx, int ny, int nz, const vector<SplatPoint> & pts)
+	{
+		bool is3d = nz > 1;
+		int naxis = is3d ? nz : ny;
+		int tile = naxis / (4 * EMThreads::get_num_threads());
+		if (tile < 4) tile = 4;
+		int ntile = (naxis + tile - 1) / tile;
+
+		vector< vector<size_t> > bins(ntile);
+		for (size_t s = 0; s < pts.size(); s++) {
+			double c = is3d ? pts[s].zc : pts[s].yc;
+			int gbox = pts[s].table->get_half_box();
+			int lo = int (c) - gbox, hi = int (c) + gbox;
+			if (lo < 0) lo = 0;
+			if (hi > naxis) hi = naxis;
+			for (int t = lo / tile; lo < hi && t <= (hi - 1) / tile; t++) bins[t].push_back(s);
+		}
+
+		size_t nxy = (size_t)nx * ny;
+		EMThreads::parallel_for_each(ntile, [&](size_t t, int) {
+			int tlo = (int)t * tile, thi = std::min(naxis, tlo + tile);
+			vector<double> xv;
+
+			for (size_t b = 0; b < bins[t].size(); b++) {
+				const SplatPoint & p = pts[bins[t][b]];
+				const GaussianTable & table = *p.table;
+				int gbox = table.get_half_box();
+
+				int imin = int (p.xc) - gbox, imax = int (p.xc) + gbox;
+				int jmin = int (p.yc) - gbox, jmax = int (p.yc) + gbox;
+				int kmin = 0, kmax = 1;
+				if (is3d) {
+					kmin = int (p.zc) - gbox;
+					kmax = int (p.zc) + gbox;
+				}
+				if (imin < 0) imin = 0;
+				if (jmin < 0) jmin = 0;
+				if (kmin < 0) kmin = 0;
+				if (imax > nx) imax = nx;
+				if (jmax > ny) jmax = ny;
+				if (kmax > nz) kmax = nz;
+
+				// restrict the tiled axis to this tile
+				if (is3d) {
+					kmin = std::max(kmin, tlo);
+					kmax = std::min(kmax, thi);
+				}
+				else {
+					jmin = std::max(jmin, tlo);
+					jmax = std::min(jmax, thi);
+				}
+				if (imin >= imax) continue;
+
+				xv.resize(imax - imin);
+				for (int i = imin; i < imax; i++) xv[i - imin] = table(i - p.xc);
+
+				for (int k = kmin; k < kmax; k++) {
+					double zval = is3d ? table(k - p.zc) : 1.0;
+					if (zval == 0.0) continue;
+					double fz = p.fval * zval;
+					for (int j = jmin; j < jmax; j++) {
+						double yval = table(j - p.yc);
+						if (yval == 0.0) continue;
+						double fzy = fz * yval;
+						float *row = pd + k * nxy + (size_t)j * nx;
+						for (int i = imin; i < imax; i++) {
+							double xval = xv[i - imin];
+							if (xval == 0.0) continue;
+							row[i] += (float) (fzy * xval);
+						}
+					}
+				}
+			}
+		});
+	}
+}
+
 EMData *PointArray::pdb2mrc_by_summation(int map_size, float apix, float res, int addpdbbfactor)
 {
 #ifdef DEBUG
@@ -2280,96 +2609,39 @@ EMData *PointArray::pdb2mrc_by_summation(int map_size, float apix, float res, in
 #endif
 	//if ( gauss_real_width < apix) LOGERR("PointArray::projection_by_summation(): apix(%g) is too large for resolution (%g Angstrom in Fourier space) with %g pixels of 1/e half width", apix, res, gauss_real_width);
 
-	double min_table_val = 1e-7;
-	double max_table_x = sqrt(-log(min_table_val));	// for exp(-x*x)
-
-	double table_step_size = 0.001;	// number of steps for each pixel
-	double inv_table_step_size = 1.0 / table_step_size;
-	
-//	sort_by_axis(2);			// sort by Z-axis
-
 	EMData *map = new EMData();
 	map->set_size(map_size, map_size, map_size);
 	map->to_zero();
 	float *pd = map->get_data();
-	
-	vector<double> table;
-	double gauss_real_width;
-	int table_size;
-	int gbox;
-	
-	
+
+	// One table for a fixed resolution, otherwise one per distinct B-factor
+	std::shared_ptr<const GaussianTable> res_table;
+	std::map<double, GaussianTable> bfactor_tables;
+	if (addpdbbfactor == -1) res_table = cached_gaussian_table(res / M_PI, apix);
+
+	vector<SplatPoint> pts(get_number_points());
 	for ( size_t s = 0; s < get_number_points(); ++s) {
-		double xc = points[4 * s] / apix + map_size / 2;
-		double yc = points[4 * s + 1] / apix + map_size / 2;
-		double zc = points[4 * s + 2] / apix + map_size / 2;
-		double fval = points[4 * s + 3];
-		
-		//printf("\n bfactor=%f",bfactor[s]);
-		
-		if(addpdbbfactor==-1){
-			gauss_real_width = res/M_PI;	// in Angstrom, res is in Angstrom
-		}else{
-			gauss_real_width = (bfactor[s])/(4*sqrt(2.0)*M_PI);	// in Angstrom, res is in Angstrom
-		}
-		
-		table_size = int (max_table_x * gauss_real_width / (apix * table_step_size) * 1.25);
-		table.resize(table_size);
-		for (int i = 0; i < table_size; i++){
-			table[i] = 0;
-		}
-		
-		for (int i = 0; i < table_size; i++) {						
-			double x = -i * table_step_size * apix / gauss_real_width;
-			if(addpdbbfactor==-1){
-				table[i] =  exp(-x * x);	
-			}
-			else{
-			table[i] =  exp(-x * x)/sqrt(gauss_real_width * gauss_real_width * 2 * M_PI);
-			}
-		}
+		pts[s].xc = points[4 * s] / apix + map_size / 2;
+		pts[s].yc = points[4 * s + 1] / apix + map_size / 2;
+		pts[s].zc = points[4 * s + 2] / apix + map_size / 2;
+		pts[s].fval = points[4 * s + 3];
 
-		gbox = int (max_table_x * gauss_real_width / apix);	// local box half size in pixels to consider for each point
-		if (gbox <= 0)
-			gbox = 1;
-		
-		int imin = int (xc) - gbox, imax = int (xc) + gbox;
-		int jmin = int (yc) - gbox, jmax = int (yc) + gbox;
-		int kmin = int (zc) - gbox, kmax = int (zc) + gbox;
-		if (imin < 0)
-			imin = 0;
-		if (jmin < 0)
-			jmin = 0;
-		if (kmin < 0)
-			kmin = 0;
-		if (imax > map_size)
-			imax = map_size;
-		if (jmax > map_size)
-			jmax = map_size;
-		if (kmax > map_size)
-			kmax = map_size;		
-		
-		for (int k = kmin; k < kmax; k++) {
-			size_t table_index_z = size_t (fabs(k - zc) * inv_table_step_size);
-			if ( table_index_z >= table.size() ) continue;
-			double zval = table[table_index_z];
-			size_t pd_index_z = k * map_size * map_size;
-			
-			for (int j = jmin; j < jmax; j++) {
-				size_t table_index_y = size_t (fabs(j - yc) * inv_table_step_size);
-				if ( table_index_y >= table.size() ) continue;
-				double yval = table[table_index_y];
-				size_t pd_index = pd_index_z + j * map_size + imin;
-				for (int i = imin; i < imax; i++, pd_index++) {
-					size_t table_index_x = size_t (fabs(i - xc) * inv_table_step_size);
-					if ( table_index_x >= table.size() ) continue;
-					double xval = table[table_index_x];
-					pd[pd_index] += (float) (fval * zval * yval * xval);
-				}
+		if (addpdbbfactor == -1) {
+			pts[s].table = res_table.get();
+		}
+		else {
+			std::map<double, GaussianTable>::iterator it = bfactor_tables.find(bfactor[s]);
+			if (it == bfactor_tables.end()) {
+				double gauss_real_width = (bfactor[s])/(4*sqrt(2.0)*M_PI);	// in Angstrom, res is in Angstrom
+				double norm = sqrt(gauss_real_width * gauss_real_width * 2 * M_PI);
+				it = bfactor_tables.insert(std::make_pair(bfactor[s], GaussianTable(gauss_real_width, apix, norm))).first;
 			}
+			pts[s].table = &it->second;
 		}
 	}
 
+	splat_points(pd, map_size, map_size, map_size, pts);
+
 	map->update();
 	map->set_attr("apix_x", apix);
 	map->set_attr("apix_y", apix);
@@ -2387,72 +2659,298 @@ EMData *PointArray::projection_by_summation(int image_size, float apix, float re
 	double gauss_real_width = res / (M_PI);	// in Angstrom, res is in Angstrom
 	//if ( gauss_real_width < apix) LOGERR("PointArray::projection_by_summation(): apix(%g) is too large for resolution (%g Angstrom in Fourier space) with %g pixels of 1/e half width", apix, res, gauss_real_width);
 
-	double min_table_val = 1e-7;
-	double max_table_x = sqrt(-log(min_table_val));	// for exp(-x*x)
+	std::shared_ptr<const GaussianTable> table = cached_gaussian_table(gauss_real_width, apix);
 
-	//double table_step_size = 0.001;    // number of steps for x=[0,1] in exp(-x*x)
-	//int table_size = int(max_table_x / table_step_size *1.25);
-	//double* table = (double*)malloc(sizeof(double) * table_size);
-	//for(int i=0; i<table_size; i++) table[i]=exp(-i*i*table_step_size*table_step_size);
-
-	double table_step_size = 0.001;	// number of steps for each pixel
-	double inv_table_step_size = 1.0 / table_step_size;
-	int table_size = int (max_table_x * gauss_real_width / (apix * table_step_size) * 1.25);
-	double *table = (double *) malloc(sizeof(double) * table_size);
-	for (int i = 0; i < table_size; i++) {
-		double x = -i * table_step_size * apix / gauss_real_width;
-		table[i] = exp(-x * x);
-	}
-
-	int gbox = int (max_table_x * gauss_real_width / apix);	// local box half size in pixels to consider for each point
-	if (gbox <= 0)
-		gbox = 1;
 	EMData *proj = new EMData();
 	proj->set_size(image_size, image_size, 1);
 	proj->to_zero();
 	float *pd = proj->get_data();
+
+	vector<SplatPoint> pts(get_number_points());
 	for ( size_t s = 0; s < get_number_points(); ++s) {
-		double xc = points[4 * s] / apix + image_size / 2;
-		double yc = points[4 * s + 1] / apix + image_size / 2;
-		double fval = points[4 * s + 3];
-		int imin = int (xc) - gbox, imax = int (xc) + gbox;
-		int jmin = int (yc) - gbox, jmax = int (yc) + gbox;
-		if (imin < 0)
-			imin = 0;
-		if (jmin < 0)
-			jmin = 0;
-		if (imax > image_size)
-			imax = image_size;
-		if (jmax > image_size)
-			jmax = image_size;
-
-		for (int j = jmin; j < jmax; j++) {
-			//int table_index_y = int(fabs(j-yc)*apix/gauss_real_width/table_step_size);
-			int table_index_y = int (fabs(j - yc) * inv_table_step_size);
-			double yval = table[table_index_y];
-#ifdef DEBUG
-			//double yval2 = exp( - (j-yc)*(j-yc)*apix*apix/(gauss_real_width*gauss_real_width));
-			//if(fabs(yval2-yval)/yval2>1e-2) printf("s=%d\txc,yc=%g,%g\tyval,yval2=%g,%g\tdiff=%g\n",s,xc,yc,yval,yval2,fabs(yval2-yval)/yval2);
-#endif
-			int pd_index = j * image_size + imin;
-			for (int i = imin; i < imax; i++, pd_index++) {
-				//int table_index_x = int(fabs(i-xc)*apix/gauss_real_width/table_step_size);
-				int table_index_x = int (fabs(i - xc) * inv_table_step_size);
-				double xval = table[table_index_x];
-#ifdef DEBUG
-				//double xval2 = exp( - (i-xc)*(i-xc)*apix*apix/(gauss_real_width*gauss_real_width));
-				//if(fabs(xval2-xval)/xval2>1e-2) printf("\ts=%d\txc,yc=%g,%g\txval,xval2=%g,%g\tdiff=%g\n",s,xc,yc,xval,xval2,fabs(xval2-xval)/xval2);
-#endif
-				pd[pd_index] += (float)(fval * yval * xval);
-			}
-		}
+		pts[s].xc = points[4 * s] / apix + image_size / 2;
+		pts[s].yc = points[4 * s + 1] / apix + image_size / 2;
+		pts[s].zc = 0;
+		pts[s].fval = points[4 * s + 3];
+		pts[s].table = table.get();
 	}
+
+	splat_points(pd, image_size, image_size, 1, pts);
+
 	for (int i = 0; i < image_size * image_size; i++)
 		pd[i] /= sqrt(M_PI);
 	proj->update();
 	return proj;
 }
 
+vector<EMData *> PointArray::projections_by_summation(const vector<Transform> & xforms, int image_size, float apix, float res)
+{
+	double gauss_real_width = res / (M_PI);	// in Angstrom, res is in Angstrom
+	std::shared_ptr<const GaussianTable> table = cached_gaussian_table(gauss_real_width, apix);
+
+	vector<EMData *> projs(xforms.size(), (EMData *)0);
+	for (size_t p = 0; p < xforms.size(); p++) {
+		projs[p] = new EMData();
+		projs[p]->set_size(image_size, image_size, 1);
+		projs[p]->to_zero();
+	}
+
+	size_t np = get_number_points();
+	EMThreads::parallel_for_each(xforms.size(), [&](size_t p, int) {
+		vector<SplatPoint> pts(np);
+		for (size_t s = 0; s < np; ++s) {
+			Vec3f v((float)points[4 * s], (float)points[4 * s + 1], (float)points[4 * s + 2]);
+			v = v * xforms[p];
+			pts[s].xc = (double)v[0] / apix + image_size / 2;
+			pts[s].yc = (double)v[1] / apix + image_size / 2;
+			pts[s].zc = 0;
+			pts[s].fval = points[4 * s + 3];
+			pts[s].table = table.get();
+		}
+
+		float *pd = projs[p]->get_data();
+		splat_points(pd, image_size, image_size, 1, pts);
+		for (int i = 0; i < image_size * image_size; i++)
+			pd[i] /= sqrt(M_PI);
+	});
+
+	for (size_t p = 0; p < projs.size(); p++) {
+		projs[p]->update();
+		Transform t = xforms[p];
+		projs[p]->set_attr("xform.projection", &t);
+	}
+	return projs;
+}
+
+namespace {
+	/** Fourier layout of a projection and the transform of one unit Gaussian,
+	 * shared by projections_by_fourier() and its gradient */
+	struct FourierGaussGrid {
+		int n;		// real space image size
+		int nxc;	// complex columns stored per row
+		int kcut;	// largest |k| where the Gaussian envelope is still significant
+		double amp;	// Fourier amplitude of a unit point
+		vector<double> env;	// envelope for k = 0 .. kcut
+
+		FourierGaussGrid(int image_size, float apix, float res)
+			: n(image_size), nxc(image_size / 2 + 1)
+		{
+			// real space exp(-d^2/w^2)/sqrt(pi) with w = res/(pi apix) pixels, as in projection_by_summation
+			double w = res / (M_PI * apix);
+			amp = sqrt(M_PI) * w * w;
+
+			double kmax = sqrt(-log(1e-7)) * apix * n / res;
+			kcut = kmax < n / 2 ? int(kmax) : n / 2;
+			env.resize(kcut + 1);
+			for (int k = 0; k <= kcut; k++) {
+				double x = res * k / (apix * n);
+				env[k] = exp(-x * x);
+			}
+		}
+
+		/** @return the frequency stored in row y */
+		inline int ky(int y) const { return 2 * y < n ? y : y - n; }
+	};
+
+	/** Fills re/im with env[k]*exp(-2 pi i k pos/n) for k = 0 .. kmax. The
+	 * phase is advanced by complex multiplication, so each call costs a
+	 * single sin/cos pair. */
+	void gauss_phasors(const FourierGaussGrid & g, double pos, int kmax, double *re, double *im)
+	{
+		double th = -2.0 * M_PI * pos / g.n;
+		double sr = cos(th), si = sin(th);
+		double pr = 1.0, pim = 0.0;
+		for (int k = 0; k <= kmax; k++) {
+			re[k] = pr * g.env[k];
+			im[k] = pim * g.env[k];
+			double t = pr * sr - pim * si;
+			pim = pr * si + pim * sr;
+			pr = t;
+		}
+	}
+
+	/** points are processed in blocks of this size so a row of the
+	 * output/gradient image stays in cache while the block is applied */
+	const size_t FOURIER_GAUSS_BLOCK = 64;
+}
+
+vector<EMData *> PointArray::projections_by_fourier(const vector<Transform> & xforms, int image_size, float apix, float res)
+{
+	if (res <= 0) throw InvalidValueException(res, "resolution must be positive");
+	if (image_size <= 0) throw InvalidValueException(image_size, "image size must be positive");
+
+	FourierGaussGrid grid(image_size, apix, res);
+	int nxc = grid.nxc, kc = grid.kcut;
+	int xn = kc + 1 < nxc ? kc + 1 : nxc;	// columns inside the envelope
+
+	vector<EMData *> projs(xforms.size(), (EMData *)0);
+	vector<float *> pdata(xforms.size(), (float *)0);
+	for (size_t p = 0; p < xforms.size(); p++) {
+		projs[p] = new EMData();
+		projs[p]->set_size(2 * nxc, image_size, 1);
+		projs[p]->to_zero();
+		projs[p]->set_complex(true);
+		projs[p]->set_ri(true);
+		projs[p]->set_fftpad(true);
+		projs[p]->set_fftodd(image_size % 2 == 1);
+		pdata[p] = projs[p]->get_data();
+	}
+
+	size_t np = get_number_points();
+	EMThreads::parallel_for_each(xforms.size(), [&](size_t p, int) {
+		vector<double> accr((size_t)image_size * xn, 0.0), acci((size_t)image_size * xn, 0.0);
+		vector<double> exr(FOURIER_GAUSS_BLOCK * xn), exi(FOURIER_GAUSS_BLOCK * xn);
+		vector<double> eyr(FOURIER_GAUSS_BLOCK * (kc + 1)), eyi(FOURIER_GAUSS_BLOCK * (kc + 1));
+		vector<double> amp(FOURIER_GAUSS_BLOCK);
+
+		for (size_t b = 0; b < np; b += FOURIER_GAUSS_BLOCK) {
+			size_t m = std::min(FOURIER_GAUSS_BLOCK, np - b);
+			for (size_t j = 0; j < m; j++) {
+				size_t s = b + j;
+				Vec3f v((float)points[4 * s], (float)points[4 * s + 1], (float)points[4 * s + 2]);
+				v = v * xforms[p];
+				amp[j] = points[4 * s + 3] * grid.amp;
+				gauss_phasors(grid, v[0] / apix + image_size / 2, xn - 1, &exr[j * xn], &exi[j * xn]);
+				gauss_phasors(grid, v[1] / apix + image_size / 2, kc, &eyr[j * (kc + 1)], &eyi[j * (kc + 1)]);
+			}
+
+			for (int y = 0; y < image_size; y++) {
+				int k = grid.ky(y);
+				int ka = k < 0 ? -k : k;
+				if (ka > kc) continue;
+				double *rr = &accr[(size_t)y * xn];
+				double *ri = &acci[(size_t)y * xn];
+				for (size_t j = 0; j < m; j++) {
+					double cr = amp[j] * eyr[j * (kc + 1) + ka];
+					double ci = amp[j] * (k < 0 ? -eyi[j * (kc + 1) + ka] : eyi[j * (kc + 1) + ka]);
+					const double *er = &exr[j * xn];
+					const double *ei = &exi[j * xn];
+					for (int x = 0; x < xn; x++) {
+						rr[x] += cr * er[x] - ci * ei[x];
+						ri[x] += cr * ei[x] + ci * er[x];
+					}
+				}
+			}
+		}
+
+		float *d = pdata[p];
+		for (int y = 0; y < image_size; y++) {
+			for (int x = 0; x < xn; x++) {
+				d[(size_t)y * 2 * nxc + 2 * x] = (float)accr[(size_t)y * xn + x];
+				d[(size_t)y * 2 * nxc + 2 * x + 1] = (float)acci[(size_t)y * xn + x];
+			}
+		}
+	});
+
+	for (size_t p = 0; p < projs.size(); p++) {
+		projs[p]->update();
+		Transform t = xforms[p];
+		projs[p]->set_attr("xform.projection", &t);
+	}
+	return projs;
+}
+
+vector<float> PointArray::projections_by_fourier_gradient(const vector<Transform> & xforms, const vector<EMData *> & grads, float apix, float res)
+{
+	if (res <= 0) throw InvalidValueException(res, "resolution must be positive");
+	if (grads.size() != xforms.size()) throw InvalidParameterException("one gradient image is required per orientation");
+
+	size_t np = get_number_points();
+	vector<float> ret(4 * np, 0.0f);
+	if (grads.empty()) return ret;
+
+	// get_data() may convert storage, so fetch every pointer before threading
+	int image_size = 0;
+	vector<const float *> gdata(grads.size(), (const float *)0);
+	for (size_t p = 0; p < grads.size(); p++) {
+		EMData *g = grads[p];
+		if (g == 0 || !g->is_complex() || !g->is_ri() || g->get_zsize() != 1)
+			throw ImageFormatException("gradient images must be 2-D complex ri images");
+		int n = g->get_xsize() - (g->is_fftodd() ? 1 : 2);
+		if (p == 0) image_size = n;
+		if (n != image_size || g->get_ysize() != image_size)
+			throw ImageDimensionException("gradient images must all match projections_by_fourier() output size");
+		gdata[p] = g->get_data();
+	}
+
+	FourierGaussGrid grid(image_size, apix, res);
+	int nxc = grid.nxc, kc = grid.kcut;
+	int xn = kc + 1 < nxc ? kc + 1 : nxc;
+
+	// columns other than 0 and Nyquist stand for their Hermitian mates as well
+	vector<double> wx(xn), kwx(xn);
+	for (int x = 0; x < xn; x++) {
+		wx[x] = (x == 0 || (image_size % 2 == 0 && x == image_size / 2)) ? 1.0 : 2.0;
+		kwx[x] = wx[x] * x;
+	}
+	double dphase = 2.0 * M_PI / image_size;
+
+	size_t nblocks = (np + FOURIER_GAUSS_BLOCK - 1) / FOURIER_GAUSS_BLOCK;
+	EMThreads::parallel_for_each(nblocks, [&](size_t bi, int) {
+		size_t b = bi * FOURIER_GAUSS_BLOCK;
+		size_t m = std::min(FOURIER_GAUSS_BLOCK, np - b);
+		vector<double> exr(m * xn), exi(m * xn), eyr(m * (kc + 1)), eyi(m * (kc + 1));
+		vector<double> s0r(m), sxi(m), syi(m);
+		vector<double> acc(4 * m, 0.0);
+
+		for (size_t p = 0; p < xforms.size(); p++) {
+			const Transform & xf = xforms[p];
+			const float *g = gdata[p];
+
+			for (size_t j = 0; j < m; j++) {
+				size_t s = b + j;
+				Vec3f v((float)points[4 * s], (float)points[4 * s + 1], (float)points[4 * s + 2]);
+				v = v * xf;
+				gauss_phasors(grid, v[0] / apix + image_size / 2, xn - 1, &exr[j * xn], &exi[j * xn]);
+				gauss_phasors(grid, v[1] / apix + image_size / 2, kc, &eyr[j * (kc + 1)], &eyi[j * (kc + 1)]);
+				s0r[j] = sxi[j] = syi[j] = 0.0;
+			}
+
+			for (int y = 0; y < image_size; y++) {
+				int k = grid.ky(y);
+				int ka = k < 0 ? -k : k;
+				if (ka > kc) continue;
+				const float *grow = g + (size_t)y * 2 * nxc;
+				for (size_t j = 0; j < m; j++) {
+					const double *er = &exr[j * xn];
+					const double *ei = &exi[j * xn];
+					double r0r = 0, r0i = 0, rxr = 0, rxi = 0;
+					for (int x = 0; x < xn; x++) {
+						// conj(G) * phasor
+						double zr = grow[2 * x] * er[x] + grow[2 * x + 1] * ei[x];
+						double zi = grow[2 * x] * ei[x] - grow[2 * x + 1] * er[x];
+						r0r += wx[x] * zr;
+						r0i += wx[x] * zi;
+						rxr += kwx[x] * zr;
+						rxi += kwx[x] * zi;
+					}
+					double yr = eyr[j * (kc + 1) + ka];
+					double yi = k < 0 ? -eyi[j * (kc + 1) + ka] : eyi[j * (kc + 1) + ka];
+					double ti = r0r * yi + r0i * yr;
+					s0r[j] += r0r * yr - r0i * yi;
+					sxi[j] += rxr * yi + rxi * yr;
+					syi[j] += k * ti;
+				}
+			}
+
+			// d/du of exp(-2 pi i k u/n) is -2 pi i k/n, then chain through v*xf back to the model frame
+			for (size_t j = 0; j < m; j++) {
+				double a = points[4 * (b + j) + 3] * grid.amp;
+				double gx = dphase * a * sxi[j] / apix;
+				double gy = dphase * a * syi[j] / apix;
+				for (int c = 0; c < 3; c++)
+					acc[4 * j + c] += xf[c][0] * gx + xf[c][1] * gy;
+				acc[4 * j + 3] += grid.amp * s0r[j];
+			}
+		}
+
+		for (size_t j = 0; j < 4 * m; j++)
+			ret[4 * b + j] = (float)acc[j];
+	});
+
+	return ret;
+}
+
 void PointArray::replace_by_summation(EMData *proj, int ind, Vec3f vec, float amp, float apix, float res)
 {
 	double gauss_real_width = res / (M_PI);	// in Angstrom, res is in Angstrom
@@ -47,6 +47,36 @@ extern "C"
 
 namespace EMAN
 {
+	/** GaussianTable tabulates the 1-D Gaussian exp(-(d*apix/width)^2)/norm
+	 * used by the PointArray summation projectors, in steps of 1/1000 pixel
+	 * out to where it falls below 1e-7. A table depends only on width, apix
+	 * and norm, so build it once and reuse it across calls and threads.
+	 */
+	class GaussianTable
+	{
+		public:
+		/** @param width Gaussian 1/e half width in Angstroms
+		 * @param apix Angstroms per pixel
+		 * @param norm each value is divided by this */
+		GaussianTable(double width, double apix, double norm = 1.0);
+
+		/** @return the value at a distance of d pixels, 0 beyond the table */
+		inline double operator()(double d) const {
+			size_t i = size_t(fabs(d) * 1000.0);
+			return i < table.size() ? table[i] : 0.0;
+		}
+
+		/** @return the half size in pixels of the box a point is splatted into */
+		int get_half_box() const { return gbox; }
+
+		bool matches(double w, double a, double nm) const { return w == width && a == apix && nm == norm; }
+
+		private:
+		vector<double> table;
+		double width, apix, norm;
+		int gbox;
+	};
+
 	/** PointArray defines a double array of points with values in a 3D space. */
 	class PointArray
 	{
@@ -127,6 +157,26 @@ namespace EMAN
 		EMData *pdb2mrc_by_summation(int map_size, float apix, float res, int addpdbbfactor);	// return real space 3-D map
 		EMData *projection_by_nfft(int image_size, float apix, float res = 0);	// return 2-D Fourier Transform
 		EMData *projection_by_summation(int image_size, float apix, float res);	// return 2-D real space image
+
+		/** Project the points along each of a set of orientations, as
+		 * projection_by_summation() would after transform(xforms[i]).
+		 * The projections are computed in parallel and share one Gaussian table.
+		 * @return one new 2-D real space image per orientation */
+		vector<EMData *> projections_by_summation(const vector<Transform> & xforms, int image_size, float apix, float res);
+
+		/** Project the points along each of a set of orientations directly in
+		 * Fourier space. Each point is treated as a Gaussian of the same width
+		 * projection_by_summation() uses, so do_ift() of each result matches
+		 * projections_by_summation() up to the truncation of its real space table.
+		 * @return one new 2-D complex (ri, fft padded) image per orientation */
+		vector<EMData *> projections_by_fourier(const vector<Transform> & xforms, int image_size, float apix, float res);
+
+		/** Gradient for optimizing the points against projections_by_fourier().
+		 * grads[i] holds dL/dF for orientation i, with dL = Re sum conj(grads) dF
+		 * taken over the full (Hermitian) Fourier plane, so passing F-target
+		 * yields the gradient of 0.5*|F-target|^2.
+		 * @return dL/dx, dL/dy, dL/dz (per Angstrom) and dL/damplitude for each point */
+		vector<float> projections_by_fourier_gradient(const vector<Transform> & xforms, const vector<EMData *> & grads, float apix, float res);
 		void replace_by_summation(EMData *image, int i, Vec3f vec, float amp, float apix, float res); // changes a single Gaussian from the projection
 
 		/** Optimizes a pointarray based on a set of projection images (EMData objects)
@@ -145,6 +195,13 @@ namespace EMAN
 
 		/** Computes overall potential for the configuration **/
 		double sim_potential();
+
+		/** Computes the potential and its analytic gradient for every point in one
+		 * parallel pass. Map gradients are interpolated from cached central
+		 * difference volumes, so this replaces per-point finite differences.
+		 * @param grad filled with dPotential/dxyz for each point
+		 * @return the sum of sim_potentiald() over all points **/
+		double sim_potential_gradient(vector<Vec3f> & grad);
 		
 		/** Compute a single point potential value **/
 		double sim_potentiald(int ind);
@@ -218,6 +275,9 @@ namespace EMAN
 		Transform calc_transform(PointArray *p);
 		
 		private:
+		/** Computes gradx/grady/gradz from map if they are missing or map has changed since **/
+		void sim_update_gradient_maps();
+
 		double *points;
 		size_t n;
 		double *bfactor;
@@ -245,6 +305,7 @@ namespace EMAN
 		bool map2d; // map is 2d
 		EMData *map;
 		EMData *gradx, *grady, *gradz;
+		int gradchange;	// map->get_changecount() when gradx/grady/gradz were computed
 		vector<Vec3f> oldshifts;
 		int centx, centy, centz;
 	};
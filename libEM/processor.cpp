@@ -43,6 +43,7 @@
 #include "symmetry.h"
 #include "averager.h"
 #include "util.h"
+#include "volumesummary.h"
 
 #include <gsl/gsl_randist.h>
 #include <gsl/gsl_statistics.h>
@@ -4987,27 +4988,23 @@ float NormalizeCircleMeanProcessor::calc_mean(EMData * image) const
 	float width = params.set_default("width",2.0f);
 	if (radius<0) radius=ny/2+radius;
 
-	static bool busy = false;		// reduce problems with threads and different image sizes
-	static EMData *mask = 0;
-	static int oldradius=radius;
-	static int oldwidth=width;
+	// one cached mask per thread, so threads with different image sizes don't collide
+	static thread_local EMData mask;
+	static thread_local float oldradius = 0;
+	static thread_local float oldwidth = 0;
 
-	if (!mask || !EMUtil::is_same_size(image, mask)||radius!=oldradius||width!=oldwidth) {
-		while (busy) ;
-		busy=true;
-		if (!mask) {
-			mask = new EMData();
-		}
-		mask->set_size(nx, ny, nz);
-		mask->to_one();
+	if (!EMUtil::is_same_size(image, &mask)||radius!=oldradius||width!=oldwidth) {
+		oldradius=radius;
+		oldwidth=width;
+		mask.set_size(nx, ny, nz);
+		mask.to_one();
 
-		mask->process_inplace("mask.sharp", Dict("inner_radius", radius,
+		mask.process_inplace("mask.sharp", Dict("inner_radius", radius,
 							 "outer_radius", radius + width));
 
 	}
-	busy=true;
 	double n = 0,s=0;
-	float *d = mask->get_data();
+	float *d = mask.get_data();
 	float * data = image->get_data();
 	size_t size = (size_t)nx*ny*nz;
 	for (size_t i = 0; i < size; ++i) {
@@ -5016,7 +5013,6 @@ float NormalizeCircleMeanProcessor::calc_mean(EMData * image) const
 
 	float result = (float)(s/n);
 //	printf("cmean=%f\n",result);
-	busy=false;
 
 	return result;
 }
@@ -8838,24 +8834,51 @@ void AutoMask3D2Processor::process_inplace(EMData * image)
 
 
 	// iteratively 'flood fills' the map... recursion would be better
+	// Only bricks of the VolumeSummary with voxels above threshold can grow, and after
+	// the first pass a brick is rescanned only if it or a neighbor changed in the last one
+	const VolumeSummary *summary = image->get_volume_summary();
+	IntSize bs = summary->get_level_size(0);
+	int bsize = summary->get_brick_size();
+	size_t nbrick = (size_t)bs[0]*bs[1]*bs[2];
+	vector<char> live(nbrick,0);
+	vector<int> above = summary->get_bricks_above(threshold);
+	for (vector<int>::iterator b=above.begin(); b!=above.end(); ++b) live[*b]=1;
+	vector<char> active(live), next(nbrick);
+
 	int done=0;
 	int iter=0;
 	while (!done) {
 		iter++;
 		done=1;
 		if (verbose && iter%10==0) printf("%d iterations\n",iter);
-		for (k=1; k<nz-1; ++k) {
-			for (j=1; j<ny-1; ++j) {
-				for (i=1; i<nx-1; ++i) {
-					l=i+j*nx+k*nx*ny;
-					if (dat2[l]) continue;
-					if (dat[l]>threshold && (dat2[l-1]||dat2[l+1]||dat2[l+nx]||dat2[l-nx]||dat2[l-nxy]||dat2[l+nxy])) {
-						dat2[l]=1.0;
-						done=0;
+		std::fill(next.begin(),next.end(),0);
+		for (size_t b=0; b<nbrick; b++) {
+			if (!active[b]) continue;
+			int bx=b%bs[0], by=b/bs[0]%bs[1], bz=b/bs[0]/bs[1];
+			int changed=0;
+			for (k=std::max(bz*bsize,1); k<std::min((bz+1)*bsize,nz-1); ++k) {
+				for (j=std::max(by*bsize,1); j<std::min((by+1)*bsize,ny-1); ++j) {
+					for (i=std::max(bx*bsize,1); i<std::min((bx+1)*bsize,nx-1); ++i) {
+						l=i+j*nx+(size_t)k*nxy;
+						if (dat2[l]) continue;
+						if (dat[l]>threshold && (dat2[l-1]||dat2[l+1]||dat2[l+nx]||dat2[l-nx]||dat2[l-nxy]||dat2[l+nxy])) {
+							dat2[l]=1.0;
+							changed=1;
+						}
 					}
 				}
 			}
+			if (!changed) continue;
+			done=0;
+			next[b]=live[b];
+			if (bx>0) next[b-1]=live[b-1];
+			if (bx<bs[0]-1) next[b+1]=live[b+1];
+			if (by>0) next[b-bs[0]]=live[b-bs[0]];
+			if (by<bs[1]-1) next[b+bs[0]]=live[b+bs[0]];
+			if (bz>0) next[b-(size_t)bs[0]*bs[1]]=live[b-(size_t)bs[0]*bs[1]];
+			if (bz<bs[2]-1) next[b+(size_t)bs[0]*bs[1]]=live[b+(size_t)bs[0]*bs[1]];
 		}
+		active.swap(next);
 	}
 
 	amask->update();
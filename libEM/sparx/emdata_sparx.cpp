@@ -33,6 +33,7 @@
 #include <stack>
 #include "ctf.h"
 #include "emdata.h"
+#include "emthreads.h"
 #include <iostream>
 #include <cmath>
 #include <cstring>
@@ -756,6 +757,7 @@ EMData* EMData::mult_radial(EMData* radial) {
 #define square(x) ((x)*(x))
 vector<float> EMData::cog() {
 
+	get_data();	// make sure rdata is current
 	vector<float> cntog;
 	int ndim = get_ndim();
 	int i=1,j=1,k=1;
@@ -1215,6 +1217,84 @@ EMData* EMData::average_circ_sub() const
 //  Helper functions for method nn
 
 
+namespace {
+	/* One nearest neighbour update of a Fourier volume and its weights */
+	struct NnUpdate
+	{
+		std::complex<float>* c;
+		float* w;
+		std::complex<float> v;
+		float wv;
+	};
+
+	/* Insert the lines [0,nline) of a Fourier slice; line(l, emit) calls
+	   emit(iza, update) for every voxel line l contributes to, in order.
+	   With several threads the lines are split into contiguous ranges and each
+	   thread bins the updates of its lines by the z slab of the volume (iza in
+	   1..nz) they fall in; each thread then applies the bins of one slab in line
+	   order. No voxel is written by two threads and every voxel receives its
+	   contributions in the serial order, so the volume is bitwise identical to
+	   serial insertion, without locks or per-thread volumes. */
+	template<class F>
+	void nn_insert_lines(int nline, int nz, F line)
+	{
+		const int grain = 8;
+		int nchunk = EMThreads::get_num_chunks(nline, grain);
+		if (nchunk == 1) {
+			auto apply = [](int, const NnUpdate& u) { *u.c += u.v; *u.w += u.wv; };
+			for (int l = 0; l < nline; l++) line(l, apply);
+			return;
+		}
+
+		vector< vector< vector<NnUpdate> > > bins(nchunk, vector< vector<NnUpdate> >(nchunk));
+		EMThreads::parallel_for(nline, [&](size_t b, size_t e, int chunk) {
+			vector< vector<NnUpdate> >& mybins = bins[chunk];
+			auto bin = [&](int iza, const NnUpdate& u) {
+				int slab = (int)((long)(iza-1)*nchunk/nz);
+				mybins[std::min(std::max(slab, 0), nchunk-1)].push_back(u);
+			};
+			for (size_t l = b; l < e; l++) line((int)l, bin);
+		}, grain);
+
+		EMThreads::parallel_for(nchunk, [&](size_t b, size_t e, int) {
+			for (size_t slab = b; slab < e; slab++) {
+				for (int c = 0; c < nchunk; c++) {
+					for (const NnUpdate& u : bins[c][slab]) { *u.c += u.v; *u.w += u.wv; }
+				}
+			}
+		});
+	}
+
+	/* Nearest neighbour target of pixel (i,j) of the padded Fourier slice bi
+	   (offsets 0,1; jp is the row of j) in an n^3 Fourier volume with offsets
+	   0,1,1. The value is conjugated when the point is reflected into the
+	   stored x >= 0 half. Same mapping as EMData::onelinenn. */
+	inline void nn_target(int i, int j, int jp, int n, const Transform& tf, EMData* bi,
+	                      int& ixn, int& iya, int& iza, std::complex<float>& btq)
+	{
+		float xnew = i*tf[0][0] + j*tf[1][0];
+		float ynew = i*tf[0][1] + j*tf[1][1];
+		float znew = i*tf[0][2] + j*tf[1][2];
+		if (xnew < 0.) {
+			xnew = -xnew;
+			ynew = -ynew;
+			znew = -znew;
+			btq = conj(bi->cmplx(i,jp));
+		} else {
+			btq = bi->cmplx(i,jp);
+		}
+		ixn = int(xnew + 0.5 + n) - n;
+		int iyn = int(ynew + 0.5 + n) - n;
+		int izn = int(znew + 0.5 + n) - n;
+
+		if (izn >= 0)  iza = izn + 1;
+		else	       iza = n + izn + 1;
+
+		if (iyn >= 0) iya = iyn + 1;
+		else	      iya = n + iyn + 1;
+	}
+}
+
 void EMData::onelinenn(int j, int n, int n2, EMData* wptr, EMData* bi, const Transform& tf)
 {
         //std::cout<<"   onelinenn  "<<j<<"  "<<n<<"  "<<n2<<"  "<<std::endl;
@@ -1360,11 +1440,23 @@ void EMData::nn(EMData* wptr, EMData* myfft, const Transform& tf, float mult)
 	//for(int i = 0; i <= 2; i++){{for(int l = 0; l <= 2; l++) std::cout<<"  "<<tf[l][i];}std::cout<<std::endl;};std::cout<<std::endl;
 	//Dict tt = tf.get_rotation("spider");
 	//std::cout << static_cast<float>(tt["phi"]) << " " << static_cast<float>(tt["theta"]) << " " << static_cast<float>(tt["psi"]) << std::endl;
-	if( mult == 1 ) {
-		for (int iy = -ny/2 + 1; iy <= ny/2; iy++) onelinenn(iy, ny, nxc, wptr, myfft, tf);
-	} else {
-		for (int iy = -ny/2 + 1; iy <= ny/2; iy++) onelinenn_mult(iy, ny, nxc, wptr, myfft, tf, mult);
-	}
+	// lines iy = -ny/2+1 .. ny/2, inserted in parallel (see nn_insert_lines)
+	get_data();
+	wptr->get_data();
+	myfft->get_data();
+	const int n = ny, nnd4 = n*n/4;
+	nn_insert_lines(ny, nz, [&](int l, const auto& emit) {
+		int j = l - ny/2 + 1;
+		int jp = (j >= 0) ? j+1 : n+j+1;
+		for (int i = 0; i <= nxc; i++) {
+			if (((i*i+j*j) < nnd4) && !((0 == i) && (j < 0))) {
+				int ixn, iya, iza;
+				std::complex<float> btq;
+				nn_target(i, j, jp, n, tf, myfft, ixn, iya, iza, btq);
+				emit(iza, NnUpdate{&cmplx(ixn,iya,iza), &(*wptr)(ixn,iya,iza), btq * mult, mult});
+			}
+		}
+	});
 
 	set_array_offsets(saved_offsets);
 	myfft->set_array_offsets(myfft_saved_offsets);
@@ -1382,8 +1474,6 @@ void EMData::insert_rect_slice(EMData* w, EMData* myfft, const Transform& trans,
 	
 	// insert rectangular fft from my nn4_rect code
 
-	Vec2f coordinate_2d_square;
-	Vec3f coordinate_3dnew;
 	Vec3f axis_newx;
 	Vec3f axis_newy;
 	Vec3f tempv;
@@ -1411,13 +1501,19 @@ void EMData::insert_rect_slice(EMData* w, EMData* myfft, const Transform& trans,
 	float ellipse_step_y = 0.5f*(sizeofprojection*npad)/float(ellipse_length_y_int);
 	float yscale = ellipse_step_y;
 	//end of scaling factor calculation
-	std::complex<float> c1;
 	int nxyz = sizeofprojection*npad;
 
 	float r2=0.25f*sizeofprojection*npad*sizeofprojection*npad;
-	float r2_at_point;
 	
-	for(int i=0;i<ellipse_length_x_int;i++) {
+	// rows of constant i are inserted in parallel (see nn_insert_lines)
+	get_data();
+	w->get_data();
+	myfft->get_data();
+	nn_insert_lines(ellipse_length_x_int, nz, [&](int i, const auto& emit) {
+		Vec2f coordinate_2d_square;
+		Vec3f coordinate_3dnew;
+		std::complex<float> c1;
+		float r2_at_point;
 		for(int j=-1*ellipse_length_y_int+1; j<=ellipse_length_y_int; j++) {
         	    
 			r2_at_point=i*xscale*i*xscale+j*yscale*j*yscale;
@@ -1481,13 +1577,11 @@ void EMData::insert_rect_slice(EMData* w, EMData* myfft, const Transform& trans,
 				if (iyn >= 0) iya = iyn + 1;
 				else	      iya = ny + iyn + 1;
 
-				cmplx(ixn,iya,iza) += btq * mult;
-				(*w)(ixn,iya,iza) += mult;
+				emit(iza, NnUpdate{&cmplx(ixn,iya,iza), &(*w)(ixn,iya,iza), btq * mult, mult});
 					
 				}
 			}
-        		    
-		}
+	});
 
 
 	//end insert rectanular fft
@@ -2296,8 +2390,25 @@ void EMData::nn_ctf(EMData* w, EMData* myfft, const Transform& tf, float mult) {
     ctf_store::init( ny, ctf );
     if(ctf) {delete ctf; ctf=0;}
 
-	// loop over frequencies in y
-	for (int iy = -ny/2 + 1; iy <= ny/2; iy++) onelinenn_ctf(iy, ny, nxc, w, myfft, tf, mult);
+	// loop over frequencies in y, in parallel (see nn_insert_lines)
+	get_data();
+	w->get_data();
+	myfft->get_data();
+	const int n = ny, nnd4 = n*n/4;
+	nn_insert_lines(ny, nz, [&](int l, const auto& emit) {
+		int j = l - ny/2 + 1;
+		int jp = (j >= 0) ? j+1 : n+j+1;
+		for (int i = 0; i <= nxc; i++) {
+			int r2 = i*i+j*j;
+			if ( (r2<nnd4) && !((0==i) && (j<0)) ) {
+				float ctf = ctf_store::get_ctf( r2, i, j ); //This is in 2D projection plane
+				int ixn, iya, iza;
+				std::complex<float> btq;
+				nn_target(i, j, jp, n, tf, myfft, ixn, iya, iza, btq);
+				emit(iza, NnUpdate{&cmplx(ixn,iya,iza), &(*w)(ixn,iya,iza), btq*ctf*mult, ctf*ctf*mult});
+			}
+		}
+	});
 	set_array_offsets(saved_offsets);
 	myfft->set_array_offsets(myfft_saved_offsets);
 	EXITFUNC;
@@ -2358,8 +2469,25 @@ void EMData::nn_ctf_exists(EMData* w, EMData* myfft, EMData* ctf2d2, const Trans
 	vector<int> ctf2d2_saved_offsets = ctf2d2->get_array_offsets();
 	ctf2d2->set_array_offsets(0,1);
 
-	// loop over frequencies in y
-	for (int iy = -ny/2 + 1; iy <= ny/2; iy++) onelinenn_ctf_exists(iy, ny, nxc, w, myfft, ctf2d2, tf, weight);
+	// loop over frequencies in y, in parallel (see nn_insert_lines)
+	get_data();
+	w->get_data();
+	myfft->get_data();
+	ctf2d2->get_data();
+	const int n = ny, nnd4 = n*n/4;
+	nn_insert_lines(ny, nz, [&](int l, const auto& emit) {
+		int j = l - ny/2 + 1;
+		int jp = (j >= 0) ? j+1 : n+j+1;
+		for (int i = 0; i <= nxc; i++) {
+			if ( (i*i + j*j < nnd4) && !((0 == i) && (j < 0)) ) {
+				int ixn, iya, iza;
+				std::complex<float> btq;
+				nn_target(i, j, jp, n, tf, myfft, ixn, iya, iza, btq);
+				float c2val = (*ctf2d2)(i,jp);
+				emit(iza, NnUpdate{&cmplx(ixn,iya,iza), &(*w)(ixn,iya,iza), btq * weight, c2val * weight});
+			}
+		}
+	});
 	set_array_offsets(saved_offsets);
 	myfft->set_array_offsets(myfft_saved_offsets);
 	ctf2d2->set_array_offsets(ctf2d2_saved_offsets);
@@ -7492,6 +7620,7 @@ vector<float> EMData::peak_search(int ml, float invert) {
 #define Z(k) Z[k-1]
 vector<float> EMData::phase_cog()
 {
+	get_data();	// make sure rdata is current
 	vector<float> ph_cntog;
 	int i=1,j=1,k=1;
 	float C=0.f,S=0.f,P=0.f,F1=0.f,SNX;
@@ -7647,6 +7776,7 @@ float EMData::find_3d_threshold(float mass, float pixel_size)
 	float thr2 = (thr1-thr3)/2 + thr3;
 	size_t size = (size_t)nx*ny*nz;
 	float x0 = thr1,x3 = thr3,x1,x2,THR=0;
+	get_data();	// make sure rdata is current
 
 		int ILE = std::min(nx*ny*nx,std::max(1,vol_voxels));
 
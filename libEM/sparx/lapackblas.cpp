@@ -29,11 +29,98 @@
  *
  */
 
+#include <atomic>
+#include <cstddef>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 
 #include "lapackblas.h"
 
+/* When EMAN_EXTERNAL_BLAS is defined (cmake -DENABLE_EXTERNAL_BLAS=ON and an
+   optimized BLAS/LAPACK was found), the level 1-3 BLAS kernels and the
+   eigen/SVD drivers that dominate the sparx PCA, Lanczos and coveig paths are
+   forwarded to the library.  The routines in this file have C++ linkage, so
+   the Fortran symbols below do not collide with them and the bundled code
+   remains available as a fallback; setting EMAN_BLAS=bundled in the
+   environment, or calling lapackblas_use_external(false), selects it at run
+   time.  Only LP64 libraries (32-bit integer) are supported. */
+#ifdef EMAN_EXTERNAL_BLAS
+namespace lapackblas_ext {
+extern "C" {
+	void saxpy_(const integer *n, const real *sa, const real *sx,
+		const integer *incx, real *sy, const integer *incy);
+	void scopy_(const integer *n, const real *sx, const integer *incx,
+		real *sy, const integer *incy);
+	void sscal_(const integer *n, const real *sa, real *sx, const integer *incx);
+	void sgemm_(const char *transa, const char *transb, const integer *m,
+		const integer *n, const integer *k, const real *alpha, const real *a,
+		const integer *lda, const real *b, const integer *ldb,
+		const real *beta, real *c, const integer *ldc,
+		size_t ltransa, size_t ltransb);
+	void sgemv_(const char *trans, const integer *m, const integer *n,
+		const real *alpha, const real *a, const integer *lda, const real *x,
+		const integer *incx, const real *beta, real *y, const integer *incy,
+		size_t ltrans);
+	void sger_(const integer *m, const integer *n, const real *alpha,
+		const real *x, const integer *incx, const real *y,
+		const integer *incy, real *a, const integer *lda);
+	void ssyev_(const char *jobz, const char *uplo, const integer *n, real *a,
+		const integer *lda, real *w, real *work, const integer *lwork,
+		integer *info, size_t ljobz, size_t luplo);
+	void sstevd_(const char *jobz, const integer *n, real *d, real *e, real *z,
+		const integer *ldz, real *work, const integer *lwork, integer *iwork,
+		const integer *liwork, integer *info, size_t ljobz);
+	void sgesvd_(const char *jobu, const char *jobvt, const integer *m,
+		const integer *n, real *a, const integer *lda, real *s, real *u,
+		const integer *ldu, real *vt, const integer *ldvt, real *work,
+		const integer *lwork, integer *info, size_t ljobu, size_t ljobvt);
+}
+}
+#endif
+
+namespace {
+	int lapackblas_default_external()
+	{
+#ifdef EMAN_EXTERNAL_BLAS
+		const char *env = getenv("EMAN_BLAS");
+		return (env && strcmp(env, "bundled") == 0) ? 0 : 1;
+#else
+		return 0;
+#endif
+	}
+
+	std::atomic<int> lapackblas_external(lapackblas_default_external());
+}
+
+bool lapackblas_external_available()
+{
+#ifdef EMAN_EXTERNAL_BLAS
+	return true;
+#else
+	return false;
+#endif
+}
+
+bool lapackblas_use_external(bool use)
+{
+	bool old = lapackblas_external.load() != 0;
+	lapackblas_external.store(use && lapackblas_external_available() ? 1 : 0);
+	return old;
+}
+
+bool lapackblas_using_external()
+{
+	return lapackblas_external.load(std::memory_order_relaxed) != 0;
+}
+
+#ifdef EMAN_EXTERNAL_BLAS
+#define LAPACKBLAS_ROUTE(call) \
+	if (lapackblas_using_external()) { lapackblas_ext::call; return 0; }
+#else
+#define LAPACKBLAS_ROUTE(call)
+#endif
+
 int s_cat(char *lp, const char **rpp, integer *rnp, integer *np, ftnlen ll)
 //VOID s_cat(char *lp, char *rpp[], ftnlen rnp[], ftnlen *np, ftnlen ll)
 {
@@ -994,6 +1081,7 @@ return( *b >= 0 ? x : -x);
 /* Subroutine */ int saxpy_(integer *n, real *sa, real *sx, integer *incx, 
 	real *sy, integer *incy)
 {
+    LAPACKBLAS_ROUTE(saxpy_(n, sa, sx, incx, sy, incy))
     /* System generated locals */
     integer i__1;
     /* Local variables */
@@ -1163,6 +1251,7 @@ void s_copy(char *a, const char *b, ftnlen la, ftnlen lb)
 /* Subroutine */ int scopy_(integer *n, real *sx, integer *incx, real *sy, 
 	integer *incy)
 {
+    LAPACKBLAS_ROUTE(scopy_(n, sx, incx, sy, incy))
     /* System generated locals */
     integer i__1;
     /* Local variables */
@@ -1313,6 +1402,7 @@ L60:
 	n, integer *k, real *alpha, real *a, integer *lda, real *b, integer *
 	ldb, real *beta, real *c__, integer *ldc)
 {
+    LAPACKBLAS_ROUTE(sgemm_(transa, transb, m, n, k, alpha, a, lda, b, ldb, beta, c__, ldc, 1, 1))
     /* System generated locals */
     integer a_dim1, a_offset, b_dim1, b_offset, c_dim1, c_offset, i__1, i__2, 
 	    i__3;
@@ -1625,6 +1715,7 @@ L60:
 	real *a, integer *lda, real *x, integer *incx, real *beta, real *y, 
 	integer *incy)
 {
+    LAPACKBLAS_ROUTE(sgemv_(trans, m, n, alpha, a, lda, x, incx, beta, y, incy, 1))
     /* System generated locals */
     integer a_dim1, a_offset, i__1, i__2;
     /* Local variables */
@@ -1870,6 +1961,7 @@ L60:
 /* Subroutine */ int sger_(integer *m, integer *n, real *alpha, real *x, 
 	integer *incx, real *y, integer *incy, real *a, integer *lda)
 {
+    LAPACKBLAS_ROUTE(sger_(m, n, alpha, x, incx, y, incy, a, lda))
     /* System generated locals */
     integer a_dim1, a_offset, i__1, i__2;
     /* Local variables */
@@ -7696,6 +7788,7 @@ doublereal snrm2_(integer *n, real *x, integer *incx)
 
 /* Subroutine */ int sscal_(integer *n, real *sa, real *sx, integer *incx)
 {
+    LAPACKBLAS_ROUTE(sscal_(n, sa, sx, incx))
     /* System generated locals */
     integer i__1, i__2;
     /* Local variables */
@@ -8869,6 +8962,7 @@ L40:
 /* Subroutine */ int ssyev_(char *jobz, char *uplo, integer *n, real *a, 
 	integer *lda, real *w, real *work, integer *lwork, integer *info)
 {
+    LAPACKBLAS_ROUTE(ssyev_(jobz, uplo, n, a, lda, w, work, lwork, info, 1, 1))
 /*  -- LAPACK driver routine (version 3.0) --   
        Univ. of Tennessee, Univ. of California Berkeley, NAG Ltd.,   
        Courant Institute, Argonne National Lab, and Rice University   
@@ -11684,6 +11778,7 @@ L20:
 	*z__, integer *ldz, real *work, integer *lwork, integer *iwork, 
 	integer *liwork, integer *info)
 {
+    LAPACKBLAS_ROUTE(sstevd_(jobz, n, d__, e, z__, ldz, work, lwork, iwork, liwork, info, 1))
 /*  -- LAPACK driver routine (version 3.0) --   
        Univ. of Tennessee, Univ. of California Berkeley, NAG Ltd.,   
        Courant Institute, Argonne National Lab, and Rice University   
@@ -16379,6 +16474,7 @@ static real c_b438 = 1.f;
 	real *a, integer *lda, real *s, real *u, integer *ldu, real *vt, 
 	integer *ldvt, real *work, integer *lwork, integer *info)
 {
+    LAPACKBLAS_ROUTE(sgesvd_(jobu, jobvt, m, n, a, lda, s, u, ldu, vt, ldvt, work, lwork, info, 1, 1))
     /* System generated locals */
     typedef const char *address;
 
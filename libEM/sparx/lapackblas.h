@@ -58,6 +58,13 @@ void s_copy(char *a, const char *b, ftnlen la, ftnlen lb);
 double pow_ri(real *ap, integer *bp);
 double r_sign(real *a, real *b);
 
+/* Optimized BLAS/LAPACK backend (see lapackblas.cpp).  available() is true
+   when the library was built with ENABLE_EXTERNAL_BLAS; use_external() returns
+   the previous setting. */
+bool lapackblas_external_available();
+bool lapackblas_use_external(bool use);
+bool lapackblas_using_external();
+
 integer ieeeck_(integer *ispec, real *zero, real *one);
 
 integer ilaenv_(integer *ispec, const char *name__, const char *opts, integer *n1, 
@@ -2,6 +2,8 @@
 #include <cstring>
 #include <cmath>
 #include <cstdlib>
+#include "lbfgsb.h"
+#include "emthreads.h"
 
 #define TRUE_ (1)
 #define FALSE_ (0)
@@ -389,7 +391,7 @@ long int csave_len;*/
     long int s_cmp(char *, const char *const, long int, long int);
 
     /* Local variables */
-    static long int lsnd, lsgo, lygo, l1, l2, l3, ld, lr, lt;
+    static thread_local long int lsnd, lsgo, lygo, l1, l2, l3, ld, lr, lt;
     extern /* Subroutine */ int mainlb_(long int *n, long int *m, double *x, double *l, double *u, long int *nbd, double *f, 
 			 double *g, double *factr, double *pgtol, double *ws, double *wy,
 			 double *sy, double *ss, double *yy, double *wt, double *wn, double *snd, 
@@ -397,7 +399,7 @@ long int csave_len;*/
 			 double *sgo, double *yg, double *ygo, long int *index, long int *iwhere, long int *indx2, 
 			 char *task, long int *iprint, char *csave, long int *lsave, long int *isave, double *dsave, 
 			 long int task_len, long int csave_len);
-    static long int lz, lwa, lsg, lyg, lwn, lss, lws, lwt, lsy, lwy, lyy;
+    static thread_local long int lz, lwa, lsg, lyg, lwn, lss, lws, lwt, lsy, lwy, lyy;
 
 /*     ************ */
 
@@ -701,37 +703,37 @@ actorization in formt;\002,/,\002   refresh the lbfgs memory and restart the\
     //long int f_open(olist *), s_wsfe(cilist *), do_fio(long int*, char*, long int), e_wsfe();
 
     /* Local variables */
-    static long int head;
-    static double fold;
-    static long int nact;
-    static double ddum;
+    static thread_local long int head;
+    static thread_local double fold;
+    static thread_local long int nact;
+    static thread_local double ddum;
     extern double ddot_(long int *n, double *dx, long int *incx, double *dy, long int *incy);
-    static long int info;
-    static double time;
-    static long int nfgv, ifun, iter, nint;
-    static char word[3];
-    static double time1, time2;
-    static long int i__, iback, k;
+    static thread_local long int info;
+    static thread_local double time;
+    static thread_local long int nfgv, ifun, iter, nint;
+    static thread_local char word[3];
+    static thread_local double time1, time2;
+    static thread_local long int i__, iback, k;
     extern /* Subroutine */ int dscal_(long int *n, double *da, double *dx, long int *incx);
-    static double gdold;
-    static long int nfree;
-    static long int boxed;
-    static long int itail;
-    static double theta;
+    static thread_local double gdold;
+    static thread_local long int nfree;
+    static thread_local long int boxed;
+    static thread_local long int itail;
+    static thread_local double theta;
     extern /* Subroutine */ int freev_(long int *n, long int *nfree, long int *index, long int *nenter, long int *ileave, long int *indx2, long int *iwhere, 
 	    		         long int *wrk, long int *updatd, long int *cnstnd, long int *iprint, long int *iter),
 				 dcopy_(long int *n, double *dx, long int *incx, double *dy, long int *incy);
-    static double dnorm;
+    static thread_local double dnorm;
     extern /* Subroutine */ int timer_(double *ttime), 
     			  formk_(long int *n, long int *nsub, long int *ind, long int *nenter, long int *ileave, long int *indx2, long int *iupdat, 
 			         long int *updatd, double *wn, double *wn1, long int *m, double *ws, double *wy, double *sy, 
 			 	 double *theta, long int *col, long int *head, long int *info);
-    static long int nskip, iword;
+    static thread_local long int nskip, iword;
     extern /* Subroutine */ int formt_(long int *m, double *wt, double *sy, double *ss, long int *col, double *theta, long int *info), 
     			   subsm_(long int *n, long int *m, long int *nsub, long int *ind, double *l, double *u, long int *nbd,
 			          double *x, double *d__, double *ws, double *wy, double *theta, long int *col,
 				  long int *head, long int *iword, double *wv, double *wn, long int *iprint, long int *info);
-    static double xstep, stpmx;
+    static thread_local double xstep, stpmx;
     extern /* Subroutine */ int prn1lb_(long int*, long int*, double*, double*, double*, long int*, long int*, double*),
     			   prn2lb_(long int *n, double *x, double *f, double *g, long int *iprint, long int *itfile,
 			 long int *iter, long int *nfgv, long int *nact, double *sbgnrm, long int *nint, char *word,
@@ -741,23 +743,23 @@ actorization in formt;\002,/,\002   refresh the lbfgs memory and restart the\
 			 double *sbgnrm, double *time, long int *nint, char *word, long int *iback, double *stp,
 			 double *xstep, long int *k, double *cachyt, double *sbtime, double *lnscht,
 			 long int task_len, long int word_len);
-    static double gd, dr, rr;
-    static long int ileave;
+    static thread_local double gd, dr, rr;
+    static thread_local long int ileave;
     extern /* Subroutine */ int errclb_(long int *n, long int *m, double *factr, double *l, double *u, long int *nbd, char *task,
 			 long int *info, long int *k, long int task_len);
-    static long int itfile;
-    static double cachyt, epsmch;
-    static long int updatd;
-    static double sbtime;
+    static thread_local long int itfile;
+    static thread_local double cachyt, epsmch;
+    static thread_local long int updatd;
+    static thread_local double sbtime;
     extern /* Subroutine */ int active_(long int *n, double *l, double *u, long int *nbd, double *x, long int *iwhere, 
 			 long int *iprint, long int *prjctd, long int *cnstnd, long int *boxed);
-    static long int prjctd;
-    static long int iupdat;
+    static thread_local long int prjctd;
+    static thread_local long int iupdat;
     extern double dpmeps_();
-    static long int cnstnd;
-    static double sbgnrm;
-    static long int nenter;
-    static double lnscht;
+    static thread_local long int cnstnd;
+    static thread_local double sbgnrm;
+    static thread_local long int nenter;
+    static thread_local double lnscht;
     extern /* Subroutine */ int cauchy_(long int *n, double *x, double *l, double *u, long int *nbd, double *g, long int *iorder,
 			 long int *iwhere, double *t, double *d__, double *xcp, long int *m, double *wy, double *ws,
 			 double *sy, double *wt, double *theta, long int *col, long int *head, double *p, double *c__,
@@ -773,13 +775,13 @@ actorization in formt;\002,/,\002   refresh the lbfgs memory and restart the\
 			  matupd_(long int *n, long int *m, double *ws, double *wy, double *sy, double *ss,
 			 double *d__, double *r__, long int *itail, long int *iupdat, long int *col, long int *head,
 			 double *theta, double *rr, double *dr, double *stp, double *dtd);
-    static long int nintol;
+    static thread_local long int nintol;
     extern /* Subroutine */ int projgr_(long int *n, double *l, double *u, long int *nbd, double *x, double *g, double *sbgnrm);
-    static double dtd;
-    static long int col;
-    static double tol;
-    static long int wrk;
-    static double stp, cpu1, cpu2;
+    static thread_local double dtd;
+    static thread_local long int col;
+    static thread_local double tol;
+    static thread_local long int wrk;
+    static thread_local double stp, cpu1, cpu2;
 
     /* Fortran I/O blocks */
 /*    static cilist io___62 = { 0, 6, 0, fmt_1002, 0 };
@@ -1514,7 +1516,7 @@ y at the bounds\002)";*/
     //long int s_wsle(cilist *), do_lio(long int *, long int *, char *, long int), e_wsle(), s_wsfe(cilist *), do_fio(long int*, char*, long int), e_wsfe();
 
     /* Local variables */
-    static long int nbdd, i__;
+    static thread_local long int nbdd, i__;
 
     /* Fortran I/O blocks */
 /*    static cilist io___81 = { 0, 6, 0, 0, 0 };
@@ -1639,10 +1641,10 @@ long int *info;*/
     //double sqrt();
 
     /* Local variables */
-    static long int i__, k;
+    static thread_local long int i__, k;
     extern /* Subroutine */ int dtrsl_(double *t, long int *ldt, long int *n, double *b, long int *job, long int *info);
-    static long int i2;
-    static double sum;
+    static thread_local long int i2;
+    static thread_local double sum;
 
 /*     ************ */
 
@@ -1816,31 +1818,31 @@ oint \002,1p,2(1x,d11.4))";
 //    long int s_wsle(cilist *), do_lio(long int *, long int *, char *, long int), e_wsle(), s_wsfe(cilist *), e_wsfe(), do_fio(long int*, char*, long int);
 
     /* Local variables */
-    static double dibp;
+    static thread_local double dibp;
     extern double ddot_(long int *n, double *dx, long int *incx, double *dy, long int *incy);
-    static long int iter;
-    static double zibp, tsum, dibp2;
-    static long int i__, j;
-    static long int bnded;
+    static thread_local long int iter;
+    static thread_local double zibp, tsum, dibp2;
+    static thread_local long int i__, j;
+    static thread_local long int bnded;
     extern /* Subroutine */ int dscal_(long int *n, double *da, double *dx, long int *incx);
-    static double neggi;
-    static long int nfree;
-    static double bkmin;
-    static long int nleft;
+    static thread_local double neggi;
+    static thread_local long int nfree;
+    static thread_local double bkmin;
+    static thread_local long int nleft;
     extern /* Subroutine */ int dcopy_(long int *n, double *dx, long int *incx, double *dy, long int *incy),
     			  daxpy_(long int *n, double *da, double *dx, long int *incx, double *dy, long int *incy);
-    static double f1, f2, dt, tj, tl;
-    static long int nbreak, ibkmin;
-    static double tu;
+    static thread_local double f1, f2, dt, tj, tl;
+    static thread_local long int nbreak, ibkmin;
+    static thread_local double tu;
     extern /* Subroutine */ int hpsolb_(long int *n, double *t, long int *iorder, long int *iheap);
-    static long int pointr;
-    static double tj0;
-    static long int xlower, xupper;
-    static long int ibp;
-    static double dtm;
+    static thread_local long int pointr;
+    static thread_local double tj0;
+    static thread_local long int xlower, xupper;
+    static thread_local long int ibp;
+    static thread_local double dtm;
     extern /* Subroutine */ int bmv_(long int *m, double *sy, double *wt, long int *col, double *v, double *p, long int *info);
-    static double wmc, wmp, wmw;
-    static long int col2;
+    static thread_local double wmc, wmp, wmw;
+    static thread_local long int col2;
 
     /* Fortran I/O blocks */
 /*    static cilist io___88 = { 0, 6, 0, 0, 0 };
@@ -2410,9 +2412,9 @@ long int *info;*/
 	    wt_dim1, wt_offset, i__1, i__2;
 
     /* Local variables */
-    static long int i__, j, k;
-    static double a1, a2;
-    static long int pointr;
+    static thread_local long int i__, j, k;
+    static thread_local double a1, a2;
+    static thread_local long int pointr;
     extern /* Subroutine */ int bmv_(long int *m, double *sy, double *wt, long int *col, double *v, double *p, long int *info);
 
 /*     ************ */
@@ -2514,7 +2516,7 @@ long int task_len;*/
     /* Subroutine */ int s_copy(char *, const char *const, long int, long int);
 
     /* Local variables */
-    static long int i__;
+    static thread_local long int i__;
 
 /*     ************ */
 
@@ -2589,15 +2591,15 @@ long int *col, *head, *info;*/
 	    wy_dim1, wy_offset, sy_dim1, sy_offset, i__1, i__2, i__3;
 
     /* Local variables */
-    static long int dend, pend;
+    static thread_local long int dend, pend;
     extern double ddot_(long int *n, double *dx, long int *incx, double *dy, long int *incy);
-    static long int upcl;
-    static double temp1, temp2, temp3, temp4;
-    static long int i__, k;
+    static thread_local long int upcl;
+    static thread_local double temp1, temp2, temp3, temp4;
+    static thread_local long int i__, k;
     extern /* Subroutine */ int dpofa_(double *a, long int *lda, long int *n, long int *info), 
     			dcopy_(long int *n, double *dx, long int *incx, double *dy, long int *incy),
 			dtrsl_(double *t, long int *ldt, long int *n, double *b, long int *job, long int *info);
-    static long int ipntr, jpntr, k1, m2, dbegin, is, js, iy, jy, pbegin, is1, 
+    static thread_local long int ipntr, jpntr, k1, m2, dbegin, is, js, iy, jy, pbegin, is1, 
 	    js1, col2;
 
 /*     ************ */
@@ -2978,10 +2980,10 @@ long int *info;*/
 	    i__2, i__3;
 
     /* Local variables */
-    static double ddum;
-    static long int i__, j, k;
+    static thread_local double ddum;
+    static thread_local long int i__, j, k;
     extern /* Subroutine */ int dpofa_(double *a, long int *lda, long int *n, long int *info);
-    static long int k1;
+    static thread_local long int k1;
 
 /*     ************ */
 
@@ -3067,7 +3069,7 @@ long int *iprint, *iter;*/
 //    long int s_wsle(cilist *), do_lio(long int *, long int *, char *, long int), e_wsle();
 
     /* Local variables */
-    static long int iact, i__, k;
+    static thread_local long int iact, i__, k;
 
     /* Fortran I/O blocks */
 /*    static cilist io___168 = { 0, 6, 0, 0, 0 };
@@ -3203,9 +3205,9 @@ long int *iorder, *iheap;*/
     long int i__1;
 
     /* Local variables */
-    static double ddum;
-    static long int i__, j, k, indxin, indxou;
-    static double out;
+    static thread_local double ddum;
+    static thread_local long int i__, j, k, indxin, indxou;
+    static thread_local double out;
 
 /*     ************ */
 
@@ -3339,9 +3341,9 @@ long int csave_len;*/
 
     /* Local variables */
     extern double ddot_(long int *n, double *dx, long int *incx, double *dy, long int *incy);
-    static long int i__;
+    static thread_local long int i__;
     extern /* Subroutine */ int dcopy_(long int *n, double *dx, long int *incx, double *dy, long int *incy);
-    static double a1, a2;
+    static thread_local double a1, a2;
     extern /* Subroutine */ int dcsrch_(double *f, double *g, double *stp, double *ftol, double *gtol, double *xtol,
 			 double *stpmin, double *stpmax, char *task, long int *isave, double *dsave, long int task_len);
 
@@ -3483,9 +3485,9 @@ double *theta, *rr, *dr, *stp, *dtd;*/
 
     /* Local variables */
     extern double ddot_(long int *n, double *dx, long int *incx, double *dy, long int *incy);
-    static long int j;
+    static thread_local long int j;
     extern /* Subroutine */ int dcopy_(long int *n, double *dx, long int *incx, double *dy, long int *incy);
-    static long int pointr;
+    static thread_local long int pointr;
 
 /*     ************ */
 
@@ -4135,8 +4137,8 @@ double *x, *g, *sbgnrm;*/
     double d__1, d__2;
 
     /* Local variables */
-    static long int i__;
-    static double gi;
+    static thread_local long int i__;
+    static thread_local double gi;
 
 /*     ************ */
 
@@ -4222,14 +4224,14 @@ OX\002)";
 //    long int s_wsfe(cilist *), e_wsfe(), do_fio(long int*, char*, long int), s_wsle(cilist *), do_lio(long int *, long int *, char *, long int), e_wsle();
 
     /* Local variables */
-    static double temp1, temp2;
-    static long int i__, j, k;
-    static double alpha;
+    static thread_local double temp1, temp2;
+    static thread_local long int i__, j, k;
+    static thread_local double alpha;
     //extern /* Subroutine */ int dtrsl_();
     extern int dtrsl_(double *t, long int *ldt, long int *n, double *b, long int *job, long int *info);
-    static long int m2;
-    static double dk;
-    static long int js, jy, pointr, ibd, col2;
+    static thread_local long int m2;
+    static thread_local double dk;
+    static thread_local long int js, jy, pointr, ibd, col2;
 
     /* Fortran I/O blocks */
 /*    static cilist io___232 = { 0, 6, 0, fmt_1001, 0 };
@@ -4561,15 +4563,15 @@ long int task_len;*/
     /* Subroutine */ int s_copy(char *, const char *const, long int, long int);
 
     /* Local variables */
-    static long int stage;
-    static double finit, ginit, width, ftest, gtest, stmin, stmax, width1,
+    static thread_local long int stage;
+    static thread_local double finit, ginit, width, ftest, gtest, stmin, stmax, width1,
 	     fm, gm, fx, fy, gx, gy;
-    static long int brackt;
+    static thread_local long int brackt;
     //extern /* Subroutine */ int dcstep_();
     extern int dcstep_(double *stx, double *fx, double *dx, double *sty, double *fy, double *dy,
 		     double *stp, double *fp, double *dp, long int *brackt, double *stpmin, double *stpmax);
 
-    static double fxm, fym, gxm, gym, stx, sty;
+    static thread_local double fxm, fym, gxm, gym, stx, sty;
 
 /*     ********** */
 
@@ -4903,7 +4905,7 @@ double *stpmin, *stpmax;*/
     //double sqrt();
 
     /* Local variables */
-    static double sgnd, stpc, stpf, stpq, p, q, gamma, r__, s, theta;
+    static thread_local double sgnd, stpc, stpf, stpq, p, q, gamma, r__, s, theta;
 
 /*     ********** */
 
@@ -5220,8 +5222,8 @@ long int *incx;*/
     //double sqrt();
 
     /* Local variables */
-    static long int i__;
-    static double scale;
+    static thread_local long int i__;
+    static thread_local double scale;
 
 /*     ********** */
 
@@ -5286,24 +5288,24 @@ double dpmeps_()
 {
     /* Initialized data */
 
-    static double zero = 0.;
-    static double one = 1.;
-    static double two = 2.;
+    static thread_local double zero = 0.;
+    static thread_local double one = 1.;
+    static thread_local double two = 2.;
 
     /* System generated locals */
     long int i__1;
     double ret_val;
 
     /* Local variables */
-    static double beta;
-    static long int irnd;
+    static thread_local double beta;
+    static thread_local long int irnd;
     static volatile double temp, temp1, a, b;
-    static long int i__;
-    static double betah;
-    static long int ibeta, negep;
-    static double tempa;
-    static long int itemp, it;
-    static double betain;
+    static thread_local long int i__;
+    static thread_local double betah;
+    static thread_local long int ibeta, negep;
+    static thread_local double tempa;
+    static thread_local long int itemp, it;
+    static thread_local double betain;
 
 /*     ********** */
 
@@ -5417,7 +5419,7 @@ long int *incy;*/
     long int i__1;
 
     /* Local variables */
-    static long int i__, m, ix, iy, mp1;
+    static thread_local long int i__, m, ix, iy, mp1;
 
 
 /*     constant times a vector plus a vector. */
@@ -5503,7 +5505,7 @@ long int *incy;*/
     long int i__1;
 
     /* Local variables */
-    static long int i__, m, ix, iy, mp1;
+    static thread_local long int i__, m, ix, iy, mp1;
 
 
 /*     copies a vector, x, to a vector, y. */
@@ -5590,9 +5592,9 @@ long int *incy;*/
     double ret_val;
 
     /* Local variables */
-    static long int i__, m;
-    static double dtemp;
-    static long int ix, iy, mp1;
+    static thread_local long int i__, m;
+    static thread_local double dtemp;
+    static thread_local long int ix, iy, mp1;
 
 
 /*     forms the dot product of two vectors. */
@@ -5680,9 +5682,9 @@ long int *lda, *n, *info;*/
 
     /* Local variables */
     //extern double ddot_();
-    static long int j, k;
-    static double s, t;
-    static long int jm1;
+    static thread_local long int j, k;
+    static thread_local double s, t;
+    static thread_local long int jm1;
 
 
 /*     dpofa factors a double precision symmetric positive definite */
@@ -5777,7 +5779,7 @@ long int *incx;*/
     long int i__1, i__2;
 
     /* Local variables */
-    static long int i__, m, nincx, mp1;
+    static thread_local long int i__, m, nincx, mp1;
 
 
 /*     scales a vector by a constant. */
@@ -5851,13 +5853,13 @@ long int *job, *info;*/
     long int t_dim1, t_offset, i__1, i__2;
 
     /* Local variables */
-    static long int case__;
+    static thread_local long int case__;
     //extern double ddot_(void);
-    static double temp;
-    static long int j;
+    static thread_local double temp;
+    static thread_local long int j;
     //extern /* Subroutine */ int daxpy_(double *a, long int *n, double *c, long int *d, long int *e);
     extern int daxpy_(long int *n, double *da, double *dx, long int *incx, double *dy, long int *incy);
-    static long int jj;
+    static thread_local long int jj;
 
 
 
@@ -6029,3 +6031,101 @@ L150:
 } /* dtrsl_ */
 
 
+namespace {
+	// setulb_ work arrays of one problem in setulb_batch()
+	struct SetulbState
+	{
+		std::vector<double> wa, dsave;
+		std::vector<long int> iwa, isave, lsave;
+		char task[SIXTY], csave[SIXTY];
+		bool done;
+	};
+
+	void setulb_call(SetulbProblem& p, SetulbState& s, long int m, double factr, double pgtol)
+	{
+		long int n = p.x.size(), iprint = -1;
+		setulb_(&n, &m, &p.x[0], &p.l[0], &p.u[0], &p.nbd[0], &p.f, &p.g[0], &factr, &pgtol,
+			&s.wa[0], &s.iwa[0], s.task, &iprint, s.csave, &s.lsave[0], &s.isave[0], &s.dsave[0],
+			(long int)SIXTY, (long int)SIXTY);
+	}
+
+	void setulb_finish(SetulbProblem& p, SetulbState& s)
+	{
+		int len = 0;
+		while (len < SIXTY && s.task[len] != '\0') len++;
+		while (len > 0 && s.task[len-1] == ' ') len--;
+		p.task.assign(s.task, len);
+		s.wa.clear();
+		s.iwa.clear();
+		s.done = true;
+	}
+}
+
+void setulb_batch(std::vector<SetulbProblem>& probs, long int m, double factr, double pgtol,
+		  const SetulbBatchFunc& fg, int maxfg)
+{
+	size_t np = probs.size();
+	std::vector<SetulbState> st(np);
+
+	for (size_t k = 0; k < np; k++) {
+		SetulbProblem& p = probs[k];
+		SetulbState& s = st[k];
+		long int n = p.x.size();
+		// missing bounds are treated as unbounded variables
+		p.l.resize(n, 0.0);
+		p.u.resize(n, 0.0);
+		p.nbd.resize(n, 0);
+		p.g.assign(n, 0.0);
+		p.nfg = 0;
+		s.wa.assign(2*m*n+4*n+12*m*m+12*m, 0.0);
+		s.iwa.assign(3*n, 0);
+		s.isave.assign(44, 0);
+		s.dsave.assign(29, 0.0);
+		s.lsave.assign(4, 0);
+		s.done = false;
+		// (**MUST clear remaining chars in task with spaces (else crash)!**)
+		strcpy(s.task, "START");
+		for (int i = 5; i < SIXTY; i++) s.task[i] = ' ';
+		if (n == 0) setulb_finish(p, s);
+		else setulb_call(p, s, m, factr, pgtol);
+	}
+
+	std::vector<size_t> which;
+	for (;;) {
+		which.clear();
+		for (size_t k = 0; k < np; k++) {
+			SetulbProblem& p = probs[k];
+			SetulbState& s = st[k];
+			if (s.done) continue;
+			while (strncmp(s.task, "NEW_X", 5) == 0) {
+				if (maxfg > 0 && p.nfg >= maxfg) {
+					strcpy(s.task, "STOP: TOTAL NO. of f AND g EVALUATIONS EXCEEDS LIMIT");
+					break;
+				}
+				setulb_call(p, s, m, factr, pgtol);
+			}
+			if (strncmp(s.task, "FG", 2) == 0) which.push_back(k);
+			else setulb_finish(p, s);
+		}
+		if (which.empty()) break;
+
+		fg(which, probs);
+
+		for (size_t i = 0; i < which.size(); i++) {
+			size_t k = which[i];
+			probs[k].nfg++;
+			setulb_call(probs[k], st[k], m, factr, pgtol);
+		}
+	}
+}
+
+void setulb_parallel(std::vector<SetulbProblem>& probs, long int m, double factr, double pgtol,
+		     const SetulbFunc& fg, int maxfg)
+{
+	setulb_batch(probs, m, factr, pgtol,
+		[&fg](const std::vector<size_t>& which, std::vector<SetulbProblem>& p) {
+			EMAN::EMThreads::parallel_for_each(which.size(), [&](size_t i, int) {
+				fg(which[i], p[which[i]]);
+			});
+		}, maxfg);
+}
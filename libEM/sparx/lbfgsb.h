@@ -1,3 +1,7 @@
+#include <vector>
+#include <string>
+#include <functional>
+
 int setulb_(long int *n, long int *m, double *x, double *l, double *u, long int *nbd, double *f, double *g, 
 			 double *factr, double *pgtol, double *wa, long int *iwa, char *task, long int *iprint, char *csave, long int *lsave,
 			 long int *isave, double *dsave, long int task_len, long int csave_len);
@@ -94,5 +98,47 @@ long int s_cmp(char *str1, const char *const str2, long int l1, long int l2);
 
 int s_copy(char *str1, const char *const str2, long int l1, long int l2);
 
-
-
+/** One bound constrained minimization for setulb_batch().
+ *  x holds the starting point on entry and the solution on exit, nbd/l/u
+ *  describe the bounds exactly as for setulb_.  f and g are filled by the
+ *  objective callback at the current x; on exit they hold the values at the
+ *  solution, task holds the final setulb_ task string and nfg the number of
+ *  objective/gradient evaluations.
+ */
+struct SetulbProblem
+{
+	std::vector<double> x, l, u, g;
+	std::vector<long int> nbd;
+	double f;
+	int nfg;
+	std::string task;
+
+	SetulbProblem() : f(0.0), nfg(0) {}
+	explicit SetulbProblem(size_t n) : x(n, 0.0), l(n, 0.0), u(n, 0.0), g(n, 0.0), nbd(n, 0), f(0.0), nfg(0) {}
+};
+
+/** Batched objective for setulb_batch(): set probs[k].f and probs[k].g at
+ *  probs[k].x for every k in which.  The problems are independent, so the
+ *  callback is free to evaluate them concurrently.
+ */
+typedef std::function<void(const std::vector<size_t>& which, std::vector<SetulbProblem>& probs)> SetulbBatchFunc;
+
+/** Per-problem objective for setulb_parallel(): set p.f and p.g at p.x.
+ *  Called concurrently for different problems.
+ */
+typedef std::function<void(size_t k, SetulbProblem& p)> SetulbFunc;
+
+/** Run L-BFGS-B on many independent problems in lockstep.  Every round all
+ *  unfinished problems are advanced by one setulb_ call and the ones that
+ *  request a function evaluation are handed to fg in a single batch, in
+ *  increasing problem order.  Each problem follows exactly the iterates of a
+ *  separate setulb_ loop.
+ *  @param m number of limited memory corrections
+ *  @param maxfg stop a problem after this many evaluations (0: no limit)
+ */
+void setulb_batch(std::vector<SetulbProblem>& probs, long int m, double factr, double pgtol,
+		  const SetulbBatchFunc& fg, int maxfg = 0);
+
+/** setulb_batch() with the evaluations of each round spread over EMThreads. */
+void setulb_parallel(std::vector<SetulbProblem>& probs, long int m, double factr, double pgtol,
+		     const SetulbFunc& fg, int maxfg = 0);
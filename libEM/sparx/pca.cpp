@@ -34,6 +34,7 @@
 #include "emutil.h"
 
 #include "pca.h"
+#include "analyzer.h"
 #include "lapackblas.h"
 
 using namespace EMAN;
@@ -185,6 +186,33 @@ int PCA::dopca_lan(vector <EMData*> imgstack, EMData *mask, int nvec)
    return status;
 }
 
+//------------------------------------------------------------------
+// PCA by randomized SVD, the basis is found with a few threaded passes
+// over the images instead of a full decomposition
+int PCA::dopca_rand(vector <EMData*> imgstack, EMData *mask, int nvec)
+{
+   int nimgs = imgstack.size();
+   if ( nvec > nimgs || nvec == 0 ) nvec = nimgs;
+
+   Dict params;
+   params["mask"] = mask;
+   params["nvec"] = nvec;
+   params["nimg"] = nimgs;
+   params["mode"] = "randomized";
+
+   Analyzer *svd = Factory < Analyzer >::get("svd_gsl", params);
+   svd->insert_images_list(imgstack);
+   vector<EMData*> eigvecs = svd->analyze();
+   EMDeletePtr(svd);
+
+   for (size_t i=0; i<eigvecs.size(); i++) {
+      singular_vals.push_back((float)(double)eigvecs[i]->get_attr("eigval"));
+      eigenimages.push_back(eigvecs[i]);
+   }
+
+   return 0;
+}
+
 //------------------------------------------------------------------
 // out of core version of PCA, not completed yet
 int PCA::dopca_ooc(const string &filename_in, const string &filename_out, 
@@ -44,6 +44,8 @@ namespace EMAN {
          int dopca(vector <EMData*> imgstack, EMData *mask);
          int dopca(vector <EMData*> imgstack, EMData *mask, int nvec);
          int dopca_lan(vector <EMData*> imgstack, EMData *mask, int nvec);
+         // randomized SVD (svd_gsl analyzer), for very large stacks
+         int dopca_rand(vector <EMData*> imgstack, EMData *mask, int nvec);
 
          // pca out of core
          int dopca_ooc(const string &filename_in, const string &filename_out, 
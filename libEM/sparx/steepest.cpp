@@ -39,7 +39,10 @@
 ******************************************************/
 #include <cstdio>
 #include <cmath>
+#include <vector>
+#include <algorithm>
 #include "emdata.h"
+#include "emthreads.h"
 
 #define  MACHEPS  1e-15
 
@@ -62,46 +65,69 @@ using namespace EMAN;
     *dd=sqrt(*dd);
   }
 
-  void Utilit2(double *X, double *X1, double *Y, double *D, double *dd, double xk, int l, float (*my_func)(EMData* , EMData* , EMData* , float , float , float), EMData *image,
-  EMData *refim, EMData *mask) {
-	int i;
-    // Update the X[i] 
+namespace {
+  // The steepest descent iteration with the objective given as a functor of
+  // the 1-based point X. Steepda(), Steepda_G() and Steepda_batch() all run it.
+  template<class F>
+  void steepda_run(double *X, double xk, double e, int l, int m, int *n, F eval)  {
+  int i;
+  double dd;
+  std::vector<double> D(l+1), X1(l+1), Y(std::max(l,3)+1);
+
+  // Update the X[i] and obtain Y[3]
+  auto step = [&]() {
     for (i=1; i<l+1; i++) {
-      // Save old values
       X1[i]=X[i];
-      X[i] += xk*D[i]/(*dd);
+      X[i] += xk*D[i]/dd;
     }
-    Y[3]=(*my_func)(image, refim, mask, (float)X[1], (float)X[2], (float)X[3]);
-  }
-
-  // Find approximations of partial derivatives D(i)
-  // by finite differences
-  void Derivatives(double *X, double *D, double *Y, double *dd, double xk, int l, float (*my_func)(EMData* , EMData* , EMData* , float , float , float), EMData *image, EMData
-  *refim, EMData *mask)  {
-    double a,b,yy;
-    int i;
+    Y[3]=eval(X);
+  };
+  // Finite difference derivatives and their magnitude
+  auto derivatives = [&]() {
     for (i=1; i<l+1; i++) {
-      // Save X(i)
-      a=X[i];
-      // Find increment
-      b=D[i]*xk/(2.0*(*dd));
-      // Move increment in X(i)
+      double a=X[i];
+      double b=D[i]*xk/(2.0*dd);
       X[i]=X[i]+b;
-      // Obtain yy
-      yy=(*my_func)(image, refim, mask, (float)X[1], (float)X[2], (float)X[3]);
-      // Guard against divide by zero near maximum
+      double yy=eval(X);
       if (b==0) b=1e-12;
-      // Update D(i)
       D[i]=(yy-Y[3])/b;
-      // Guard against locked up derivative
       if (D[i]==0) D[i]=1e-5;
-      // Restore X(i) and yy
-      X[i]=a; yy=Y[3];
+      X[i]=a;
     }
-    // Obtain dd
-    Utilit1(D, dd, l);
-  }
+    Utilit1(&D[0], &dd, l);
+  };
 
+  *n=0;
+  dd=1.0;
+  D[1]=1.0/sqrt((double)l);
+  for (i=2; i<l+1; i++)  D[i]=D[i-1];
+  // Start initial probe
+  for (int j=1; j<l+1; j++) {
+    Y[j]=eval(X);
+    Utilit1(&D[0], &dd, l);
+    step();
+  }
+  for (;;) {
+    // Accelerate search if approach is monotonic
+    if (!(fabs(Y[2]-Y[1])<MACHEPS) && (Y[3]-Y[2])/(Y[2]-Y[1])>0.0) xk=xk*1.2;
+    // Decelerate if heading the wrong way
+    if (Y[3]<Y[2]) xk=xk/2.0;
+    // Update the Y[i] if value has increased, otherwise restore the X[i]
+    if (Y[3]>Y[2]) {
+      Y[1]=Y[2]; Y[2]=Y[3];
+    } else {
+      for (i=1; i<l+1; i++) X[i]=X1[i];
+    }
+    Y[3]=eval(X);
+    derivatives();
+    if (dd==0) return;
+    step();
+    (*n)++;
+    if (*n>=m) return;
+    if (fabs(Y[3]-Y[2])<e) return;
+  }
+  }
+}
 
 /**************************************************
 *    Steepest descent optimization subroutine     *
@@ -126,55 +152,9 @@ using namespace EMAN;
 **************************************************/
   void Steepda(double *X, double xk, double e, int l, int m, int *n, float (*my_func)(EMData* , EMData* , EMData* , float , float , float), EMData *image, EMData *refim, EMData
   *mask)  {
-  // Labels: e50,e51,e100,e200
-  int i;
-  double dd;
-  double  D[4], Y[4];
-  double  X1[11];
-  
-  *n=0;
-  //The routine needs three values of Y to get started
-  //Generate starting D(i) values
-  //These are not even good guesses and slow the program a little
-  dd=1.0;
-  D[1]=1.0/sqrt((double)l);
-  for (i=2; i<l+1; i++)  D[i]=D[i-1];
-  // Start initial probe
-  for (i=1; i<l+1; i++) {
-    // Obtain yy and D[i]
-    Y[i]=(*my_func)(image, refim, mask, (float)X[1], (float)X[2], (float)X[3]);
-    // Update X[i]
-    Utilit1(D, &dd, l);
-    Utilit2(X, X1, Y, D, &dd, xk, l, my_func, image, refim, mask);
-  }
-  // We now have a history to base the subsequent search on
-  // Accelerate search if approach is monotonic 
-e50: if (fabs(Y[2]-Y[1])<MACHEPS) goto e51;
-  if ((Y[3]-Y[2])/(Y[2]-Y[1])>0.0) xk=xk*1.2;
-  // Decelerate if heading the wrong way
-e51: if (Y[3]<Y[2]) xk=xk/2.0;
-  // Update the Y[i] if value has decreased
-  if (Y[3]>Y[2]) goto e100;
-  // Restore the X[i]
-  for (i=1; i<l+1; i++) {
-    X[i]=X1[i];
-  }
-  goto e200;
-e100: Y[1]=Y[2]; Y[2]=Y[3];
-  // Obtain new values
-e200: Y[3]=(*my_func)(image, refim, mask, (float)X[1], (float)X[2], (float)X[3]);
-  Derivatives(X, D, Y, &dd, xk, l, my_func, image, refim, mask); // Get D(i)
-  //if dd=0 then the precision limit of the computer has been reached
-  if (dd==0) return;
-  // Update X[i]
-  Utilit2(X, X1, Y, D, &dd, xk, l, my_func, image, refim, mask);
-  // Check for maximum iterations and convergence
-  (*n)++;
-  //printf("Step %3d: X[0]=%12.6f  X[1]=%12.6f  X[2]=%12.6f\n",*n,X[1],X[2],X[3]);
-  if (*n>=m) return;
-  if (fabs(Y[3]-Y[2])<e) return;
-  // Try another iteration
-  goto e50;
+  steepda_run(X, xk, e, l, m, n, [&](const double *Xk) {
+    return (*my_func)(image, refim, mask, (float)Xk[1], (float)Xk[2], (float)Xk[3]);
+  });
 } // Steepds()
 
 /*
@@ -206,97 +186,17 @@ int main() {
 
 // End of file Steepda.cpp
 
-  void Utilit2_G(double *X, double *X1, double *Y, double *D, double *dd, double xk, int l, float (*my_func)(EMData* , EMData* , EMData* , Util::KaiserBessel& , float , float , float), EMData *image,
-  EMData *refim, EMData *mask, Util::KaiserBessel& kb) {
-	int i;
-    // Update the X[i] 
-    for (i=1; i<l+1; i++) {
-      // Save old values
-      X1[i]=X[i];
-      X[i] += xk*D[i]/(*dd);
-    }
-    Y[3]=(*my_func)(image, refim, mask, kb, (float)X[1], (float)X[2], (float)X[3]);
-  }
-
-  // Find approximations of partial derivatives D(i)
-  // by finite differences
-  void Derivatives_G(double *X, double *D, double *Y, double *dd, double xk, int l, float (*my_func)(EMData* , EMData* , EMData* , Util::KaiserBessel& , float , float , float), EMData *image, EMData
-  *refim, EMData *mask, Util::KaiserBessel& kb)  {
-    double a,b,yy;
-    int i;
-    for (i=1; i<l+1; i++) {
-      // Save X(i)
-      a=X[i];
-      // Find increment
-      b=D[i]*xk/(2.0*(*dd));
-      // Move increment in X(i)
-      X[i]=X[i]+b;
-      // Obtain yy
-      yy=(*my_func)(image, refim, mask, kb, (float)X[1], (float)X[2], (float)X[3]);
-      // Guard against divide by zero near maximum
-      if (b==0) b=1e-12;
-      // Update D(i)
-      D[i]=(yy-Y[3])/b;
-      // Guard against locked up derivative
-      if (D[i]==0) D[i]=1e-5;
-      // Restore X(i) and yy
-      X[i]=a; yy=Y[3];
-    }
-    // Obtain dd
-    Utilit1(D, dd, l);
-  }
-
-
-
   void Steepda_G(double *X, double xk, double e, int l, int m, int *n, float (*my_func)(EMData* , EMData* , EMData* , Util::KaiserBessel& , float , float , float), EMData *image, EMData *refim, EMData
   *mask, Util::KaiserBessel& kb)  {
-  // Labels: e50,e51,e100,e200
-  int i;
-  double dd;
-  double  D[4], Y[4];
-  double  X1[11];
-  
-  *n=0;
-  //The routine needs three values of Y to get started
-  //Generate starting D(i) values
-  //These are not even good guesses and slow the program a little
-  dd=1.0;
-  D[1]=1.0/sqrt((double)l);
-  for (i=2; i<l+1; i++)  D[i]=D[i-1];
-  // Start initial probe
-  for (i=1; i<l+1; i++) {
-    // Obtain yy and D[i]
-    Y[i]=(*my_func)(image, refim, mask, kb, (float)X[1], (float)X[2], (float)X[3]);
-    // Update X[i]
-    Utilit1(D, &dd, l);
-    Utilit2_G(X, X1, Y, D, &dd, xk, l, my_func, image, refim, mask, kb);
-  }
-  // We now have a history to base the subsequent search on
-  // Accelerate search if approach is monotonic 
-e50: if (fabs(Y[2]-Y[1])<MACHEPS) goto e51;
-  if ((Y[3]-Y[2])/(Y[2]-Y[1])>0.0) xk=xk*1.2;
-  // Decelerate if heading the wrong way
-e51: if (Y[3]<Y[2]) xk=xk/2.0;
-  // Update the Y[i] if value has decreased
-  if (Y[3]>Y[2]) goto e100;
-  // Restore the X[i]
-  for (i=1; i<l+1; i++) {
-    X[i]=X1[i];
-  }
-  goto e200;
-e100: Y[1]=Y[2]; Y[2]=Y[3];
-  // Obtain new values
-e200: Y[3]=(*my_func)(image, refim, mask, kb, (float)X[1], (float)X[2], (float)X[3]);
-  Derivatives_G(X, D, Y, &dd, xk, l, my_func, image, refim, mask, kb); // Get D(i)
-  //if dd=0 then the precision limit of the computer has been reached
-  if (dd==0) return;
-  // Update X[i]
-  Utilit2_G(X, X1, Y, D, &dd, xk, l, my_func, image, refim, mask, kb);
-  // Check for maximum iterations and convergence
-  (*n)++;
-  //printf("Step %3d: X[0]=%12.6f  X[1]=%12.6f  X[2]=%12.6f\n",*n,X[1],X[2],X[3]);
-  if (*n>=m) return;
-  if (fabs(Y[3]-Y[2])<e) return;
-  // Try another iteration
-  goto e50;
+  steepda_run(X, xk, e, l, m, n, [&](const double *Xk) {
+    return (*my_func)(image, refim, mask, kb, (float)Xk[1], (float)Xk[2], (float)Xk[3]);
+  });
 } // Steepds()
+
+
+void Steepda_batch(double *X, double xk, double e, int l, int m, int *n, size_t nprob,
+		   const std::function<double(size_t, const double *)>& func)  {
+  EMThreads::parallel_for_each(nprob, [&](size_t k, int) {
+    steepda_run(X + k*(l+1), xk, e, l, m, n + k, [&func, k](const double *Xk) { return func(k, Xk); });
+  });
+}
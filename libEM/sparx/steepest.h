@@ -1,17 +1,17 @@
+#include <functional>
+
 void Utilit1(double *, double *, int );
   
-void Utilit2(double *X, double *X1, double *Y, double *D, double *dd, double xk, int l, float (*my_func)(EMData* , EMData* , EMData* , float , float , float), EMData *image, EMData *refim, EMData *mask);
-    
-void Derivatives(double *X, double *D, double *Y, double *dd, double xk, int l, float (*my_func)(EMData* , EMData* , EMData* , float , float , float), EMData *, EMData *,
-EMData *);
-
 void Steepda(double *X, double xk, double e, int l, int m, int *n, float (*my_func)(EMData* , EMData* , EMData* , float , float , float), EMData *, EMData *, EMData *);
 
-void Utilit2_G(double *X, double *X1, double *Y, double *D, double *dd, double xk, int l, float (*my_func)(EMData* , EMData* , EMData* , Util::KaiserBessel& , float , float , float), EMData *image,
-EMData *refim, EMData *mask, Util::KaiserBessel& kb);
-
-void Derivatives_G(double *X, double *D, double *Y, double *dd, double xk, int l, float (*my_func)(EMData* , EMData* , EMData* , Util::KaiserBessel& , float , float , float), EMData *image, EMData
-*refim, EMData *mask, Util::KaiserBessel& kb);
-
 void Steepda_G(double *X, double xk, double e, int l, int m, int *n, float (*my_func)(EMData* , EMData* , EMData* , Util::KaiserBessel& , float , float , float), EMData *image, EMData *refim, EMData
 *mask, Util::KaiserBessel& kb);
+
+/** Steepest descent on nprob independent problems, spread over EMThreads.
+ *  X holds nprob consecutive blocks of l+1 doubles, each a 1-based starting
+ *  point as for Steepda(), and receives the optima.  func(k, Xk) returns the
+ *  objective of problem k at the 1-based point Xk and is called concurrently
+ *  for different problems.  The iteration count of problem k goes to n[k].
+ */
+void Steepda_batch(double *X, double xk, double e, int l, int m, int *n, size_t nprob,
+		   const std::function<double(size_t, const double *)>& func);
@@ -44,6 +44,7 @@
 #include <cassert>
 #include <sstream>
 #include "emdata.h"
+#include "emthreads.h"
 #include "util.h"
 #include "fundamentals.h"
 #include "lapackblas.h"
@@ -55,6 +56,9 @@ using namespace EMAN;
 #include "mcqd.h"
 #include <algorithm>
 #include <vector>
+#include <map>
+#include <array>
+#include <type_traits>
 
 #include <gsl/gsl_sf_bessel.h>
 #include <gsl/gsl_sf_bessel.h>
@@ -7141,20 +7145,22 @@ c
 */
 EMData* Util::Polar2Dm(EMData* image, float cnx2, float cny2, vector<int> numr, string cmode){
 	int nring = numr.size()/3;
-	int maxPoints = numr(3,nring);
-	
-	int nx = image->get_xsize();
-	int ny = image->get_ysize();
-	
-	int limit = nx*ny - 2; // As required by bilinear_inline function
-
 	int lcirc = numr[3*nring-2]+numr[3*nring-1]-1;
-	float xold, yold, xnew, ynew;
-	
+
 	EMData* out = new EMData();
 	out->set_size(lcirc,1, 1);
 
 	char mode = (cmode == "F" || cmode == "f") ? 'F' : 'H';
+	Polar2Dm_buf(image->get_data(), image->get_xsize(), image->get_ysize(), cnx2, cny2, numr, mode, out->get_data());
+	return out;
+}
+
+void Util::Polar2Dm_buf(float* xim, int nx, int ny, float cnx2, float cny2, const vector<int>& numr, char mode, float* circ){
+	int nring = numr.size()/3;
+	int maxPoints = numr(3,nring);
+
+	float xold, yold, xnew, ynew;
+
 	int div = (mode == 'F' ? 4 : 2);
 
 	maxPoints = maxPoints /div - 1;
@@ -7170,8 +7176,6 @@ EMData* Util::Polar2Dm(EMData* image, float cnx2, float cny2, vector<int> numr,
 		vcos[x] = cos(ang);
 	}
 
-	float *xim  = image->get_data();
-	float* circ = out->get_data();
 	for (int it = 1; it <= nring; it++) {
 
 		//int it = r+1;
@@ -7227,7 +7231,6 @@ EMData* Util::Polar2Dm(EMData* image, float cnx2, float cny2, vector<int> numr,
 			}
 		}
 	}
-	return out;
 }
 
 /*
@@ -7728,6 +7731,173 @@ EMData* Util::Polar2Dmi(EMData* image, float cns2, float cnr2, vector<int> numr,
 	return  out;
 }
 
+// Serializes all FFTW planning in the library (defined in emfft.cpp)
+extern MUTEX fft_mutex;
+
+namespace {
+	/* FFTW for batches of the packed real 1D transforms of fftr_q/fftr_d:
+	   x[0] = R(0), x[1] = R(n/2), then (real, imaginary) pairs, with their
+	   sign convention and the 1/n normalization of the inverse.  A batch is
+	   nimg sets of run consecutive transforms of length n, the sets img_dist
+	   apart.  A plan covers one set (a howmany loop of run transforms, stride
+	   n) and is executed once per set with the new-array calls, so plans
+	   depend only on (n, run, direction), not on how the images were split
+	   over threads.  They are made with FFTW_UNALIGNED and serve any buffer
+	   from any thread; only planning and destruction, which FFTW does not
+	   allow concurrently, take fft_mutex, shared with EMfft. */
+	template<class T> struct RingFFTW;
+
+	template<> struct RingFFTW<float>
+	{
+		typedef fftwf_plan plan;
+		typedef fftwf_iodim iodim;
+		static plan make(int dir, const iodim* dim, const iodim* hdim, float* x, complex<float>* c)
+		{
+			const unsigned flags = FFTW_ESTIMATE | FFTW_UNALIGNED;
+			if (dir > 0) return fftwf_plan_guru_dft_r2c(1, dim, 1, hdim, x, (fftwf_complex*)c, flags);
+			return fftwf_plan_guru_dft_c2r(1, dim, 1, hdim, (fftwf_complex*)c, x, flags);
+		}
+		static void run(plan p, int dir, float* x, complex<float>* c)
+		{
+			if (dir > 0) fftwf_execute_dft_r2c(p, x, (fftwf_complex*)c);
+			else         fftwf_execute_dft_c2r(p, (fftwf_complex*)c, x);
+		}
+		static void destroy(plan p) { fftwf_destroy_plan(p); }
+	};
+
+	template<> struct RingFFTW<double>
+	{
+		typedef fftw_plan plan;
+		typedef fftw_iodim iodim;
+		static plan make(int dir, const iodim* dim, const iodim* hdim, double* x, complex<double>* c)
+		{
+			const unsigned flags = FFTW_ESTIMATE | FFTW_UNALIGNED;
+			if (dir > 0) return fftw_plan_guru_dft_r2c(1, dim, 1, hdim, x, (fftw_complex*)c, flags);
+			return fftw_plan_guru_dft_c2r(1, dim, 1, hdim, (fftw_complex*)c, x, flags);
+		}
+		static void run(plan p, int dir, double* x, complex<double>* c)
+		{
+			if (dir > 0) fftw_execute_dft_r2c(p, x, (fftw_complex*)c);
+			else         fftw_execute_dft_c2r(p, (fftw_complex*)c, x);
+		}
+		static void destroy(plan p) { fftw_destroy_plan(p); }
+	};
+
+	struct FFTPlannerLock {
+		FFTPlannerLock() { Util::MUTEX_LOCK(&fft_mutex); }
+		~FFTPlannerLock() { Util::MUTEX_UNLOCK(&fft_mutex); }
+	};
+
+	// ring geometries whose plans are kept; a call with a new geometry past
+	// this plans, runs and destroys its own plan
+	const size_t RING_PLAN_MAX = 64;
+
+	template<class T>
+	struct RingPlanCache
+	{
+		typedef std::array<int, 3> key_t;
+		std::map<key_t, typename RingFFTW<T>::plan> plans;
+
+		// runs at exit, possibly while other threads still plan through EMfft
+		~RingPlanCache() {
+			FFTPlannerLock lock;
+			for (auto& p : plans) RingFFTW<T>::destroy(p.second);
+		}
+	};
+
+	/* The plan for run transforms of length n in direction dir.  cached is
+	   set false if the caller owns the plan and must destroy it. */
+	template<class T>
+	typename RingFFTW<T>::plan ring_plan(int n, int run, int dir, T* x, complex<T>* c, bool& cached)
+	{
+		typedef typename RingFFTW<T>::plan plan;
+		typedef typename RingPlanCache<T>::key_t key_t;
+		const key_t key = {{n, run, dir}};
+
+		// plans in the shared cache live until exit, so threads may keep copies
+		static thread_local std::map<key_t, plan> local;
+		cached = true;
+		typename std::map<key_t, plan>::iterator it = local.find(key);
+		if (it != local.end()) return it->second;
+
+		static RingPlanCache<T> shared;
+		FFTPlannerLock lock;
+		it = shared.plans.find(key);
+		if (it != shared.plans.end()) {
+			local[key] = it->second;
+			return it->second;
+		}
+
+		const int nc = n/2+1;
+		typename RingFFTW<T>::iodim dim = {n, 1, 1};
+		typename RingFFTW<T>::iodim hdim = {run, n, nc};
+		if (dir < 0) {
+			hdim.is = nc;
+			hdim.os = n;
+		}
+		plan p = RingFFTW<T>::make(dir, &dim, &hdim, x, c);
+		if (!p) throw InvalidValueException(n, "ring FFT: FFTW could not make a plan");
+
+		if (shared.plans.size() >= RING_PLAN_MAX) {
+			cached = false;
+			return p;
+		}
+		shared.plans[key] = p;
+		local[key] = p;
+		return p;
+	}
+
+	template<class T>
+	void ring_fft(T* x, int n, int run, int nimg, int img_dist, int dir)
+	{
+		if (n < 2 || run < 1 || nimg < 1) return;
+		const int nc = n/2+1;
+		const size_t cdist = (size_t)run*nc;
+		static thread_local std::vector< complex<T> > buf;
+		buf.resize(cdist*nimg);
+		complex<T>* c = buf.data();
+		bool cached;
+		typename RingFFTW<T>::plan p = ring_plan<T>(n, run, dir, x, c, cached);
+
+		if (dir > 0) {
+			for (int m=0; m<nimg; m++) RingFFTW<T>::run(p, dir, x + (size_t)m*img_dist, c + m*cdist);
+			for (int m=0; m<nimg; m++) {
+				for (int r=0; r<run; r++) {
+					T* y = x + (size_t)m*img_dist + (size_t)r*n;
+					const complex<T>* f = c + m*cdist + (size_t)r*nc;
+					y[0] = f[0].real();
+					y[1] = f[n/2].real();
+					for (int k=1; k<n/2; k++) {
+						y[2*k]   =  f[k].real();
+						y[2*k+1] = -f[k].imag();
+					}
+				}
+			}
+		} else {
+			for (int m=0; m<nimg; m++) {
+				for (int r=0; r<run; r++) {
+					const T* y = x + (size_t)m*img_dist + (size_t)r*n;
+					complex<T>* f = c + m*cdist + (size_t)r*nc;
+					f[0] = complex<T>(y[0], 0);
+					f[n/2] = complex<T>(y[1], 0);
+					for (int k=1; k<n/2; k++) f[k] = complex<T>(y[2*k], -y[2*k+1]);
+				}
+			}
+			for (int m=0; m<nimg; m++) RingFFTW<T>::run(p, dir, x + (size_t)m*img_dist, c + m*cdist);
+			const T rn = T(1)/n;
+			for (int m=0; m<nimg; m++) {
+				T* y = x + (size_t)m*img_dist;
+				for (size_t k=0; k<(size_t)run*n; k++) y[k] *= rn;
+			}
+		}
+
+		if (!cached) {
+			FFTPlannerLock lock;
+			RingFFTW<T>::destroy(p);
+		}
+	}
+}
+
 /*
 
     Two 1-D power-of-two FFTs
@@ -7748,6 +7918,9 @@ fftr_d(xcmplx,nv)
  xcmplx(1,1) --- R(0), xcmplx(2,1) --- R(NV/2)
  xcmplx(1,i) --- real, xcmplx(2,i) --- imaginary
 
+ Both now run on FFTW through ring_fft above, fftc_q/fftc_d are the
+ radix kernels they used to call.
+
 */
 #define  tab1(i)      tab1[i-1]
 #define  xcmplx(i,j)  xcmplx [(j-1)*2 + i-1]
@@ -8063,164 +8236,18 @@ EXIT:
 
 void  Util::fftr_q(float *xcmplx, int nv)
 {
-   // dimension xcmplx(2,1); xcmplx(1,i) --- real, xcmplx(2,i) --- imaginary
-
-	int nu, inv, nu1, n, isub, n2, i1, i2, i;
-	float ss, cc, c, s, tr, ti, tr1, tr2, ti1, ti2, t;
-
-	const float tab1[] = {
-		9.58737990959775e-5f,
-		1.91747597310703e-4f,
-		3.83495187571395e-4f,
-		7.66990318742704e-4f,
-		1.53398018628476e-3f,
-		3.06795676296598e-3f,
-		6.13588464915449e-3f,
-		1.22715382857199e-2f,
-		2.45412285229123e-2f,
-		4.90676743274181e-2f,
-		9.80171403295604e-2f,
-		1.95090322016128e-1f,
-		3.82683432365090e-1f,
-		7.07106781186546e-1f,
-		1.00000000000000f,
-	};
+	// dimension xcmplx(2,1); xcmplx(1,i) --- real, xcmplx(2,i) --- imaginary
+	if (nv == 0) return;
+	int nu = nv < 0 ? -nv : nv;
+	ring_fft<float>(xcmplx, 1<<nu, 1, 1, 0, nv > 0 ? 1 : -1);
+}
 
-	nu=abs(nv);
-	inv=nv/nu;
-	nu1=nu-1;
-	n=(int)pow(2.f,nu1);
-	isub=16-nu1;
-
-	ss=-tab1(isub);
-	cc=-2.0f*pow(tab1(isub-1),2.f);
-	c=1.0f;
-	s=0.0f;
-	n2=n/2;
-	if ( inv > 0) {
-		fftc_q(&xcmplx(1,1),&xcmplx(2,1),nu1,2);
-		tr=xcmplx(1,1);
-		ti=xcmplx(2,1);
-		xcmplx(1,1)=tr+ti;
-		xcmplx(2,1)=tr-ti;
-		for (i=1;i<=n2;i++) {
-			i1=i+1;
-			i2=n-i+1;
-			tr1=xcmplx(1,i1);
-			tr2=xcmplx(1,i2);
-			ti1=xcmplx(2,i1);
-			ti2=xcmplx(2,i2);
-			t=(cc*c-ss*s)+c;
-			s=(cc*s+ss*c)+s;
-			c=t;
-			xcmplx(1,i1)=0.5f*((tr1+tr2)+(ti1+ti2)*c-(tr1-tr2)*s);
-			xcmplx(1,i2)=0.5f*((tr1+tr2)-(ti1+ti2)*c+(tr1-tr2)*s);
-			xcmplx(2,i1)=0.5f*((ti1-ti2)-(ti1+ti2)*s-(tr1-tr2)*c);
-			xcmplx(2,i2)=0.5f*(-(ti1-ti2)-(ti1+ti2)*s-(tr1-tr2)*c);
-		}
-	} else {
-		tr=xcmplx(1,1);
-		ti=xcmplx(2,1);
-		xcmplx(1,1)=0.5f*(tr+ti);
-		xcmplx(2,1)=0.5f*(tr-ti);
-		for (i=1; i<=n2; i++) {
-			i1=i+1;
-			i2=n-i+1;
-			tr1=xcmplx(1,i1);
-			tr2=xcmplx(1,i2);
-			ti1=xcmplx(2,i1);
-			ti2=xcmplx(2,i2);
-			t=(cc*c-ss*s)+c;
-			s=(cc*s+ss*c)+s;
-			c=t;
-			xcmplx(1,i1)=0.5f*((tr1+tr2)-(tr1-tr2)*s-(ti1+ti2)*c);
-			xcmplx(1,i2)=0.5f*((tr1+tr2)+(tr1-tr2)*s+(ti1+ti2)*c);
-			xcmplx(2,i1)=0.5f*((ti1-ti2)+(tr1-tr2)*c-(ti1+ti2)*s);
-			xcmplx(2,i2)=0.5f*(-(ti1-ti2)+(tr1-tr2)*c-(ti1+ti2)*s);
-		}
-		fftc_q(&xcmplx(1,1),&xcmplx(2,1),nu1,-2);
-	}
-}
-
-// -------------------------------------------
 void  Util::fftr_d(double *xcmplx, int nv)
 {
-	// double precision  x(2,1)
-	int    i1, i2,  nu, inv, nu1, n, isub, n2, i;
-	double tr1,tr2,ti1,ti2,tr,ti;
-	double cc,c,ss,s,t;
-	const double tab1[] = {
-		9.58737990959775e-5,
-		1.91747597310703e-4,
-		3.83495187571395e-4,
-		7.66990318742704e-4,
-		1.53398018628476e-3,
-		3.06795676296598e-3,
-		6.13588464915449e-3,
-		1.22715382857199e-2,
-		2.45412285229123e-2,
-		4.90676743274181e-2,
-		9.80171403295604e-2,
-		1.95090322016128e-1,
-		3.82683432365090e-1,
-		7.07106781186546e-1,
-		1.00000000000000,
-	};
-
-	nu=abs(nv);
-	inv=nv/nu;
-	nu1=nu-1;
-	n=(int)pow(2.0f,nu1);
-	isub=16-nu1;
-	ss=-tab1(isub);
-	cc=-2.0*pow(tab1(isub-1),2);
-	c=1.0f;
-	s=0.0f;
-	n2=n/2;
-
-	if ( inv > 0 ) {
-		fftc_d(&xcmplx(1,1),&xcmplx(2,1),nu1,2);
-		tr=xcmplx(1,1);
-		ti=xcmplx(2,1);
-		xcmplx(1,1)=tr+ti;
-		xcmplx(2,1)=tr-ti;
-		for (i=1;i<=n2;i++) {
-			i1=i+1;
-			i2=n-i+1;
-			tr1=xcmplx(1,i1);
-			tr2=xcmplx(1,i2);
-			ti1=xcmplx(2,i1);
-			ti2=xcmplx(2,i2);
-			t=(cc*c-ss*s)+c;
-			s=(cc*s+ss*c)+s;
-			c=t;
-			xcmplx(1,i1)=0.5*((tr1+tr2)+(ti1+ti2)*c-(tr1-tr2)*s);
-			xcmplx(1,i2)=0.5*((tr1+tr2)-(ti1+ti2)*c+(tr1-tr2)*s);
-			xcmplx(2,i1)=0.5*((ti1-ti2)-(ti1+ti2)*s-(tr1-tr2)*c);
-			xcmplx(2,i2)=0.5*(-(ti1-ti2)-(ti1+ti2)*s-(tr1-tr2)*c);
-		}
-	} else {
-		tr=xcmplx(1,1);
-		ti=xcmplx(2,1);
-		xcmplx(1,1)=0.5*(tr+ti);
-		xcmplx(2,1)=0.5*(tr-ti);
-		for (i=1; i<=n2; i++) {
-			i1=i+1;
-			i2=n-i+1;
-			tr1=xcmplx(1,i1);
-			tr2=xcmplx(1,i2);
-			ti1=xcmplx(2,i1);
-			ti2=xcmplx(2,i2);
-			t=(cc*c-ss*s)+c;
-			s=(cc*s+ss*c)+s;
-			c=t;
-			xcmplx(1,i1)=0.5*((tr1+tr2)-(tr1-tr2)*s-(ti1+ti2)*c);
-			xcmplx(1,i2)=0.5*((tr1+tr2)+(tr1-tr2)*s+(ti1+ti2)*c);
-			xcmplx(2,i1)=0.5*((ti1-ti2)+(tr1-tr2)*c-(ti1+ti2)*s);
-			xcmplx(2,i2)=0.5*(-(ti1-ti2)+(tr1-tr2)*c-(ti1+ti2)*s);
-		}
-		fftc_d(&xcmplx(1,1),&xcmplx(2,1),nu1,-2);
-	}
+	// dimension xcmplx(2,1); xcmplx(1,i) --- real, xcmplx(2,i) --- imaginary
+	if (nv == 0) return;
+	int nu = nv < 0 ? -nv : nv;
+	ring_fft<double>(xcmplx, 1<<nu, 1, 1, 0, nv > 0 ? 1 : -1);
 }
 #undef  tab1
 #undef  xcmplx
@@ -8510,35 +8537,36 @@ void Util::multiply_rows( EMData* rings, const vector<float>& bckgnoise, int nb
 
 
 void Util::Frngs(EMData* circp, vector<int> numr){
-	int nring = numr.size()/3;
-	float *circ = circp->get_data();
-	int i, l;
-	for (i=1; i<=nring;i++) {
-
-#ifdef _WIN32
-		l = (int)( log((float)numr(3,i))/log(2.0f) );
-#else
-		l = (int)(log2(numr(3,i)));
-#endif	//_WIN32
+	Frngs_buf(circp->get_data(), numr);
+}
 
-		fftr_q(&circ(numr(2,i)),l);
+namespace {
+	// transform nimg sets of rings, lcirc apart, one FFTW batch per run of
+	// consecutive rings of equal length
+	void frngs_runs(float* circ, const vector<int>& numr, size_t nimg, int dir)
+	{
+		int nring = numr.size()/3;
+		int lcirc = numr[3*nring-2]+numr[3*nring-1]-1;
+		int i = 1;
+		while (i <= nring) {
+			int run = 1;
+			while (i+run <= nring && numr(3,i+run) == numr(3,i) && numr(2,i+run) == numr(2,i+run-1)+numr(3,i)) run++;
+			ring_fft<float>(&circ(numr(2,i)), numr(3,i), run, nimg, lcirc, dir);
+			i += run;
+		}
 	}
 }
 
-void Util::Frngs_inv(EMData* circp, vector<int> numr){
-	int nring = numr.size()/3;
-	float *circ = circp->get_data();
-	int i, l;
-	for (i=1; i<=nring;i++) {
+void Util::Frngs_buf(float* circ, const vector<int>& numr){
+	frngs_runs(circ, numr, 1, 1);
+}
 
-#ifdef _WIN32
-		l = (int)( log((float)numr(3,i))/log(2.0f) );
-#else
-		l=(int)(log2(numr(3,i)));
-#endif	//_WIN32
+void Util::Frngs_batch(float* circ, const vector<int>& numr, size_t nimg){
+	frngs_runs(circ, numr, nimg, 1);
+}
 
-		fftr_q(&circ(numr(2,i)),-l);
-	}
+void Util::Frngs_inv(EMData* circp, vector<int> numr){
+	frngs_runs(circp->get_data(), numr, 1, -1);
 }
 #undef  circ
 
@@ -8613,13 +8641,15 @@ void Util::prb1d(double *b, int npoint, float *pos) {
 #define  b(i)            b[i-1]
 #define  t7(i)           t7[i-1]
 Dict Util::Crosrng_e(EMData*  circ1p, EMData* circ2p, vector<int> numr, int neg, float delta_psi) {
+	return Crosrng_e_buf(circ1p->get_data(), circ2p->get_data(), numr, neg, delta_psi);
+}
+
+Dict Util::Crosrng_e_buf(float* circ1, float* circ2, const vector<int>& numr, int neg, float delta_psi) {
 	//  neg = 1 mirrored; otherwise straight
 	int nring = numr.size()/3;
 	//int lcirc = numr[3*nring-2]+numr[3*nring-1]-1;
 	int maxrin = numr[numr.size()-1];
 	double qn;   float  tot;
-	float *circ1 = circ1p->get_data();
-	float *circ2 = circ2p->get_data();
 /*
 c checks single position, neg is flag for checking mirrored position
 c
@@ -8980,12 +9010,14 @@ c       automatic arrays
 }
 
 Dict Util::Crosrng_ms(EMData* circ1p, EMData* circ2p, vector<int> numr, float delta_psi) {
+	return Crosrng_ms_buf(circ1p->get_data(), circ2p->get_data(), numr, delta_psi);
+}
+
+Dict Util::Crosrng_ms_buf(float* circ1, float* circ2, const vector<int>& numr, float delta_psi) {
 	int nring = numr.size()/3;
 	//int lcirc = numr[3*nring-2]+numr[3*nring-1]-1;
 	int maxrin = numr[numr.size()-1];
 	double qn; float tot; double qm; float tmt;
-	float *circ1 = circ1p->get_data();
-	float *circ2 = circ2p->get_data();
 /*
 c
 c  checks both straight & mirrored positions
@@ -9553,13 +9585,15 @@ c
 
 
 Dict Util::Crosrng_sm_psi(EMData* circ1p, EMData* circ2p, vector<int> numr, float psi, int flag, float psi_max) {
+	return Crosrng_sm_psi_buf(circ1p->get_data(), circ2p->get_data(), numr, psi, flag, psi_max);
+}
+
+Dict Util::Crosrng_sm_psi_buf(float* circ1, float* circ2, const vector<int>& numr, float psi, int flag, float psi_max) {
 // flag 0 - straight, 1 - mirror
 
 	int nring = numr.size()/3;
 	int maxrin = numr[numr.size()-1];
 	double qn; float tot;
-	float *circ1 = circ1p->get_data();
-	float *circ2 = circ2p->get_data();
 
 	double *q;
 
@@ -9637,13 +9671,15 @@ Dict Util::Crosrng_sm_psi(EMData* circ1p, EMData* circ2p, vector<int> numr, floa
 }
 
 Dict Util::Crosrng_psi(EMData* circ1p, EMData* circ2p, vector<int> numr, float psi, float psi_max) {
+	return Crosrng_psi_buf(circ1p->get_data(), circ2p->get_data(), numr, psi, psi_max);
+}
+
+Dict Util::Crosrng_psi_buf(float* circ1, float* circ2, const vector<int>& numr, float psi, float psi_max) {
 // Computes both straight and mirrored
 
 	int nring = numr.size()/3;
 	int maxrin = numr[numr.size()-1];
 	double qn; float tot; double qm; float tmt;
-	float *circ1 = circ1p->get_data();
-	float *circ2 = circ2p->get_data();
 
 	double *t, *q;
 
@@ -11792,48 +11828,47 @@ vector<int> Util::cml_line_insino(vector<float> Rot, int i_prj, int n_prj){
 
 vector<int> Util::cml_line_insino_all(vector<float> Rot, vector<int> seq, int, int n_lines) {
 	vector<int> com(2*n_lines);
-	int a=0, b, c, l;
-	int n1=0, n2=0, mem=-1;
-	float vmax = 1 - 1.0e-6f;
-	double r11, r12, r13, r23, r31, r32, r33;
-	c = 0;
-	for (l=0; l<n_lines; ++l){
-		c = 2*l;
-		if (seq[c]!=mem){
-		    mem = seq[c];
-		    a = seq[c]*9;
-		}
-		b = seq[c+1]*9;
-
-		// this is equivalent to R = A*B'
-		r11 = Rot[a]*Rot[b]+Rot[a+1]*Rot[b+1]+Rot[a+2]*Rot[b+2];
-		r12 = Rot[a]*Rot[b+3]+Rot[a+1]*Rot[b+4]+Rot[a+2]*Rot[b+5];
-		r13 = Rot[a]*Rot[b+6]+Rot[a+1]*Rot[b+7]+Rot[a+2]*Rot[b+8];
-		r23 = Rot[a+3]*Rot[b+6]+Rot[a+4]*Rot[b+7]+Rot[a+5]*Rot[b+8];
-		r31 = Rot[a+6]*Rot[b]+Rot[a+7]*Rot[b+1]+Rot[a+8]*Rot[b+2];
-		r32 = Rot[a+6]*Rot[b+3]+Rot[a+7]*Rot[b+4]+Rot[a+8]*Rot[b+5];
-		r33 = Rot[a+6]*Rot[b+6]+Rot[a+7]*Rot[b+7]+Rot[a+8]*Rot[b+8];
-		if (r33 > vmax) {
-		    n2 = 270;
-		    n1 = 270 + nint180((float)(rad_deg*atan2(r12, r11)));
-		}
-		else if (r33 < -vmax) {
-		    n2 = 270;
-		    n1 = 270 - nint180((float)(rad_deg*atan2(r12, r11)));
-		} else {
-		    n2 = nint180((float)(rad_deg*atan2(r31, -r32)));
-		    n1 = nint180((float)(rad_deg*atan2(r13, r23)));
-		    if (n1 < 0) {n1 += 360;}
-		    if (n2 <= 0) {n2 = abs(n2);}
-		    else {n2 = 360 - n2;}
-		}
-		if (n1 >= 360){n1 = n1 % 360;}
-		if (n2 >= 360){n2 = n2 % 360;}
+	const float vmax = 1 - 1.0e-6f;
+	// every common-line only depends on its own pair of rotations
+	EMThreads::parallel_for(n_lines, [&](size_t lb, size_t le, int) {
+		int a, b, c;
+		int n1=0, n2=0;
+		double r11, r12, r13, r23, r31, r32, r33;
+		for (size_t l=lb; l<le; ++l){
+			c = 2*l;
+			a = seq[c]*9;
+			b = seq[c+1]*9;
 
-		// store common-lines
-		com[c] = n1;
-		com[c+1] = n2;
-	}
+			// this is equivalent to R = A*B'
+			r11 = Rot[a]*Rot[b]+Rot[a+1]*Rot[b+1]+Rot[a+2]*Rot[b+2];
+			r12 = Rot[a]*Rot[b+3]+Rot[a+1]*Rot[b+4]+Rot[a+2]*Rot[b+5];
+			r13 = Rot[a]*Rot[b+6]+Rot[a+1]*Rot[b+7]+Rot[a+2]*Rot[b+8];
+			r23 = Rot[a+3]*Rot[b+6]+Rot[a+4]*Rot[b+7]+Rot[a+5]*Rot[b+8];
+			r31 = Rot[a+6]*Rot[b]+Rot[a+7]*Rot[b+1]+Rot[a+8]*Rot[b+2];
+			r32 = Rot[a+6]*Rot[b+3]+Rot[a+7]*Rot[b+4]+Rot[a+8]*Rot[b+5];
+			r33 = Rot[a+6]*Rot[b+6]+Rot[a+7]*Rot[b+7]+Rot[a+8]*Rot[b+8];
+			if (r33 > vmax) {
+			    n2 = 270;
+			    n1 = 270 + nint180((float)(rad_deg*atan2(r12, r11)));
+			}
+			else if (r33 < -vmax) {
+			    n2 = 270;
+			    n1 = 270 - nint180((float)(rad_deg*atan2(r12, r11)));
+			} else {
+			    n2 = nint180((float)(rad_deg*atan2(r31, -r32)));
+			    n1 = nint180((float)(rad_deg*atan2(r13, r23)));
+			    if (n1 < 0) {n1 += 360;}
+			    if (n2 <= 0) {n2 = abs(n2);}
+			    else {n2 = 360 - n2;}
+			}
+			if (n1 >= 360){n1 = n1 % 360;}
+			if (n2 >= 360){n2 = n2 % 360;}
+
+			// store common-lines
+			com[c] = n1;
+			com[c+1] = n2;
+		}
+	}, 1024);
 
 	return com;
 
@@ -11894,26 +11929,114 @@ vector<double> Util::cml_line_in3d(vector<float> Ori, vector<int> seq, int, int
 	return cml;
 }
 
+namespace {
+	// Squared distance between two sinogram lines.  T is the type the
+	// difference is squared in, so that every caller keeps the precision and
+	// summation order of its original serial loop and results do not depend
+	// on the number of threads.
+	template<class T>
+	inline double cml_line_disc(const float* line_1, const float* line_2, int lnlen)
+	{
+		double buf = 0;
+		for (int i=0; i<lnlen; ++i) {
+			T tmp = line_1[i]-line_2[i];
+			buf += tmp*tmp;
+		}
+		return buf;
+	}
+
+	// get_data() may convert the storage of an image, so it is called once
+	// per sinogram before any parallel region
+	vector<float*> cml_sino_data(const vector<EMData*>& data)
+	{
+		vector<float*> rows(data.size());
+		for (size_t k=0; k<data.size(); ++k) rows[k] = data[k]->get_data();
+		return rows;
+	}
+
+	vector<double> cml_spin_psi_run(const vector<EMData*>& data, const vector<int>& com0, const float* weights, \
+				int iprj, const vector<int>& iw, int n_psi, int d_psi, int n_prj)
+	{
+		if (d_psi <= 0) throw InvalidValueException(d_psi, "cml_spin_psi: d_psi must be positive");
+		vector<double> res(2);
+		const int lnlen = data[0]->get_xsize();
+		const int end = 2*(n_prj-1);
+		const vector<float*> rows = cml_sino_data(data);
+		const size_t nstep = n_psi > 0 ? (n_psi + d_psi - 1) / d_psi : 0;
+		vector<double> discs(nstep);
+		// each chunk replays the psi updates up to its first step, so the
+		// common-lines it sees are exactly the ones of the serial loop
+		EMThreads::parallel_for(nstep, [&](size_t sb, size_t se, int) {
+			vector<int> com(com0);
+			for (size_t s=0; s<se; ++s) {
+				if (s >= sb) {
+					double disc = 0;
+					int c = 0;
+					for (int n=0; n<n_prj; ++n) {
+						if (n != iprj) {
+							const int ind = 2*c;
+							double buf = cml_line_disc<double>(rows[iprj] + com[ind]*lnlen, rows[n] + com[ind+1]*lnlen, lnlen);
+							if (weights) disc += buf * weights[iw[c]];
+							else         disc += buf;
+							++c;
+						}
+					}
+					discs[s] = disc;
+				}
+				// update common-lines
+				for (int i=0; i<end; i+=2) {
+					com[i] += d_psi;
+					if (com[i] >= n_psi) com[i] = com[i] - n_psi;
+				}
+			}
+		}, 4);
+		// select the best value, last one wins on ties as before
+		double bdisc = 1.0e6;
+		int bipsi = -1;
+		for (size_t s=0; s<nstep; ++s) {
+			if (discs[s] <= bdisc) {
+				bdisc = discs[s];
+				bipsi = s*d_psi;
+			}
+		}
+		res[0] = bdisc;
+		res[1] = float(bipsi);
+
+		return res;
+	}
+}
+
 double Util::cml_disc(const vector<EMData*>& data, vector<int> com, vector<int> seq, vector<float> weights, int n_lines) {
-	double res = 0;
-	double buf = 0;
-	float* line_1;
-	float* line_2;
-	int i, n, ind;
-	int lnlen = data[0]->get_xsize();
-	for (n=0; n<n_lines; ++n) {
-		ind = n*2;
-		line_1 = data[seq[ind]]->get_data() + com[ind] * lnlen;
-		line_2 = data[seq[ind+1]]->get_data() + com[ind+1] *lnlen;
-		buf = 0;
-		for (i=0; i<lnlen; ++i) {
-		    buf += (line_1[i]-line_2[i])*(line_1[i]-line_2[i]);
-		}
-		res += buf * weights[n];
+	if (n_lines <= 0) return 0;
+	com.resize(2*n_lines);
+	vector<double> res = cml_disc_batch(data, com, seq, weights, n_lines);
+	return res[0];
+}
+
+vector<double> Util::cml_disc_batch(const vector<EMData*>& data, const vector<int>& coms, const vector<int>& seq, const vector<float>& weights, int n_lines) {
+	if (n_lines <= 0 || coms.size() % (2*n_lines) != 0)
+		throw InvalidValueException(int(coms.size()), "cml_disc_batch: coms must hold 2*n_lines common-lines per candidate");
+	const size_t ncand = coms.size() / (2*n_lines);
+	const int lnlen = data[0]->get_xsize();
+	const vector<float*> rows = cml_sino_data(data);
+	// the lines of all candidates are evaluated together, then each
+	// candidate is reduced in line order
+	vector<double> bufs(ncand*n_lines);
+	EMThreads::parallel_for(bufs.size(), [&](size_t b, size_t e, int) {
+		for (size_t k=b; k<e; ++k) {
+			const size_t n = k % n_lines;
+			const int* com = &coms[2*k];
+			bufs[k] = cml_line_disc<float>(rows[seq[2*n]] + com[0]*lnlen, rows[seq[2*n+1]] + com[1]*lnlen, lnlen);
+		}
+	}, 16);
+	vector<double> res(ncand);
+	for (size_t j=0; j<ncand; ++j) {
+		double disc = 0;
+		for (int n=0; n<n_lines; ++n) disc += bufs[j*n_lines+n] * weights[n];
+		res[j] = disc;
 	}
 
 	return res;
-
 }
 
 vector<double> Util::cml_spin_psi(const vector<EMData*>& data, vector<int> com, vector<float> weights, \
@@ -11922,49 +12045,7 @@ vector<double> Util::cml_spin_psi(const vector<EMData*>& data, vector<int> com,
 	// res: [best_disc, best_ipsi]
 	// seq: pairwise indexes ij, 0, 1, 0, 2, 0, 3, 1, 2, 1, 3, 2, 3
 	// iw : index to know where is the weight for the common-lines on the current projection in the all weights, [12, 4, 2, 7]
-	vector<double> res(2);
-	int lnlen = data[0]->get_xsize();
-	int end = 2*(n_prj-1);
-	double disc, buf, bdisc, tmp;
-	int n, i, ipsi, ind, bipsi, c;
-	float* line_1;
-	float* line_2;
-	bdisc = 1.0e6;
-	bipsi = -1;
-	// loop psi
-	for(ipsi=0; ipsi<n_psi; ipsi += d_psi) {
-		// discrepancy
-		disc = 0;
-		c = 0;
-		for (n=0; n<n_prj; ++n) {
-			if(n!=iprj) {
-				ind = 2*c;
-				line_1 = data[iprj]->get_data() + com[ind] * lnlen;
-				line_2 = data[n]->get_data() + com[ind+1] * lnlen;
-				buf = 0;
-				for (i=0; i<lnlen; ++i) {
-					tmp = line_1[i]-line_2[i];
-					buf += tmp*tmp;
-				}
-				disc += buf * weights[iw[c]];
-				++c;
-			}
-		}
-		// select the best value
-		if (disc <= bdisc) {
-			bdisc = disc;
-			bipsi = ipsi;
-		}
-		// update common-lines
-		for (i=0; i<end; i+=2){
-			com[i] += d_psi;
-			if (com[i] >= n_psi) com[i] = com[i] - n_psi;
-		}
-	}
-	res[0] = bdisc;
-	res[1] = float(bipsi);
-
-	return res;
+	return cml_spin_psi_run(data, com, weights.data(), iprj, iw, n_psi, d_psi, n_prj);
 }
 
 vector<double> Util::cml_spin_psi_now(const vector<EMData*>& data, vector<int> com, \
@@ -11973,49 +12054,7 @@ vector<double> Util::cml_spin_psi_now(const vector<EMData*>& data, vector<int> c
 	// res: [best_disc, best_ipsi]
 	// seq: pairwise indexes ij, 0, 1, 0, 2, 0, 3, 1, 2, 1, 3, 2, 3
 	// iw : index to know where is the weight for the common-lines on the current projection in the all weights, [12, 4, 2, 7]
-	vector<double> res(2);
-	int lnlen = data[0]->get_xsize();
-	int end = 2*(n_prj-1);
-	double disc, buf, bdisc, tmp;
-	int n, i, ipsi, ind, bipsi, c;
-	float* line_1;
-	float* line_2;
-	bdisc = 1.0e6;
-	bipsi = -1;
-	// loop psi
-	for(ipsi=0; ipsi<n_psi; ipsi += d_psi) {
-		// discrepancy
-		disc = 0;
-		c = 0;
-		for (n=0; n<n_prj; ++n) {
-			if(n!=iprj) {
-				ind = 2*c;
-				line_1 = data[iprj]->get_data() + com[ind] * lnlen;
-				line_2 = data[n]->get_data() + com[ind+1] * lnlen;
-				buf = 0;
-				for (i=0; i<lnlen; ++i) {
-					tmp = line_1[i]-line_2[i];
-					buf += tmp*tmp;
-				}
-				disc += buf;
-				++c;
-			}
-		}
-		// select the best value
-		if (disc <= bdisc) {
-			bdisc = disc;
-			bipsi = ipsi;
-		}
-		// update common-lines
-		for (i=0; i<end; i+=2){
-			com[i] += d_psi;
-			if (com[i] >= n_psi) com[i] = com[i] - n_psi;
-		}
-	}
-	res[0] = bdisc;
-	res[1] = float(bipsi);
-
-	return res;
+	return cml_spin_psi_run(data, com, NULL, iprj, iw, n_psi, d_psi, n_prj);
 }
 
 /****************************************************
@@ -12134,53 +12173,49 @@ Dict Util::min_dist_four(EMData* image, const vector<EMData*>& data) {
 }
 
 int Util::k_means_cont_table_(int* group1, int* group2, int* stb, long int s1, long int s2, int flag) {
-    long int d2 = group2[s2 - 1] - group2[0];
-    long int p2 = 0;
-    long int i1 = 0;
-    long int i2 = 0;
-    long int max = 0;
+    // group2 is sorted, so every element of group1 is looked up by bisection
+    if (s2 <= 0) return 0;
     long int cont = 0;
-    long int i = 0;
-    int stop1 = 0;
-    int stop2 = 0;
-
-    for (i=0; i<s1; i++) {
-	p2 = (long int)(s2 * (double)group1[i] / (double)d2);
-	if (p2 >= s2) {p2 = s2 - 1;}
-	i1 = p2;
-	i2 = p2;
-	max = s2;
-	if (group1[i] < group2[0] || group1[i] > group2[s2 - 1]) {continue;}
-
-	stop1 = 0;
-	stop2 = 0;
-	while (max--) {
-	    if (group1[i] == group2[i1]) {
-		if (flag) {stb[cont] = group1[i];}
-		cont++;
-		break;
-	    }
-	    if (group2[i1] < group1[i]) {stop1=1;}
-	    if (group1[i] == group2[i2]) {
-		if (flag) {stb[cont] = group1[i];}
-		cont++;
-		break;
-	    }
-	    if (group2[i2] > group1[i]) {stop2=1;}
-	    //printf("i1 %li i2 %li    v2 %i v2 %i   stop1 %i stop2 %i\n", i1, i2, group2[i1], group2[i2], stop1, stop2);
-
-	    if (stop1 & stop2) {break;}
-	    i1--;
-	    i2++;
-	    if (i1 < 0) {i1 = 0;}
-	    if (i2 >= s2) {i2 = s2 - 1;}
+    for (long int i=0; i<s1; i++) {
+	if (std::binary_search(group2, group2 + s2, group1[i])) {
+	    if (flag) {stb[cont] = group1[i];}
+	    cont++;
 	}
-	//printf("v1: %i    ite: %li   cont: %li\n", group1[i], s2-max, cont);
     }
 
     return cont;
 }
 
+vector<int> Util::k_means_cont_table_all(const vector<int>& assign1, const vector<int>& assign2, int K1, int K2) {
+	if (assign1.size() != assign2.size())
+		throw InvalidValueException(int(assign2.size()), "k_means_cont_table_all: both partitions must label the same objects");
+	if (K1 <= 0 || K2 <= 0)
+		throw InvalidValueException(K1 <= 0 ? K1 : K2, "k_means_cont_table_all: number of classes must be positive");
+	const size_t n = assign1.size();
+	const size_t ncell = (size_t)K1*K2;
+	// every chunk counts into its own table, chunks are large enough to
+	// amortize clearing and summing the tables
+	const size_t grain = std::max(ncell, (size_t)65536);
+	const int nchunk = EMThreads::get_num_chunks(n, grain);
+	vector<int> part((size_t)nchunk*ncell, 0);
+	EMThreads::parallel_for(n, [&](size_t b, size_t e, int chunk) {
+		int* tab = &part[chunk*ncell];
+		for (size_t i=b; i<e; i++) {
+			int k1 = assign1[i], k2 = assign2[i];
+			if (k1 >= 0 && k1 < K1 && k2 >= 0 && k2 < K2) tab[(size_t)k1*K2 + k2]++;
+		}
+	}, grain);
+	vector<int> table(ncell, 0);
+	EMThreads::parallel_for(ncell, [&](size_t b, size_t e, int) {
+		for (int c=0; c<nchunk; c++) {
+			const int* tab = &part[c*ncell];
+			for (size_t k=b; k<e; k++) table[k] += tab[k];
+		}
+	}, 4096);
+
+	return table;
+}
+
 
 
 #define old_ptr(i,j,k)          old_ptr[i+(j+(k*ny))*(size_t)nx]
@@ -13317,6 +13352,16 @@ int Util::coveig(int n, float *covmat, float *eigval, float *eigvec)
 	return info;
 }
 
+bool Util::use_external_blas(bool use)
+{
+	return lapackblas_use_external(use);
+}
+
+bool Util::using_external_blas()
+{
+	return lapackblas_using_external();
+}
+
 Dict Util::coveig_for_py(int ncov, const vector<float>& covmatpy)
 {
 
@@ -26109,7 +26154,13 @@ float Util::polar_norm2( EMData* ring, const vector<int>& numr )
 
 void Util::Normalize_ring( EMData* ring, const vector<int>& numr, int norm_by_square )
 {
-    float* data = ring->get_data();
+    size_t n = (size_t)ring->get_xsize() * ring->get_ysize() * ring->get_zsize();
+    Normalize_ring_buf( ring->get_data(), n, numr, norm_by_square );
+    ring->update();
+}
+
+void Util::Normalize_ring_buf( float* data, size_t n, const vector<int>& numr, int norm_by_square )
+{
     float av=0.0;
     float sq=0.0;
     float nn=0.0;
@@ -26128,33 +26179,123 @@ void Util::Normalize_ring( EMData* ring, const vector<int>& numr, int norm_by_sq
 
     float avg = av/nn;
     float sgm = sqrt( (sq-av*av/nn)/nn );
-    size_t n = (size_t)ring->get_xsize() * ring->get_ysize() * ring->get_zsize();
     if( norm_by_square == 0) {
 		for( size_t i=0; i < n; ++i )  data[i] = (data[i] - avg)/sgm;
 	}  else  {
 		sq /= nn;
 		for( size_t i=0; i < n; ++i )  data[i] /= sq;
 	}
-
-    ring->update();
 }
 
-vector<float> Util::multiref_polar_ali_2d(EMData* image, const vector< EMData* >& crefim,
-                vector<float> xrng, vector<float> yrng, float step, string mode,
-                vector<int>numr, float cnx, float cny) {
+namespace {
+	/* Fourier transformed, normalized polar rings of one particle for every
+	   trial shift of a multiref search, computed once into a single buffer
+	   that all reference threads then read. */
+	struct MultirefRings
+	{
+		vector<float> sx, sy;
+		vector<float> data;
+		int lcirc;
 
-    // Manually extract.
-/*    vector< EMAN::EMData* > crefim;
-    std::size_t crefim_len = PyObject_Length(crefim_list.ptr());
-    crefim.reserve(crefim_len);
+		void add(float ix, float iy) { sx.push_back(ix); sy.push_back(iy); }
+		size_t size() const { return sx.size(); }
+		float* ring(size_t s) { return &data[s*lcirc]; }
 
-    for(std::size_t i=0;i<crefim_len;i++) {
-        boost::python::extract<EMAN::EMData*> proxy(crefim_list[i]);
-        crefim.push_back(proxy());
-    }
-*/
-	const float qv = static_cast<float>( pi/180.0 );
-	size_t crefim_len = crefim.size();
+		void compute(EMData* image, const vector<int>& numr, const string& cmode, float cnx, float cny)
+		{
+			int nring = numr.size()/3;
+			lcirc = numr[3*nring-2]+numr[3*nring-1]-1;
+			data.resize(size()*lcirc);
+
+			char mode = (cmode == "F" || cmode == "f") ? 'F' : 'H';
+			float* xim = image->get_data();
+			int nx = image->get_xsize();
+			int ny = image->get_ysize();
+			EMThreads::parallel_for(size(), [&](size_t b, size_t e, int) {
+				for (size_t s = b; s < e; s++) {
+					float* circ = ring(s);
+					Util::Polar2Dm_buf(xim, nx, ny, cnx+sx[s], cny+sy[s], numr, mode, circ);
+					Util::Normalize_ring_buf(circ, lcirc, numr, 0);
+				}
+				Util::Frngs_batch(ring(b), numr, e-b);
+			});
+		}
+	};
+
+	/* Best match of a multiref search. order is the position of the match in
+	   the serial search loops; keeping the later of two equal peaks makes the
+	   reduction over threads give exactly the serial answer. */
+	struct MultirefPeak
+	{
+		float peak, ang, sx, sy;
+		int mirror, nref;
+		size_t order;
+
+		MultirefPeak(int nref0 = 0) : peak(-1.0E23f), ang(0.0f), sx(0.0f), sy(0.0f), mirror(0), nref(nref0), order(0) {}
+
+		void update(double qn, float a, float x, float y, int m, int r, size_t o)
+		{
+			float q = static_cast<float>(qn);
+			if (q > peak || (q == peak && o >= order)) {
+				peak = q; ang = a; sx = x; sy = y; mirror = m; nref = r; order = o;
+			}
+		}
+
+		void update(const MultirefPeak& p)
+		{
+			if (p.peak > peak || (p.peak == peak && p.order >= order && p.peak != -1.0E23f)) *this = p;
+		}
+	};
+
+	/* Run f(i, best) for i in [0,n), partitioning the references (or reference
+	   directions) over threads, and reduce the per-thread peaks. */
+	template<class F>
+	MultirefPeak multiref_search(size_t n, int nref0, F f)
+	{
+		vector<MultirefPeak> best(EMThreads::get_num_chunks(n), MultirefPeak(nref0));
+		EMThreads::parallel_for(n, [&](size_t b, size_t e, int chunk) {
+			for (size_t i = b; i < e; i++) f(i, best[chunk]);
+		});
+		MultirefPeak res(nref0);
+		for (size_t c = 0; c < best.size(); c++) res.update(best[c]);
+		return res;
+	}
+
+	vector<float*> multiref_data(const vector<EMData*>& crefim)
+	{
+		// get_data() may expand half precision storage, so touch every
+		// reference before the threads start
+		vector<float*> refs(crefim.size());
+		for (size_t i = 0; i < crefim.size(); i++) refs[i] = crefim[i]->get_data();
+		return refs;
+	}
+
+	vector<float> multiref_result(const MultirefPeak& p, bool rotate_shift)
+	{
+		const float qv = static_cast<float>( pi/180.0 );
+		float sxs = p.sx, sys = p.sy;
+		if (rotate_shift) {
+			float co = static_cast<float>(  cos(p.ang*qv) );
+			float so = static_cast<float>( -sin(p.ang*qv) );
+			sxs = p.sx*co - p.sy*so;
+			sys = p.sx*so + p.sy*co;
+		}
+		vector<float> res;
+		res.push_back(p.ang);
+		res.push_back(sxs);
+		res.push_back(sys);
+		res.push_back(static_cast<float>(p.mirror));
+		res.push_back(static_cast<float>(p.nref));
+		res.push_back(p.peak);
+		return res;
+	}
+}
+
+vector<float> Util::multiref_polar_ali_2d(EMData* image, const vector< EMData* >& crefim,
+                vector<float> xrng, vector<float> yrng, float step, string mode,
+                vector<int>numr, float cnx, float cny) {
+
+	size_t crefim_len = crefim.size();
 
 // 	int   ky = int(2*yrng/step+0.5)/2;
 // 	int   kx = int(2*xrng/step+0.5)/2;
@@ -26162,74 +26303,35 @@ vector<float> Util::multiref_polar_ali_2d(EMData* image, const vector< EMData* >
 	int rkx = int(xrng[1]/step);
 	int lky = int(yrng[0]/step);
 	int rky = int(yrng[1]/step);
-	
-	int   iref, nref=0, mirror=0;
-	float iy, ix, sx=0, sy=0;
-	float peak = -1.0E23f;
-	float ang=0.0f;
+
+	MultirefRings rings;
 	for (int i = -lky; i <= rky; i++) {
-		iy = i * step ;
-		for (int j = -lkx; j <= rkx; j++) {
-			ix = j*step ;
-			EMData* cimage = Polar2Dm(image, cnx+ix, cny+iy, numr, mode);
+		for (int j = -lkx; j <= rkx; j++)  rings.add(j*step, i*step);
+	}
+	rings.compute(image, numr, mode, cnx, cny);
 
-			Normalize_ring( cimage, numr, 0 );
+	vector<float*> refs = multiref_data(crefim);
+	const size_t nshift = rings.size();
+	const int maxrin = numr[numr.size()-1];
 
-			Frngs(cimage, numr);
-			//  compare with all reference images
-			// for iref in xrange(len(crefim)):
-			for ( iref = 0; iref < (int)crefim_len; iref++) {
-				Dict retvals = Crosrng_ms(crefim[iref], cimage, numr, 0.0f);
-				double qn = retvals["qn"];
-				double qm = retvals["qm"];
-				if(qn >= peak || qm >= peak) {
-					sx = -ix;
-					sy = -iy;
-					nref = iref;
-					if (qn >= qm) {
-						ang = ang_n(retvals["tot"], mode, numr[numr.size()-1]);
-						peak = static_cast<float>(qn);
-						mirror = 0;
-					} else {
-						ang = ang_n(retvals["tmt"], mode, numr[numr.size()-1]);
-						peak = static_cast<float>(qm);
-						mirror = 1;
-					}
-				}
-			}  delete cimage; cimage = 0;
-		}	
-	}
+	//  compare all reference images with all shifted rings, references are split over threads
+	MultirefPeak best = multiref_search(crefim_len*nshift, 0, [&](size_t k, MultirefPeak& peak) {
+		size_t iref = k/nshift, s = k%nshift;
+		Dict retvals = Crosrng_ms_buf(refs[iref], rings.ring(s), numr, 0.0f);
+		double qn = retvals["qn"];
+		double qm = retvals["qm"];
+		size_t order = s*crefim_len + iref;
+		if (qn >= qm) peak.update(qn, ang_n(retvals["tot"], mode, maxrin), -rings.sx[s], -rings.sy[s], 0, iref, order);
+		else          peak.update(qm, ang_n(retvals["tmt"], mode, maxrin), -rings.sx[s], -rings.sy[s], 1, iref, order);
+	});
 
-	float co, so, sxs, sys;
-	co = static_cast<float>(  cos(ang*qv) );
-	so = static_cast<float>( -sin(ang*qv) );
-	sxs = sx*co - sy*so;
-	sys = sx*so + sy*co;
-	vector<float> res;
-	res.push_back(ang);
-	res.push_back(sxs);
-	res.push_back(sys);
-	res.push_back(static_cast<float>(mirror));
-	res.push_back(static_cast<float>(nref));
-	res.push_back(peak);
-	return res;
+	return multiref_result(best, true);
 }
 
 vector<float> Util::multiref_polar_ali_3d(EMData* image, const vector< EMData* >& crefim,
                 vector<float> xrng, vector<float> yrng, float step, string mode,
                 vector<int>numr, float cnx, float cny, float delta_psi) {
 
-    // Manually extract.
-/*    vector< EMAN::EMData* > crefim;
-    std::size_t crefim_len = PyObject_Length(crefim_list.ptr());
-    crefim.reserve(crefim_len);
-
-    for(std::size_t i=0;i<crefim_len;i++) {
-        boost::python::extract<EMAN::EMData*> proxy(crefim_list[i]);
-        crefim.push_back(proxy());
-    }
-*/
-	const float qv = static_cast<float>( pi/180.0 );
 	size_t crefim_len = crefim.size();
 
 	int lkx = int(xrng[0]/step);
@@ -26239,58 +26341,30 @@ vector<float> Util::multiref_polar_ali_3d(EMData* image, const vector< EMData* >
 	
 	int circle = max(lkx,max(lky,max(rkx,rky)));
 	circle = circle*circle;
-	
-	int   iref, nref=0, mirror=0;
-	float iy, ix, sxs=0, sys=0;
-	float peak = -1.0E23f;
-	float ang=0.0f;
+
+	MultirefRings rings;
 	for (int i = -lky; i <= rky; i++) {
-		iy = i * step ;
 		for (int j = -lkx; j <= rkx; j++) {
-			ix = j*step ;
-
-			if( i*i + j*j <= circle ) {
-
-				EMData* cimage = Polar2Dm(image, cnx+ix, cny+iy, numr, mode);
+			if( i*i + j*j <= circle )  rings.add(j*step, i*step);
+		}
+	}
+	rings.compute(image, numr, mode, cnx, cny);
 
-				Normalize_ring( cimage, numr, 0 );
+	vector<float*> refs = multiref_data(crefim);
+	const size_t nshift = rings.size();
+	const int maxrin = numr[numr.size()-1];
 
-				Frngs(cimage, numr);
-				//  compare with all reference images
-				// for iref in xrange(len(crefim)):
-				for ( iref = 0; iref < (int)crefim_len; iref++) {
-					Dict retvals = Crosrng_ms(crefim[iref], cimage, numr, delta_psi);
-					double qn = retvals["qn"];
-					double qm = retvals["qm"];
-				//printf(" ex within loop  %3d  %3d  %3d  %3d     %3d  %7.4f  %3d  %7.4f  %7.1f  %7.1f  \n",lkx,rkx,lky,rky,j,ix,i,iy,qn,qm);
-					if(qn >= peak || qm >= peak) {
-						sxs = -ix;
-						sys = -iy;
-						nref = iref;
-						if (qn >= qm) {
-							ang = ang_n(retvals["tot"], mode, numr[numr.size()-1]);
-							peak = static_cast<float>(qn);
-							mirror = 0;
-						} else {
-							ang = ang_n(retvals["tmt"], mode, numr[numr.size()-1]);
-							peak = static_cast<float>(qm);
-							mirror = 1;
-						}
-						//printf(" ex better within loop  %4.1f  %4.1f   %4.1f  %4.1f  \n",sxs,sys,ang,peak);
-					}
-				}  delete cimage; cimage = 0;
-			}
-		}	
-	}
+	MultirefPeak best = multiref_search(crefim_len*nshift, 0, [&](size_t k, MultirefPeak& peak) {
+		size_t iref = k/nshift, s = k%nshift;
+		Dict retvals = Crosrng_ms_buf(refs[iref], rings.ring(s), numr, delta_psi);
+		double qn = retvals["qn"];
+		double qm = retvals["qm"];
+		size_t order = s*crefim_len + iref;
+		if (qn >= qm) peak.update(qn, ang_n(retvals["tot"], mode, maxrin), -rings.sx[s], -rings.sy[s], 0, iref, order);
+		else          peak.update(qm, ang_n(retvals["tmt"], mode, maxrin), -rings.sx[s], -rings.sy[s], 1, iref, order);
+	});
 
-	vector<float> res;
-	res.push_back(ang);
-	res.push_back(sxs);
-	res.push_back(sys);
-	res.push_back(static_cast<float>(mirror));
-	res.push_back(static_cast<float>(nref));
-	res.push_back(peak);
-	return res;
+	return multiref_result(best, false);
 }
 
 vector<float> Util::multiref_polar_ali_2d_peaklist(EMData* image, const vector< EMData* >& crefim,
@@ -26304,56 +26378,37 @@ vector<float> Util::multiref_polar_ali_2d_peaklist(EMData* image, const vector<
 	int rkx = int(xrng[1]/step);
 	int lky = int(yrng[0]/step);
 	int rky = int(yrng[1]/step);
-		
-	float iy, ix;
-	vector<float> peak(crefim_len*5);  //, -1.0e23f);
-	for (int iref = 0; iref < (int)crefim_len; iref++) {
-		peak[iref*5] = -1.0e23f;
-		peak[iref*5+1] = 0.0f;
-		peak[iref*5+2] = 0.0;
-		peak[iref*5+3] = 0.0;
-		peak[iref*5+4] = 0;
-	}
-	
+
+	MultirefRings rings;
 	for (int i = -lky; i <= rky; i++) {
-		iy = i * step ;
-		for (int j = -lkx; j <= rkx; j++) {
-			ix = j*step ;
-			EMData* cimage = Polar2Dm(image, cnx+ix, cny+iy, numr, mode);
-			Normalize_ring( cimage, numr, 0 );
-			Frngs(cimage, numr);
-			for (int iref = 0; iref < (int)crefim_len; iref++) {
-				Dict retvals = Crosrng_ms(crefim[iref], cimage, numr, 0.0f);
-				double qn = retvals["qn"];
-				double qm = retvals["qm"];
-				if(qn >= peak[iref*5] || qm >= peak[iref*5]) {
-					peak[iref*5+2] = -ix;
-					peak[iref*5+3] = -iy;
-					if (qn >= qm) {
-						peak[iref*5] = static_cast<float>(qn);
-						peak[iref*5+1] = ang_n(retvals["tot"], mode, numr[numr.size()-1]);
-						peak[iref*5+4] = 0;
-					} else {
-						peak[iref*5] = static_cast<float>(qm);
-						peak[iref*5+1] = ang_n(retvals["tmt"], mode, numr[numr.size()-1]);
-						peak[iref*5+4] = 1;
-					}
-				}
-			}  delete cimage; cimage = 0;
-		}
+		for (int j = -lkx; j <= rkx; j++)  rings.add(j*step, i*step);
 	}
+	rings.compute(image, numr, mode, cnx, cny);
 
-	for (int iref = 0; iref < (int)crefim_len; iref++) {
-		float ang = peak[iref*5+1];
-		float sx  = peak[iref*5+2];
-		float sy  = peak[iref*5+3];
-		float co  =  cos(ang*qv);
-		float so  = -sin(ang*qv);
-		float sxs = sx*co - sy*so;
-		float sys = sx*so + sy*co;
-		peak[iref*5+2] = sxs;
-		peak[iref*5+3] = sys;
-	}
+	vector<float*> refs = multiref_data(crefim);
+	const int maxrin = numr[numr.size()-1];
+
+	// each reference keeps its own best peak, so the references can simply be split over threads
+	vector<float> peak(crefim_len*5);
+	EMThreads::parallel_for(crefim_len, [&](size_t b, size_t e, int) {
+		for (size_t iref = b; iref < e; iref++) {
+			MultirefPeak best;
+			for (size_t s = 0; s < rings.size(); s++) {
+				Dict retvals = Crosrng_ms_buf(refs[iref], rings.ring(s), numr, 0.0f);
+				double qn = retvals["qn"];
+				double qm = retvals["qm"];
+				if (qn >= qm) best.update(qn, ang_n(retvals["tot"], mode, maxrin), -rings.sx[s], -rings.sy[s], 0, iref, s);
+				else          best.update(qm, ang_n(retvals["tmt"], mode, maxrin), -rings.sx[s], -rings.sy[s], 1, iref, s);
+			}
+			float co  =  cos(best.ang*qv);
+			float so  = -sin(best.ang*qv);
+			peak[iref*5]   = best.peak;
+			peak[iref*5+1] = best.ang;
+			peak[iref*5+2] = best.sx*co - best.sy*so;
+			peak[iref*5+3] = best.sx*so + best.sy*co;
+			peak[iref*5+4] = best.mirror;
+		}
+	});
 	return peak;
 }
 
@@ -26427,24 +26482,60 @@ vector<float> Util::multiref_polar_ali_2d_peaklist_local(EMData* image, const ve
 }
 
 
-struct assign_groups_comparator {
-	const float * values;
-	bool operator() (int i,int j) { return (values[i] > values[j]); }
-	assign_groups_comparator(const float * v) : values(v) {}
-};
-
-vector<int> Util::assign_groups(std::string matrix_address, int nref, int nima)
-{
-	const float * matrix;
-	{ // convert memory address sent as string to pointer to float
+namespace {
+	// Sort on EMThreads: chunks are sorted independently and then merged
+	// pairwise.  comp must be a strict total order (break ties on an index),
+	// then the result does not depend on the number of threads.
+	template<class T, class C>
+	void parallel_sort(vector<T>& v, C comp)
+	{
+		const size_t n = v.size();
+		const int nchunk = EMThreads::get_num_chunks(n, 1<<16);
+		if (nchunk == 1) {
+			std::sort(v.begin(), v.end(), comp);
+			return;
+		}
+		vector<size_t> bnd(nchunk+1);
+		for (int c=0; c<=nchunk; c++) bnd[c] = n*c/nchunk;
+		EMThreads::parallel_for_each(nchunk, [&](size_t c, int) {
+			std::sort(v.begin()+bnd[c], v.begin()+bnd[c+1], comp);
+		});
+		vector<T> buf(n);
+		for (size_t w=1; w<(size_t)nchunk; w*=2) {
+			const size_t npair = (nchunk + 2*w - 1)/(2*w);
+			EMThreads::parallel_for_each(npair, [&](size_t p, int) {
+				const size_t lo = bnd[2*w*p];
+				const size_t mid = bnd[std::min(2*w*p + w, (size_t)nchunk)];
+				const size_t hi = bnd[std::min(2*w*p + 2*w, (size_t)nchunk)];
+				std::merge(v.begin()+lo, v.begin()+mid, v.begin()+mid, v.begin()+hi, buf.begin()+lo, comp);
+			});
+			v.swap(buf);
+		}
+	}
+
+	const float* matrix_from_address(const std::string& matrix_address)
+	{
+		// convert memory address sent as string to pointer to float
 		size_t addr = 0;
 		for ( std::string::const_iterator i = matrix_address.begin();  i != matrix_address.end();  ++i ) {
 			int digit = *i - '0';
 			addr *= 10;
 			addr += digit;
 		}
-		matrix = reinterpret_cast<float*>(addr);
+		return reinterpret_cast<const float*>(addr);
 	}
+}
+
+struct assign_groups_comparator {
+	const float * values;
+	// equal values keep their index order so the assignment is reproducible
+	bool operator() (int i,int j) const { return (values[i] > values[j]) || (values[i] == values[j] && i < j); }
+	assign_groups_comparator(const float * v) : values(v) {}
+};
+
+vector<int> Util::assign_groups(std::string matrix_address, int nref, int nima)
+{
+	const float * matrix = matrix_from_address(matrix_address);
 
 	int kt = nref;
 	unsigned int maxasi = nima/nref;
@@ -26459,7 +26550,7 @@ vector<int> Util::assign_groups(std::string matrix_address, int nref, int nima)
 			dd[i] = i;
 		}
 		assign_groups_comparator comparator(matrix);
-		sort(dd.begin(), dd.end(), comparator);
+		parallel_sort(dd, comparator);
 		// main loop
 		std::vector<bool> del_row(nref, false);
 		std::vector<bool> del_column(nima, false);
@@ -26499,6 +26590,324 @@ vector<int> Util::assign_groups(std::string matrix_address, int nref, int nima)
 	return id_list_1;
 }
 
+namespace {
+	struct AuctionBid {
+		double bid;
+		int ima;
+	};
+
+	// a held bid is better when it is higher, ties go to the lower image index
+	struct auction_bid_better {
+		bool operator() (const AuctionBid& a, const AuctionBid& b) const {
+			return a.bid > b.bid || (a.bid == b.bid && a.ima < b.ima);
+		}
+	};
+}
+
+vector<int> Util::assign_groups_auction(std::string matrix_address, int nref, int nima)
+{
+	if (nref <= 0 || nima < nref)
+		throw InvalidValueException(nima, "assign_groups_auction: need at least one image per group");
+	const float * matrix = matrix_from_address(matrix_address);
+
+	const int maxasi = nima/nref;
+	const int nrem = nima%nref;
+	const size_t nm = (size_t)nref*nima;
+
+	// range of the similarities, sets the scale of the bidding increments
+	const int nchunk = EMThreads::get_num_chunks(nm, 1<<16);
+	vector<float> cmin(nchunk, matrix[0]), cmax(nchunk, matrix[0]);
+	EMThreads::parallel_for(nm, [&](size_t b, size_t e, int c) {
+		for (size_t k=b; k<e; k++) {
+			cmin[c] = std::min(cmin[c], matrix[k]);
+			cmax[c] = std::max(cmax[c], matrix[k]);
+		}
+	}, 1<<16);
+	const float amin = *std::min_element(cmin.begin(), cmin.end());
+	const float amax = *std::max_element(cmax.begin(), cmax.end());
+	double range = double(amax) - double(amin);
+	if (!(range > 0)) range = 1.0;
+
+	// Equal-size assignment as a transportation problem: nref groups of
+	// maxasi places each, plus, when nima is not a multiple of nref, one
+	// group of nrem places that is worth amin to every image, so the auction
+	// also decides which images are left over.  Places of a group share a
+	// price, the lowest bid the group holds once it is full.
+	const int ngrp = nrem ? nref+1 : nref;
+	vector<int> cap(ngrp, maxasi);
+	if (nrem) cap[nref] = nrem;
+	vector<double> price(ngrp, 0.0);
+	vector< vector<AuctionBid> > held(ngrp);
+	auction_bid_better better;
+
+	const double eps_final = range*1.0e-6;
+	for (double eps = range/4; ; eps /= 8) {
+		const bool last = (eps <= eps_final);
+		if (last) eps = eps_final;
+		for (int g=0; g<ngrp; g++) held[g].clear();
+		vector<int> todo(nima);
+		for (int i=0; i<nima; i++) todo[i] = i;
+
+		while (!todo.empty()) {
+			// all unassigned images bid against the same prices, the bids are
+			// then resolved in image order
+			const size_t nt = todo.size();
+			vector<int> tgrp(nt);
+			vector<double> tbid(nt);
+			EMThreads::parallel_for(nt, [&](size_t b, size_t e, int) {
+				const size_t nb = e - b;
+				vector<double> v1(nb, -DBL_MAX), v2(nb, -DBL_MAX);
+				vector<int> g1(nb, 0);
+				for (int g=0; g<ngrp; g++) {
+					const float* row = matrix + (size_t)g*nima;
+					for (size_t t=0; t<nb; t++) {
+						double v = (g < nref ? double(row[todo[b+t]]) : double(amin)) - price[g];
+						if (v > v1[t]) { v2[t] = v1[t]; v1[t] = v; g1[t] = g; }
+						else if (v > v2[t]) v2[t] = v;
+					}
+				}
+				for (size_t t=0; t<nb; t++) {
+					tgrp[b+t] = g1[t];
+					if (ngrp == 1) tbid[b+t] = price[g1[t]] + eps;
+					else           tbid[b+t] = price[g1[t]] + (v1[t] - v2[t]) + eps;
+				}
+			}, 256);
+
+			vector<int> next;
+			for (size_t t=0; t<nt; t++) {
+				vector<AuctionBid>& h = held[tgrp[t]];
+				AuctionBid nb = {tbid[t], todo[t]};
+				if ((int)h.size() < cap[tgrp[t]]) {
+					h.push_back(nb);
+					std::push_heap(h.begin(), h.end(), better);
+				} else if (better(nb, h.front())) {
+					std::pop_heap(h.begin(), h.end(), better);
+					next.push_back(h.back().ima);
+					h.back() = nb;
+					std::push_heap(h.begin(), h.end(), better);
+				} else {
+					next.push_back(todo[t]);
+				}
+			}
+			for (int g=0; g<ngrp; g++) {
+				if ((int)held[g].size() == cap[g]) price[g] = held[g].front().bid;
+			}
+			std::sort(next.begin(), next.end());
+			todo.swap(next);
+		}
+		if (last) break;
+	}
+
+	vector< vector<int> > id_list(ngrp);
+	for (int g=0; g<ngrp; g++) {
+		for (size_t k=0; k<held[g].size(); k++) id_list[g].push_back(held[g][k].ima);
+		std::sort(id_list[g].begin(), id_list[g].end());
+	}
+	// the left over images join the group they match best together
+	int group = 0;
+	if (nrem) {
+		double best = -DBL_MAX;
+		for (int g=0; g<nref; g++) {
+			double q = 0.0;
+			for (int k=0; k<nrem; k++) q += matrix[(size_t)g*nima + id_list[nref][k]];
+			if (q > best) {
+				best = q;
+				group = g;
+			}
+		}
+	}
+
+	vector<int> id_list_1;
+	for (int iref=0; iref<nref; iref++)
+		for (int im=0; im<maxasi; im++)
+			id_list_1.push_back(id_list[iref][im]);
+	for (int im=0; im<nrem; im++)
+			id_list_1.push_back(id_list[nref][im]);
+	id_list_1.push_back(group);
+
+	return id_list_1;
+}
+
+namespace {
+	// kd-tree over direction vectors for the nearest projection direction
+	// queries below.  A subtree is skipped only when the largest dot product
+	// its bounding box admits is clearly below the current best, and the
+	// survivors are scored with the caller's own expression, so the answers,
+	// ties to the lowest index included, are those of a linear scan.
+	class DirTree
+	{
+	public:
+		// n vectors of 3 floats
+		DirTree(const float* v, int n) : pts(v, v+3*(size_t)n), id(n)
+		{
+			init();
+		}
+
+		explicit DirTree(const vector<vector<float> >& v) : pts(3*v.size()), id(v.size())
+		{
+			for (size_t i = 0; i < v.size(); i++) {
+				for (int t = 0; t < 3; t++) pts[3*i+t] = v[i][t];
+			}
+			init();
+		}
+
+		// index maximizing score(i) for the nq query vectors in q; bound is the
+		// largest of the dot products with q (abs: of their magnitudes)
+		template<class Score>
+		int best(const float* q, int nq, bool absval, Score score) const
+		{
+			float bv = 0.0f;
+			int bi = -1;
+			search(q, nq, absval, 1, score, &bv, &bi);
+			return bi;
+		}
+
+		// k highest scoring indices, best first, ties by lower index
+		template<class Score>
+		void top(const float* q, int nq, bool absval, int k, Score score, int* out) const
+		{
+			vector<float> bv(k);
+			vector<int> bi(k, -1);
+			search(q, nq, absval, k, score, &bv[0], &bi[0]);
+			for (int h = 0; h < k; h++) out[h] = bi[h];
+		}
+
+	private:
+		struct Node {
+			float lo[3], hi[3];
+			int begin, end, left, right;
+		};
+		static const int leaf_size = 16;
+		vector<float> pts;
+		vector<int> id;
+		vector<Node> nodes;
+
+		void init()
+		{
+			for (size_t i = 0; i < id.size(); i++) id[i] = i;
+			if (!id.empty()) build(0, id.size());
+		}
+
+		int build(int begin, int end)
+		{
+			Node nd;
+			for (int t = 0; t < 3; t++) nd.lo[t] = nd.hi[t] = pts[3*begin+t];
+			for (int i = begin+1; i < end; i++) {
+				for (int t = 0; t < 3; t++) {
+					nd.lo[t] = std::min(nd.lo[t], pts[3*i+t]);
+					nd.hi[t] = std::max(nd.hi[t], pts[3*i+t]);
+				}
+			}
+			nd.begin = begin;
+			nd.end = end;
+			nd.left = nd.right = -1;
+			int me = nodes.size();
+			nodes.push_back(nd);
+			if (end - begin <= leaf_size) return me;
+
+			int ax = 0;
+			for (int t = 1; t < 3; t++) {
+				if (nd.hi[t]-nd.lo[t] > nd.hi[ax]-nd.lo[ax]) ax = t;
+			}
+			vector<int> order(end - begin);
+			for (int i = begin; i < end; i++) order[i-begin] = i;
+			int mid = (end - begin)/2;
+			std::nth_element(order.begin(), order.begin()+mid, order.end(), [&](int a, int b) {
+				return pts[3*a+ax] < pts[3*b+ax] || (pts[3*a+ax] == pts[3*b+ax] && a < b);
+			});
+			vector<float> p(3*order.size());
+			vector<int> d(order.size());
+			for (size_t i = 0; i < order.size(); i++) {
+				for (int t = 0; t < 3; t++) p[3*i+t] = pts[3*order[i]+t];
+				d[i] = id[order[i]];
+			}
+			std::copy(p.begin(), p.end(), pts.begin()+3*begin);
+			std::copy(d.begin(), d.end(), id.begin()+begin);
+
+			int l = build(begin, begin+mid);
+			int r = build(begin+mid, end);
+			nodes[me].left = l;
+			nodes[me].right = r;
+			return me;
+		}
+
+		float bound(const Node& nd, const float* q, int nq, bool absval) const
+		{
+			float b = -1.0e30f;
+			for (int n = 0; n < nq; n++) {
+				const float* qn = q + 3*n;
+				float up = 0.0f, dn = 0.0f;
+				for (int t = 0; t < 3; t++) {
+					up += std::max(qn[t]*nd.lo[t], qn[t]*nd.hi[t]);
+					dn += std::min(qn[t]*nd.lo[t], qn[t]*nd.hi[t]);
+				}
+				b = std::max(b, absval ? std::max(up, -dn) : up);
+			}
+			return b;
+		}
+
+		// bv/bi hold the k best so far, best first; bi[k-1] < 0 while not full
+		template<class Score>
+		void search(const float* q, int nq, bool absval, int k, Score& score, float* bv, int* bi) const
+		{
+			// margin covering the rounding of bound() and score() against the
+			// exact dot products
+			const float margin = 1.0e-4f;
+			if (nodes.empty() || k <= 0) return;
+			// the tree is balanced, so its depth stays far below 64
+			int stack[128];
+			float stackb[128];
+			int top = 0;
+			stack[top] = 0;
+			stackb[top++] = bound(nodes[0], q, nq, absval);
+			while (top > 0) {
+				top--;
+				int ni = stack[top];
+				float nb = stackb[top];
+				if (bi[k-1] >= 0 && nb + margin < bv[k-1]) continue;
+				const Node& nd = nodes[ni];
+				if (nd.left < 0) {
+					for (int j = nd.begin; j < nd.end; j++) {
+						int i = id[j];
+						float v = score(i);
+						int h = k;
+						while (h > 0 && (bi[h-1] < 0 || v > bv[h-1] || (v == bv[h-1] && i < bi[h-1]))) h--;
+						if (h == k) continue;
+						for (int m = k-1; m > h; m--) {
+							bv[m] = bv[m-1];
+							bi[m] = bi[m-1];
+						}
+						bv[h] = v;
+						bi[h] = i;
+					}
+					continue;
+				}
+				float bl = bound(nodes[nd.left], q, nq, absval);
+				float br = bound(nodes[nd.right], q, nq, absval);
+				// the more promising child is searched first
+				if (bl >= br) {
+					stack[top] = nd.right; stackb[top++] = br;
+					stack[top] = nd.left;  stackb[top++] = bl;
+				} else {
+					stack[top] = nd.left;  stackb[top++] = bl;
+					stack[top] = nd.right; stackb[top++] = br;
+				}
+			}
+		}
+	};
+
+	// queries per task for the batched direction searches
+	const size_t dir_grain = 256;
+
+	// nearest_ang_f() through a DirTree of vecref
+	int nearest_dir_f(const DirTree& tree, const vector<vector<float> >& vecref, const float* q)
+	{
+		return tree.best(q, 1, false, [&](int i) {
+			return vecref[i][0]*q[0]+vecref[i][1]*q[1]+vecref[i][2]*q[2];
+		});
+	}
+}
+
 int Util::nearest_ang(const vector<float>& vecref, float x, float y, float z) {
 	float best_v = -1.0f;
 	int best_i = -1;
@@ -26597,6 +27006,68 @@ vector<int> Util::nearest_fang_sym(const vector<vector<float> >& angles_sym_norm
 
 
 
+vector<int> Util::nearest_fang_list(const vector<vector<float> >& vecref, const vector<vector<float> >& dirs) {
+	size_t ndir = dirs.size();
+	vector<int> bout(2*ndir);
+	DirTree tree(vecref);
+	EMThreads::parallel_for(ndir, [&](size_t b, size_t e, int) {
+		for (size_t k=b; k<e; k++) {
+			const float q[3] = {dirs[k][0], dirs[k][1], dirs[k][2]};
+			auto score = [&](int i) { return vecref[i][0]*q[0]+vecref[i][1]*q[1]+vecref[i][2]*q[2]; };
+			int best_i = tree.best(q, 1, false, score);
+			float best_v = -1.0f;
+			if (best_i >= 0 && score(best_i) > best_v)  best_v = score(best_i);
+			else best_i = -1;
+			bout[2*k] = best_i;
+			bout[2*k+1] = int(best_v*1000000);
+		}
+	}, dir_grain);
+	return bout;
+}
+
+vector<int> Util::nearest_fang_select_list(const vector<vector<float> >& vecref, const vector<vector<float> >& dirs, int howmany) {
+	if ( howmany > vecref.size() ) throw InvalidValueException(howmany,"Error, number of neighbors cannot be larger than number of reference directions");
+	size_t ndir = dirs.size();
+	vector<int> bout(howmany*ndir);
+	DirTree tree(vecref);
+	EMThreads::parallel_for(ndir, [&](size_t b, size_t e, int) {
+		for (size_t k=b; k<e; k++) {
+			const float q[3] = {dirs[k][0], dirs[k][1], dirs[k][2]};
+			tree.top(q, 1, false, howmany, [&](int i) {
+				return vecref[i][0]*q[0]+vecref[i][1]*q[1]+vecref[i][2]*q[2];
+			}, bout.data()+k*howmany);
+		}
+	}, dir_grain/8);
+	return bout;
+}
+
+vector<int> Util::nearest_fang_sym_list(const vector<vector<float> >& angles_sym_normals, const vector<vector<float> >& reference_normals, int neighbors, int howmany) {
+	if ( howmany > reference_normals.size() ) throw InvalidValueException(howmany,"Error, number of neighbors cannot be larger than number of reference directions");
+	if ( neighbors <= 0 || angles_sym_normals.size()%neighbors != 0 ) throw InvalidValueException(neighbors,"Error, number of symmetry normals is not a multiple of neighbors");
+	size_t ndir = angles_sym_normals.size()/neighbors;
+	vector<int> bout(howmany*ndir);
+	DirTree tree(reference_normals);
+	EMThreads::parallel_for(ndir, [&](size_t b, size_t e, int) {
+		vector<float> q(3*neighbors);
+		for (size_t k=b; k<e; k++) {
+			const vector<float>* sym = &angles_sym_normals[k*neighbors];
+			for (int n=0; n<neighbors; n++) {
+				for (int t=0; t<3; t++) q[3*n+t] = sym[n][t];
+			}
+			tree.top(q.data(), neighbors, false, howmany, [&](int i) {
+				float v = -1.0e10;
+				for (int n=0; n<neighbors; n++) {
+					float  qv = 0.0f;
+					for (int t=0; t<3; t++) qv += reference_normals[i][t]*sym[n][t];
+					if( qv > v )  v = qv;
+				}
+				return v;
+			}, bout.data()+k*howmany);
+		}
+	}, dir_grain/8);
+	return bout;
+}
+
 int Util::nearest_ang_f(const vector<vector<float> >& vecref, float x, float y, float z) {
 
 	float best_v = vecref[0][0]*x+vecref[0][1]*y+vecref[0][2]*z;
@@ -26629,11 +27100,17 @@ vector<int> Util::assign_projangles(const vector<float>& projangles, const vecto
 	vector<float> vecref(nref*3);
 	for (int i=0; i<nref; i++)
 		getvec(refangles[i*2], refangles[i*2+1], vecref[i*3], vecref[i*3+1], vecref[i*3+2]);
-	for (int i=0; i<nproj; i++) {
-		float x, y, z;
-		getvec(projangles[i*2], projangles[i*2+1], x, y, z);
-		asg[i] = nearest_ang(vecref, x, y, z);
-	}
+	//  same answers as nearest_ang() for every projection
+	DirTree tree(vecref.data(), nref);
+	EMThreads::parallel_for(nproj, [&](size_t b, size_t e, int) {
+		for (size_t i=b; i<e; i++) {
+			float q[3];
+			getvec(projangles[i*2], projangles[i*2+1], q[0], q[1], q[2]);
+			asg[i] = tree.best(q, 1, true, [&](int j) {
+				return abs(vecref[j*3]*q[0]+vecref[j*3+1]*q[1]+vecref[j*3+2]*q[2]);
+			});
+		}
+	}, dir_grain);
 	return asg;
 }
 
@@ -26647,11 +27124,14 @@ vector<int> Util::assign_projangles_f(const vector<vector<float> >& projangles,
 	for (int i=0; i<length_of_refangles; i++)
 		getfvec(refangles[i][0], refangles[i][1], reference_vectors[i][0], reference_vectors[i][1], reference_vectors[i][2]);
 
-	for (int i=0; i<length_of_projangles; i++) {
-		float x, y, z;
-		getfvec(projangles[i][0], projangles[i][1], x, y, z);
-		asg[i] = nearest_ang_f(reference_vectors, x, y, z);
-	}
+	DirTree tree(reference_vectors);
+	EMThreads::parallel_for(length_of_projangles, [&](size_t b, size_t e, int) {
+		for (size_t i=b; i<e; i++) {
+			float q[3];
+			getfvec(projangles[i][0], projangles[i][1], q[0], q[1], q[2]);
+			asg[i] = nearest_dir_f(tree, reference_vectors, q);
+		}
+	}, dir_grain);
 	return asg;
 }
 
@@ -26661,7 +27141,13 @@ vector<int> Util::assign_projdirs_f(const vector<vector<float> >& projdirs, cons
 
 	vector<int> asg(length_of_projdirs);
 
-	for (int i=0; i<length_of_projdirs; i++)   asg[i] = nearest_ang_f(refdirs, projdirs[i][0], projdirs[i][1], projdirs[i][2])/neighbors;
+	DirTree tree(refdirs);
+	EMThreads::parallel_for(length_of_projdirs, [&](size_t b, size_t e, int) {
+		for (size_t i=b; i<e; i++) {
+			float q[3] = {projdirs[i][0], projdirs[i][1], projdirs[i][2]};
+			asg[i] = nearest_dir_f(tree, refdirs, q)/neighbors;
+		}
+	}, dir_grain);
 
 	return asg;
 }
@@ -26679,10 +27165,18 @@ vector<float> Util::get_largest_angles_in_cones(const vector<vector<float> >& pr
 	for (int i=0; i<length_of_refangles; i++)
 		getfvec(refangles[i][0], refangles[i][1], reference_vectors[i][0], reference_vectors[i][1], reference_vectors[i][2]);
 
+	DirTree tree(reference_vectors);
+	EMThreads::parallel_for(length_of_projangles, [&](size_t b, size_t e, int) {
+		for (size_t i=b; i<e; i++) {
+			float q[3];
+			getfvec(projangles[i][0], projangles[i][1], q[0], q[1], q[2]);
+			asg[i] = nearest_dir_f(tree, reference_vectors, q);
+		}
+	}, dir_grain);
+
 	for (int i=0; i<length_of_projangles; i++) {
 		float x, y, z;
 		getfvec(projangles[i][0], projangles[i][1], x, y, z);
-		asg[i] = nearest_ang_f(reference_vectors, x, y, z);
 		float image_cone_direction_angle = acos(abs(reference_vectors[asg[i]][0]*x + reference_vectors[asg[i]][1]*y + reference_vectors[asg[i]][2]*z))/pi180;
 		if (image_cone_direction_angle > largest_angles[asg[i]])
 		  largest_angles[asg[i]] = image_cone_direction_angle;
@@ -26720,27 +27214,19 @@ vector<int> Util::nearestk_to_refdir(const vector<float>& projangles, const vect
 		getvec(projangles[i*2], projangles[i*2+1], vecproj[i*3], vecproj[i*3+1], vecproj[i*3+2]);
 
 
-	vector<bool> taken(nproj);
-	for (int k=0; k<nref; k++) {
-		for (int i=0; i<nproj; i++)  taken[i] = true;
-		float x, y, z;
-		getvec(refangles[k*2], refangles[k*2+1], x, y, z);
-		for (int h=0; h<howmany; h++) {
-			float best_v = -1.0f;
-			int best_i = -1;
-			for (int i=0; i<nproj; i++) {
-				if( taken[i] ) {
-					float v = abs(vecproj[i*3]*x+vecproj[i*3+1]*y+vecproj[i*3+2]*z);
-					if (v > best_v) {
-						best_v = v;
-						best_i = i;
-					}
-				}
-			}
-			asg[k*howmany + h] = best_i;
-			taken[best_i] = false;
+	if (howmany > nproj) throw InvalidValueException(howmany, "Error, howmany cannot be larger than number of projections");
+
+	//  the howmany projections taken one by one by largest |cos|, ties to the lower index
+	DirTree tree(vecproj.data(), nproj);
+	EMThreads::parallel_for(nref, [&](size_t b, size_t e, int) {
+		for (size_t k=b; k<e; k++) {
+			float q[3];
+			getvec(refangles[k*2], refangles[k*2+1], q[0], q[1], q[2]);
+			tree.top(q, 1, true, howmany, [&](int i) {
+				return abs(vecproj[i*3]*q[0]+vecproj[i*3+1]*q[1]+vecproj[i*3+2]*q[2]);
+			}, asg.data()+k*howmany);
 		}
-	}
+	}, 16);
 	return asg;
 }
 
@@ -27183,10 +27669,7 @@ vector<float> Util::multiref_polar_ali_2d_local(EMData* image, const vector< EMD
 	int rkx = int(xrng[1]/step);
 	int lky = int(yrng[0]/step);
 	int rky = int(yrng[1]/step);
-	int   iref, nref=0, mirror=0;
-	float iy, ix, sx=0, sy=0;
-	float peak = -1.0E23f;
-	float ang  = 0.0f;
+	int   iref, mirror=0;
 
 	size_t crefim_len = crefim.size();
 	const float qv = static_cast<float>( pi/180.0 );
@@ -27202,6 +27685,7 @@ vector<float> Util::multiref_polar_ali_2d_local(EMData* image, const vector< EMD
     //  tsym is a vector of transforms that are input transofrmation multiplied by all symmetries.
     // its length is number of symmetries.
     vector<Transform> tsym = t->get_sym_proj(sym);
+    delete t; t = 0;
 
     int isym = 0;
     int nsym = tsym.size();
@@ -27219,66 +27703,47 @@ vector<float> Util::multiref_polar_ali_2d_local(EMData* image, const vector< EMD
         vIms[isym].ims3 = cos(theta*qv);
     }
 
-	for (iref = 0; iref < crefim_len; iref++) {
-
-	    float ref_theta = crefim[iref]->get_attr("theta");
-	    float ref_phi = crefim[iref]->get_attr("phi");
-	    float ref_psi = crefim[iref]->get_attr("psi");
-
+	// references within ant of any symmetry related direction of the image; the
+	// comparison does not depend on the symmetry, so each is searched once
+	vector<int> use;
+	for (iref = 0; iref < (int)crefim_len; iref++) {
 		float n1 = crefim[iref]->get_attr("n1");
 		float n2 = crefim[iref]->get_attr("n2");
 		float n3 = crefim[iref]->get_attr("n3");
 
-
-
 		for (isym = 0; isym < nsym; ++isym) {
 			float dot_product = -mirror*(n1*vIms[isym].ims1 + n2*vIms[isym].ims2 + n3*vIms[isym].ims3);
 			if(dot_product >= ant) {
-				for (int i = -lky; i <= rky; i++) {
-					iy = i * step ;
-					for (int j = -lkx; j <= rkx; j++) {
-						ix = j*step;
-						EMData* cimage = Polar2Dm(image, cnx+ix, cny+iy, numr, mode);
-						Normalize_ring( cimage, numr, 0 );
-						Frngs(cimage, numr);
-						//  compare with all reference images that are on a new list
-						Dict retvals = Crosrng_e(crefim[iref], cimage, numr, mirror, 0.0f);
-						double qn = retvals["qn"];
-
-						if(qn >= peak) {
-							sx = -ix;
-							sy = -iy;
-							nref = iref;
-							ang = ang_n(retvals["tot"], mode, numr[numr.size()-1]);
-							peak = static_cast<float>( qn );
-						}
-						delete cimage; cimage = 0;
-					}
-				}
+				use.push_back(iref);
+				break;
 			}
 		}
 	}
 
-	float co, so, sxs, sys;
-	if(peak == -1.0E23) {
-		ang=0.0; sxs=0.0; sys=0.0; mirror=0;
-		nref = -1;
-	} else {
-		co  =  cos(ang*qv);
-		so  = -sin(ang*qv);
-		sxs = sx*co - sy*so;
-		sys = sx*so + sy*co;
-		if( mirror == -1)  mirror=0;
+	MultirefRings rings;
+	if (!use.empty()) {
+		for (int i = -lky; i <= rky; i++) {
+			for (int j = -lkx; j <= rkx; j++)  rings.add(j*step, i*step);
+		}
+		rings.compute(image, numr, mode, cnx, cny);
 	}
 
-	vector<float> res;
-	res.push_back(ang);
-	res.push_back(sxs);
-	res.push_back(sys);
-	res.push_back(static_cast<float>(mirror));
-	res.push_back(static_cast<float>(nref));
-	res.push_back(peak);
-	return res;
+	vector<float*> refs = multiref_data(crefim);
+	const size_t nshift = rings.size();
+	const int maxrin = numr[numr.size()-1];
+
+	MultirefPeak best = multiref_search(use.size()*nshift, 0, [&](size_t k, MultirefPeak& peak) {
+		size_t iref = use[k/nshift], s = k%nshift;
+		Dict retvals = Crosrng_e_buf(refs[iref], rings.ring(s), numr, mirror, 0.0f);
+		double qn = retvals["qn"];
+		peak.update(qn, ang_n(retvals["tot"], mode, maxrin), -rings.sx[s], -rings.sy[s], 0, iref, iref*nshift + s);
+	});
+
+	// The serial code compared the float peak with the double -1.0E23, which
+	// never matched, so with no reference in range it returned nref 0 and
+	// peak -1.0E23. Callers have always seen that result and it is kept.
+	if( mirror == 1 )  best.mirror = 1;
+	return multiref_result(best, true);
 }
 
 vector<float> Util::multiref_polar_ali_3d_local(EMData* image, const vector< EMData* >& crefim,
@@ -27308,29 +27773,23 @@ vector<float> Util::multiref_polar_ali_3d_local(EMData* image, const vector< EMD
 	int rkx = int(xrng[1]/step);
 	int lky = int(yrng[0]/step);
 	int rky = int(yrng[1]/step);
-	vector< vector<EMData*> > cimages( lky+rky+1, vector<EMData*>(lkx+rkx+1) );
-
 
 	int circle = max(lkx,max(lky,max(rkx,rky)));
 	circle = circle*circle;
 
-
-	int   iref, nref=0, niu=-1, mirror=0;
-	float iy, ix, sxs=0, sys=0;
-	float peak = -1.0E23f;
-	float ang  = 0.0f;
-
 	const float qv = static_cast<float>( pi/180.0 );
 
 	Dict d = t->get_params("spider");
+	delete t; t = 0;
 	float phi   = (float)d["phi"] * qv;
 	float theta = (float)d["theta"] * qv;
 	float n1 = sin(theta)*cos(phi);
 	float n2 = sin(theta)*sin(phi);
 	float n3 = cos(theta);
 
-	bool compute_cimages = true;
-	bool process_image = false;
+	// reference directions within ant of the image, with the reference and mirror flag each one uses
+	vector<unsigned> use;
+	vector<int> use_ref, use_mirror;
 	for (unsigned iu = 0; iu < list_of_reference_angles_length; iu++) {
 
 		float m_phi   = list_of_reference_angles[iu][0] * qv;
@@ -27342,73 +27801,38 @@ vector<float> Util::multiref_polar_ali_3d_local(EMData* image, const vector< EMD
 		float dot_product = n1*m1 + n2*m2 + n3*m3;
 
 		if(dot_product >= ant) {
-			process_image = true;
 			// iref is the reference to refrings
-			iref = cone_mode ? list_of_reference_angles[iu][4] : iu % crefim_len_original_only_from_asymmetric_unit;
-
-			if( compute_cimages ) {
-				compute_cimages = false;
-				for (int i = -lky; i <= rky; i++) {
-					iy = i * step ;
-					for (int j = -lkx; j <= rkx; j++) {
-						ix = j*step ;
-
-						if( i*i + j*j <= circle ) {
-                            EMData* cimage = Polar2Dm(image, cnx+ix, cny+iy, numr, mode);
-                            Normalize_ring( cimage, numr, 0 );
-                            Frngs(cimage, numr);
-                            cimages[i+lky][j+lkx] = cimage;
-						}
-					}
-				}
-			}
+			use.push_back(iu);
+			use_ref.push_back(cone_mode ? list_of_reference_angles[iu][4] : iu % crefim_len_original_only_from_asymmetric_unit);
+			use_mirror.push_back(cone_mode ? (((int)list_of_reference_angles[iu][3]/crefim_len_original_only_from_asymmetric_unit)%2) : ((iu/crefim_len_original_only_from_asymmetric_unit)%2));
+		}
+	}
 
-			for (int i = -lky; i <= rky; i++) {
-				iy = i * step ;
-				for (int j = -lkx; j <= rkx; j++) {
-					ix = j*step;
-
-					if( i*i + j*j <= circle ) {
-
-                        int compmirror = cone_mode ? (((int)list_of_reference_angles[iu][3]/crefim_len_original_only_from_asymmetric_unit)%2) : ((iu/crefim_len_original_only_from_asymmetric_unit)%2);
-                        Dict retvals = Crosrng_e(crefim[iref], cimages[i+lky][j+lkx], numr, compmirror, delta_psi);
-                        double qn = retvals["qn"];
-                        
-                        if(qn >= peak) {
-                            sxs = -ix;
-                            sys = -iy;
-                            nref = iref;
-                            mirror = compmirror;
-                            ang = ang_n(retvals["tot"], mode, numr[numr.size()-1]);
-                            peak = static_cast<float>( qn );
-                        }
-                        //delete cimage; cimage = 0;
-					}
-				}
+	MultirefRings rings;
+	if (!use.empty()) {
+		for (int i = -lky; i <= rky; i++) {
+			for (int j = -lkx; j <= rkx; j++) {
+				if( i*i + j*j <= circle )  rings.add(j*step, i*step);
 			}
 		}
+		rings.compute(image, numr, mode, cnx, cny);
 	}
 
-	if(peak == -1.0E23) {
-		ang=0.0; sxs=0.0; sys=0.0; mirror=0;
-		nref = -1;
-	}
+	vector<float*> refs = multiref_data(crefim);
+	const size_t nshift = rings.size();
+	const int maxrin = numr[numr.size()-1];
 
-	for (unsigned i = 0; i < cimages.size(); ++i) {
-		for (unsigned j = 0; j < cimages[i].size(); ++j) {
-			delete cimages[i][j];
-			cimages[i][j] = NULL;
-		}
-	}
+	MultirefPeak best = multiref_search(use.size()*nshift, 0, [&](size_t k, MultirefPeak& peak) {
+		size_t u = k/nshift, s = k%nshift;
+		int iref = use_ref[u];
+		Dict retvals = Crosrng_e_buf(refs[iref], rings.ring(s), numr, use_mirror[u], delta_psi);
+		double qn = retvals["qn"];
+		peak.update(qn, ang_n(retvals["tot"], mode, maxrin), -rings.sx[s], -rings.sy[s], use_mirror[u], iref, use[u]*nshift + s);
+	});
 
-	vector<float> res;
-	res.push_back(ang);
-	res.push_back(sxs);
-	res.push_back(sys);
-	res.push_back(static_cast<float>(mirror));
-	res.push_back(static_cast<float>(nref));
-	res.push_back(peak);
-	return res;
+	// with no reference in range this is nref 0 and peak -1.0E23, as the
+	// serial code returned (see multiref_polar_ali_2d_local)
+	return multiref_result(best, false);
 }
 
 vector<float> Util::shc(EMData* image, const vector< EMData* >& crefim,
@@ -27940,12 +28364,7 @@ vector<float> Util::multiref_polar_ali_helical(EMData* image, const vector< EMDa
                 vector<int>numr, float cnx, float cny, int ynumber) {
 	
 	size_t crefim_len = crefim.size();
-	const float qv = static_cast<float>( pi/180.0 );
 
-	int   iref, nref=0, mirror=0;
-	float iy, ix, sx=0, sy=0;
-	float peak = -1.0E23f;
-	float ang=0.0f;
 // 	int   kx = int(2*xrng/step+0.5)/2;
 	int lkx = int(xrng[0]/step);
 	int rkx = int(xrng[1]/step);
@@ -27971,85 +28390,43 @@ vector<float> Util::multiref_polar_ali_helical(EMData* image, const vector< EMDa
 	   	 kystart = rky;
 	} else {
 //	    ky = int(ynumber/2);		
-		stepy=(yrng[0]+yrng[1])/ynumber;		//2-25-2015@ming 
-		lky = int(yrng[0]/stepy);
-		rky = int(yrng[1]/stepy);
-//		kystart = -lky + 1;  
-		kystart = -lky;   
-	}
-	//std::cout<<"yrng="<<yrng<<"ynumber="<<ynumber<<"stepy=="<<stepy<<"stepx=="<<step<<std::endl;
-	for (int i = kystart; i <= rky; i++) {
-		iy = i * stepy ;
-		for (int j = -lkx; j <= rkx; j++) {
-			ix = j*step ;
-			EMData* cimage = Polar2Dm(image, cnx+ix, cny+iy, numr, mode);
-
-			Normalize_ring( cimage, numr, 0 );
-
-			Frngs(cimage, numr);
-			//  compare with all reference images
-			// for iref in xrange(len(crefim)):
-			for ( iref = 0; iref < (int)crefim_len; iref++) {
-				Dict retvals_0   = Crosrng_psi(crefim[iref], cimage, numr,   0, psi_max);
-				Dict retvals_180 = Crosrng_psi(crefim[iref], cimage, numr, 180, psi_max);
-				double qn_0   = retvals_0["qn"];
-				double qn_180 = retvals_180["qn"];
-				double qm_0   = retvals_0["qm"];
-				double qm_180 = retvals_180["qm"];
-				double qn;
-				double qm;
-				bool   qn_is_zero = false;
-				bool   qm_is_zero = false;
-
-				if (qn_0 >= qn_180) {
-					qn = qn_0;
-					qn_is_zero = true;
-				} else {
-					qn = qn_180;
-					qn_is_zero = false; 
-				}
-
-				if (qm_0 >= qm_180) {
-					qm = qm_0;
-					qm_is_zero = true;
-				} else {
-					qm = qm_180;
-					qm_is_zero = false; 
-				}
-
-				if(qn >= peak || qm >= peak) {
-					sx = -ix;
-					sy = -iy;
-					nref = iref;
-					if (qn >= qm) {
-						if (qn_is_zero) ang = ang_n(retvals_0["tot"], mode, numr[numr.size()-1]);
-						else            ang = ang_n(retvals_180["tot"], mode, numr[numr.size()-1]);
-						peak = static_cast<float>(qn);
-						mirror = 0;
-					} else {
-						if (qm_is_zero) ang = ang_n(retvals_0["tmt"], mode, numr[numr.size()-1]);
-						else            ang = ang_n(retvals_180["tmt"], mode, numr[numr.size()-1]);
-						peak = static_cast<float>(qm);
-						mirror = 1;
-					}
-				}
-			}
-			delete cimage; cimage = 0;
-		}
+		stepy=(yrng[0]+yrng[1])/ynumber;		//2-25-2015@ming 
+		lky = int(yrng[0]/stepy);
+		rky = int(yrng[1]/stepy);
+//		kystart = -lky + 1;  
+		kystart = -lky;   
 	}
-	float co, so, sxs, sys;
-	co = static_cast<float>(  cos(ang*qv) );
-	so = static_cast<float>( -sin(ang*qv) );
-	sxs = sx*co - sy*so;
-	sys = sx*so + sy*co;
-	vector<float> res;
-	res.push_back(ang);
-	res.push_back(sxs);
-	res.push_back(sys);
-	res.push_back(static_cast<float>(mirror));
-	res.push_back(static_cast<float>(nref));
-	res.push_back(peak);
-	return res;
+	//std::cout<<"yrng="<<yrng<<"ynumber="<<ynumber<<"stepy=="<<stepy<<"stepx=="<<step<<std::endl;
+	MultirefRings rings;
+	for (int i = kystart; i <= rky; i++) {
+		for (int j = -lkx; j <= rkx; j++)  rings.add(j*step, i*stepy);
+	}
+	rings.compute(image, numr, mode, cnx, cny);
+
+	vector<float*> refs = multiref_data(crefim);
+	const size_t nshift = rings.size();
+	const int maxrin = numr[numr.size()-1];
+
+	MultirefPeak best = multiref_search(crefim_len*nshift, 0, [&](size_t k, MultirefPeak& peak) {
+		size_t iref = k/nshift, s = k%nshift;
+		float* cimage = rings.ring(s);
+		Dict retvals_0   = Crosrng_psi_buf(refs[iref], cimage, numr,   0, psi_max);
+		Dict retvals_180 = Crosrng_psi_buf(refs[iref], cimage, numr, 180, psi_max);
+		double qn_0   = retvals_0["qn"];
+		double qn_180 = retvals_180["qn"];
+		double qm_0   = retvals_0["qm"];
+		double qm_180 = retvals_180["qm"];
+		Dict& retvals_n = (qn_0 >= qn_180) ? retvals_0 : retvals_180;
+		Dict& retvals_m = (qm_0 >= qm_180) ? retvals_0 : retvals_180;
+		double qn = retvals_n["qn"];
+		double qm = retvals_m["qm"];
+
+		size_t order = s*crefim_len + iref;
+		if (qn >= qm) peak.update(qn, ang_n(retvals_n["tot"], mode, maxrin), -rings.sx[s], -rings.sy[s], 0, iref, order);
+		else          peak.update(qm, ang_n(retvals_m["tmt"], mode, maxrin), -rings.sx[s], -rings.sy[s], 1, iref, order);
+	});
+
+	return multiref_result(best, true);
 }
 
 vector<float> Util::multiref_polar_ali_helical_local(EMData* image, const vector< EMData* >& crefim,
@@ -28059,11 +28436,8 @@ vector<float> Util::multiref_polar_ali_helical_local(EMData* image, const vector
 	size_t crefim_len = crefim.size();
 	const float qv = static_cast<float>( pi/180.0 );
 
-	int   iref, nref=-1, mirror=0;
-	float iy, ix, sx=0, sy=0;
-	float peak = -1.0E23f;
+	int   iref;
 	float jneginf = -2.0E23f;
-	float ang=0.0f;
 	Transform * t = image->get_attr("xform.projection");
 	Dict d = t->get_params("spider");
 	if(t) {delete t; t=0;}
@@ -28081,10 +28455,6 @@ vector<float> Util::multiref_polar_ali_helical_local(EMData* image, const vector
 		n2[iref] = crefim[iref]->get_attr("n2");
 		n3[iref] = crefim[iref]->get_attr("n3");		
 	}
-	float nbrinp;
-	float nbrinp_mirror;
-	bool  use_ref;
-	bool  use_ref_mirror;
 //	int   kx = int(2*xrng/step+0.5)/2;
 //	int   ky;
 	int lkx = int(xrng[0]/step);
@@ -28116,78 +28486,48 @@ vector<float> Util::multiref_polar_ali_helical_local(EMData* image, const vector
 		}
 	}
 
-	for (int i = -lky; i <= rky; i++) {
-		iy = i * stepy ;
-		for (int j = -lkx; j <= rkx; j++) {
-			ix = j*step ;
-			EMData* cimage = Polar2Dm(image, cnx+ix, cny+iy, numr, mode);
-			Normalize_ring( cimage, numr, 0 );
-	
-			Frngs(cimage, numr);
-			//  Compare with All reference images within neighborhood ant
-			// for iref in xrange(len(crefim)):
-			for ( iref = 0; iref < (int)crefim_len; iref++) {
-
-				use_ref = false;
-				use_ref_mirror = false;
+	// inner products of the references' (and their mirrors') Eulerian angles with that of the data
+	vector<int> use_ref(crefim_len), use_ref_mirror(crefim_len);
+	for ( iref = 0; iref < (int)crefim_len; iref++) {
+		use_ref[iref]        = (n1[iref]*imn1 + n2[iref]*imn2 + n3[iref]*imn3 >= ant);
+		use_ref_mirror[iref] = (n3[iref]*imn3 - n1[iref]*imn1 - n2[iref]*imn2 >= ant);
+	}
+	const float psi_ref = ((psi-90.0f) < 90.0f) ? 0.0f : 180.0f;
 
-				// inner product of iref's Eulerian angles with that of the data
-				nbrinp = n1[iref]*imn1 + n2[iref]*imn2 + n3[iref]*imn3;
-				if (nbrinp >= ant)   use_ref = true;
+	MultirefRings rings;
+	for (int i = -lky; i <= rky; i++) {
+		for (int j = -lkx; j <= rkx; j++)  rings.add(j*step, i*stepy);
+	}
+	rings.compute(image, numr, mode, cnx, cny);
 
-				// inner product of the mirror of iref's Eulerian angles with that of the data
-				nbrinp_mirror = n3[iref]*imn3 - n1[iref]*imn1 - n2[iref]*imn2;
-				if (nbrinp_mirror >= ant)  use_ref_mirror = true;
-				if(use_ref || use_ref_mirror){
+	vector<float*> refs = multiref_data(crefim);
+	const size_t nshift = rings.size();
+	const int maxrin = numr[numr.size()-1];
 
-					Dict retvals;
-					Dict retvals_mirror;
-					if (use_ref_mirror == true) {
-						if ((psi-90.0f) < 90.0f) retvals_mirror = Crosrng_sm_psi(crefim[iref], cimage, numr,   0.0f, 1, psi_max);
-						else                     retvals_mirror = Crosrng_sm_psi(crefim[iref], cimage, numr, 180.0f, 1, psi_max);
-					}
-					if (use_ref == true) {
-						if ((psi-90.0f) < 90.0f) retvals = Crosrng_sm_psi(crefim[iref], cimage, numr,   0.0f, 0, psi_max);
-						else                     retvals = Crosrng_sm_psi(crefim[iref], cimage, numr, 180.0f, 0, psi_max);
-					}
-					double qn = jneginf;
-					if (use_ref) qn = retvals["qn"];
-					double qm = jneginf;
-					if (use_ref_mirror) qm = retvals_mirror["qn"];
+	//  Compare with All reference images within neighborhood ant
+	MultirefPeak best = multiref_search(crefim_len*nshift, -1, [&](size_t k, MultirefPeak& peak) {
+		size_t iref = k/nshift, s = k%nshift;
+		if (!use_ref[iref] && !use_ref_mirror[iref])  return;
 
-					if(qn >= peak || qm >= peak) {
-						sx = -ix;
-						sy = -iy;
-						nref = iref;
-						if (qn >= qm){
-							ang = ang_n(retvals["tot"], mode, numr[numr.size()-1]);
-							mirror = 0;
-							peak = static_cast<float>(qn);
-						} else {
-							ang = ang_n(retvals_mirror["tot"], mode, numr[numr.size()-1]);
-							mirror = 1;
-							peak = static_cast<float>(qm);
-						}
-					}
-				}
-			}
-			delete cimage; cimage = 0;
+		Dict retvals;
+		Dict retvals_mirror;
+		double qn = jneginf;
+		double qm = jneginf;
+		if (use_ref_mirror[iref]) {
+			retvals_mirror = Crosrng_sm_psi_buf(refs[iref], rings.ring(s), numr, psi_ref, 1, psi_max);
+			qm = retvals_mirror["qn"];
+		}
+		if (use_ref[iref]) {
+			retvals = Crosrng_sm_psi_buf(refs[iref], rings.ring(s), numr, psi_ref, 0, psi_max);
+			qn = retvals["qn"];
 		}
-	}
 
-	float co, so, sxs, sys;
-	co = static_cast<float>(  cos(ang*qv) );
-	so = static_cast<float>( -sin(ang*qv) );
-	sxs = sx*co - sy*so;
-	sys = sx*so + sy*co;
-	vector<float> res;
-	res.push_back(ang);
-	res.push_back(sxs);
-	res.push_back(sys);
-	res.push_back(static_cast<float>(mirror));
-	res.push_back(static_cast<float>(nref));
-	res.push_back(peak);
-	return res;
+		size_t order = s*crefim_len + iref;
+		if (qn >= qm) peak.update(qn, ang_n(retvals["tot"], mode, maxrin), -rings.sx[s], -rings.sy[s], 0, iref, order);
+		else          peak.update(qm, ang_n(retvals_mirror["tot"], mode, maxrin), -rings.sx[s], -rings.sy[s], 1, iref, order);
+	});
+
+	return multiref_result(best, true);
 }
 
 
@@ -28196,12 +28536,7 @@ vector<float> Util::multiref_polar_ali_helical_90(EMData* image, const vector< E
                 vector<int>numr, float cnx, float cny, int ynumber) {
 
 	size_t crefim_len = crefim.size();
-	const float qv = static_cast<float>( pi/180.0 );
 
-	int   iref, nref=0, mirror=0;
-	float iy, ix, sx=0, sy=0;
-	float peak = -1.0E23f;
-	float ang=0.0f;
 //	int   kx = int(2*xrng/step+0.5)/2;
 	int lkx = int(xrng[0]/step);
 	int rkx = int(xrng[1]/step);
@@ -28230,63 +28565,28 @@ vector<float> Util::multiref_polar_ali_helical_90(EMData* image, const vector< E
 	}
 
 	//std::cout<<"yrng="<<yrng<<"ynumber="<<ynumber<<"stepy=="<<stepy<<"stepx=="<<step<<std::endl;
+	MultirefRings rings;
 	for (int i = kystart; i <= rky; i++) {
-		iy = i * stepy ;
-		for (int j = -lkx; j <= rkx; j++) {
-			ix = j*step ;
-			EMData* cimage = Polar2Dm(image, cnx+ix, cny+iy, numr, mode);
+		for (int j = -lkx; j <= rkx; j++)  rings.add(j*step, i*stepy);
+	}
+	rings.compute(image, numr, mode, cnx, cny);
 
-			Normalize_ring( cimage, numr, 0 );
+	vector<float*> refs = multiref_data(crefim);
+	const size_t nshift = rings.size();
+	const int maxrin = numr[numr.size()-1];
 
-			Frngs(cimage, numr);
-			//  compare with all reference images
-			// for iref in xrange(len(crefim)):
-			for ( iref = 0; iref < (int)crefim_len; iref++) {
-				Dict retvals_0   = Crosrng_sm_psi(crefim[iref], cimage, numr,   0.0f, 0, psi_max);
-				Dict retvals_180 = Crosrng_sm_psi(crefim[iref], cimage, numr, 180.0f, 0, psi_max);
-				double qn_0   = retvals_0["qn"];
-				double qn_180 = retvals_180["qn"];
-				double qn;
-				bool qn_is_zero = false;
-		
-				if (qn_0 >= qn_180){
-					qn = qn_0;
-					qn_is_zero = true;
-				} else {
-					qn = qn_180;
-					qn_is_zero = false; 
-				}
+	MultirefPeak best = multiref_search(crefim_len*nshift, 0, [&](size_t k, MultirefPeak& peak) {
+		size_t iref = k/nshift, s = k%nshift;
+		Dict retvals_0   = Crosrng_sm_psi_buf(refs[iref], rings.ring(s), numr,   0.0f, 0, psi_max);
+		Dict retvals_180 = Crosrng_sm_psi_buf(refs[iref], rings.ring(s), numr, 180.0f, 0, psi_max);
+		double qn_0   = retvals_0["qn"];
+		double qn_180 = retvals_180["qn"];
+		Dict& retvals = (qn_0 >= qn_180) ? retvals_0 : retvals_180;
+		double qn = retvals["qn"];
+		peak.update(qn, ang_n(retvals["tot"], mode, maxrin), -rings.sx[s], -rings.sy[s], 0, iref, s*crefim_len + iref);
+	});
 
-				if(qn >= peak) {
-					sx = -ix;
-					sy = -iy;
-					nref = iref;
-			
-					if (qn_is_zero){
-						ang = ang_n(retvals_0["tot"], mode, numr[numr.size()-1]);
-					} else {
-						ang = ang_n(retvals_180["tot"], mode, numr[numr.size()-1]);
-					}
-					peak = static_cast<float>(qn);
-					mirror = 0;
-				}
-			}
-			delete cimage; cimage = 0;
-		}	
-	}	
-	float co, so, sxs, sys;
-	co = static_cast<float>(  cos(ang*qv) );
-	so = static_cast<float>( -sin(ang*qv) );
-	sxs = sx*co - sy*so;
-	sys = sx*so + sy*co;
-	vector<float> res;
-	res.push_back(ang);
-	res.push_back(sxs);
-	res.push_back(sys);
-	res.push_back(static_cast<float>(mirror));
-	res.push_back(static_cast<float>(nref));
-	res.push_back(peak);
-	return res;
+	return multiref_result(best, true);
 }
 
 vector<float> Util::multiref_polar_ali_helical_90_local(EMData* image, const vector< EMData* >& crefim,
@@ -28307,10 +28607,7 @@ vector<float> Util::multiref_polar_ali_helical_90_local(EMData* image, const vec
 	vector<float> n1(crefim_len);
 	vector<float> n2(crefim_len);
 	vector<float> n3(crefim_len);
-	int   iref, nref=-1, mirror=0;
-	float iy, ix, sx=0, sy=0;
-	float peak = -1.0E23f;
-	float ang  = 0.0f;
+	int   iref;
 //	int   kx   = int(2*xrng/step+0.5)/2;
 	int lkx = int(xrng[0]/step);
 	int rkx = int(xrng[1]/step);
@@ -28346,51 +28643,30 @@ vector<float> Util::multiref_polar_ali_helical_90_local(EMData* image, const vec
 		}
 	}
 
-	for (int i = -lky; i <= rky; i++) {
-		iy = i * stepy ;
-		for (int j = -lkx; j <= rkx; j++) {
-			ix = j*step ;
-			EMData* cimage = Polar2Dm(image, cnx+ix, cny+iy, numr, mode);
+	vector<int> use;
+	for ( iref = 0; iref < (int)crefim_len; iref++) {
+		if(fabs(n1[iref]*imn1 + n2[iref]*imn2 + n3[iref]*imn3)>=ant)  use.push_back(iref);
+	}
+	const float psi_ref = ((psi-90.0f) < 90.0f) ? 0.0f : 180.0f;
 
-			Normalize_ring( cimage, numr, 0 );
+	MultirefRings rings;
+	for (int i = -lky; i <= rky; i++) {
+		for (int j = -lkx; j <= rkx; j++)  rings.add(j*step, i*stepy);
+	}
+	rings.compute(image, numr, mode, cnx, cny);
 
-			Frngs(cimage, numr);
-			//  compare with all reference images
-			// for iref in xrange(len(crefim)):
-			for ( iref = 0; iref < (int)crefim_len; iref++) {
-				if(fabs(n1[iref]*imn1 + n2[iref]*imn2 + n3[iref]*imn3)>=ant) {
-					Dict retvals; 
-					if ((psi-90.0f) < 90.0f) retvals = Crosrng_sm_psi(crefim[iref], cimage, numr,   0.0f, 0, psi_max);
-					else                     retvals = Crosrng_sm_psi(crefim[iref], cimage, numr, 180.0f, 0, psi_max);
+	vector<float*> refs = multiref_data(crefim);
+	const size_t nshift = rings.size();
+	const int maxrin = numr[numr.size()-1];
 
-					double qn = retvals["qn"];
-					if( qn >= peak) {
-						sx = -ix;
-						sy = -iy;
-						nref = iref;
-						ang = ang_n(retvals["tot"], mode, numr[numr.size()-1]);
-						peak = static_cast<float>(qn);
-						mirror = 0;
-					}
-				}
-			}  
-			delete cimage; cimage = 0;
-		}
-	}
+	MultirefPeak best = multiref_search(use.size()*nshift, -1, [&](size_t k, MultirefPeak& peak) {
+		size_t iref = use[k/nshift], s = k%nshift;
+		Dict retvals = Crosrng_sm_psi_buf(refs[iref], rings.ring(s), numr, psi_ref, 0, psi_max);
+		double qn = retvals["qn"];
+		peak.update(qn, ang_n(retvals["tot"], mode, maxrin), -rings.sx[s], -rings.sy[s], 0, iref, s*crefim_len + iref);
+	});
 
-	float co, so, sxs, sys;
-	co = static_cast<float>(  cos(ang*qv) );
-	so = static_cast<float>( -sin(ang*qv) );
-	sxs = sx*co - sy*so;
-	sys = sx*so + sy*co;
-	vector<float> res;
-	res.push_back(ang);
-	res.push_back(sxs);
-	res.push_back(sys);
-	res.push_back(static_cast<float>(mirror));
-	res.push_back(static_cast<float>(nref));
-	res.push_back(peak);
-	return res;
+	return multiref_result(best, true);
 }
 
 // HELICON
@@ -29347,6 +29623,102 @@ vector<float> Util::twoD_fine_ali_SD(EMData* image, EMData *refim, EMData* mask,
 	return res;
 }
 
+namespace {
+	// Checks of the *_batch fine alignment functions.  Prepares the images so
+	// that their objectives can be evaluated from several threads.
+	void fine_ali_batch_setup(const vector<EMData*>& images, const vector<EMData*>& refims, EMData* mask, const vector<float>& params)
+	{
+		if (refims.size() != 1 && refims.size() != images.size())
+			throw InvalidValueException((int)refims.size(), "need one reference image, or one per image");
+		if (params.size() != 3*images.size())
+			throw InvalidValueException((int)params.size(), "need ang, sx, sy for every image");
+		for (size_t i = 0; i < images.size(); i++) {
+			if (!images[i]) throw NullPointerException("NULL image");
+			images[i]->get_data();
+		}
+		for (size_t i = 0; i < refims.size(); i++) {
+			if (!refims[i]) throw NullPointerException("NULL reference image");
+			refims[i]->get_data();
+		}
+		if (mask) mask->get_data();
+		// rot_scale_trans2D changes the array offsets of the image it rotates
+		vector<EMData*> sorted(images);
+		std::sort(sorted.begin(), sorted.end());
+		if (std::adjacent_find(sorted.begin(), sorted.end()) != sorted.end())
+			throw InvalidValueException(0, "the same image appears twice");
+	}
+
+	float fine_ali_sqeuclidean(EMData* image, EMData* refim, EMData* mask, float ang, float sx, float sy)
+	{
+		EMData* rot = image->rot_scale_trans2D(ang, sx, sy, 1.0f);
+		float f = rot->cmp("sqeuclidean", refim, Dict("mask", mask));
+		delete rot;
+		return f;
+	}
+}
+
+vector<float> Util::twoD_fine_ali_batch(const vector<EMData*>& images, const vector<EMData*>& refims, EMData* mask, const vector<float>& params) {
+
+	fine_ali_batch_setup(images, refims, mask, params);
+	size_t nima = images.size();
+
+	//  Same problem, tolerances and finite difference gradient as twoD_fine_ali
+	vector<SetulbProblem> probs(nima, SetulbProblem(3));
+	for (size_t k = 0; k < nima; k++) {
+		SetulbProblem& p = probs[k];
+		float ang = params[3*k], sxs = params[3*k+1], sys = params[3*k+2];
+		p.x[0] = ang; p.nbd[0] = 2; p.l[0] = ang-2.0; p.u[0] = ang+2.0;
+		p.x[1] = sxs; p.nbd[1] = 2; p.l[1] = sxs-1.5; p.u[1] = sxs+1.5;
+		p.x[2] = sys; p.nbd[2] = 2; p.l[2] = sys-1.5; p.u[2] = sys+1.5;
+	}
+
+	setulb_parallel(probs, 3, 1.0e1, 1.0e-5, [&](size_t k, SetulbProblem& p) {
+		EMData* image = images[k];
+		EMData* refim = refims[refims.size() == 1 ? 0 : k];
+		const double* x = &p.x[0];
+		p.f = fine_ali_sqeuclidean(image, refim, mask, (float)x[0], (float)x[1], (float)x[2]);
+		float dt = 1.0e-3f;
+		p.g[0] = (fine_ali_sqeuclidean(image, refim, mask, (float)x[0]+dt, (float)x[1], (float)x[2]) - p.f)/dt;
+		dt = 1.0e-2f;
+		p.g[1] = (fine_ali_sqeuclidean(image, refim, mask, (float)x[0], (float)x[1]+dt, (float)x[2]) - p.f)/dt;
+		p.g[2] = (fine_ali_sqeuclidean(image, refim, mask, (float)x[0], (float)x[1], (float)x[2]+dt) - p.f)/dt;
+	});
+
+	vector<float> res;
+	res.reserve(3*nima);
+	for (size_t k = 0; k < nima; k++) {
+		for (int i = 0; i < 3; i++) res.push_back(static_cast<float>(probs[k].x[i]));
+	}
+	return res;
+}
+
+vector<float> Util::twoD_fine_ali_SD_batch(const vector<EMData*>& images, const vector<EMData*>& refims, EMData* mask, const vector<float>& params) {
+
+	fine_ali_batch_setup(images, refims, mask, params);
+	size_t nima = images.size();
+
+	//  Same settings as twoD_fine_ali_SD, x of image k in X[4*k+1..4*k+3]
+	if (nima == 0) return vector<float>();
+	vector<double> X(4*nima);
+	vector<int> n(nima);
+	for (size_t k = 0; k < nima; k++) {
+		for (int i = 0; i < 3; i++) X[4*k+1+i] = params[3*k+i];
+	}
+
+	Steepda_batch(&X[0], 0.01, 1e-9, 3, 200, &n[0], nima, [&](size_t k, const double* x) {
+		EMData* refim = refims[refims.size() == 1 ? 0 : k];
+		return (double)(-fine_ali_sqeuclidean(images[k], refim, mask, (float)x[1], (float)x[2], (float)x[3]));
+	});
+
+	vector<float> res;
+	res.reserve(4*nima);
+	for (size_t k = 0; k < nima; k++) {
+		for (int i = 1; i <= 3; i++) res.push_back(static_cast<float>(X[4*k+i]));
+		res.push_back(static_cast<float>(n[k]));
+	}
+	return res;
+}
+
 /* Parameters:
  * args - parameters of (L-1) G transformation (G_1, G_2, ..., G_(L-1)), saved as alpha_1, sx_1, sy_1, alpha_2, sx_2, sy_2, ... (transformation G_L is always set to I)
  * all_ali_params - parameters of (L*N) T transformation, saved as flat list: <parameters of N images for G_1 alignment>, <parameters of N images for G_2 alignment>, ...
@@ -29465,43 +29837,44 @@ vector<double> Util::multi_align_error_func2(double* x, vector<float> ali_params
 		cosa[i] = cos(args[i*3]*M_PI/180.0);
 		sina[i] = sin(args[i*3]*M_PI/180.0);
 	}
-	double* sx = new double[num_ali];
-	double* sy = new double[num_ali];
 	
 	vector<double> sqr_pixel_error(nima);
 
-	for (int i=0; i<nima; i++) {
-		double sum_cosa = 0.0;
-		double sum_sina = 0.0;
-		for (int j=0; j<num_ali; j++) {
-			if (static_cast<int>(ali_params[j*nima*4+i*4+3]) == 0) {
-				sum_cosa += cos((args[j*3]+ali_params[j*nima*4+i*4])*M_PI/180.0);
-				sum_sina += sin((args[j*3]+ali_params[j*nima*4+i*4])*M_PI/180.0);
-				sx[j] = args[j*3+1] + ali_params[j*nima*4+i*4+1]*cosa[j] + ali_params[j*nima*4+i*4+2]*sina[j];
-				sy[j] = args[j*3+2] - ali_params[j*nima*4+i*4+1]*sina[j] + ali_params[j*nima*4+i*4+2]*cosa[j];
-			} else {
-				sum_cosa += cos((-args[j*3]+ali_params[j*nima*4+i*4])*M_PI/180.0);
-				sum_sina += sin((-args[j*3]+ali_params[j*nima*4+i*4])*M_PI/180.0);
-				sx[j] = -args[j*3+1] + ali_params[j*nima*4+i*4+1]*cosa[j] - ali_params[j*nima*4+i*4+2]*sina[j];
-				sy[j] =  args[j*3+2] + ali_params[j*nima*4+i*4+1]*sina[j] + ali_params[j*nima*4+i*4+2]*cosa[j];
+	//  images are independent, each chunk has its own sx, sy
+	EMThreads::parallel_for(nima, [&](size_t b, size_t e, int) {
+		vector<double> sx(num_ali), sy(num_ali);
+		for (int i=(int)b; i<(int)e; i++) {
+			double sum_cosa = 0.0;
+			double sum_sina = 0.0;
+			for (int j=0; j<num_ali; j++) {
+				if (static_cast<int>(ali_params[j*nima*4+i*4+3]) == 0) {
+					sum_cosa += cos((args[j*3]+ali_params[j*nima*4+i*4])*M_PI/180.0);
+					sum_sina += sin((args[j*3]+ali_params[j*nima*4+i*4])*M_PI/180.0);
+					sx[j] = args[j*3+1] + ali_params[j*nima*4+i*4+1]*cosa[j] + ali_params[j*nima*4+i*4+2]*sina[j];
+					sy[j] = args[j*3+2] - ali_params[j*nima*4+i*4+1]*sina[j] + ali_params[j*nima*4+i*4+2]*cosa[j];
+				} else {
+					sum_cosa += cos((-args[j*3]+ali_params[j*nima*4+i*4])*M_PI/180.0);
+					sum_sina += sin((-args[j*3]+ali_params[j*nima*4+i*4])*M_PI/180.0);
+					sx[j] = -args[j*3+1] + ali_params[j*nima*4+i*4+1]*cosa[j] - ali_params[j*nima*4+i*4+2]*sina[j];
+					sy[j] =  args[j*3+2] + ali_params[j*nima*4+i*4+1]*sina[j] + ali_params[j*nima*4+i*4+2]*cosa[j];
+				}
 			}
+			double sqrtP = sqrt(sum_cosa*sum_cosa+sum_sina*sum_sina);
+			sqr_pixel_error[i] = d*d/4.0*(1.0-sqrtP/num_ali)+var(&sx[0], num_ali)+var(&sy[0], num_ali);
 		}
-		double sqrtP = sqrt(sum_cosa*sum_cosa+sum_sina*sum_sina);
-		sqr_pixel_error[i] = d*d/4.0*(1.0-sqrtP/num_ali)+var(sx, num_ali)+var(sy, num_ali);
-	}
+	}, 64);
 	
 	delete[] args;
 	delete[] cosa;
 	delete[] sina;
-	delete[] sx;
-	delete[] sy;
 	
 	return sqr_pixel_error;
 }
 
 void Util::multi_align_error_dfunc(double* x, vector<float> ali_params, int nima, int num_ali, double* g, int d) {
 
-	for (int i=0; i<num_ali*3-3; i++)    g[i] = 0.0;
+	const int ng = num_ali*3-3;
+	for (int i=0; i<ng; i++)    g[i] = 0.0;
 
 	double* args = new double[num_ali*3];
 	for (int i=0; i<3*num_ali-3; i++)   args[i] = x[i];
@@ -29514,49 +29887,58 @@ void Util::multi_align_error_dfunc(double* x, vector<float> ali_params, int nima
 		cosa[i] = cos(args[i*3]*M_PI/180.0);
 		sina[i] = sin(args[i*3]*M_PI/180.0);
 	}
-	double* sx = new double[num_ali];
-	double* sy = new double[num_ali];
-	
-	vector<float> sqr_pixel_error(nima);
 
-	for (int i=0; i<nima; i++) {
-		double sum_cosa = 0.0;
-		double sum_sina = 0.0;
-		for (int j=0; j<num_ali; j++) {
-			if (static_cast<int>(ali_params[j*nima*4+i*4+3]) == 0) {
-				sum_cosa += cos((args[j*3]+ali_params[j*nima*4+i*4])*M_PI/180.0);
-				sum_sina += sin((args[j*3]+ali_params[j*nima*4+i*4])*M_PI/180.0);
-				sx[j] = args[j*3+1] + ali_params[j*nima*4+i*4+1]*cosa[j] + ali_params[j*nima*4+i*4+2]*sina[j];
-				sy[j] = args[j*3+2] - ali_params[j*nima*4+i*4+1]*sina[j] + ali_params[j*nima*4+i*4+2]*cosa[j];
-			} else {
-				sum_cosa += cos((-args[j*3]+ali_params[j*nima*4+i*4])*M_PI/180.0);
-				sum_sina += sin((-args[j*3]+ali_params[j*nima*4+i*4])*M_PI/180.0);
-				sx[j] = -args[j*3+1] + ali_params[j*nima*4+i*4+1]*cosa[j] - ali_params[j*nima*4+i*4+2]*sina[j];
-				sy[j] =  args[j*3+2] + ali_params[j*nima*4+i*4+1]*sina[j] + ali_params[j*nima*4+i*4+2]*cosa[j];
+	//  The contribution of every image is computed in parallel and the
+	//  contributions are added up in image order, as in the serial loop.
+	vector<double> gi((size_t)nima*ng);
+
+	EMThreads::parallel_for(nima, [&](size_t b, size_t e, int) {
+		vector<double> sx(num_ali), sy(num_ali);
+		for (int i=(int)b; i<(int)e; i++) {
+			double* gc = &gi[(size_t)i*ng];
+			double sum_cosa = 0.0;
+			double sum_sina = 0.0;
+			for (int j=0; j<num_ali; j++) {
+				if (static_cast<int>(ali_params[j*nima*4+i*4+3]) == 0) {
+					sum_cosa += cos((args[j*3]+ali_params[j*nima*4+i*4])*M_PI/180.0);
+					sum_sina += sin((args[j*3]+ali_params[j*nima*4+i*4])*M_PI/180.0);
+					sx[j] = args[j*3+1] + ali_params[j*nima*4+i*4+1]*cosa[j] + ali_params[j*nima*4+i*4+2]*sina[j];
+					sy[j] = args[j*3+2] - ali_params[j*nima*4+i*4+1]*sina[j] + ali_params[j*nima*4+i*4+2]*cosa[j];
+				} else {
+					sum_cosa += cos((-args[j*3]+ali_params[j*nima*4+i*4])*M_PI/180.0);
+					sum_sina += sin((-args[j*3]+ali_params[j*nima*4+i*4])*M_PI/180.0);
+					sx[j] = -args[j*3+1] + ali_params[j*nima*4+i*4+1]*cosa[j] - ali_params[j*nima*4+i*4+2]*sina[j];
+					sy[j] =  args[j*3+2] + ali_params[j*nima*4+i*4+1]*sina[j] + ali_params[j*nima*4+i*4+2]*cosa[j];
+				}
 			}
-		}
-		double P = sqrt(sum_cosa*sum_cosa+sum_sina*sum_sina);
-		sum_cosa /= P;
-		sum_sina /= P;
-		for (int j=0; j<num_ali-1; j++) {
-			double dx = 2.0*(sx[j]-mean(sx, num_ali));
-			double dy = 2.0*(sy[j]-mean(sy, num_ali));
-			if (static_cast<int>(ali_params[j*nima*4+i*4+3]) == 0) {
-				g[j*3] += (d*d/4.0*(sum_cosa*sin((args[j*3]+ali_params[j*nima*4+i*4])*M_PI/180.0) -
-					 	    sum_sina*cos((args[j*3]+ali_params[j*nima*4+i*4])*M_PI/180.0)) +
+			double P = sqrt(sum_cosa*sum_cosa+sum_sina*sum_sina);
+			sum_cosa /= P;
+			sum_sina /= P;
+			for (int j=0; j<num_ali-1; j++) {
+				double dx = 2.0*(sx[j]-mean(&sx[0], num_ali));
+				double dy = 2.0*(sy[j]-mean(&sy[0], num_ali));
+				if (static_cast<int>(ali_params[j*nima*4+i*4+3]) == 0) {
+					gc[j*3] = (d*d/4.0*(sum_cosa*sin((args[j*3]+ali_params[j*nima*4+i*4])*M_PI/180.0) -
+						    sum_sina*cos((args[j*3]+ali_params[j*nima*4+i*4])*M_PI/180.0)) +
 						    dx*(-ali_params[j*nima*4+i*4+1]*sina[j]+ali_params[j*nima*4+i*4+2]*cosa[j])+
 						    dy*(-ali_params[j*nima*4+i*4+1]*cosa[j]-ali_params[j*nima*4+i*4+2]*sina[j]))*M_PI/180.0;
-				g[j*3+1] += dx;
-				g[j*3+2] += dy;
-			} else {
-				g[j*3] += (d*d/4.0*(-sum_cosa*sin((-args[j*3]+ali_params[j*nima*4+i*4])*M_PI/180.0) +
-					 	     sum_sina*cos((-args[j*3]+ali_params[j*nima*4+i*4])*M_PI/180.0)) +
+					gc[j*3+1] = dx;
+					gc[j*3+2] = dy;
+				} else {
+					gc[j*3] = (d*d/4.0*(-sum_cosa*sin((-args[j*3]+ali_params[j*nima*4+i*4])*M_PI/180.0) +
+						     sum_sina*cos((-args[j*3]+ali_params[j*nima*4+i*4])*M_PI/180.0)) +
 						    dx*( ali_params[j*nima*4+i*4+1]*sina[j]+ali_params[j*nima*4+i*4+2]*cosa[j])+
 						    dy*(-ali_params[j*nima*4+i*4+1]*cosa[j]+ali_params[j*nima*4+i*4+2]*sina[j]))*M_PI/180.0;
-				g[j*3+1] += -dx;
-				g[j*3+2] += dy;
+					gc[j*3+1] = -dx;
+					gc[j*3+2] = dy;
+				}
 			}
 		}
+	}, 64);
+
+	for (int i=0; i<nima; i++) {
+		const double* gc = &gi[(size_t)i*ng];
+		for (int k=0; k<ng; k++)  g[k] += gc[k];
 	}
 	
 	for (int i=0; i<3*num_ali-3; i++)  g[i] /= (num_ali*nima);
@@ -29564,8 +29946,6 @@ void Util::multi_align_error_dfunc(double* x, vector<float> ali_params, int nima
 	delete[] args;
 	delete[] cosa;
 	delete[] sina;
-	delete[] sx;
-	delete[] sy;
 }
 
 float Util::ccc_images(EMData* image, EMData* refim, EMData* mask, float ang, float sx, float sy) {
@@ -30894,38 +31274,53 @@ vector<float> Util::cluster_equalsize(EMData* d) {
 	if(N*(N-1)/2 != nx) {
 		//print  "  incorrect dimension"
 		return group;}
-	//bool active[N];	//this does not compile in VS2005. --Grant Tang
-	bool * active = new bool[N];
-	for(int i=0; i<N; i++) active[i] = true;
+	const float* dist = d->get_data();
+
+	// Taking the closest active pair K times is the same as going once
+	// through all pairs sorted by distance, ties in the order of the lower
+	// half matrix, and keeping those whose objects are both still active.
+	struct pair_dist {
+		float d;
+		unsigned int k;
+	};
+	vector<pair_dist> pairs;
+	pairs.reserve(nx);
+	for (int k=0; k<nx; k++) {
+		if (dist[k] < 1.0e23f) {
+			pair_dist p = {dist[k], (unsigned int)k};
+			pairs.push_back(p);
+		}
+	}
+	parallel_sort(pairs, [](const pair_dist& a, const pair_dist& b) {
+		return a.d < b.d || (a.d == b.d && a.k < b.k);
+	});
 
-	float dm, qd;
+	vector<bool> active(N, true);
 	int   ppi = 0, ppj = 0;
-	for(int k=0; k<K; k++) {
-		// find pairs of most similiar objects among active
-		//cout<<"  k  "<<k<<endl;
-		dm = 1.0e23f;
-		for(int i=1; i<N; i++) {
-			if(active[i]) {
-				for(int j=0; j<i; j++) {
-					if(active[j]) {
-						qd = (*d)(i*(i - 1)/2 + j);
-						if(qd < dm) {
-							dm = qd;
-							ppi = i;
-							ppj = j;
-						}
-					}
-				}
-			}
+	int   k = 0;
+	for (size_t l=0; l<pairs.size() && k<K; l++) {
+		// row i and column j of element k = i*(i-1)/2 + j
+		long int pk = pairs[l].k;
+		int i = int((1.0 + sqrt(1.0 + 8.0*pk))/2.0);
+		while ((long int)i*(i-1)/2 > pk) i--;
+		while ((long int)(i+1)*i/2 <= pk) i++;
+		int j = int(pk - (long int)i*(i-1)/2);
+		if (active[i] && active[j]) {
+			ppi = i;
+			ppj = j;
+			group[2*k] = float(ppi);
+			group[1+2*k] = float(ppj);
+			active[ppi] = false;
+			active[ppj] = false;
+			k++;
 		}
+	}
+	// no pair of active objects is closer than 1.0e23, repeat the last one
+	for (; k<K; k++) {
 		group[2*k] = float(ppi);
 		group[1+2*k] = float(ppj);
-		active[ppi] = false;
-		active[ppj] = false;
 	}
 
-	delete [] active;
-	active = NULL;
 	return  group;
 }
 /*
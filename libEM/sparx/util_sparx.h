@@ -47,6 +47,15 @@ static int coveig(int n, float *covmat, float *eigval, float *eigvec);
 /* Functions WTF, WTM and BPCQ accept as first parameter images in real and Fourier space. Output image is always in real space. */
 static Dict coveig_for_py(int ncov, const vector<float>& covmatpy);
 
+/** Select the optimized BLAS/LAPACK backend (when built with ENABLE_EXTERNAL_BLAS)
+ * or the bundled routines for the sparx linear algebra (coveig, PCA, Lanczos).
+ * Returns the previous setting; requesting the external backend in a build
+ * without one leaves the bundled routines in use. */
+static bool use_external_blas(bool use);
+
+/** True if the sparx linear algebra currently runs on the external BLAS/LAPACK. */
+static bool using_external_blas();
+
 static void WTF(EMData* PROJ,vector<float> SS,float SNR,int K);
 
 static void WTM(EMData* PROJ, vector<float> SS,int DIAMETER,int NUMP);
@@ -611,6 +620,10 @@ class FakeKaiserBessel : public KaiserBessel {
                              float *circ, int lcirc, int nring, char mode);*/
 	static EMData* Polar2D(EMData* image, vector<int> numr, string mode);
 	static EMData* Polar2Dm(EMData* image, float cns2, float cnr2, vector<int> numr, string cmode);
+	/** Polar2Dm sampling of the nx by ny image xim into the ring buffer circ,
+	 * which holds numr's lcirc values; mode is 'F' or 'H'. Does not allocate,
+	 * so it may be called from several threads. */
+	static void Polar2Dm_buf(float* xim, int nx, int ny, float cns2, float cnr2, const vector<int>& numr, char mode, float* circ);
 	static EMData* Polar2DFT(EMData* image, int ring_length, int nb, int ne);
 	static EMData* Polar2DShiftCoeffs(int nx, float xshift, float yshift, int ring_length, int nb, int ne);
 	/*static void alrq_ms(float *xim, int	 nsam, int  nrow, float cns2, float cnr2,
@@ -642,9 +655,15 @@ class FakeKaiserBessel : public KaiserBessel {
 
 	/** Single Precision Fourier Transform for a set of rings */
 	static void  Frngs(EMData* circ, vector<int> numr);
+	static void  Frngs_buf(float* circ, const vector<int>& numr);
+
+	/** Frngs on nimg sets of rings stored one after the other in circ,
+	 * transformed together as FFTW batches */
+	static void  Frngs_batch(float* circ, const vector<int>& numr, size_t nimg);
 
 	static float polar_norm2(EMData* ring, const vector<int>& numr);
 	static void  Normalize_ring(EMData* ring, const vector<int>& numr, int norm_by_square);
+	static void  Normalize_ring_buf(float* data, size_t n, const vector<int>& numr, int norm_by_square);
 
 	/** Single Precision Inverse Fourier Transform for a set of rings */
 	static void  Frngs_inv(EMData* circ, vector<int> numr);
@@ -672,11 +691,13 @@ class FakeKaiserBessel : public KaiserBessel {
 	        Crosrng_msg_m is same as Crosrng_msg except that it only checks mirrored position
 	  */
 	static Dict Crosrng_e(EMData* circ1, EMData* circ2, vector<int> numr, int neg, float delta_psi);
+	static Dict Crosrng_e_buf(float* circ1, float* circ2, const vector<int>& numr, int neg, float delta_psi);
 	static Dict Crosrng_rand_e(EMData* circ1, EMData* circ2, vector<int> numr, int neg, float previous_max, float an, int psi_pos);
 	static Dict Crosrng_ew(EMData* circ1, EMData* circ2, vector<int> numr, vector<float> w, int neg);
 
 	static Dict Crosrng(EMData* circ1, EMData* circ2, vector<int> numr, float delta_psi);
 	static Dict Crosrng_ms(EMData* circ1, EMData* circ2, vector<int> numr, float delta_psi);
+	static Dict Crosrng_ms_buf(float* circ1, float* circ2, const vector<int>& numr, float delta_psi);
 	static Dict Crosrng_ms_delta(EMData* circ1, EMData* circ2, vector<int> numr, float delta_start, float delta);
 
 	/**
@@ -685,6 +706,7 @@ class FakeKaiserBessel : public KaiserBessel {
 	 * circ1 already multiplied by weights!
 	*/
 	static Dict Crosrng_sm_psi(EMData* circ1, EMData* circ2, vector<int> numr, float psi, int flag, float psimax);
+	static Dict Crosrng_sm_psi_buf(float* circ1, float* circ2, const vector<int>& numr, float psi, int flag, float psimax);
 
     /**
 	 * checks both straight & mirrored position
@@ -692,6 +714,7 @@ class FakeKaiserBessel : public KaiserBessel {
 	 * circ1 already multiplied by weights!
 	*/
 	static Dict Crosrng_psi(EMData* circ1, EMData* circ2, vector<int> numr, float psi, float psimax);
+	static Dict Crosrng_psi_buf(float* circ1, float* circ2, const vector<int>& numr, float psi, float psimax);
  
 	/**
 	 * checks both straight & mirrored positions
@@ -796,6 +819,14 @@ class FakeKaiserBessel : public KaiserBessel {
 	 * */
 	static int k_means_cont_table_(int* group1, int* group2, int* stb, long int s1, long int s2, int flag);
 
+	/** Full contingency table of two partitions of the same objects.
+	 * assign1[i] and assign2[i] are the classes of object i in each partition,
+	 * objects with a label outside [0,K) are ignored.  Returns the K1*K2 counts
+	 * row by row, entry (k1,k2) being what k_means_cont_table_ returns for
+	 * class k1 of the first and class k2 of the second partition.
+	 */
+	static vector<int> k_means_cont_table_all(const vector<int>& assign1, const vector<int>& assign2, int K1, int K2);
+
 	// branch and bound matching algorithm
 
 	
@@ -885,6 +916,12 @@ class FakeKaiserBessel : public KaiserBessel {
 	/** 2009-03-30 15:44:05 JB. Compute the discrepancy belong all common-lines */
 	static double cml_disc(const vector<EMData*>& data, vector<int> com, vector<int> seq, vector<float> weights, int n_lines);
 
+	/** Discrepancy of several candidate orientations at once.  coms holds
+	 * the 2*n_lines common-lines of each candidate back to back, as returned by
+	 * cml_line_insino_all; the result has one cml_disc value per candidate.
+	 */
+	static vector<double> cml_disc_batch(const vector<EMData*>& data, const vector<int>& coms, const vector<int>& seq, const vector<float>& weights, int n_lines);
+
 	/**  This function drop a line (line) to an 2D image (img).
 	 *  The position of the line to the image is defined by (postline).
 	 *  The part of the line paste is defined by (offset), the begin position
@@ -1092,6 +1129,13 @@ public:
 	/* This is used in ISAC program to assign particles equally to grops */
 	static vector<int> assign_groups(std::string matrix_address, int nref, int nima);
 
+	/** Same input and output layout as assign_groups, but the groups are found
+	 * by an auction that maximizes the total similarity of the nref groups of
+	 * nima/nref images.  The nima%nref images this leaves over are put in the
+	 * group they match best, returned as the last element.
+	 */
+	static vector<int> assign_groups_auction(std::string matrix_address, int nref, int nima);
+
 	static inline void getvec(float phi, float theta, float& x, float& y, float& z, int option=0) {
 		float pi180 = M_PI/180.0f;
 		
@@ -1145,6 +1189,16 @@ public:
 	static vector<int> nearest_fang_select(const vector<vector<float> >& vecref, float x, float y, float z, int howmany);
 	static int nearest_ang_f(const vector<vector<float> >& vecref, float x, float y, float z);
 
+	/* nearest_fang, nearest_fang_select and nearest_fang_sym for many directions at once,
+	   answered through a kd-tree of the reference directions on all threads.
+	   dirs holds one (x, y, z) per direction; angles_sym_normals holds neighbors
+	   consecutive symmetry normals per direction.  The results of the directions are
+	   concatenated and equal those of the single direction functions.
+	*/
+	static vector<int> nearest_fang_list(const vector<vector<float> >& vecref, const vector<vector<float> >& dirs);
+	static vector<int> nearest_fang_select_list(const vector<vector<float> >& vecref, const vector<vector<float> >& dirs, int howmany);
+	static vector<int> nearest_fang_sym_list(const vector<vector<float> >& angles_sym_normals, const vector<vector<float> >& reference_normals, int neighbors, int howmany);
+
 	/* Assign projection angles to nearest reference projections */
 	static vector<int> assign_projangles(const vector<float>& projangles, const vector<float>& refangles); 
 
@@ -1302,6 +1356,21 @@ public:
 
 	static float ccc_images(EMData *, EMData *, EMData *, float , float , float );
 
+	/** twoD_fine_ali on many images at once, the L-BFGS-B problems of all images
+	 *  advancing together and their objectives evaluated on EMThreads.
+	 *  @param images images to align, must be distinct
+	 *  @param refims one reference per image, or a single reference for all
+	 *  @param params ang, sx, sy starting values of each image
+	 *  @return ang, sx, sy of each image, identical to twoD_fine_ali
+	 */
+	static vector<float> twoD_fine_ali_batch(const vector<EMData*>& images, const vector<EMData*>& refims, EMData* mask, const vector<float>& params);
+
+	/** twoD_fine_ali_SD on many images at once, distributed over EMThreads.
+	 *  Arguments as for twoD_fine_ali_batch; returns ang, sx, sy and the number
+	 *  of steps of each image.
+	 */
+	static vector<float> twoD_fine_ali_SD_batch(const vector<EMData*>& images, const vector<EMData*>& refims, EMData* mask, const vector<float>& params);
+
 	static vector<float> twoD_fine_ali_SD_G(EMData* image, EMData *refim, EMData* mask, Util::KaiserBessel& kb, float ang, float sxs, float sys);
 
 	static float ccc_images_G(EMData* image, EMData* refim, EMData* mask, Util::KaiserBessel& kb, float ang, float sx, float sy);
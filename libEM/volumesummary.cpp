@@ -0,0 +1,257 @@
+/*
+ * This software is issued under a joint BSD/GNU license. You may use the
+ * source code in this file under either license. However, note that the
+ * complete EMAN2 and SPARX software packages have some GPL dependencies,
+ * so you are responsible for compliance with the licenses of these packages
+ * if you opt to use BSD licensing. The warranty disclaimer below holds
+ * in either instance.
+ *
+ * This complete copyright notice must be included in any revised version of the
+ * source code. Additional authorship citations may be added, but existing
+ * author citations must be preserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA 
+ */
+
+#include "volumesummary.h"
+#include "emdata.h"
+#include "emthreads.h"
+#include "exception.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+using namespace EMAN;
+
+VolumeSummary::VolumeSummary(const EMData *image, int bsize)
+{
+	if (!image) throw NullPointerException("Cannot summarize a null image");
+	if (image->is_complex()) throw ImageFormatException("Cannot summarize a complex image");
+	if (bsize < 0) throw InvalidValueException(bsize, "brick size must not be negative");
+
+	brick_size = bsize ? bsize : DEFAULT_BRICK_SIZE;
+	nx = image->get_xsize();
+	ny = image->get_ysize();
+	nz = image->get_zsize();
+	if ((size_t)nx*ny*nz == 0) throw ImageDimensionException("Cannot summarize an empty image");
+
+	Level base;
+	base.bx = (nx + brick_size - 1) / brick_size;
+	base.by = (ny + brick_size - 1) / brick_size;
+	base.bz = (nz + brick_size - 1) / brick_size;
+	base.bricks.resize((size_t)base.bx*base.by*base.bz);
+
+	// Half precision images are converted a row at a time rather than expanded,
+	// get_data() is only called here, outside the threads
+	const float *data = image->get_half_storage() ? 0 : image->get_const_data();
+	size_t nxy = (size_t)nx*ny;
+	vector< vector<float> > rowbuf(EMThreads::get_num_chunks(base.bricks.size()), vector<float>(data ? 0 : brick_size));
+
+	EMThreads::parallel_for_each(base.bricks.size(), [&](size_t i, int chunk) {
+		int x0 = (int)(i % base.bx) * brick_size;
+		int y0 = (int)(i / base.bx % base.by) * brick_size;
+		int z0 = (int)(i / base.bx / base.by) * brick_size;
+		int w = std::min(brick_size, nx - x0);
+		int y1 = std::min(y0 + brick_size, ny);
+		int z1 = std::min(z0 + brick_size, nz);
+
+		float minval = FLT_MAX, maxval = -FLT_MAX;
+		double sum = 0, sumsq = 0;
+		for (int z = z0; z < z1; z++) {
+			for (int y = y0; y < y1; y++) {
+				size_t offset = x0 + y*(size_t)nx + z*nxy;
+				const float *row = data ? data + offset : image->get_const_data_block(offset, w, &rowbuf[chunk][0]);
+				for (int x = 0; x < w; x++) {
+					float v = row[x];
+					if (v < minval) minval = v;
+					if (v > maxval) maxval = v;
+					sum += v;
+					sumsq += (double)v*v;
+				}
+			}
+		}
+
+		Brick &b = base.bricks[i];
+		b.n = (size_t)w*(y1 - y0)*(z1 - z0);
+		double mean = sum / b.n;
+		b.minval = minval;
+		b.maxval = maxval;
+		b.mean = (float)mean;
+		b.sigma = (float)std::sqrt(std::max(0.0, sumsq/b.n - mean*mean));
+	});
+	levels.push_back(base);
+
+	// Each level up combines 2x2x2 bricks of the one below, pooling the variances
+	while (levels.back().bricks.size() > 1) {
+		const Level &below = levels.back();
+		Level up;
+		up.bx = (below.bx + 1) / 2;
+		up.by = (below.by + 1) / 2;
+		up.bz = (below.bz + 1) / 2;
+		up.bricks.resize((size_t)up.bx*up.by*up.bz);
+
+		for (int z = 0; z < up.bz; z++) {
+			for (int y = 0; y < up.by; y++) {
+				for (int x = 0; x < up.bx; x++) {
+					const Brick *kids[8];
+					int nkid = 0;
+					for (int k = 2*z; k < std::min(2*z + 2, below.bz); k++) {
+						for (int j = 2*y; j < std::min(2*y + 2, below.by); j++) {
+							for (int m = 2*x; m < std::min(2*x + 2, below.bx); m++) {
+								kids[nkid++] = &below.bricks[m + (size_t)below.bx*(j + (size_t)below.by*k)];
+							}
+						}
+					}
+
+					Brick &b = up.bricks[x + (size_t)up.bx*(y + (size_t)up.by*z)];
+					b.n = 0;
+					b.minval = FLT_MAX;
+					b.maxval = -FLT_MAX;
+					double sum = 0;
+					for (int c = 0; c < nkid; c++) {
+						b.n += kids[c]->n;
+						b.minval = std::min(b.minval, kids[c]->minval);
+						b.maxval = std::max(b.maxval, kids[c]->maxval);
+						sum += (double)kids[c]->n * kids[c]->mean;
+					}
+					double mean = sum / b.n, var = 0;
+					for (int c = 0; c < nkid; c++) {
+						double d = kids[c]->mean - mean;
+						var += kids[c]->n * ((double)kids[c]->sigma*kids[c]->sigma + d*d);
+					}
+					b.mean = (float)mean;
+					b.sigma = (float)std::sqrt(var / b.n);
+				}
+			}
+		}
+		levels.push_back(up);
+	}
+}
+
+IntSize VolumeSummary::get_level_size(int level) const
+{
+	if (level < 0 || level >= (int)levels.size()) throw OutofRangeException(0, (int)levels.size() - 1, level, "level");
+	const Level &lv = levels[level];
+	return IntSize(lv.bx, lv.by, lv.bz);
+}
+
+const VolumeSummary::Brick & VolumeSummary::get_brick(int level, int x, int y, int z) const
+{
+	IntSize size = get_level_size(level);
+	if (x < 0 || x >= size[0]) throw OutofRangeException(0, size[0] - 1, x, "brick x");
+	if (y < 0 || y >= size[1]) throw OutofRangeException(0, size[1] - 1, y, "brick y");
+	if (z < 0 || z >= size[2]) throw OutofRangeException(0, size[2] - 1, z, "brick z");
+	return levels[level].bricks[x + (size_t)size[0]*(y + (size_t)size[1]*z)];
+}
+
+Region VolumeSummary::get_brick_region(int level, int x, int y, int z) const
+{
+	get_brick(level, x, y, z);
+	int s = get_brick_size(level);
+	return Region(x*s, y*s, z*s, std::min(s, nx - x*s), std::min(s, ny - y*s), std::min(s, nz - z*s));
+}
+
+void VolumeSummary::range_in(int l, int x, int y, int z, const int *lo, const int *hi, float &minval, float &maxval) const
+{
+	int s = get_brick_size(l);
+	int b0[3] = { x*s, y*s, z*s };
+	int b1[3] = { std::min(b0[0] + s, nx) - 1, std::min(b0[1] + s, ny) - 1, std::min(b0[2] + s, nz) - 1 };
+	bool inside = true;
+	for (int i = 0; i < 3; i++) {
+		if (b1[i] < lo[i] || b0[i] > hi[i]) return;
+		if (b0[i] < lo[i] || b1[i] > hi[i]) inside = false;
+	}
+
+	const Level &lv = levels[l];
+	if (inside || l == 0) {
+		const Brick &b = lv.bricks[x + (size_t)lv.bx*(y + (size_t)lv.by*z)];
+		minval = std::min(minval, b.minval);
+		maxval = std::max(maxval, b.maxval);
+		return;
+	}
+
+	const Level &below = levels[l - 1];
+	for (int k = 2*z; k < std::min(2*z + 2, below.bz); k++) {
+		for (int j = 2*y; j < std::min(2*y + 2, below.by); j++) {
+			for (int i = 2*x; i < std::min(2*x + 2, below.bx); i++) range_in(l - 1, i, j, k, lo, hi, minval, maxval);
+		}
+	}
+}
+
+bool VolumeSummary::get_range(int x0, int y0, int z0, int x1, int y1, int z1, float &minval, float &maxval) const
+{
+	int lo[3] = { std::max(x0, 0), std::max(y0, 0), std::max(z0, 0) };
+	int hi[3] = { std::min(x1, nx - 1), std::min(y1, ny - 1), std::min(z1, nz - 1) };
+	for (int i = 0; i < 3; i++) {
+		if (lo[i] > hi[i]) return false;
+	}
+
+	float lmin = FLT_MAX, lmax = -FLT_MAX;
+	range_in((int)levels.size() - 1, 0, 0, 0, lo, hi, lmin, lmax);
+	minval = lmin;
+	maxval = lmax;
+	return true;
+}
+
+void VolumeSummary::collect_above(float threshold, int level, int l, int x, int y, int z, vector<int> &found) const
+{
+	const Level &lv = levels[l];
+	if (lv.bricks[x + (size_t)lv.bx*(y + (size_t)lv.by*z)].maxval <= threshold) return;
+
+	if (l == level) {
+		found.push_back(x + lv.bx*(y + lv.by*z));
+		return;
+	}
+
+	const Level &below = levels[l - 1];
+	for (int k = 2*z; k < std::min(2*z + 2, below.bz); k++) {
+		for (int j = 2*y; j < std::min(2*y + 2, below.by); j++) {
+			for (int i = 2*x; i < std::min(2*x + 2, below.bx); i++) collect_above(threshold, level, l - 1, i, j, k, found);
+		}
+	}
+}
+
+vector<int> VolumeSummary::get_bricks_above(float threshold, int level) const
+{
+	get_level_size(level);
+	vector<int> found;
+	collect_above(threshold, level, (int)levels.size() - 1, 0, 0, 0, found);
+	std::sort(found.begin(), found.end());
+	return found;
+}
+
+Region VolumeSummary::get_bounding_region(float threshold) const
+{
+	vector<int> found = get_bricks_above(threshold, 0);
+	if (found.empty()) return Region(0, 0, 0, 0, 0, 0);
+
+	const Level &lv = levels[0];
+	int lo[3] = { lv.bx, lv.by, lv.bz };
+	int hi[3] = { -1, -1, -1 };
+	for (vector<int>::const_iterator it = found.begin(); it != found.end(); ++it) {
+		int b[3] = { *it % lv.bx, *it / lv.bx % lv.by, *it / lv.bx / lv.by };
+		for (int i = 0; i < 3; i++) {
+			lo[i] = std::min(lo[i], b[i]);
+			hi[i] = std::max(hi[i], b[i]);
+		}
+	}
+
+	int x0 = lo[0]*brick_size, y0 = lo[1]*brick_size, z0 = lo[2]*brick_size;
+	return Region(x0, y0, z0,
+			std::min((hi[0] + 1)*brick_size, nx) - x0,
+			std::min((hi[1] + 1)*brick_size, ny) - y0,
+			std::min((hi[2] + 1)*brick_size, nz) - z0);
+}
@@ -0,0 +1,127 @@
+/*
+ * This software is issued under a joint BSD/GNU license. You may use the
+ * source code in this file under either license. However, note that the
+ * complete EMAN2 and SPARX software packages have some GPL dependencies,
+ * so you are responsible for compliance with the licenses of these packages
+ * if you opt to use BSD licensing. The warranty disclaimer below holds
+ * in either instance.
+ *
+ * This complete copyright notice must be included in any revised version of the
+ * source code. Additional authorship citations may be added, but existing
+ * author citations must be preserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA 
+ */
+
+#ifndef eman__volumesummary_h__
+#define eman__volumesummary_h__ 1
+
+#include "geometry.h"
+
+#include <vector>
+
+using std::vector;
+
+namespace EMAN
+{
+	class EMData;
+
+	/** VolumeSummary is a pyramid of value statistics over bricks of an image.
+	 * Level 0 splits the image into cubic bricks of get_brick_size() voxels on a
+	 * side (smaller at the high edges), and each brick of level l+1 combines up to
+	 * 2x2x2 bricks of level l, until the top level is a single brick covering the
+	 * whole image.
+	 *
+	 * It lets threshold-based code, such as isosurfacing, masking and region
+	 * selection, skip parts of the image that cannot contain the values it wants
+	 * without visiting their voxels. Use EMData::get_volume_summary() to get the
+	 * summary cached on an image rather than making one directly.
+	 */
+	class VolumeSummary
+	{
+	  public:
+		/** Statistics of the voxels in one brick */
+		struct Brick
+		{
+			float minval, maxval;
+			float mean, sigma;	// sigma is the population standard deviation
+			size_t n;		// number of voxels
+		};
+
+		static const int DEFAULT_BRICK_SIZE = 16;
+
+		/** Summarize a real image, in parallel. Half precision images are read
+		 * without being expanded.
+		 * @param image the image to summarize
+		 * @param brick_size level 0 brick edge length in voxels, 0 for the default
+		 * @exception NullPointerException if image is null
+		 * @exception ImageFormatException if image is complex
+		 * @exception InvalidValueException if brick_size is negative
+		 */
+		VolumeSummary(const EMData *image, int brick_size = 0);
+
+		int get_brick_size() const { return brick_size; }
+
+		/** @return the edge length of the bricks of a level in voxels */
+		int get_brick_size(int level) const { return brick_size << level; }
+
+		int get_num_levels() const { return (int)levels.size(); }
+
+		/** @return the size of the image that was summarized */
+		IntSize get_image_size() const { return IntSize(nx, ny, nz); }
+
+		/** @return the number of bricks along x, y and z at a level */
+		IntSize get_level_size(int level) const;
+
+		const Brick & get_brick(int level, int x, int y, int z) const;
+
+		/** @return the voxels covered by a brick */
+		Region get_brick_region(int level, int x, int y, int z) const;
+
+		/** Find bounds on the values in a box of voxels. The bounds come from the
+		 * bricks the box overlaps, so they contain the true range of the box but
+		 * may be wider when the box does not line up with level 0 bricks.
+		 * Coordinates are inclusive and clipped to the image.
+		 * @return false, leaving minval and maxval alone, if the box misses the image
+		 */
+		bool get_range(int x0, int y0, int z0, int x1, int y1, int z1, float &minval, float &maxval) const;
+
+		/** Find the bricks of a level holding at least one voxel above threshold.
+		 * Whole subtrees of the pyramid below the threshold are skipped.
+		 * @return brick indices x+y*bx+z*bx*by, with (bx,by,bz) = get_level_size(level), in increasing order
+		 */
+		vector<int> get_bricks_above(float threshold, int level = 0) const;
+
+		/** @return the smallest box of level 0 bricks containing every voxel above
+		 * threshold, or a region of size 0 if there are none */
+		Region get_bounding_region(float threshold) const;
+
+	  private:
+		struct Level
+		{
+			int bx, by, bz;
+			vector<Brick> bricks;
+		};
+
+		void collect_above(float threshold, int level, int l, int x, int y, int z, vector<int> &found) const;
+		void range_in(int l, int x, int y, int z, const int *lo, const int *hi, float &minval, float &maxval) const;
+
+		int nx, ny, nz;
+		int brick_size;
+		vector<Level> levels;
+	};
+}
+
+#endif	//eman__volumesummary_h__
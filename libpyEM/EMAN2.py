@@ -147,6 +147,8 @@ EMData.set=EMData.set_value_at
 EMData.numpy=EMNumPy.em2numpy
 from_numpy=EMNumPy.numpy2em
 to_numpy=EMNumPy.em2numpy
+EMDataStack.numpy=EMNumPy.stack2numpy
+EMDataStack.__iter__=lambda self:(self.get_image(i) for i in range(self.get_n()))
 
 
 def emdata_to_string(self):
@@ -162,6 +164,32 @@ def emdata_from_string(s):
 EMData.from_string=emdata_from_string
 EMData.to_string=emdata_to_string
 
+def emdata_reduce_ex(self,protocol):
+	"""Pickle support. With protocol 5 the pixel data is passed as a PickleBuffer, so
+	pickle.dumps(img,protocol=5,buffer_callback=...) can hand it over out of band without a copy.
+	Older protocols use the pickle_suite state, which embeds a copy of the data."""
+	if protocol<5 : return self.__reduce__()
+	return (emdata_from_buffer,(self._pickle_header(),pickle.PickleBuffer(self)))
+
+def emdata_from_buffer(state,data):
+	"""Rebuilds an EMData pickled with protocol 5 from its header state and pixel buffer"""
+	ret=EMData()
+	ret.__setstate__(state)
+	memoryview(ret).cast("B")[:]=memoryview(data).cast("B")
+	return ret
+
+def emdata_from_shared(state,name,writable=False):
+	"""Rebuilds an EMData from its header state and the name of a shared memory segment holding
+	its pixels (see EMData.to_shared()). The segment is mapped, not copied, and is only valid on
+	the host that created it, while the creating image still exists. The mapping is copy-on-write,
+	so changes to the returned image stay in this process, unless writable is set."""
+	ret=EMData()
+	ret.attach_shared(name,writable)
+	ret.__setstate__(state)
+	return ret
+
+EMData.__reduce_ex__=emdata_reduce_ex
+
 def list_to_emdata(l):
 	"""Converts a 1-D list into a 1-D EMData object (slow)"""
 	r=EMData(len(l),1,1)
@@ -1666,7 +1694,7 @@ def get_supported_3d_stack_formats():
 	calling function must be aware of this
 	@Note - it would be nice if this was automatic, not hard coded.
 	'''
-	return ["hdf","spi","pif","emim"]
+	return ["hdf","spi","pif","emim","emz"]
 
 
 def get_supported_2d_stack_formats():
@@ -1678,7 +1706,7 @@ def get_supported_2d_stack_formats():
 	calling function must be aware of this
 	@Note - it would be nice if this was automatic, not hard coded.
 	'''
-	return ["hdf","spi","pif","emim","img"]
+	return ["hdf","spi","pif","emim","img","emz"]
 
 
 def get_supported_2d_write_formats():
@@ -1689,7 +1717,7 @@ def get_supported_2d_write_formats():
 	calling function must be aware of this
 	@Note - it would be nice if this was automatic, not hard coded.
 	'''
-	return ["mrc","spi","img","hdf"]
+	return ["mrc","spi","img","hdf","emz"]
 
 def get_supported_3d_formats():
 	'''
@@ -1700,7 +1728,7 @@ def get_supported_3d_formats():
 	calling function must be aware of this
 	@Note - it would be nice if this was automatic, not hard coded.
 	'''
-	return ["hdf","spi","mrc","pif","emim","img","vtk","icos","xplor","em","fits"]
+	return ["hdf","spi","mrc","pif","emim","img","vtk","icos","xplor","em","fits","emz"]
 
 def remove_file( file_name, img_couples_too=True ):
 	'''
@@ -39,10 +39,11 @@ from builtins import range
 from builtins import object
 
 import sys, os, getpass, socket, subprocess, threading, time,select,shutil, traceback, random,_thread, queue
+import pickle
 from pickle import dumps,loads,dump,load
 
 from EMAN2jsondb import JSTask,JSTaskQueue,js_open_dict
-from EMAN2 import test_image,EMData,abs_path,local_datetime,EMUtil,Util,get_platform, e2getinstalldir
+from EMAN2 import test_image,EMData,abs_path,local_datetime,EMUtil,Util,get_platform, e2getinstalldir, emdata_from_shared
 
 # If we can't import it then we probably won't be trying to use MPI
 try :
@@ -78,8 +79,11 @@ class EMTaskCustomer(object):
 	def __init__(self,target,module=""):
 		"""Specify the type and target host of the parallelism server to use.
 	dc[:hostname[:port]] - default hostname localhost, default port 9990
-	thread:nthreads[:scratch_dir]
+	thread:nthreads[:scratch_dir[:shm]]
 	mpi:ncpu[:scratch_dir_on_nodes]
+
+	With the shm option, the thread server passes images to its workers through shared memory
+	instead of copying them into the task files.
 	"""
 		origtarget=target
 		#target=target.lower()
@@ -92,7 +96,9 @@ class EMTaskCustomer(object):
 			self.maxthreads=int(target.split(":")[1])
 			try: self.scratchdir=target.split(":")[2]
 			except: self.scratchdir="/tmp"
-			self.handler=EMLocalTaskHandler(self.maxthreads,self.scratchdir, module)
+			if self.scratchdir=="" : self.scratchdir="/tmp"
+			shared="shm" in target.split(":")[3:]
+			self.handler=EMLocalTaskHandler(self.maxthreads,self.scratchdir, module, shared)
 		elif self.servtype=="thread_sm":
 			self.maxthreads=int(target.split(":")[1])
 			self.handler=EMSharedMemoryLocalTaskHandler(self.maxthreads)
@@ -758,12 +764,31 @@ class EMSharedMemoryLocalTaskHandler(object):
 
 
 # Here we define the classes for local threaded parallelism
+class EMSharedImagePickler(pickle.Pickler):
+	"""Pickler which copies the pixels of every EMData it meets into a new shared memory segment
+	(EMData.copy_to_shared()) and stores only the segment name, so a process on the same host can
+	map the pixels rather than read them from the pickle. The pickled images are not changed. The
+	segment copies are kept in self.shared; the segments go away when they are freed, so the
+	caller must hold on to them until the pickle has been loaded."""
+	def __init__(self,file,protocol=-1):
+		pickle.Pickler.__init__(self,file,protocol)
+		self.shared=[]
+
+	def reducer_override(self,obj):
+		if isinstance(obj,EMData):
+			shm=obj.copy_to_shared()
+			self.shared.append(shm)
+			return (emdata_from_shared,(obj._pickle_header(),shm.get_shared_name()))
+		return NotImplemented
+
 class EMLocalTaskHandler(object):
 	"""Local threaded Taskserver. This runs as a thread in the 'Customer' and executes tasks. Not a
-	subclass of EMTaskHandler for efficient local processing and to avoid data name translation."""
+	subclass of EMTaskHandler for efficient local processing and to avoid data name translation.
+	If shared is set, images in tasks are passed to the workers in shared memory rather than
+	written into the task files."""
 	lock=threading.Lock()
 	allrunning = {}	# Static dict of running local tasks. Used for killing thses task upon parent kill
-	def __init__(self,nthreads=2,scratchdir="/tmp", module=""):
+	def __init__(self,nthreads=2,scratchdir="/tmp", module="", shared=False):
 		self.maxthreads=nthreads
 		self.running=[]			# running subprocesses
 		self.completed=set()	# completed subprocesses
@@ -772,6 +797,8 @@ class EMLocalTaskHandler(object):
 		self.nextid=0
 		self.doexit=0
 		self.module=module
+		self.shared=shared and get_platform()!="Windows"
+		self.sharedimgs={}		# images in shared memory, by task id, kept alive until get_results
 
 
 		os.makedirs(self.scratchdir)
@@ -787,7 +814,12 @@ class EMLocalTaskHandler(object):
 	def add_task(self,task):
 		EMLocalTaskHandler.lock.acquire()
 		if not isinstance(task,JSTask) : raise Exception("Non-task object passed to EMLocalTaskHandler for execution")
-		dump(task,open("%s/%07d"%(self.scratchdir,self.maxid),"wb"),-1)
+		with open("%s/%07d"%(self.scratchdir,self.maxid),"wb") as out:
+			if self.shared :
+				pkl=EMSharedImagePickler(out,-1)
+				pkl.dump(task)
+				self.sharedimgs[self.maxid]=pkl.shared
+			else: dump(task,out,-1)
 		ret=self.maxid
 		self.maxid+=1
 		EMLocalTaskHandler.lock.release()
@@ -821,6 +853,7 @@ class EMLocalTaskHandler(object):
 		os.unlink("%s/%07d.out"%(self.scratchdir,taskid))
 		os.unlink("%s/%07d"%(self.scratchdir,taskid))
 		self.completed.remove(taskid)
+		self.sharedimgs.pop(taskid,None)
 
 		return (task,results)
 
@@ -867,7 +900,10 @@ class EMLocalTaskHandler(object):
 				if get_platform() == 'Windows':
 					cmd="python {}\\bin\\".format(e2getinstalldir())+cmd
 					
-				proc=subprocess.Popen(cmd, shell=True, stderr=logfile)
+				# maxthreads tasks run at once, so each gets an equal share of the cpus for libEM threading
+				env=dict(os.environ)
+				if "EMAN_NUM_THREADS" not in env : env["EMAN_NUM_THREADS"]=str(max(1,(os.cpu_count() or 1)//self.maxthreads))
+				proc=subprocess.Popen(cmd, shell=True, stderr=logfile, env=env)
 				self.running.append((proc,self.nextid))
 				EMLocalTaskHandler.allrunning[self.nextid] = proc
 				self.nextid+=1
@@ -207,7 +207,7 @@ class EMStack():
 	def coerce_emdata(self):
 		"""Forces the current representation to EMData/NumPy"""
 		if isinstance(self._data,list): return
-		elif isinstance(self._data,np.ndarray): self._data=[from_numpy(i) for i in self._data]
+		elif isinstance(self._data,np.ndarray): self._data=EMNumPy.numpy2em_stack(self._data)
 		elif isinstance(self._data,tf.Tensor): self._data=from_tf(self._data,True)
 		else: raise Exception(f"Invalid data in EMStack3D: {type(self._data)}")
 		self._npy_list=None		# not necessary if already EMData list
@@ -766,7 +766,7 @@ def from_tf(tftensor,stack=False):
 	If stack is set, then the first axis of the tensor will be unpacked to form a list. ie a 3D tensor would become a list of 2D EMData objects"""
 
 	if stack:
-		return [EMNumPy.numpy2em(tftensor[i].numpy()) for i in range(tftensor.shape[0])]
+		return EMNumPy.numpy2em_stack(tftensor.numpy())
 	return EMNumPy.numpy2em(tftensor.numpy())
 
 def to_tfvar(emdata):
@@ -775,7 +775,7 @@ def to_tfvar(emdata):
 		return tf.Variable(EMNumPy.em2numpy(emdata))
 
 	if isinstance(emdata,list) or isinstance(emdata,tuple):
-		npstack=np.stack([to_numpy(im) for im in emdata],axis=0)
+		npstack=EMNumPy.em2numpy_stack(list(emdata))
 		return tf.Variable(npstack)
 
 def to_tf(emdata):
@@ -785,7 +785,7 @@ def to_tf(emdata):
 		return tf.constant(EMNumPy.em2numpy(emdata))
 
 	if isinstance(emdata,list) or isinstance(emdata,tuple):
-		npstack=np.stack([to_numpy(im) for im in emdata],axis=0)
+		npstack=EMNumPy.em2numpy_stack(list(emdata))
 		return tf.constant(npstack)
 
 def tf_fft2d(imgs):
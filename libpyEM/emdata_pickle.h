@@ -53,6 +53,26 @@ struct EMData_pickle_suite : boost::python::pickle_suite
 		using namespace boost::python;
 		EMAN::EMData const& em = extract<EMAN::EMData const&>(em_obj)();
 		
+		return state_tuple(em_obj, em, object(em.get_data_pickle()));
+	}
+	
+	/** The pickle state without the pixel data (None in its place). Used
+	 * by the protocol 5 and shared memory reducers, which send the data
+	 * out of band. */
+	static
+	boost::python::tuple
+	getstate_header(boost::python::object em_obj)
+	{
+		using namespace boost::python;
+		EMAN::EMData const& em = extract<EMAN::EMData const&>(em_obj)();
+		
+		return state_tuple(em_obj, em, object());
+	}
+	
+	static
+	boost::python::tuple
+	state_tuple(boost::python::object em_obj, EMAN::EMData const& em, boost::python::object data)
+	{
 		return boost::python::make_tuple(em_obj.attr("__dict__"),
 							em.get_flags(), 
 							em.get_changecount(),
@@ -66,7 +86,7 @@ struct EMData_pickle_suite : boost::python::pickle_suite
 							em.get_pathnum(),
 							em.get_attr_dict(),
 							em.get_translation(),
-							em.get_data_pickle(),
+							data,
 							em.get_supp_pickle());
 	}
 	
@@ -97,7 +117,12 @@ struct EMData_pickle_suite : boost::python::pickle_suite
 		int nx = extract<int>(state[3]);
 		int ny = extract<int>(state[4]);
 		int nz = extract<int>(state[5]);
-		em.set_size(nx, ny, nz);
+		bool has_data = !object(state[13]).is_none();
+		// a header-only state applied to an image that already holds data
+		// of the right size (eg. attached shared memory) keeps that data
+		if (has_data || em.get_data() == 0 || nx != em.get_xsize() || ny != em.get_ysize() || nz != em.get_zsize()) {
+			em.set_size(nx, ny, nz);
+		}
 		
 		int xoff = extract<int>(state[6]);
 		int yoff = extract<int>(state[7]);
@@ -117,8 +142,10 @@ struct EMData_pickle_suite : boost::python::pickle_suite
 		em.set_translation(all_translation);
 		
 		//vector<float> vf = extract< vector<float> >(state[13]);
-		std::string vf = extract< std::string >(state[13]);
-		em.set_data_pickle(vf);
+		if (has_data) {
+			std::string vf = extract< std::string >(state[13]);
+			em.set_data_pickle(vf);
+		}
 		
 		int fake_supp = extract<int>(state[14]);
 		em.set_supp_pickle(fake_supp);
@@ -0,0 +1,70 @@
+/*
+ * This software is issued under a joint BSD/GNU license. You may use the
+ * source code in this file under either license. However, note that the
+ * complete EMAN2 and SPARX software packages have some GPL dependencies,
+ * so you are responsible for compliance with the licenses of these packages
+ * if you opt to use BSD licensing. The warranty disclaimer below holds
+ * in either instance.
+ *
+ * This complete copyright notice must be included in any revised version of the
+ * source code. Additional authorship citations may be added, but existing
+ * author citations must be preserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA 
+ */
+
+#ifndef eman__gilrelease_h__
+#define eman__gilrelease_h__ 1
+
+#include <Python.h>
+
+namespace EMAN
+{
+	/** Instantiating this class in a binding releases the GIL for the rest of the
+	 * scope, so other Python threads run while libEM does the pixel work. It is
+	 * restored on every exit path, including exceptions, before Boost.Python
+	 * converts the result. Only the C++ call may happen inside the scope: no
+	 * Python objects may be touched until it ends.
+	 * drawn from https://wiki.python.org/moin/boost.python/HowTo#Multithreading_Support_for_my_function
+	 */
+	class GILRelease
+	{
+	public:
+		inline GILRelease() { m_thread_state = PyEval_SaveThread(); }
+		inline ~GILRelease() { PyEval_RestoreThread(m_thread_state); m_thread_state = NULL; }
+	private:
+		GILRelease(const GILRelease&);
+		GILRelease& operator=(const GILRelease&);
+		PyThreadState * m_thread_state;
+	};
+
+	/** The counterpart of GILRelease for the Python-side overrides of virtual
+	 * methods (the *_Wrapper classes). A released binding may end up in one of
+	 * them, so each takes the GIL back before calling into Python. This is a
+	 * no-op cost when the calling thread already holds it.
+	 */
+	class GILAcquire
+	{
+	public:
+		inline GILAcquire() { m_state = PyGILState_Ensure(); }
+		inline ~GILAcquire() { PyGILState_Release(m_state); }
+	private:
+		GILAcquire(const GILAcquire&);
+		GILAcquire& operator=(const GILAcquire&);
+		PyGILState_STATE m_state;
+	};
+}
+
+#endif	//eman__gilrelease_h__
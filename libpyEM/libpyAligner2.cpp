@@ -36,6 +36,7 @@
 #include <ctf.h>
 #include <emdata.h>
 #include <emobject.h>
+#include <gilrelease.h>
 #include <xydata.h>
 
 #include "emdata_pickle.h"
@@ -55,22 +56,27 @@ struct EMAN_Aligner_Wrapper: EMAN::Aligner
         EMAN::Aligner(), py_self(py_self_) {}
 
     EMAN::EMData* align(EMAN::EMData* p0, EMAN::EMData* p1) const {
+        EMAN::GILAcquire gil;
         return call_method< EMAN::EMData* >(py_self, "align", p0, p1);
     }
 
     EMAN::EMData* align(EMAN::EMData* p0, EMAN::EMData* p1, const std::string& p2, const EMAN::Dict& p3) const {
+        EMAN::GILAcquire gil;
         return call_method< EMAN::EMData* >(py_self, "align", p0, p1, p2, p3);
     }
 
     std::string get_name() const {
+        EMAN::GILAcquire gil;
         return call_method< std::string >(py_self, "get_name");
     }
 
     std::string get_desc() const {
+        EMAN::GILAcquire gil;
         return call_method< std::string >(py_self, "get_desc");
     }
 
     EMAN::Dict get_params() const {
+        EMAN::GILAcquire gil;
         return call_method< EMAN::Dict >(py_self, "get_params");
     }
 
@@ -79,6 +85,7 @@ struct EMAN_Aligner_Wrapper: EMAN::Aligner
     }
 
     void set_params(const EMAN::Dict& p0) {
+        EMAN::GILAcquire gil;
         call_method< void >(py_self, "set_params", p0);
     }
 
@@ -87,6 +94,7 @@ struct EMAN_Aligner_Wrapper: EMAN::Aligner
     }
 
     EMAN::TypeDict get_param_types() const {
+        EMAN::GILAcquire gil;
         return call_method< EMAN::TypeDict >(py_self, "get_param_types");
     }
 
@@ -103,62 +111,77 @@ struct EMAN_Ctf_Wrapper: EMAN::Ctf
         EMAN::Ctf(), py_self(py_self_) {}
 
 	float get_phase() const {
+        EMAN::GILAcquire gil;
         return call_method< float >(py_self, "get_phase");
 	}
 
 	void set_phase(float phase) {
+        EMAN::GILAcquire gil;
         return call_method< void >(py_self, "set_phase", phase);
 	}
 
     int from_string(const std::string& p0) {
+        EMAN::GILAcquire gil;
         return call_method< int >(py_self, "from_string", p0);
     }
 
     std::string to_string() const {
+        EMAN::GILAcquire gil;
         return call_method< std::string >(py_self, "to_string");
     }
 
     void from_dict(const EMAN::Dict& p0) {
+        EMAN::GILAcquire gil;
         call_method< void >(py_self, "from_dict", p0);
     }
 
     EMAN::Dict to_dict() const {
+        EMAN::GILAcquire gil;
         return call_method< EMAN::Dict >(py_self, "to_dict");
     }
 
     void from_vector(const std::vector<float,std::allocator<float> >& p0) {
+        EMAN::GILAcquire gil;
         call_method< void >(py_self, "from_vector", p0);
     }
 
     std::vector<float,std::allocator<float> > to_vector() const {
+        EMAN::GILAcquire gil;
         return call_method< std::vector<float,std::allocator<float> > >(py_self, "to_vector");
     }
 
     std::vector<float,std::allocator<float> > compute_1d(int p0,float p1, EMAN::Ctf::CtfType p2, EMAN::XYData* p3) {
+        EMAN::GILAcquire gil;
         return call_method< std::vector<float,std::allocator<float> > >(py_self, "compute_1d", p0, p1, p2, p3);
     }
 
     std::vector<float,std::allocator<float> > compute_1d_fromimage(int p0, float p1, EMAN::EMData *p2) {
+        EMAN::GILAcquire gil;
         return call_method< std::vector<float,std::allocator<float> > >(py_self, "compute_1d_fromimage", p0, p1, p2);
     }
 
     void compute_2d_real(EMAN::EMData* p0, EMAN::Ctf::CtfType p1, EMAN::XYData* p2) {
+        EMAN::GILAcquire gil;
         call_method< void >(py_self, "compute_2d_real", p0, p1, p2);
     }
 
     void compute_2d_complex(EMAN::EMData* p0, EMAN::Ctf::CtfType p1, EMAN::XYData* p2) {
+        EMAN::GILAcquire gil;
         call_method< void >(py_self, "compute_2d_complex", p0, p1, p2);
     }
 
     void copy_from(const EMAN::Ctf* p0) {
+        EMAN::GILAcquire gil;
         call_method< void >(py_self, "copy_from", p0);
     }
 
     bool equal(const EMAN::Ctf* p0) const {
+        EMAN::GILAcquire gil;
         return call_method< bool >(py_self, "equal", p0);
     }
 
     float zero(int n) const {
+        EMAN::GILAcquire gil;
         return call_method< float >(py_self, "zero", n);
     }
 
@@ -175,6 +198,7 @@ struct EMAN_EMAN1Ctf_Wrapper: EMAN::EMAN1Ctf
         EMAN::EMAN1Ctf(), py_self(py_self_) {}
 
     std::vector<float,std::allocator<float> > compute_1d(int p0, float p1,EMAN::Ctf::CtfType p2, EMAN::XYData* p3) {
+        EMAN::GILAcquire gil;
         return call_method< std::vector<float,std::allocator<float> > >(py_self, "compute_1d", p0, p1, p2, p3);
     }
 
@@ -187,6 +211,7 @@ struct EMAN_EMAN1Ctf_Wrapper: EMAN::EMAN1Ctf
     }
 
     std::vector<float,std::allocator<float> > compute_1d_fromimage(int p0, float p1, EMAN::EMData* p2) {
+        EMAN::GILAcquire gil;
         return call_method< std::vector<float,std::allocator<float> > >(py_self, "compute_1d_fromimage", p0, p1, p2);
     }
 
@@ -195,6 +220,7 @@ struct EMAN_EMAN1Ctf_Wrapper: EMAN::EMAN1Ctf
     }
 
 	float get_phase() const {
+        EMAN::GILAcquire gil;
         return call_method< float >(py_self, "get_phase");
 	}
 
@@ -203,6 +229,7 @@ struct EMAN_EMAN1Ctf_Wrapper: EMAN::EMAN1Ctf
 	}
 
 	void set_phase(float phase) {
+        EMAN::GILAcquire gil;
         return call_method< void >(py_self, "set_phase", phase);
 	}
 
@@ -211,6 +238,7 @@ struct EMAN_EMAN1Ctf_Wrapper: EMAN::EMAN1Ctf
 	}
 		
     void compute_2d_real(EMAN::EMData* p0, EMAN::Ctf::CtfType p1, EMAN::XYData* p2) {
+        EMAN::GILAcquire gil;
         call_method< void >(py_self, "compute_2d_real", p0, p1, p2);
     }
 
@@ -223,6 +251,7 @@ struct EMAN_EMAN1Ctf_Wrapper: EMAN::EMAN1Ctf
     }
 
     void compute_2d_complex(EMAN::EMData* p0, EMAN::Ctf::CtfType p1, EMAN::XYData* p2) {
+        EMAN::GILAcquire gil;
         call_method< void >(py_self, "compute_2d_complex", p0, p1, p2);
     }
 
@@ -235,6 +264,7 @@ struct EMAN_EMAN1Ctf_Wrapper: EMAN::EMAN1Ctf
     }
 
     int from_string(const std::string& p0) {
+        EMAN::GILAcquire gil;
         return call_method< int >(py_self, "from_string", p0);
     }
 
@@ -243,6 +273,7 @@ struct EMAN_EMAN1Ctf_Wrapper: EMAN::EMAN1Ctf
     }
 
     std::string to_string() const {
+        EMAN::GILAcquire gil;
         return call_method< std::string >(py_self, "to_string");
     }
 
@@ -251,6 +282,7 @@ struct EMAN_EMAN1Ctf_Wrapper: EMAN::EMAN1Ctf
     }
 
     void from_dict(const EMAN::Dict& p0) {
+        EMAN::GILAcquire gil;
         call_method< void >(py_self, "from_dict", p0);
     }
 
@@ -259,6 +291,7 @@ struct EMAN_EMAN1Ctf_Wrapper: EMAN::EMAN1Ctf
     }
 
     EMAN::Dict to_dict() const {
+        EMAN::GILAcquire gil;
         return call_method< EMAN::Dict >(py_self, "to_dict");
     }
 
@@ -267,6 +300,7 @@ struct EMAN_EMAN1Ctf_Wrapper: EMAN::EMAN1Ctf
     }
 
     void from_vector(const std::vector<float,std::allocator<float> >& p0) {
+        EMAN::GILAcquire gil;
         call_method< void >(py_self, "from_vector", p0);
     }
 
@@ -275,6 +309,7 @@ struct EMAN_EMAN1Ctf_Wrapper: EMAN::EMAN1Ctf
     }
 
     std::vector<float,std::allocator<float> > to_vector() const {
+        EMAN::GILAcquire gil;
         return call_method< std::vector<float,std::allocator<float> > >(py_self, "to_vector");
     }
 
@@ -283,6 +318,7 @@ struct EMAN_EMAN1Ctf_Wrapper: EMAN::EMAN1Ctf
     }
 
     void copy_from(const EMAN::Ctf* p0) {
+        EMAN::GILAcquire gil;
         call_method< void >(py_self, "copy_from", p0);
     }
 
@@ -291,6 +327,7 @@ struct EMAN_EMAN1Ctf_Wrapper: EMAN::EMAN1Ctf
     }
 
     bool equal(const EMAN::Ctf* p0) const {
+        EMAN::GILAcquire gil;
         return call_method< bool >(py_self, "equal", p0);
     }
     
@@ -299,6 +336,7 @@ struct EMAN_EMAN1Ctf_Wrapper: EMAN::EMAN1Ctf
     }
     
     float zero(int p0) const {
+        EMAN::GILAcquire gil;
         return call_method< float >(py_self, "zero", p0);
     }
 
@@ -318,6 +356,7 @@ struct EMAN_EMAN2Ctf_Wrapper: EMAN::EMAN2Ctf
         EMAN::EMAN2Ctf(), py_self(py_self_) {}
 
     std::vector<float,std::allocator<float> > compute_1d(int p0, float p1, EMAN::Ctf::CtfType p2, EMAN::XYData* p3) {
+        EMAN::GILAcquire gil;
         return call_method< std::vector<float,std::allocator<float> > >(py_self, "compute_1d", p0, p1, p2, p3);
     }
 
@@ -330,6 +369,7 @@ struct EMAN_EMAN2Ctf_Wrapper: EMAN::EMAN2Ctf
     }
     
     float get_phase() const {
+        EMAN::GILAcquire gil;
         return call_method< float >(py_self, "get_phase");
 	}
 
@@ -338,6 +378,7 @@ struct EMAN_EMAN2Ctf_Wrapper: EMAN::EMAN2Ctf
 	}
 
 	void set_phase(float phase) {
+        EMAN::GILAcquire gil;
         return call_method< void >(py_self, "set_phase", phase);
 	}
 
@@ -347,6 +388,7 @@ struct EMAN_EMAN2Ctf_Wrapper: EMAN::EMAN2Ctf
 
 	
     std::vector<float,std::allocator<float> > compute_1d_fromimage(int p0, float p1, EMAN::Ctf::CtfType p2, EMAN::XYData* p3) {
+        EMAN::GILAcquire gil;
         return call_method< std::vector<float,std::allocator<float> > >(py_self, "compute_1d_fromimage", p0, p1, p2, p3);
     }
 
@@ -355,6 +397,7 @@ struct EMAN_EMAN2Ctf_Wrapper: EMAN::EMAN2Ctf
     }
 
     void compute_2d_real(EMAN::EMData* p0, EMAN::Ctf::CtfType p1, EMAN::XYData* p2) {
+        EMAN::GILAcquire gil;
         call_method< void >(py_self, "compute_2d_real", p0, p1, p2);
     }
 
@@ -367,6 +410,7 @@ struct EMAN_EMAN2Ctf_Wrapper: EMAN::EMAN2Ctf
     }
 
     void compute_2d_complex(EMAN::EMData* p0, EMAN::Ctf::CtfType p1, EMAN::XYData* p2) {
+        EMAN::GILAcquire gil;
         call_method< void >(py_self, "compute_2d_complex", p0, p1, p2);
     }
 
@@ -379,6 +423,7 @@ struct EMAN_EMAN2Ctf_Wrapper: EMAN::EMAN2Ctf
     }
 
     int from_string(const std::string& p0) {
+        EMAN::GILAcquire gil;
         return call_method< int >(py_self, "from_string", p0);
     }
 
@@ -387,6 +432,7 @@ struct EMAN_EMAN2Ctf_Wrapper: EMAN::EMAN2Ctf
     }
 
     std::string to_string() const {
+        EMAN::GILAcquire gil;
         return call_method< std::string >(py_self, "to_string");
     }
 
@@ -395,6 +441,7 @@ struct EMAN_EMAN2Ctf_Wrapper: EMAN::EMAN2Ctf
     }
 
     void from_dict(const EMAN::Dict& p0) {
+        EMAN::GILAcquire gil;
         call_method< void >(py_self, "from_dict", p0);
     }
 
@@ -403,6 +450,7 @@ struct EMAN_EMAN2Ctf_Wrapper: EMAN::EMAN2Ctf
     }
 
     EMAN::Dict to_dict() const {
+        EMAN::GILAcquire gil;
         return call_method< EMAN::Dict >(py_self, "to_dict");
     }
 
@@ -411,6 +459,7 @@ struct EMAN_EMAN2Ctf_Wrapper: EMAN::EMAN2Ctf
     }
 
     void from_vector(const std::vector<float,std::allocator<float> >& p0) {
+        EMAN::GILAcquire gil;
         call_method< void >(py_self, "from_vector", p0);
     }
 
@@ -419,6 +468,7 @@ struct EMAN_EMAN2Ctf_Wrapper: EMAN::EMAN2Ctf
     }
 
     std::vector<float,std::allocator<float> > to_vector() const {
+        EMAN::GILAcquire gil;
         return call_method< std::vector<float,std::allocator<float> > >(py_self, "to_vector");
     }
 
@@ -427,6 +477,7 @@ struct EMAN_EMAN2Ctf_Wrapper: EMAN::EMAN2Ctf
     }
 
     void copy_from(const EMAN::Ctf* p0) {
+        EMAN::GILAcquire gil;
         call_method< void >(py_self, "copy_from", p0);
     }
 
@@ -435,6 +486,7 @@ struct EMAN_EMAN2Ctf_Wrapper: EMAN::EMAN2Ctf
     }
 
     bool equal(const EMAN::Ctf* p0) const {
+        EMAN::GILAcquire gil;
         return call_method< bool >(py_self, "equal", p0);
     }
 
@@ -443,6 +495,7 @@ struct EMAN_EMAN2Ctf_Wrapper: EMAN::EMAN2Ctf
     }
 
     float zero(int p0) const {
+        EMAN::GILAcquire gil;
         return call_method< float >(py_self, "zero", p0);
     }
     
@@ -454,6 +507,24 @@ struct EMAN_EMAN2Ctf_Wrapper: EMAN::EMAN2Ctf
     PyObject* py_self;
 };
 
+EMAN::EMData *aligner_align_wrapper2(const EMAN::Aligner &ths, EMAN::EMData *this_img, EMAN::EMData *to_img) {
+	EMAN::GILRelease rel;
+
+	return ths.align(this_img,to_img);
+}
+
+EMAN::EMData *aligner_align_wrapper4(const EMAN::Aligner &ths, EMAN::EMData *this_img, EMAN::EMData *to_img, const std::string &cmp_name, const EMAN::Dict &cmp_params) {
+	EMAN::GILRelease rel;
+
+	return ths.align(this_img,to_img,cmp_name,cmp_params);
+}
+
+std::vector<EMAN::Dict> aligner_xform_align_nbest_wrapper(const EMAN::Aligner &ths, EMAN::EMData *this_img, EMAN::EMData *to_img, const unsigned int nsoln, const std::string &cmp_name, const EMAN::Dict &cmp_params) {
+	EMAN::GILRelease rel;
+
+	return ths.xform_align_nbest(this_img,to_img,nsoln,cmp_name,cmp_params);
+}
+
 }// namespace
 
 
@@ -463,9 +534,9 @@ BOOST_PYTHON_MODULE(libpyAligner2)
     def("dump_aligners", &EMAN::dump_aligners);
     def("dump_aligners_list", &EMAN::dump_aligners_list);
     class_< EMAN::Aligner, boost::noncopyable, EMAN_Aligner_Wrapper >("__Aligner", init<  >())
-        .def("align", pure_virtual((EMAN::EMData* (EMAN::Aligner::*)(EMAN::EMData*, EMAN::EMData*) const)&EMAN::Aligner::align), return_value_policy< manage_new_object >())
-        .def("align", pure_virtual((EMAN::EMData* (EMAN::Aligner::*)(EMAN::EMData*, EMAN::EMData*, const std::string&, const EMAN::Dict&) const)&EMAN::Aligner::align), return_value_policy< manage_new_object >())
-		.def("xform_align_nbest", &EMAN::Aligner::xform_align_nbest)
+        .def("align", pure_virtual(&aligner_align_wrapper2), return_value_policy< manage_new_object >())
+        .def("align", pure_virtual(&aligner_align_wrapper4), return_value_policy< manage_new_object >())
+		.def("xform_align_nbest", &aligner_xform_align_nbest_wrapper)
         .def("get_name", pure_virtual(&EMAN::Aligner::get_name))
         .def("get_desc", pure_virtual(&EMAN::Aligner::get_desc))
         .def("get_params", &EMAN::Aligner::get_params, &EMAN_Aligner_Wrapper::default_get_params)
@@ -35,6 +35,7 @@
 #include <analyzer.h>
 #include <emdata.h>
 #include <emobject.h>
+#include <gilrelease.h>
 
 // Using =======================================================================
 using namespace boost::python;
@@ -51,26 +52,32 @@ struct EMAN_Analyzer_Wrapper: EMAN::Analyzer
         EMAN::Analyzer(), py_self(py_self_) {}
 
     int insert_image(EMAN::EMData* p0) {
+        EMAN::GILAcquire gil;
         return call_method< int >(py_self, "insert_image", p0);
     }
 
     int insert_images_list(std::vector<EMAN::EMData*,std::allocator<EMAN::EMData*> > p0) {
+        EMAN::GILAcquire gil;
         return call_method< int >(py_self, "insert_images_list", p0);
     }
 
     std::vector<EMAN::EMData*,std::allocator<EMAN::EMData*> > analyze() {
+        EMAN::GILAcquire gil;
         return call_method< std::vector<EMAN::EMData*,std::allocator<EMAN::EMData*> > >(py_self, "analyze");
     }
 
     std::string get_name() const {
+        EMAN::GILAcquire gil;
         return call_method< std::string >(py_self, "get_name");
     }
 
     std::string get_desc() const {
+        EMAN::GILAcquire gil;
         return call_method< std::string >(py_self, "get_desc");
     }
 
     void set_params(const EMAN::Dict& p0) {
+        EMAN::GILAcquire gil;
         call_method< void >(py_self, "set_params", p0);
     }
 
@@ -79,6 +86,7 @@ struct EMAN_Analyzer_Wrapper: EMAN::Analyzer
     }
 
     EMAN::Dict get_params() const {
+        EMAN::GILAcquire gil;
         return call_method< EMAN::Dict >(py_self, "get_params");
     }
 
@@ -87,6 +95,7 @@ struct EMAN_Analyzer_Wrapper: EMAN::Analyzer
     }
 
     EMAN::TypeDict get_param_types() const {
+        EMAN::GILAcquire gil;
         return call_method< EMAN::TypeDict >(py_self, "get_param_types");
     }
 
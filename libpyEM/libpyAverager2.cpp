@@ -34,7 +34,9 @@
 // Includes ====================================================================
 #include <averager.h>
 #include <emdata.h>
+#include <emdatastack.h>
 #include <emobject.h>
+#include <gilrelease.h>
 
 // Using =======================================================================
 using namespace boost::python;
@@ -42,15 +44,6 @@ using namespace boost::python;
 // Declarations ================================================================
 namespace  {
 
-class GILRelease
-{
-public:
-    inline GILRelease() { m_thread_state = PyEval_SaveThread(); }
-    inline ~GILRelease() { PyEval_RestoreThread(m_thread_state); m_thread_state = NULL; }
-private:
-    PyThreadState * m_thread_state;
-};
-
 // This is a really wierd construct. I think someone probably didn't know what they were doing with
 // Boost when writing it, but since it works, I'm leaving it alone
 struct EMAN_Averager_Wrapper: EMAN::Averager
@@ -62,6 +55,7 @@ struct EMAN_Averager_Wrapper: EMAN::Averager
         EMAN::Averager(), py_self(py_self_) {}
 
     void add_image(EMAN::EMData* p0) {
+      EMAN::GILAcquire gil;
       call_method< void >(py_self, "add_image", p0);
     }
     
@@ -70,6 +64,7 @@ struct EMAN_Averager_Wrapper: EMAN::Averager
     }
 
     void add_image_list(const std::vector<EMAN::EMData*,std::allocator<EMAN::EMData*> >& p0) {
+        EMAN::GILAcquire gil;
         call_method< void >(py_self, "add_image_list", p0);
     }
 
@@ -78,18 +73,22 @@ struct EMAN_Averager_Wrapper: EMAN::Averager
     }
 
     EMAN::EMData* finish() {
+        EMAN::GILAcquire gil;
         return call_method< EMAN::EMData* >(py_self, "finish");
     }
 
     std::string get_name() const {
+        EMAN::GILAcquire gil;
         return call_method< std::string >(py_self, "get_name");
     }
 
     std::string get_desc() const {
+        EMAN::GILAcquire gil;
         return call_method< std::string >(py_self, "get_desc");
     }
 
     void set_params(const EMAN::Dict& p0) {
+        EMAN::GILAcquire gil;
         call_method< void >(py_self, "set_params", p0);
     }
 
@@ -98,6 +97,7 @@ struct EMAN_Averager_Wrapper: EMAN::Averager
     }
 
     EMAN::TypeDict get_param_types() const {
+        EMAN::GILAcquire gil;
         return call_method< EMAN::TypeDict >(py_self, "get_param_types");
     }
 
@@ -109,11 +109,23 @@ struct EMAN_Averager_Wrapper: EMAN::Averager
 };
 
 void averager_add_image_wrapper(EMAN::Averager &ths, EMAN::EMData *img) {
-	GILRelease rel;
+	EMAN::GILRelease rel;
 	
 	ths.add_image(img);
 }
 
+void averager_add_image_stack_wrapper(EMAN::Averager &ths, const EMAN::EMDataStack &stack) {
+	EMAN::GILRelease rel;
+
+	ths.add_image_stack(stack);
+}
+
+EMAN::EMData *averager_finish_wrapper(EMAN::Averager &ths) {
+	EMAN::GILRelease rel;
+
+	return ths.finish();
+}
+
 
 }// namespace
 
@@ -126,8 +138,9 @@ BOOST_PYTHON_MODULE(libpyAverager2)
         .def("add_image",&averager_add_image_wrapper)
 //        .def("add_image",&EMAN::Averager::add_image, &EMAN_Averager_Wrapper::default_add_image)
         .def("add_image_list", &EMAN::Averager::add_image_list, &EMAN_Averager_Wrapper::default_add_image_list)
+        .def("add_image_stack", &averager_add_image_stack_wrapper, args("stack"), "Add every image in an EMDataStack. Some averagers sum the stack buffer directly.")
 		.def("mult", &EMAN::Averager::mult)
-        .def("finish", pure_virtual(&EMAN::Averager::finish), return_value_policy< manage_new_object >())
+        .def("finish", pure_virtual(&averager_finish_wrapper), return_value_policy< manage_new_object >())
         .def("get_name", pure_virtual(&EMAN::Averager::get_name))
         .def("get_desc", pure_virtual(&EMAN::Averager::get_desc))
         .def("set_params", &EMAN::Averager::set_params, &EMAN_Averager_Wrapper::default_set_params)
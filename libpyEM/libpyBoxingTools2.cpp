@@ -33,6 +33,7 @@
 
 // Includes ====================================================================
 #include "boxingtools.h"
+#include <gilrelease.h>
 
 // Using =======================================================================
 using namespace boost::python;
@@ -40,6 +41,37 @@ using namespace boost::python;
 // Declarations ================================================================
 namespace  {
 
+	vector<std::shared_ptr<EMAN::EMData>> BoxingTools_extract_boxes(const EMAN::EMData* const image,
+			const vector<EMAN::Vec3i>& centers, int boxsize, const EMAN::Dict& params)
+	{
+		vector<EMAN::EMData*> boxes;
+		{
+			EMAN::GILRelease rel;
+			boxes = EMAN::BoxingTools::extract_boxes(image, centers, boxsize, params);
+		}
+
+		return vector<std::shared_ptr<EMAN::EMData>>(boxes.begin(), boxes.end());
+	}
+
+	vector<std::shared_ptr<EMAN::EMData>> BoxingTools_extract_boxes_1(const EMAN::EMData* const image,
+			const vector<EMAN::Vec3i>& centers, int boxsize)
+	{
+		return BoxingTools_extract_boxes(image, centers, boxsize, EMAN::Dict());
+	}
+
+	int BoxingTools_extract_boxes_to_file(const string& infile, int image_index,
+			const vector<EMAN::Vec3i>& centers, int boxsize, const string& outfile, const EMAN::Dict& params)
+	{
+		EMAN::GILRelease rel;
+		return EMAN::BoxingTools::extract_boxes_to_file(infile, image_index, centers, boxsize, outfile, params);
+	}
+
+	int BoxingTools_extract_boxes_to_file_1(const string& infile, int image_index,
+			const vector<EMAN::Vec3i>& centers, int boxsize, const string& outfile)
+	{
+		return BoxingTools_extract_boxes_to_file(infile, image_index, centers, boxsize, outfile, EMAN::Dict());
+	}
+
 	// Module ======================================================================
 	BOOST_PYTHON_MODULE(libpyBoxingTools2)
 	{
@@ -59,6 +91,10 @@ namespace  {
 		.def("get_color",&EMAN::BoxingTools::get_color)
 		.def("set_mode",&EMAN::BoxingTools::set_mode)
 		.def("set_region",&EMAN::BoxingTools::set_region)
+		.def("extract_boxes",&BoxingTools_extract_boxes)
+		.def("extract_boxes",&BoxingTools_extract_boxes_1)
+		.def("extract_boxes_to_file",&BoxingTools_extract_boxes_to_file)
+		.def("extract_boxes_to_file",&BoxingTools_extract_boxes_to_file_1)
 		.staticmethod("get_min_delta_profile")
 		.staticmethod("is_local_maximum")
 		.staticmethod("auto_correlation_pick")
@@ -68,6 +104,8 @@ namespace  {
 		.staticmethod("get_color")
 		.staticmethod("set_mode")
 		.staticmethod("set_region")
+		.staticmethod("extract_boxes")
+		.staticmethod("extract_boxes_to_file")
 		);
 
 
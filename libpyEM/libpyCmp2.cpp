@@ -35,6 +35,7 @@
 #include <cmp.h>
 #include <emdata.h>
 #include <emobject.h>
+#include <gilrelease.h>
 #include <log.h>
 #include <transform.h>
 #include <xydata.h>
@@ -54,18 +55,22 @@ struct EMAN_Cmp_Wrapper: EMAN::Cmp
         EMAN::Cmp(), py_self(py_self_) {}
 
     float cmp(EMAN::EMData* p0, EMAN::EMData* p1) const {
+        EMAN::GILAcquire gil;
         return call_method< float >(py_self, "cmp", p0, p1);
     }
 
     std::string get_name() const {
+        EMAN::GILAcquire gil;
         return call_method< std::string >(py_self, "get_name");
     }
 
     std::string get_desc() const {
+        EMAN::GILAcquire gil;
         return call_method< std::string >(py_self, "get_desc");
     }
 
     EMAN::Dict get_params() const {
+        EMAN::GILAcquire gil;
         return call_method< EMAN::Dict >(py_self, "get_params");
     }
 
@@ -74,6 +79,7 @@ struct EMAN_Cmp_Wrapper: EMAN::Cmp
     }
 
     void set_params(const EMAN::Dict& p0) {
+        EMAN::GILAcquire gil;
         call_method< void >(py_self, "set_params", p0);
     }
 
@@ -82,12 +88,19 @@ struct EMAN_Cmp_Wrapper: EMAN::Cmp
     }
 
     EMAN::TypeDict get_param_types() const {
+        EMAN::GILAcquire gil;
         return call_method< EMAN::TypeDict >(py_self, "get_param_types");
     }
 
     PyObject* py_self;
 };
 
+float cmp_cmp_wrapper(EMAN::Cmp &ths, EMAN::EMData *image, EMAN::EMData *with) {
+	EMAN::GILRelease rel;
+
+	return ths.cmp(image,with);
+}
+
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(EMAN_Log_end_overloads_1_3, end, 1, 3)
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(EMAN_XYData_get_yatx_overloads_1_2, get_yatx, 1, 2)
 
@@ -108,7 +121,7 @@ BOOST_PYTHON_MODULE(libpyCmp2)
     ;
 
     class_< EMAN::Cmp, boost::noncopyable, EMAN_Cmp_Wrapper >("__Cmp", init<  >())
-        .def("cmp", pure_virtual(&EMAN::Cmp::cmp))
+        .def("cmp", pure_virtual(&cmp_cmp_wrapper))
         .def("get_name", pure_virtual(&EMAN::Cmp::get_name))
         .def("get_desc", pure_virtual(&EMAN::Cmp::get_desc))
         .def("get_params", &EMAN::Cmp::get_params, &EMAN_Cmp_Wrapper::default_get_params)
@@ -36,11 +36,14 @@
 #include <cmp.h>
 #include <ctf.h>
 #include <emdata.h>
+#include <emdatastack.h>
 #include <emdata_pickle.h>
 #include <emdata_wrapitems.h>
 #include <emfft.h>
+#include <gilrelease.h>
 #include <processor.h>
 #include <transform.h>
+#include <volumesummary.h>
 #include <xydata.h>/** return the FFT amplitude which is greater than thres %
  *
  * @exception ImageFormatException If the image is not a complex image.
@@ -57,16 +60,10 @@ namespace  {
 
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(EMAN_EMData_read_binedimage_overloads_1_5, read_binedimage, 1, 5)
 
-BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(EMAN_EMData_write_image_overloads_1_7, write_image, 1, 7)
-
-BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(EMAN_EMData_append_image_overloads_1_3, append_image, 1, 3)
-
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(EMAN_EMData_write_lst_overloads_1_4, write_lst, 1, 4)
 
 //BOOST_PYTHON_FUNCTION_OVERLOADS(EMAN_EMData_read_images_overloads_1_4, EMAN::EMData::read_images, 1, 4)
 
-BOOST_PYTHON_FUNCTION_OVERLOADS(EMAN_EMData_write_images_overloads_2_8, EMAN::EMData::write_images, 2, 8)
-
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(EMAN_EMData_set_size_overloads_1_4, EMAN::EMData::set_size, 1, 4)
 
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(EMAN_EMData_set_complex_size_overloads_1_3, EMAN::EMData::set_complex_size, 1, 3)
@@ -87,8 +84,6 @@ BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(EMAN_EMData_clip_inplace_overloads_1_2, E
 
 //BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(EMAN_EMData_project_overloads_1_2, EMAN::EMData::project, 1, 2)
 
-BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(EMAN_EMData_backproject_overloads_1_2, EMAN::EMData::backproject, 1, 2)
-
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(EMAN_EMData_insert_scaled_sum_overloads_2_4, EMAN::EMData::insert_scaled_sum, 2, 4)
 
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(EMAN_EMData_add_overloads_1_2, EMAN::EMData::add, 1, 2)
@@ -141,18 +136,12 @@ BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(EMAN_EMData_little_big_dot_overloads_1_2,
 
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(EMAN_EMData_calc_ccf_overloads_0_3, EMAN::EMData::calc_ccf, 0, 3)
 
-BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(EMAN_EMData_calc_ccfx_overloads_1_6, EMAN::EMData::calc_ccfx, 1, 6)
-
-BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(EMAN_EMData_make_rotational_footprint_overloads_0_1, EMAN::EMData::make_rotational_footprint, 0, 1)
-
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(EMAN_EMData_make_rotational_footprint_e1_overloads_0_1, EMAN::EMData::make_rotational_footprint_e1, 0, 1)
 
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(EMAN_EMData_make_rotational_footprint_cmc_overloads_0_1, EMAN::EMData::make_rotational_footprint_cmc, 0, 1)
 
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(EMAN_EMData_calc_mutual_correlation_overloads_1_3, EMAN::EMData::calc_mutual_correlation, 1, 3)
 
-BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(EMAN_EMData_unwrap_overloads_0_7, EMAN::EMData::unwrap, 0, 7)
-
 
 //#ifdef EMAN2_USING_CUDA
 //BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(EMAN_EMData_unwrap_cuda_overloads_0_6, unwrap_cuda, 0, 6)
@@ -176,8 +165,6 @@ BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(EMAN_EMData_cut_slice_overloads_2_3, EMAN
 
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(EMAN_EMData_get_clip_overloads_1_2, EMAN::EMData::get_clip, 1, 2)
 
-BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(EMAN_EMData_mult_overloads_1_2, EMAN::EMData::mult, 1, 2)
-
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(EMAN_EMData_norm_pad_overloads_2_3, EMAN::EMData::norm_pad, 2, 3)
 
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(EMAN_EMData_read_data_overloads_2_6, EMAN::EMData::read_data, 2, 6)
@@ -206,21 +193,15 @@ BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(EMAN_EMData_make_footprint_overloads_0_1,
 
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(EMAN_EMData_compute_missingwedge_overloads_1_3, EMAN::EMData::compute_missingwedge, 1, 3)
 
+BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(EMAN_EMData_to_shared_overloads_0_1, to_shared, 0, 1)
+BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(EMAN_EMData_copy_to_shared_overloads_0_1, copy_to_shared, 0, 1)
+BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(EMAN_EMData_attach_shared_overloads_1_2, attach_shared, 1, 2)
+
 }// namespace
 
 using namespace EMAN;
 //// These give us threadsafety. Couldn't find a more elegant way to do it with overloading :^/
-
-// drawn from https://wiki.python.org/moin/boost.python/HowTo#Multithreading_Support_for_my_function
-// Instantiating this class in the function gives us GIL release
-class GILRelease
-{
-public:
-    inline GILRelease() { m_thread_state = PyEval_SaveThread(); }
-    inline ~GILRelease() { PyEval_RestoreThread(m_thread_state); m_thread_state = NULL; }
-private:
-    PyThreadState * m_thread_state;
-};
+// Every wrapper below releases the GIL (gilrelease.h) around one libEM call
 void EMData_read_image_wrapper1(EMData &ths, const string & filename) 
 {
 	GILRelease rel;
@@ -370,238 +351,280 @@ vector<float> EMData_calc_fourier_shell_correlation_wrapper2(EMData &ths, EMData
 
 
 vector<Dict> EMData_align_nbest_wrapper6(EMData &ths, const string & aligner_name, EMData * to_img, const Dict & params, int nsoln, const string & cmp_name, const Dict& cmp_params) {
-	vector<Dict> ret;
-	PyThreadState *_save = PyEval_SaveThread();
-
-	try {
-		ret = ths.xform_align_nbest(aligner_name,to_img,params,nsoln,cmp_name,cmp_params);
-	}
-	catch (std::exception &e) {
-		PyEval_RestoreThread(_save);
-		cerr << e.what() << endl;
-		throw e;
-	}
-	PyEval_RestoreThread(_save);
-	return ret;
+	GILRelease rel;
+	
+	return ths.xform_align_nbest(aligner_name,to_img,params,nsoln,cmp_name,cmp_params);
 }
 
 vector<Dict> EMData_align_nbest_wrapper5(EMData &ths, const string & aligner_name, EMData * to_img, const Dict & params, int nsoln, const string & cmp_name) {
-	vector<Dict> ret;
-	PyThreadState *_save = PyEval_SaveThread();
-
-	try {
-		ret = ths.xform_align_nbest(aligner_name,to_img,params,nsoln,cmp_name);
-	}
-	catch (std::exception &e) {
-		PyEval_RestoreThread(_save);
-		cerr << e.what() << endl;
-		throw e;
-	}
-	PyEval_RestoreThread(_save);
-	return ret;
+	GILRelease rel;
+	
+	return ths.xform_align_nbest(aligner_name,to_img,params,nsoln,cmp_name);
 }
 
 vector<Dict> EMData_align_nbest_wrapper4(EMData &ths, const string & aligner_name, EMData * to_img, const Dict & params, int nsoln) {
-	vector<Dict> ret;
-	PyThreadState *_save = PyEval_SaveThread();
-
-	try {
-		ret = ths.xform_align_nbest(aligner_name,to_img,params,nsoln);
-	}
-	catch (std::exception &e) {
-		PyEval_RestoreThread(_save);
-		cerr << e.what() << endl;
-		throw e;
-	}
-	PyEval_RestoreThread(_save);
-	return ret;
+	GILRelease rel;
+	
+	return ths.xform_align_nbest(aligner_name,to_img,params,nsoln);
 }
 
 EMData *EMData_align_wrapper2(EMData &ths, const string & aligner_name, EMData * to_img) {
-	EMData *ret;
-	PyThreadState *_save = PyEval_SaveThread();
-
-	try {
-		ret = ths.align(aligner_name,to_img);
-	}
-	catch (std::exception &e) {
-		PyEval_RestoreThread(_save);
-		cerr << e.what() << endl;
-		throw e;
-	}
-	PyEval_RestoreThread(_save);
-	return ret;
+	GILRelease rel;
+	
+	return ths.align(aligner_name,to_img);
 }
 EMData *EMData_align_wrapper3(EMData &ths, const string & aligner_name, EMData * to_img,const Dict & params) {
-	EMData *ret;
-	PyThreadState *_save = PyEval_SaveThread();
-
-	try {
-		ret=ths.align(aligner_name,to_img,params);
-	}
-	catch (std::exception &e) {
-		PyEval_RestoreThread(_save);
-		cerr << e.what() << endl;
-		throw e;
-	}
-	PyEval_RestoreThread(_save);
-	return ret;
+	GILRelease rel;
+	
+	return ths.align(aligner_name,to_img,params);
 }
 EMData *EMData_align_wrapper4(EMData &ths, const string & aligner_name, EMData * to_img,const Dict & params, const string & cmp_name) {
-	EMData *ret;
-	PyThreadState *_save = PyEval_SaveThread();
-
-	try {
-		ret=ths.align(aligner_name,to_img,params,cmp_name);
-	}
-	catch (std::exception &e) {
-		PyEval_RestoreThread(_save);
-		cerr << e.what() << endl;
-		throw e;
-	}
-	PyEval_RestoreThread(_save);
-	return ret;
+	GILRelease rel;
+	
+	return ths.align(aligner_name,to_img,params,cmp_name);
 }
 EMData *EMData_align_wrapper5(EMData &ths, const string & aligner_name, EMData * to_img,const Dict & params, const string & cmp_name, const Dict& cmp_params) {
-	EMData *ret;
-	PyThreadState *_save = PyEval_SaveThread();
-
-	try {
-		ret=ths.align(aligner_name,to_img,params,cmp_name,cmp_params);
-	}
-	catch (std::exception &e) {
-		PyEval_RestoreThread(_save);
-		cerr << e.what() << endl;
-		throw e;
-	}
-	PyEval_RestoreThread(_save);
-	return ret;
+	GILRelease rel;
+	
+	return ths.align(aligner_name,to_img,params,cmp_name,cmp_params);
 }
 
 EMData *EMData_project_wrapperD(EMData &ths,const std::string& name, const Dict & params) {
-	PyThreadState *_save = PyEval_SaveThread();
-	EMData *ret;
-
-	try {
-		ret=ths.project(name,params);
-	}
-	catch (std::exception &e) {
-		PyEval_RestoreThread(_save);
-		cerr << e.what() << endl;
-		throw e;
-	}
-	PyEval_RestoreThread(_save);
+	GILRelease rel;
 	
-	return ret;
+	return ths.project(name,params);
 }
 
 EMData *EMData_project_wrapper(EMData &ths,const std::string& name, const EMAN::Transform& xf) {
-	PyThreadState *_save = PyEval_SaveThread();
-	EMData *ret;
-
-	try {
-		ret=ths.project(name,xf);
-	}
-	catch (std::exception &e) {
-		PyEval_RestoreThread(_save);
-		cerr << e.what() << endl;
-		throw e;
-	}
-	PyEval_RestoreThread(_save);
+	GILRelease rel;
 	
-	return ret;
+	return ths.project(name,xf);
 }
 
 void EMData_process_inplace_wrapper1(EMData &ths,const string & processorname) {
-	PyThreadState *_save = PyEval_SaveThread();
+	GILRelease rel;
 	
-	try {
-		ths.process_inplace(processorname);
-	}
-	catch (std::exception &e) {
-		PyEval_RestoreThread(_save);
-		cerr << e.what() << endl;
-		throw e;
-	}
-	PyEval_RestoreThread(_save);
+	ths.process_inplace(processorname);
 }
 
 void EMData_process_inplace_wrapper2(EMData &ths,const string & processorname, const Dict & params) {
-	PyThreadState *_save = PyEval_SaveThread();
-
-	try {
-		ths.process_inplace(processorname,params);
-	}
-	catch (std::exception &e) {
-		PyEval_RestoreThread(_save);
-		cerr << e.what() << endl;
-		throw e;
-	}
-	PyEval_RestoreThread(_save);
+	GILRelease rel;
+	
+	ths.process_inplace(processorname,params);
 }
 
 EMData *EMData_process_wrapper1(EMData &ths,const string & processorname) {
-	EMData *ret;
-	PyThreadState *_save = PyEval_SaveThread();
-
-	try {
-		ret=ths.process(processorname);
-	}
-	catch (std::exception &e) {
-		PyEval_RestoreThread(_save);
-		cerr << e.what() << endl;
-		throw e;
-	}
-	PyEval_RestoreThread(_save);
-	return ret;
+	GILRelease rel;
+	
+	return ths.process(processorname);
 }
 EMData *EMData_process_wrapper2(EMData &ths,const string & processorname, const Dict & params) {
-	EMData *ret;
-	PyThreadState *_save = PyEval_SaveThread();
-
-	try {
-		ret=ths.process(processorname,params);
-	}
-	catch (std::exception &e) {
-		PyEval_RestoreThread(_save);
-		cerr << e.what() << endl;
-		throw e;
-	}
-	PyEval_RestoreThread(_save);
-	return ret;
+	GILRelease rel;
+	
+	return ths.process(processorname,params);
 }
 
 float EMData_cmp_wrapper2(EMData &ths,const string & cmpname, EMData * with) {
-	float ret;
-	PyThreadState *_save = PyEval_SaveThread();
+	GILRelease rel;
+	
+	return ths.cmp(cmpname,with);
+}
+float EMData_cmp_wrapper3(EMData &ths,const string & cmpname, EMData * with, const Dict & params) {
+	GILRelease rel;
+	
+	return ths.cmp(cmpname,with,params);
+}
 
-	try {
-		ret=ths.cmp(cmpname,with);
-	}
-	catch (std::exception &e) {
-		PyEval_RestoreThread(_save);
-		cerr << e.what() << endl;
-		throw e;
+EMData *EMData_process_processor_wrapper(EMData &ths, Processor *p) {
+	GILRelease rel;
+	
+	return ths.process(p);
+}
+
+void EMData_process_inplace_processor_wrapper(EMData &ths, Processor *p) {
+	GILRelease rel;
+	
+	ths.process_inplace(p);
+}
+
+void EMData_write_image_wrapper(EMData &ths, const string & filename, int img_index=0, EMUtil::ImageType imgtype=EMUtil::IMAGE_UNKNOWN, bool header_only=false, const Region *region=0, EMUtil::EMDataType filestoragetype=EMUtil::EM_FLOAT, bool use_host_endian=true) {
+	GILRelease rel;
+	
+	ths.write_image(filename,img_index,imgtype,header_only,region,filestoragetype,use_host_endian);
+}
+BOOST_PYTHON_FUNCTION_OVERLOADS(EMData_write_image_wrapper_overloads_2_8, EMData_write_image_wrapper, 2, 8)
+
+void EMData_append_image_wrapper(EMData &ths, const string & filename, EMUtil::ImageType imgtype=EMUtil::IMAGE_UNKNOWN, bool header_only=false) {
+	GILRelease rel;
+	
+	ths.append_image(filename,imgtype,header_only);
+}
+BOOST_PYTHON_FUNCTION_OVERLOADS(EMData_append_image_wrapper_overloads_2_4, EMData_append_image_wrapper, 2, 4)
+
+bool EMData_write_images_wrapper(const string & filename, vector<std::shared_ptr<EMData>> imgs, int idxs=0, EMUtil::ImageType imgtype=EMUtil::IMAGE_UNKNOWN, bool header_only=false, const Region *region=nullptr, EMUtil::EMDataType filestoragetype=EMUtil::EM_FLOAT, bool use_host_endian=true) {
+	GILRelease rel;
+	
+	return EMData::write_images(filename,imgs,idxs,imgtype,header_only,region,filestoragetype,use_host_endian);
+}
+BOOST_PYTHON_FUNCTION_OVERLOADS(EMData_write_images_wrapper_overloads_2_8, EMData_write_images_wrapper, 2, 8)
+
+void EMData_do_fft_inplace_wrapper(EMData &ths) {
+	GILRelease rel;
+	
+	ths.do_fft_inplace();
+}
+
+EMData *EMData_do_ift_wrapper(EMData &ths) {
+	GILRelease rel;
+	
+	return ths.do_ift();
+}
+
+void EMData_do_ift_inplace_wrapper(EMData &ths) {
+	GILRelease rel;
+	
+	ths.do_ift_inplace();
+}
+
+EMData *EMData_backproject_wrapper(EMData &ths, const string & projector_name, const Dict & params=Dict()) {
+	GILRelease rel;
+	
+	return ths.backproject(projector_name,params);
+}
+BOOST_PYTHON_FUNCTION_OVERLOADS(EMData_backproject_wrapper_overloads_2_3, EMData_backproject_wrapper, 2, 3)
+
+EMData *EMData_calc_ccfx_wrapper(EMData &ths, EMData *with, int y0=0, int y1=-1, bool nosum=false, bool flip=false, bool usez=false) {
+	GILRelease rel;
+	
+	return ths.calc_ccfx(with,y0,y1,nosum,flip,usez);
+}
+BOOST_PYTHON_FUNCTION_OVERLOADS(EMData_calc_ccfx_wrapper_overloads_2_7, EMData_calc_ccfx_wrapper, 2, 7)
+
+EMData *EMData_make_rotational_footprint_wrapper(EMData &ths, bool unwrap=true) {
+	GILRelease rel;
+	
+	return ths.make_rotational_footprint(unwrap);
+}
+BOOST_PYTHON_FUNCTION_OVERLOADS(EMData_make_rotational_footprint_wrapper_overloads_1_2, EMData_make_rotational_footprint_wrapper, 1, 2)
+
+EMData *EMData_unwrap_wrapper(const EMData &ths, int r1=-1, int r2=-1, int xs=-1, int dx=0, int dy=0, bool do360=false, bool weight_radial=true) {
+	GILRelease rel;
+	
+	return ths.unwrap(r1,r2,xs,dx,dy,do360,weight_radial);
+}
+BOOST_PYTHON_FUNCTION_OVERLOADS(EMData_unwrap_wrapper_overloads_1_8, EMData_unwrap_wrapper, 1, 8)
+
+void EMData_transform_wrapper(EMData &ths, const Transform & t) {
+	GILRelease rel;
+	
+	ths.transform(t);
+}
+
+void EMData_mult_image_wrapper(EMData &ths, const EMData & image, bool prevent_complex_multiplication=false) {
+	GILRelease rel;
+	
+	ths.mult(image,prevent_complex_multiplication);
+}
+BOOST_PYTHON_FUNCTION_OVERLOADS(EMData_mult_image_wrapper_overloads_2_3, EMData_mult_image_wrapper, 2, 3)
+
+list EMDataStack_get_images(const EMDataStack &ths) {
+	vector<EMData *> images = ths.get_images();
+	list ret;
+	for (size_t i = 0; i < images.size(); i++) {
+		manage_new_object::apply<EMData *>::type convert;
+		ret.append(object(handle<>(convert(images[i]))));
 	}
-	PyEval_RestoreThread(_save);
 	return ret;
 }
-float EMData_cmp_wrapper3(EMData &ths,const string & cmpname, EMData * with, const Dict & params) {
-	float ret;
-	PyThreadState *_save = PyEval_SaveThread();
 
-	try {
-		ret=ths.cmp(cmpname,with,params);
+EMDataStack *EMDataStack_from_images(const vector<EMData *> &images) {
+	GILRelease rel;
+
+	return EMDataStack::from_images(images);
+}
+
+BOOST_PYTHON_FUNCTION_OVERLOADS(EMAN_EMDataStack_read_images_overloads_1_2, EMAN::EMDataStack::read_images, 1, 2)
+
+// Python gets its own copy of the summary, the one cached on the image goes away at the next update().
+// The GIL is kept, so another Python thread cannot update() the image while the copy is made.
+VolumeSummary EMData_get_volume_summary(const EMData &ths, int brick_size=0) {
+	return *ths.get_volume_summary(brick_size);
+}
+BOOST_PYTHON_FUNCTION_OVERLOADS(EMData_get_volume_summary_overloads_1_2, EMData_get_volume_summary, 1, 2)
+
+boost::python::tuple VolumeSummary_get_brick(const VolumeSummary &ths, int level, int x, int y, int z) {
+	const VolumeSummary::Brick &b = ths.get_brick(level, x, y, z);
+	return boost::python::make_tuple(b.minval, b.maxval, b.mean, b.sigma, b.n);
+}
+
+object VolumeSummary_get_range(const VolumeSummary &ths, int x0, int y0, int z0, int x1, int y1, int z1) {
+	float minval, maxval;
+	if (!ths.get_range(x0, y0, z0, x1, y1, z1, minval, maxval)) return object();
+	return boost::python::make_tuple(minval, maxval);
+}
+
+int (VolumeSummary::*VolumeSummary_get_brick_size)() const = &VolumeSummary::get_brick_size;
+int (VolumeSummary::*VolumeSummary_get_level_brick_size)(int) const = &VolumeSummary::get_brick_size;
+
+BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(EMAN_VolumeSummary_get_bricks_above_overloads_1_2, get_bricks_above, 1, 2)
+
+// Buffer protocol =============================================================
+// EMData exports its float data as a writable C-contiguous (nz,ny,nx) buffer,
+// which is what lets pickle protocol 5 send the pixels out of band. The
+// exporter does not pin the data, so the image must not be resized while a
+// view is alive.
+int EMData_getbuffer(PyObject *obj, Py_buffer *view, int flags)
+{
+	view->obj = 0;
+	EMData *em = static_cast<EMData *>(converter::get_lvalue_from_python(obj, converter::registered<EMData>::converters));
+	if (em == 0) {
+		PyErr_SetString(PyExc_BufferError, "object is not an EMData");
+		return -1;
 	}
-	catch (std::exception &e) {
-		PyEval_RestoreThread(_save);
-		cerr << e.what() << endl;
-		throw e;
+
+	float *data = em->get_data();
+	if (data == 0) {
+		PyErr_SetString(PyExc_BufferError, "EMData has no data");
+		return -1;
 	}
-	PyEval_RestoreThread(_save);
-	return ret;
+
+	int nx = em->get_xsize(), ny = em->get_ysize(), nz = em->get_zsize();
+	Py_ssize_t *dims = new Py_ssize_t[6];
+	dims[0] = nz;
+	dims[1] = ny;
+	dims[2] = nx;
+	dims[3] = (Py_ssize_t)nx * ny * sizeof(float);
+	dims[4] = (Py_ssize_t)nx * sizeof(float);
+	dims[5] = sizeof(float);
+
+	view->buf = data;
+	view->len = (Py_ssize_t)nx * ny * nz * sizeof(float);
+	view->readonly = 0;
+	view->itemsize = sizeof(float);
+	view->format = (flags & PyBUF_FORMAT) ? const_cast<char *>("f") : 0;
+	view->shape = ((flags & PyBUF_ND) == PyBUF_ND) ? dims : 0;
+	view->ndim = view->shape ? 3 : 1;
+	view->strides = ((flags & PyBUF_STRIDES) == PyBUF_STRIDES) ? dims + 3 : 0;
+	view->suboffsets = 0;
+	view->internal = dims;
+	view->obj = obj;
+	Py_INCREF(obj);
+	return 0;
 }
 
+void EMData_releasebuffer(PyObject *, Py_buffer *view)
+{
+	delete [] static_cast<Py_ssize_t *>(view->internal);
+}
+
+void EMData_install_buffer_protocol(PyObject *cls)
+{
+	PyHeapTypeObject *ht = reinterpret_cast<PyHeapTypeObject *>(cls);
+	ht->as_buffer.bf_getbuffer = EMData_getbuffer;
+	ht->as_buffer.bf_releasebuffer = EMData_releasebuffer;
+	ht->ht_type.tp_as_buffer = &ht->as_buffer;
+	PyType_Modified(&ht->ht_type);
+}
 
 // Module ======================================================================
 BOOST_PYTHON_MODULE(libpyEMData2)
@@ -626,14 +649,14 @@ BOOST_PYTHON_MODULE(libpyEMData2)
 	.def("read_image", &EMData_read_image_wrapper5,args("filename", "img_index", "header_only", "region", "is_3d"), "read an image file and stores its information to this EMData object.\n\nIf a region is given, then only read a\nregion of the image file. The region will be this\nEMData object. The given region must be inside the given\nimage file. Otherwise, an error will be created.\n\nfilename The image file name.\nimg_index The nth image you want to read.\nheader_only To read only the header or both header and data.\nregion To read only a region of the image.\nis_3d  Whether to treat the image as a single 3D or a set of 2Ds. This is a hint for certain image formats which has no difference between 3D image and set of 2Ds.\nexception ImageFormatException\nexception ImageReadException")
 	.def("read_image", &EMData_read_image_wrapper6,args("filename", "img_index", "header_only", "region", "is_3d", "imgtype"), "read an image file and stores its information to this EMData object.\n\nIf a region is given, then only read a\nregion of the image file. The region will be this\nEMData object. The given region must be inside the given\nimage file. Otherwise, an error will be created.\n\nfilename The image file name.\nimg_index The nth image you want to read.\nheader_only To read only the header or both header and data.\nregion To read only a region of the image.\nis_3d  Whether to treat the image as a single 3D or a set of 2Ds. This is a hint for certain image formats which has no difference between 3D image and set of 2Ds.\nexception ImageFormatException\nexception ImageReadException")
 	.def("read_binedimage", &EMAN::EMData::read_binedimage, EMAN_EMData_read_binedimage_overloads_1_5(args("filename", "img_index", "binfactor", "fast", "is_3d"), "read an image file and stores its information to this EMData object.\nfilename The image file name.\nimg_index The nth image you want to read.\nbinfactor The amount by which to bin by. Must be an integer\nfast bin very binfactor xy slice otherwise meanshrink z slice\nis_3d  Whether to treat the image as a single 3D or a set of 2Ds. This is a hint for certain image formats which has no difference between 3D image and set of 2Ds.\nexception ImageFormatException\nexception ImageReadException"))
-	.def("write_image", &EMAN::EMData::write_image, EMAN_EMData_write_image_overloads_1_7(args("filename", "img_index", "imgtype", "header_only", "region", "filestoragetype", "use_host_endian"), "write the header and data out to an image.\n\nIf the img_index = -1, append the image to the given image file.\n\nIf the given image file already exists, this image\nformat only stores 1 image, and no region is given, then\ntruncate the image file  to  zero length before writing\ndata out. For header writing only, no truncation happens.\n\nIf a region is given, then write a region only.\n\nfilename - The image file name.\nimg_index - The nth image to write as.\nimgtype - Write to the given image format type. if not specified, use the 'filename' extension to decide.\nheader_only - To write only the header or both header and data.\nregion - Define the region to write to.\nfilestoragetype - The image data type used in the output file.\nuse_host_endian - To write in the host computer byte order.\n\nexception - ImageFormatException\nexception ImageWriteException"))
-	.def("append_image", &EMAN::EMData::append_image, EMAN_EMData_append_image_overloads_1_3(args("filename", "imgtype", "header_only"), "append to an image file; If the file doesn't exist, create one.\nfilename - The image file name.\nimgtype - Write to the given image format type. if not specified, use the 'filename' extension to decide.\nheader_only - To write only the header or both header and data."))
+	.def("write_image", &EMData_write_image_wrapper, EMData_write_image_wrapper_overloads_2_8(args("self", "filename", "img_index", "imgtype", "header_only", "region", "filestoragetype", "use_host_endian"), "write the header and data out to an image.\n\nIf the img_index = -1, append the image to the given image file.\n\nIf the given image file already exists, this image\nformat only stores 1 image, and no region is given, then\ntruncate the image file  to  zero length before writing\ndata out. For header writing only, no truncation happens.\n\nIf a region is given, then write a region only.\n\nfilename - The image file name.\nimg_index - The nth image to write as.\nimgtype - Write to the given image format type. if not specified, use the 'filename' extension to decide.\nheader_only - To write only the header or both header and data.\nregion - Define the region to write to.\nfilestoragetype - The image data type used in the output file.\nuse_host_endian - To write in the host computer byte order.\n\nexception - ImageFormatException\nexception ImageWriteException"))
+	.def("append_image", &EMData_append_image_wrapper, EMData_append_image_wrapper_overloads_2_4(args("self", "filename", "imgtype", "header_only"), "append to an image file; If the file doesn't exist, create one.\nfilename - The image file name.\nimgtype - Write to the given image format type. if not specified, use the 'filename' extension to decide.\nheader_only - To write only the header or both header and data."))
 	.def("write_lst", &EMAN::EMData::write_lst, EMAN_EMData_write_lst_overloads_1_4(args("filename", "reffile", "refn", "comment"), "Append data to a LST image file.\nfilename - The LST image file name.\nreffile - Reference file name.\nrefn The reference file number.\ncomment - The comment to the added reference file."))
 	.def("read_images", &EMData_read_images_wrapper1,args("filename"),"Read a set of images from file specified by 'filename'.\nWhich images are read is set by 'img_indices'.\nfilename The image file name.\nimg_indices Which images are read. If it is empty, all images are read. If it is not empty, only those in this array are read.\nheader_only If true, only read image header. If false, read both data and header.\nreturn The set of images read from filename.")
 	.def("read_images", &EMData_read_images_wrapper2,args("filename", "img_indices"),"Read a set of images from file specified by 'filename'.\nWhich images are read is set by 'img_indices'.\nfilename The image file name.\nimg_indices Which images are read. If it is empty, all images are read. If it is not empty, only those in this array are read.\nheader_only If true, only read image header. If false, read both data and header.\nreturn The set of images read from filename.")
 	.def("read_images", &EMData_read_images_wrapper3,args("filename", "img_indices", "imgtype"),"Read a set of images from file specified by 'filename'.\nWhich images are read is set by 'img_indices'.\nfilename The image file name.\nimg_indices Which images are read. If it is empty, all images are read. If it is not empty, only those in this array are read.\nheader_only If true, only read image header. If false, read both data and header.\nreturn The set of images read from filename.")
 	.def("read_images", &EMData_read_images_wrapper4,args("filename", "img_indices", "imgtype", "header_only"),"Read a set of images from file specified by 'filename'.\nWhich images are read is set by 'img_indices'.\nfilename The image file name.\nimg_indices Which images are read. If it is empty, all images are read. If it is not empty, only those in this array are read.\nheader_only If true, only read image header. If false, read both data and header.\nreturn The set of images read from filename.")
-	.def("write_images", &EMAN::EMData::write_images, EMAN_EMData_write_images_overloads_2_8(args("filename", "imgs", "idxs", "imgtype", "header_only", "region", "filestoragetype", "use_host_endian"),"Write a set of images to file specified by 'filename'.\nWhich images are written is set by 'imgs'.\nfilename The image file name.\n\nIf a region is given, then write a region only.\n\nfilename - The image file name.\nimgs - Images to write.\nimgtype - Write to the given image format type. if not specified, use the 'filename' extension to decide.\nheader_only - To write only the header or both header and data.\nregion - Define the region to write to.\\nfilestoragetype - The image data type used in the output file.\nuse_host_endian - To write in the host computer byte order.\n\nreturn True if images written successfully to filename."))
+	.def("write_images", &EMData_write_images_wrapper, EMData_write_images_wrapper_overloads_2_8(args("filename", "imgs", "idxs", "imgtype", "header_only", "region", "filestoragetype", "use_host_endian"),"Write a set of images to file specified by 'filename'.\nWhich images are written is set by 'imgs'.\nfilename The image file name.\n\nIf a region is given, then write a region only.\n\nfilename - The image file name.\nimgs - Images to write.\nimgtype - Write to the given image format type. if not specified, use the 'filename' extension to decide.\nheader_only - To write only the header or both header and data.\nregion - Define the region to write to.\\nfilestoragetype - The image data type used in the output file.\nuse_host_endian - To write in the host computer byte order.\n\nreturn True if images written successfully to filename."))
 	.def("get_fft_amplitude", &EMAN::EMData::get_fft_amplitude, return_value_policy< manage_new_object >(), "return the amplitudes of the FFT including the left half\n \nreturn The current FFT image's amplitude image.\nexception - ImageFormatException If the image is not a complex image.")
 	.def("get_fft_amplitude2D", &EMAN::EMData::get_fft_amplitude2D, return_value_policy< manage_new_object >(), "return the amplitudes of the 2D FFT including the left half, PRB\n \nreturn The current FFT image's amplitude image.\nexception - ImageFormatException If the image is not a complex image.")
 	.def("get_fft_phase", &EMAN::EMData::get_fft_phase, return_value_policy< manage_new_object >(), "return the phases of the FFT including the left half\n \nreturn The current FFT image's phase image.\nexception - ImageFormatException If the image is not a complex image.")
@@ -694,6 +717,14 @@ BOOST_PYTHON_MODULE(libpyEMData2)
 	.def("get_data_as_vector", &EMAN::EMData::get_data_as_vector, "Get the pixel data as a vector\n \nreturn a vector containing the pixel data.")
 	.def("get_data_string",&EMAN::EMData::get_data_pickle,"Returns a string representation of the floating point data in the image")
 	.def("set_data_string",&EMAN::EMData::set_data_pickle, args("data_string"), "Sets the floating point data array from a string of binary data. Must be exactly the correct length.")
+	.def("_pickle_header", &EMData_pickle_suite::getstate_header, "Returns the pickle state with the pixel data left out, for reducers that send the data separately.")
+	.def("to_shared", &EMAN::EMData::to_shared, EMAN_EMData_to_shared_overloads_0_1(args("name"), "Move the pixel data into a named POSIX shared memory segment so other processes on this host can map it with attach_shared(). The segment is removed when this image's data is freed, and resizing the image moves the data back to ordinary memory.\n \nname - segment name, generated if empty(default='')\n \nreturn the segment name."))
+	.def("copy_to_shared", &EMAN::EMData::copy_to_shared, EMAN_EMData_copy_to_shared_overloads_0_1(args("name"), "Copy the pixel data into a new shared memory segment, leaving this image unchanged. The segment belongs to the returned image, which has no header, and is removed when that image is freed.\n \nname - segment name, generated if empty(default='')\n \nreturn a new image holding the segment.")[ return_value_policy< manage_new_object >() ])
+	.def("attach_shared", &EMAN::EMData::attach_shared, EMAN_EMData_attach_shared_overloads_1_2(args("name", "writable"), "Replace the pixel data with a mapping of a shared memory segment made by to_shared() in another process. The image takes the segment's dimensions, the header is unchanged. The mapping is copy-on-write unless writable is set, so by default changes stay in this process.\n \nname - segment name returned by to_shared().\nwritable - map the segment shared, so writes are seen by every process mapping it(default=False)."))
+	.def("get_shared_name", &EMAN::EMData::get_shared_name, "Get the name of the shared memory segment holding the pixel data.\n \nreturn the segment name, or an empty string if the data is not shared or is a copy-on-write mapping.")
+	.def("get_volume_summary", &EMData_get_volume_summary, EMData_get_volume_summary_overloads_1_2(args("self", "brick_size"), "Get a VolumeSummary of this image, a pyramid of per-brick min/max/mean/sigma. It is computed in parallel on first use and cached on the image until it changes.\n \nbrick_size - level 0 brick edge length in voxels, 0 for the default(default=0)\n \nreturn a copy of the cached VolumeSummary"))
+	.def("set_half_storage", &EMAN::EMData::set_half_storage, args("mode"), "Keep the pixel data of a real image in 16-bit form, halving its memory footprint. Any access needing float data converts back and ends half storage.\n \nmode - EMData.HalfStorage value, HALF_NONE converts back to float.")
+	.def("get_half_storage", &EMAN::EMData::get_half_storage, "Get the 16-bit storage mode the pixel data are kept in.\n \nreturn EMData.HalfStorage value.")
 	.def("get_ndim", &EMAN::EMData::get_ndim, "Get image dimension.\n \nreturn image dimension.")
 	.def("is_shuffled", &EMAN::EMData::is_shuffled, "Has this image been shuffled?\n \nreturn Whether this image has been shuffled to put origin in the center.")
 	.def("is_FH", &EMAN::EMData::is_FH, "Is this a FH image?\n \nreturn Whether this is a FH image or not.")
@@ -721,8 +752,8 @@ BOOST_PYTHON_MODULE(libpyEMData2)
 	.def("process_inplace", &EMData_process_inplace_wrapper2,args("processorname", "params"),return_value_policy< manage_new_object >(), "Apply a processor with its parameters on this image.\n \nprocessorname - Processor Name.\nparams - Processor parameters in a keyed dictionary. default to None.\n \nNotExistingObjectError If the processor doesn't exist.")
 	.def("process", &EMData_process_wrapper1,args("processorname"),return_value_policy< manage_new_object >(), "Apply a processor with its parameters on a copy of this image, return result\nas a a new image. The returned image may or may not be the same size as this image.\n \nprocessorname - Processor Name.\nparams - Processor parameters in a keyed dictionary.\n \nreturn the processed result, a new image\n \nexception - NotExistingObjectError If the processor doesn't exist.")
 	.def("process", &EMData_process_wrapper2,args("processorname", "params"),return_value_policy< manage_new_object >(), "Apply a processor with its parameters on a copy of this image, return result\nas a a new image. The returned image may or may not be the same size as this image.\n \nprocessorname - Processor Name.\nparams - Processor parameters in a keyed dictionary.\n \nreturn the processed result, a new image\n \nexception - NotExistingObjectError If the processor doesn't exist.")
-	.def("process", (EMAN::EMData* (EMAN::EMData::*)(EMAN::Processor*) const )&EMAN::EMData::process, args("p"), "Call the process with an instance od Processor, usually this instance can\nbe get by (in Python) Processors.get('name', {'k':v, 'k':v})\n \np - the processor object", return_value_policy< manage_new_object >())
-	.def("process_inplace", (void (EMAN::EMData::*)(EMAN::Processor*) )&EMAN::EMData::process_inplace, args("p"), "Call the process_inplace with an instance od Processor, usually this instancecan\nbe get by (in Python) Processors.get('name', {'k':v, 'k':v}).\n \np - the processor object")
+	.def("process", &EMData_process_processor_wrapper, args("p"), "Call the process with an instance od Processor, usually this instance can\nbe get by (in Python) Processors.get('name', {'k':v, 'k':v})\n \np - the processor object", return_value_policy< manage_new_object >())
+	.def("process_inplace", &EMData_process_inplace_processor_wrapper, args("p"), "Call the process_inplace with an instance od Processor, usually this instancecan\nbe get by (in Python) Processors.get('name', {'k':v, 'k':v}).\n \np - the processor object")
 	.def("cmp", &EMData_cmp_wrapper2, args("cmpname", "with"), "Compare this image with another image.\n \ncmpname - Comparison algorithm name.\nwith - The image you want to compare to.\nparams - Comparison parameters in a keyed dictionary, default to Null.\n \nreturn comparison score. The bigger, the better.\nexception - NotExistingObjectError If the comparison algorithm doesn't exist.")
 	.def("cmp", &EMData_cmp_wrapper3, args("cmpname", "with", "params"), "Compare this image with another image.\n \ncmpname - Comparison algorithm name.\nwith - The image you want to compare to.\nparams - Comparison parameters in a keyed dictionary, default to Null.\n \nreturn comparison score. The bigger, the better.\nexception - NotExistingObjectError If the comparison algorithm doesn't exist.")
 	.def("xform_align_nbest", &EMData_align_nbest_wrapper4, args("aligner_name", "to_img", "params", "nsoln"), "Align this image with another image, return the parameters of the N best solutions. Identical to align() method, but also takes number of solutions as a parameter, and returns a list of dictionaries containing the ordered solutions.")
@@ -736,11 +767,11 @@ BOOST_PYTHON_MODULE(libpyEMData2)
 	.def("project", &EMData_project_wrapperD, args("projector_name", "params"), "Calculate the projection of this image and return the result.\n \nprojector_name - Projection algorithm name.\nparams - projection options.\n \nreturn The result image.\nexception - NotExistingObjectError If the projection algorithm doesn't exist.", return_value_policy< manage_new_object >() )
 	.def("project", &EMData_project_wrapper, args("projector_name", "t3d"), "Calculate the projection of this image and return the result.\n \nprojector_name - Projection algorithm name.\nt3d - Transform object used to do projection.\n \nreturn The result image.\nexception - NotExistingObjectError If the projection algorithm doesn't exist.", return_value_policy< manage_new_object >() )
 //	.def("project", (EMAN::EMData* (EMAN::EMData::*)(const std::string&, const EMAN::Transform&) )&EMAN::EMData::project, args("projector_name", "t3d"), "Calculate the projection of this image and return the result.\n \nprojector_name - Projection algorithm name.\nt3d - Transform object used to do projection.\n \nreturn The result image.\nexception - NotExistingObjectError If the projection algorithm doesn't exist.", return_value_policy< manage_new_object >() )
-	.def("backproject", &EMAN::EMData::backproject, EMAN_EMData_backproject_overloads_1_2(args("peojector_name", "params"), "Calculate the backprojection of this image (stack) and return the result.\n \nprojector_name - Projection algorithm name. Only \"pawel\" and \"chao\" have been implemented now.\nparams - Projection Algorithm parameters, default to Null.\n \nreturn The result image.\nexception - NotExistingObjectError If the projection algorithm doesn't exist.")[ return_value_policy< manage_new_object >() ])
+	.def("backproject", &EMData_backproject_wrapper, EMData_backproject_wrapper_overloads_2_3(args("self", "peojector_name", "params"), "Calculate the backprojection of this image (stack) and return the result.\n \nprojector_name - Projection algorithm name. Only \"pawel\" and \"chao\" have been implemented now.\nparams - Projection Algorithm parameters, default to Null.\n \nreturn The result image.\nexception - NotExistingObjectError If the projection algorithm doesn't exist.")[ return_value_policy< manage_new_object >() ])
 	.def("do_fft", &EMData_do_fft_wrapper, return_value_policy< manage_new_object >(), "return the fast fourier transform (FFT) image of the current\nimage. the current image is not changed. The result is in\nreal/imaginary format.\n \nreturn The FFT of the current image in real/imaginary format.")
-	.def("do_fft_inplace", &EMAN::EMData::do_fft_inplace, return_value_policy< reference_existing_object >(), "Do FFT inplace. And return the FFT image.\n \nreturn The FFT of the current image in real/imaginary format.")
-	.def("do_ift", &EMAN::EMData::do_ift, return_value_policy< manage_new_object >(), "return the inverse fourier transform (IFT) image of the current\nimage. the current image may be changed if it is in amplitude/phase\nformat as opposed to real/imaginary format - if this change is\nperformed it is not undone.\n \nreturn The current image's inverse fourier transform image.\nexception - ImageFormatException If the image is not a complex image.")
-	.def("do_ift_inplace", &EMAN::EMData::do_ift_inplace, return_value_policy< reference_existing_object >(), "Do IFT inplace. And return the IFT image.\n \nreturn The IFT image.")
+	.def("do_fft_inplace", &EMData_do_fft_inplace_wrapper, return_value_policy< reference_existing_object >(), "Do FFT inplace. And return the FFT image.\n \nreturn The FFT of the current image in real/imaginary format.")
+	.def("do_ift", &EMData_do_ift_wrapper, return_value_policy< manage_new_object >(), "return the inverse fourier transform (IFT) image of the current\nimage. the current image may be changed if it is in amplitude/phase\nformat as opposed to real/imaginary format - if this change is\nperformed it is not undone.\n \nreturn The current image's inverse fourier transform image.\nexception - ImageFormatException If the image is not a complex image.")
+	.def("do_ift_inplace", &EMData_do_ift_inplace_wrapper, return_value_policy< reference_existing_object >(), "Do IFT inplace. And return the IFT image.\n \nreturn The IFT image.")
 	.def("bispecRotTransInvN", &EMAN::EMData::bispecRotTransInvN, return_value_policy< reference_existing_object >(), args("N", "NK"), "This computes the rotational and translational bispectral\ninvariants of an image. The invariants are labelled by the Fourier\nHarmonic label given by N.\nNK is the number of Fourier components one wishes to use in calculating this bispectrum.\nthe output is a single 2D image whose x,y labels are lengths, corresponding to the two lengths of sides of a triangle.")
 	.def("bispecRotTransInvDirect", &EMAN::EMData::bispecRotTransInvDirect, return_value_policy< reference_existing_object >(), args("type"), "This computes the rotational and translational bispectral\ninvariants of an image.\nthe output is a single 3d Volume whose x,y labels are lengths,\ncorresponding to the two lengths of sides of a triangle.\nthe z label is for the angle.")
 #ifdef EMAN2_USING_CUDA
@@ -775,7 +806,7 @@ BOOST_PYTHON_MODULE(libpyEMData2)
 	.def("sub", (void (EMAN::EMData::*)(float) )&EMAN::EMData::sub, args("f"), "subtract a float number to each pixel value of the image.\n \nf - The float number subtracted from 'this' image.")
 	.def("sub", (void (EMAN::EMData::*)(const EMAN::EMData&) )&EMAN::EMData::sub, args("image"), "subtract a same-size image from this image pixel by pixel.\n \nimage - The image subtracted  from 'this' image.\n \nexception - ImageFormatException If the 2 images are not same size.")
 	.def("subsquare", (void (EMAN::EMData::*)(const EMAN::EMData&) )&EMAN::EMData::subsquare, args("image"), "subtract the squared value of each pixel from a same-size image to this image.\n \nimage - The image whose square is subtracted from 'this' image.\n \nexception - ImageFormatException If the 2 images are not same size.")
-	.def("mult", (void (EMAN::EMData::*)(const EMAN::EMData&, bool) )&EMAN::EMData::mult, EMAN_EMData_mult_overloads_1_2(args("image", "prevent_complex_multiplication"), "multiply each pixel of this image with each pixel of some other same-size image.\n \nimage - The image multiplied to 'this' image.\nprevent_complex_multiplication - If the image is complex, this flag will override complex multiplication and just multiply each pixel by the other.(default=False)\n \nexception - ImageFormatException If the 2 images are not same size."))
+	.def("mult", &EMData_mult_image_wrapper, EMData_mult_image_wrapper_overloads_2_3(args("self", "image", "prevent_complex_multiplication"), "multiply each pixel of this image with each pixel of some other same-size image.\n \nimage - The image multiplied to 'this' image.\nprevent_complex_multiplication - If the image is complex, this flag will override complex multiplication and just multiply each pixel by the other.(default=False)\n \nexception - ImageFormatException If the 2 images are not same size."))
 	.def("mult", (void (EMAN::EMData::*)(int) )&EMAN::EMData::mult, args("n"), "multiply an integer number to each pixel value of the image.\n \nn - The integer multiplied to 'this' image.")
 	.def("mult", (void (EMAN::EMData::*)(float) )&EMAN::EMData::mult, args("f"), "multiply a float number to each pixel value of the image.\n \nf - The float multiplied to 'this' image.")
 	.def("div", (void (EMAN::EMData::*)(float) )&EMAN::EMData::div, args("f"), "make each pixel value divided by a float number.\n \nf - The float number 'this' image divided by.")
@@ -931,7 +962,7 @@ BOOST_PYTHON_MODULE(libpyEMData2)
 //	.def("rotate", (void (EMAN::EMData::*)(const EMAN::Transform3D&) )&EMAN::EMData::rotate, args("t"), "Rotate this image.\nDEPRECATED USE EMData::Transform\n \nt - Transformation rotation.")
 	.def("rotate", (void (EMAN::EMData::*)(float, float, float) )&EMAN::EMData::rotate, args("az", "alt", "phi"), "Rotate this image.\nDEPRECATED USE EMData::Transform\n \naz - Rotation euler angle az  in EMAN convention.\nalt - Rotation euler angle alt in EMAN convention.\nphi - Rotation euler angle phi in EMAN convention.")
 //	.def("rotate_translate", (void (EMAN::EMData::*)(const EMAN::Transform3D&) )&EMAN::EMData::rotate_translate, args("t"), "Rotate then translate the image.\nDEPRECATED USE EMData::Transform\n \nt - The rotation and translation transformation to be done.")
-	.def("transform", &EMAN::EMData::transform, args("t"), "Transform the image\n \nt - the transform object that describes the transformation to be applied to the image.")
+	.def("transform", &EMData_transform_wrapper, args("t"), "Transform the image\n \nt - the transform object that describes the transformation to be applied to the image.")
 	.def("rotate_translate", (void (EMAN::EMData::*)(const EMAN::Transform&) )&EMAN::EMData::rotate_translate, args("t"), "Apply a transformation to the image.\nDEPRECATED USE EMData::Transform\n \nt - transform object that describes the transformation to be applied to the image.")
 	.def("rotate_translate", (void (EMAN::EMData::*)(float, float, float, float, float, float) )&EMAN::EMData::rotate_translate, args("az", "alt", "phi", "dx", "dy", "dz"), "Rotate then translate the image.\nDEPRECATED USE EMData::Transform\n \naz - Rotation euler angle az  in EMAN convention.\nalt - Rotation euler angle alt in EMAN convention.\nphi - Rotation euler angle phi in EMAN convention.\ndx - Translation distance in x direction.\ndy - Translation distance in y direction.\ndz - Translation distance in z direction.")
 	.def("rotate_translate", (void (EMAN::EMData::*)(float, float, float, float, float, float, float, float, float) )&EMAN::EMData::rotate_translate, args("az", "alt", "phi", "dx", "dy", "dz", "pdx", "pdy", "pdz"), "Rotate then translate the image.\nDEPRECATED USE EMData::Transform\n \naz - Rotation euler angle az  in EMAN convention.\nalt - Rotation euler angle alt in EMAN convention.\nphi - Rotation euler angle phi in EMAN convention.\ndx - Translation distance in x direction.\ndy - Translation distance in y direction.\ndz - Translation distance in z direction.\npdx - Pretranslation distance in x direction.\npdy - Pretranslation distance in y direction.\npdz - Pretranslation distance in z direction.")
@@ -946,14 +977,14 @@ BOOST_PYTHON_MODULE(libpyEMData2)
 	.def("calc_ccf", &EMData_calc_ccf_wrapper3, args("with", "fpflag", "center"), return_value_policy< manage_new_object >())
 	.def("calc_ccf_masked", &EMData_calc_ccf_masked_wrapper1, args("with"), return_value_policy< manage_new_object >())
 	.def("calc_ccf_masked", &EMData_calc_ccf_masked_wrapper3, args("with", "withsquared", "mask"), return_value_policy< manage_new_object >())
-	.def("calc_ccfx", &EMAN::EMData::calc_ccfx, EMAN_EMData_calc_ccfx_overloads_1_6(args("with", "y0", "y1", "nosum","flip","usez"), "Calculate Cross-Correlation Function (CCF) in the x-direction and adds them up,\nresult in 1D.\nWARNING: this routine will modify the 'this' and 'with' to contain\n1D fft's without setting some flags. This is an optimization\nfor rotational alignment.\nsee calc_ccf()\n \nwith - The image used to calculate CCF.\ny0 - Starting position in x-direction(default=0).\ny1 - Ending position in x-direction. '-1' means the end of the row.(default=-1)\nnosum - If true, returns an image y1-y0+1 pixels high.(default=False)\n \nreturn The result image containing the CCF.\nexception - NullPointerException If input image 'with' is NULL.\nexception - ImageFormatException If 'with' and 'this' are not same size.\nexception - ImageDimensionException If 'this' image is 3D.")[ return_value_policy< manage_new_object >() ])
+	.def("calc_ccfx", &EMData_calc_ccfx_wrapper, EMData_calc_ccfx_wrapper_overloads_2_7(args("self", "with", "y0", "y1", "nosum","flip","usez"), "Calculate Cross-Correlation Function (CCF) in the x-direction and adds them up,\nresult in 1D.\nWARNING: this routine will modify the 'this' and 'with' to contain\n1D fft's without setting some flags. This is an optimization\nfor rotational alignment.\nsee calc_ccf()\n \nwith - The image used to calculate CCF.\ny0 - Starting position in x-direction(default=0).\ny1 - Ending position in x-direction. '-1' means the end of the row.(default=-1)\nnosum - If true, returns an image y1-y0+1 pixels high.(default=False)\n \nreturn The result image containing the CCF.\nexception - NullPointerException If input image 'with' is NULL.\nexception - ImageFormatException If 'with' and 'this' are not same size.\nexception - ImageDimensionException If 'this' image is 3D.")[ return_value_policy< manage_new_object >() ])
 	.def("calc_fast_sigma_image",&EMAN::EMData::calc_fast_sigma_image, return_value_policy< manage_new_object >(), args("mask"), "Calculates the local standard deviation (sigma) image using the given\nmask image. The mask image is typically much smaller than this image,\nand consists of ones, or is a small circle consisting of ones. The extent\nof the non zero neighborhood explicitly defines the range over which\nthe local standard deviation is determined.\nFourier convolution is used to do the math, ala Roseman (2003, Ultramicroscopy)\nHowever, Roseman was just working on methods Van Heel had presented earlier.\nThe normalize flag causes the mask image to be processed so that it has a unit sum.\nWorks in 1,2 and 3D\n \nmask - the image that will be used to define the neighborhood for determine the local standard deviation\n \nreturn the sigma image, the phase origin is at the corner (not the center)\nexception - ImageDimensionException if the dimensions of with do not match those of this\nexception - ImageDimensionException if any of the dimensions sizes of with exceed of this image's.")
-	.def("make_rotational_footprint", &EMAN::EMData::make_rotational_footprint, EMAN_EMData_make_rotational_footprint_overloads_0_1(args("unwrap"), "Makes a 'rotational footprint', which is an 'unwound'\nautocorrelation function. generally the image should be\nedge-normalized and masked before using this.\n \nunwrap - RFP undergoes polar->cartesian x-form,(default=True)\n \nreturn The rotaional footprint image.\nexception - ImageFormatException If image size is not even.")[ return_value_policy< manage_new_object >() ])
+	.def("make_rotational_footprint", &EMData_make_rotational_footprint_wrapper, EMData_make_rotational_footprint_wrapper_overloads_1_2(args("self", "unwrap"), "Makes a 'rotational footprint', which is an 'unwound'\nautocorrelation function. generally the image should be\nedge-normalized and masked before using this.\n \nunwrap - RFP undergoes polar->cartesian x-form,(default=True)\n \nreturn The rotaional footprint image.\nexception - ImageFormatException If image size is not even.")[ return_value_policy< manage_new_object >() ])
 	.def("make_rotational_footprint_e1", &EMAN::EMData::make_rotational_footprint_e1, EMAN_EMData_make_rotational_footprint_e1_overloads_0_1(args("unwrap"), "unwrap - RFP undergoes polar->cartesian x-form,(default=True)")[ return_value_policy< manage_new_object >() ])
 	.def("make_rotational_footprint_cmc", &EMAN::EMData::make_rotational_footprint_cmc, EMAN_EMData_make_rotational_footprint_cmc_overloads_0_1(args("unwrap"), "unwrap - RFP undergoes polar->cartesian x-form,(default=True)")[ return_value_policy< manage_new_object >() ])
 	.def("make_footprint", &EMAN::EMData::make_footprint, EMAN_EMData_make_footprint_overloads_0_1(args("type"), "Makes a 'footprint' for the current image. This is image containing\na rotational & translational invariant of the parent image. The size of the\nresulting image depends on the selected type.\ntype 0- The original, default footprint derived from the rotational footprint\ntypes 1-6 - bispectrum-based\ntypes 1,3,5 - returns Fouier-like images\ntypes 2,4,6 - returns real-space-like images\ntype 1,2 - simple r1,r2, 2-D footprints\ntype 3,4 - r1,r2,anle 3D footprints\ntype 5,6 - same as 1,2 but with the cube root of the final products used\n \ntype - Select one of several possible algorithms for producing the invariants\n \nreturn The footprint image.\nexception - ImageFormatException If image size is not even.")[return_value_policy< manage_new_object >()])
 	.def("calc_mutual_correlation", &EMAN::EMData::calc_mutual_correlation, EMAN_EMData_calc_mutual_correlation_overloads_1_3(args("with", "tocorner", "filter"), "Calculates mutual correlation function (MCF) between 2 images.\nIf 'with' is NULL, this does mirror ACF.\n \nwith - The image used to calculate MCF.\ntocorner - Set whether to translate the result image to the corner.(default=False)\nfilter - The filter image used in calculating MCF.(default=Null)\n \nreturn Mutual correlation function image.\nexception - ImageFormatException If 'with' is not NULL and it doesn't have the same size to 'this' image.\nexception NullPointerException If FFT returns NULL image.")[ return_value_policy< manage_new_object >() ])
-	.def("unwrap", &EMAN::EMData::unwrap, EMAN_EMData_unwrap_overloads_0_7(args("r1", "r2", "xs", "dx", "dy", "do360", "weight_radial"), "Maps to polar coordinates from Cartesian coordinates. Optionaly radially weighted.\nWhen used with RFP, this provides 1 pixel accuracy at 75% radius.\n2D only.\n \nr1 - (default=-1)\nr2 - (default=-1)\nxs - (deffault=-1)\ndx - (default=0)\ndy - (default=0)\ndo360 - (default=False)\nweight_redial - (default=True)\n \nreturn The image in Cartesian coordinates.\nxception - ImageDimensionException If 'this' image is not 2D.\nexception - UnexpectedBehaviorException if the dimension of this image and the function arguments are incompatibale - i.e. the return image is less than 0 in some dimension.")[ return_value_policy< manage_new_object >() ])
+	.def("unwrap", &EMData_unwrap_wrapper, EMData_unwrap_wrapper_overloads_1_8(args("self", "r1", "r2", "xs", "dx", "dy", "do360", "weight_radial"), "Maps to polar coordinates from Cartesian coordinates. Optionaly radially weighted.\nWhen used with RFP, this provides 1 pixel accuracy at 75% radius.\n2D only.\n \nr1 - (default=-1)\nr2 - (default=-1)\nxs - (deffault=-1)\ndx - (default=0)\ndy - (default=0)\ndo360 - (default=False)\nweight_redial - (default=True)\n \nreturn The image in Cartesian coordinates.\nxception - ImageDimensionException If 'this' image is not 2D.\nexception - UnexpectedBehaviorException if the dimension of this image and the function arguments are incompatibale - i.e. the return image is less than 0 in some dimension.")[ return_value_policy< manage_new_object >() ])
 	.def("apply_radial_func", &EMAN::EMData::apply_radial_func, EMAN_EMData_apply_radial_func_overloads_3_4(args("x0", "dx", "array", "interp"), "multiplies by a radial function in fourier space.\n \nx0 - starting point x coordinate.\ndx - step of x.\narray - radial function data array.\ninterp Do the interpolation or not.(default=True)"))
 	.def("calc_radial_dist", (std::vector<float,std::allocator<float> > (EMAN::EMData::*)(int, float, float, int) )&EMAN::EMData::calc_radial_dist, args("n", "x0", "dx", "inten"), "calculates radial distribution. works for real and imaginary images.\ninten=0->mean amp, 1->mean inten (amp^2), 2->min, 3->max, 4->sigma. Note that the complex\norigin is at (0,0), with periodic boundaries. Note that the inten option is NOT\nequivalent to returning amplitude and squaring the result.\n \nn - number of points.\nx0 - starting point x coordinate.\ndx - step of x.\ninten returns intensity (amp^2) rather than amplitude if set\n \nreturn The radial distribution in an array.")
 	.def("calc_radial_dist", (std::vector<float,std::allocator<float> > (EMAN::EMData::*)(int, float, float, int, float, bool) )&EMAN::EMData::calc_radial_dist, args("n", "x0", "dx", "nwedge", "offset", "inten"), "calculates radial distribution subdivided by angle. works for real and imaginary images.\n2-D only. The first returns a single vector of n*nwedge points, with radius varying first.\nThat is, the first n points represent the radial profile in the first wedge.\n \nn - number of points.\nx0 - starting x coordinate.\ndx - step of x.\nnwedge - int number of wedges to divide the circle into\noffset - angular offset in radians for start of first bin\ninten - returns intensity (amp^2) rather than amplitude if set\n \nreturn nwedge radial distributions packed into a single vector<float>\nexception - ImageDimensionException If 'this' image is not 2D.")
@@ -1011,6 +1042,54 @@ BOOST_PYTHON_MODULE(libpyEMData2)
 #endif	//_WIN32
 	);
 
+	enum_< EMAN::EMData::HalfStorage >("HalfStorage")
+		.value("HALF_NONE", EMAN::EMData::HALF_NONE)
+		.value("HALF_FLOAT16", EMAN::EMData::HALF_FLOAT16)
+		.value("HALF_BFLOAT16", EMAN::EMData::HALF_BFLOAT16)
+		;
+
+	EMData_install_buffer_protocol(EMAN_EMData_scope->ptr());
+
 	delete EMAN_EMData_scope;
 
+	class_< EMAN::EMDataStack, boost::noncopyable >("EMDataStack",
+			"EMDataStack holds N same-size images in one contiguous buffer, each with its own header.\n"
+			"get_image() returns an EMData using the stack's memory without copying; the buffer stays\n"
+			"allocated while any such image exists. Resizing such an image moves it off the stack.",
+			init< int, int, int, optional< int > >(args("n", "nx", "ny", "nz"), "Make a zero-filled stack of n images.\n \nn - number of images\nnx - x size\nny - y size\nnz - z size(default=1)"))
+	.def("read_images", &EMAN::EMDataStack::read_images, EMAN_EMDataStack_read_images_overloads_1_2(args("filename", "img_indices"), "Read images from a stack file straight into a new EMDataStack. All images must be the same size.\n \nfilename - image stack file\nimg_indices - list of images to read, all if empty(default=[])")[return_value_policy< manage_new_object >()])
+	.staticmethod("read_images")
+	.def("from_images", &EMDataStack_from_images, args("images"), return_value_policy< manage_new_object >(), "Make a stack holding copies of a list of same-size images.")
+	.staticmethod("from_images")
+	.def("get_n", &EMAN::EMDataStack::get_n, "Get the number of images in the stack.")
+	.def("__len__", &EMAN::EMDataStack::get_n)
+	.def("get_xsize", &EMAN::EMDataStack::get_xsize, "Get the image x size.")
+	.def("get_ysize", &EMAN::EMDataStack::get_ysize, "Get the image y size.")
+	.def("get_zsize", &EMAN::EMDataStack::get_zsize, "Get the image z size.")
+	.def("get_header", &EMAN::EMDataStack::get_header, args("i"), return_value_policy< copy_const_reference >(), "Get the header of image i.")
+	.def("set_header", &EMAN::EMDataStack::set_header, args("i", "header"), "Replace the header of image i. nx, ny and nz are ignored.")
+	.def("get_image", &EMAN::EMDataStack::get_image, args("i"), return_value_policy< manage_new_object >(), "Get an EMData sharing the memory of image i.")
+	.def("__getitem__", &EMAN::EMDataStack::get_image, return_value_policy< manage_new_object >())
+	.def("get_images", &EMDataStack_get_images, "Get EMData images sharing the memory of every image in the stack.")
+	.def("set_image", &EMAN::EMDataStack::set_image, args("i", "image"), "Copy an image's data and header into slot i.")
+	;
+
+	class_< EMAN::VolumeSummary >("VolumeSummary",
+			"VolumeSummary is a pyramid of value statistics over bricks of an image. Level 0 splits the image\n"
+			"into cubes of get_brick_size() voxels on a side, and each level up combines 2x2x2 bricks of the one\n"
+			"below, until the top level is a single brick. Use it to skip regions that cannot reach a threshold.\n"
+			"EMData.get_volume_summary() returns the summary cached on an image.",
+			init< const EMAN::EMData *, optional< int > >(args("image", "brick_size"), "Summarize a real image.\n \nimage - the image to summarize\nbrick_size - level 0 brick edge length in voxels, 0 for the default(default=0)"))
+	.def("get_brick_size", VolumeSummary_get_brick_size, "Get the edge length of the level 0 bricks in voxels.")
+	.def("get_level_brick_size", VolumeSummary_get_level_brick_size, args("level"), "Get the edge length of the bricks of a level in voxels.")
+	.def("get_num_levels", &EMAN::VolumeSummary::get_num_levels, "Get the number of levels in the pyramid.")
+	.def("get_image_size", &EMAN::VolumeSummary::get_image_size, "Get the size of the image that was summarized.")
+	.def("get_level_size", &EMAN::VolumeSummary::get_level_size, args("level"), "Get the number of bricks along x, y and z at a level.")
+	.def("get_brick", &VolumeSummary_get_brick, args("level", "x", "y", "z"), "Get the statistics of one brick.\n \nreturn (min, max, mean, sigma, number of voxels)")
+	.def("get_brick_region", &EMAN::VolumeSummary::get_brick_region, args("level", "x", "y", "z"), "Get the Region of voxels covered by a brick.")
+	.def("get_range", &VolumeSummary_get_range, args("x0", "y0", "z0", "x1", "y1", "z1"), "Get bounds on the values in an inclusive box of voxels, from the bricks it overlaps. They contain the true range and are exact for boxes made of whole level 0 bricks.\n \nreturn (min, max), or None if the box misses the image")
+	.def("get_bricks_above", &EMAN::VolumeSummary::get_bricks_above, EMAN_VolumeSummary_get_bricks_above_overloads_1_2(args("threshold", "level"), "Get the indices x+y*bx+z*bx*by of the bricks of a level holding at least one voxel above threshold.\n \nthreshold - the threshold\nlevel - pyramid level(default=0)"))
+	.def("get_bounding_region", &EMAN::VolumeSummary::get_bounding_region, args("threshold"), "Get the smallest box of level 0 bricks containing every voxel above threshold, a Region of size 0 if there are none.")
+	;
+
 }
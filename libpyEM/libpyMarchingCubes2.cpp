@@ -119,6 +119,7 @@ BOOST_PYTHON_MODULE(libpyMarchingCubes2)
 	//class_< EMAN::MarchingCubes, bases<EMAN::Isosurface> >("MarchingCubes", init<  >())
 	class_< EMAN::MarchingCubes, bases<EMAN::Isosurface> >("MarchingCubes", init< EMAN::EMData *>())
 		//.def(init< EMAN::EMData *, optional< bool > >())
+		.def("get_surface_counts", &EMAN::MarchingCubes::get_surface_counts, "March the surface for the current value and sampling.\n \nreturn [number of vertices, number of triangles]")
 		;
 }
 
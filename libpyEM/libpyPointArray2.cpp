@@ -33,6 +33,7 @@
 
 // Includes ====================================================================
 #include <pointarray.h>
+#include <gilrelease.h>
 
 // Using =======================================================================
 using namespace boost::python;
@@ -56,6 +57,64 @@ BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(EMAN_PointArray_sort_by_axis_overloads_0_
 
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(EMAN_PointArray_projection_by_nfft_overloads_2_3, projection_by_nfft, 2, 3)
 
+EMAN::EMData *PointArray_pdb2mrc_by_summation(EMAN::PointArray &ths, int map_size, float apix, float res, int addpdbbfactor) {
+	EMAN::GILRelease rel;
+
+	return ths.pdb2mrc_by_summation(map_size, apix, res, addpdbbfactor);
+}
+
+EMAN::EMData *PointArray_projection_by_summation(EMAN::PointArray &ths, int image_size, float apix, float res) {
+	EMAN::GILRelease rel;
+
+	return ths.projection_by_summation(image_size, apix, res);
+}
+
+list PointArray_projections_by_summation(EMAN::PointArray &ths, const vector<EMAN::Transform> &xforms, int image_size, float apix, float res) {
+	vector<EMAN::EMData *> images;
+	{
+		EMAN::GILRelease rel;
+		images = ths.projections_by_summation(xforms, image_size, apix, res);
+	}
+
+	list ret;
+	for (size_t i = 0; i < images.size(); i++) {
+		manage_new_object::apply<EMAN::EMData *>::type convert;
+		ret.append(object(handle<>(convert(images[i]))));
+	}
+	return ret;
+}
+
+list PointArray_projections_by_fourier(EMAN::PointArray &ths, const vector<EMAN::Transform> &xforms, int image_size, float apix, float res) {
+	vector<EMAN::EMData *> images;
+	{
+		EMAN::GILRelease rel;
+		images = ths.projections_by_fourier(xforms, image_size, apix, res);
+	}
+
+	list ret;
+	for (size_t i = 0; i < images.size(); i++) {
+		manage_new_object::apply<EMAN::EMData *>::type convert;
+		ret.append(object(handle<>(convert(images[i]))));
+	}
+	return ret;
+}
+
+boost::python::tuple PointArray_sim_potential_gradient(EMAN::PointArray &ths) {
+	vector<EMAN::Vec3f> grad;
+	double pot;
+	{
+		EMAN::GILRelease rel;
+		pot = ths.sim_potential_gradient(grad);
+	}
+	return boost::python::make_tuple(pot, grad);
+}
+
+vector<float> PointArray_projections_by_fourier_gradient(EMAN::PointArray &ths, const vector<EMAN::Transform> &xforms, const vector<EMAN::EMData *> &grads, float apix, float res) {
+	EMAN::GILRelease rel;
+
+	return ths.projections_by_fourier_gradient(xforms, grads, apix, res);
+}
+
 
 }// namespace
 
@@ -99,12 +158,16 @@ BOOST_PYTHON_MODULE(libpyPointArray2)
         .def("set_from_density_map", &EMAN::PointArray::set_from_density_map, EMAN_PointArray_set_from_density_map_overloads_4_5())
         .def("sort_by_axis", &EMAN::PointArray::sort_by_axis, EMAN_PointArray_sort_by_axis_overloads_0_1())
         .def("pdb2mrc_by_nfft", &EMAN::PointArray::pdb2mrc_by_nfft, return_value_policy< manage_new_object >())
-        .def("pdb2mrc_by_summation", &EMAN::PointArray::pdb2mrc_by_summation, return_value_policy< manage_new_object >())
+        .def("pdb2mrc_by_summation", &PointArray_pdb2mrc_by_summation, return_value_policy< manage_new_object >())
         .def("projection_by_nfft", &EMAN::PointArray::projection_by_nfft, EMAN_PointArray_projection_by_nfft_overloads_2_3()[ return_value_policy< manage_new_object >() ])
-        .def("projection_by_summation", &EMAN::PointArray::projection_by_summation, return_value_policy< manage_new_object >())
+        .def("projection_by_summation", &PointArray_projection_by_summation, return_value_policy< manage_new_object >())
+        .def("projections_by_summation", &PointArray_projections_by_summation, args("xforms", "image_size", "apix", "res"), "Project the points along each transform in xforms, returning one image per orientation.")
+        .def("projections_by_fourier", &PointArray_projections_by_fourier, args("xforms", "image_size", "apix", "res"), "Project the points along each transform in xforms directly in Fourier space, returning one complex image per orientation.")
+        .def("projections_by_fourier_gradient", &PointArray_projections_by_fourier_gradient, args("xforms", "grads", "apix", "res"), "Given dL/dF for each projections_by_fourier() image, return dL/dx, dL/dy, dL/dz, dL/damplitude for every point.")
         .def("replace_by_summation", &EMAN::PointArray::replace_by_summation)
         .def("opt_from_proj", &EMAN::PointArray::opt_from_proj)
         .def("sim_set_pot_parms", &EMAN::PointArray::sim_set_pot_parms)
+        .def("sim_potential_gradient", &PointArray_sim_potential_gradient, "Returns (potential, [gradient per point]) computed analytically in one parallel pass.")
         .def("sim_minstep", &EMAN::PointArray::sim_minstep)
         .def("sim_minstep_seq", &EMAN::PointArray::sim_minstep_seq)
         .def("sim_rescale", &EMAN::PointArray::sim_rescale)
@@ -34,6 +34,7 @@
 // Includes ====================================================================
 #include <emdata.h>
 #include <emobject.h>
+#include <gilrelease.h>
 #include <processor.h>
 
 // Using =======================================================================
@@ -51,10 +52,12 @@ struct EMAN_Processor_Wrapper: EMAN::Processor
         EMAN::Processor(), py_self(py_self_) {}
 
     void process_inplace(EMAN::EMData* p0) {
+        EMAN::GILAcquire gil;
         call_method< void >(py_self, "process_inplace", p0);
     }
 
     EMAN::EMData* process(const EMAN::EMData* const p0) {
+        EMAN::GILAcquire gil;
         return call_method< EMAN::EMData* >(py_self, "process", p0);
     }
 
@@ -63,6 +66,7 @@ struct EMAN_Processor_Wrapper: EMAN::Processor
     }
 
     void process_list_inplace(std::vector<EMAN::EMData*,std::allocator<EMAN::EMData*> >& p0) {
+        EMAN::GILAcquire gil;
         call_method< void >(py_self, "process_list_inplace", p0);
     }
 
@@ -71,10 +75,12 @@ struct EMAN_Processor_Wrapper: EMAN::Processor
     }
 
     std::string get_name() const {
+        EMAN::GILAcquire gil;
         return call_method< std::string >(py_self, "get_name");
     }
 
     EMAN::Dict get_params() const {
+        EMAN::GILAcquire gil;
         return call_method< EMAN::Dict >(py_self, "get_params");
     }
 
@@ -83,6 +89,7 @@ struct EMAN_Processor_Wrapper: EMAN::Processor
     }
 
     void set_params(const EMAN::Dict& p0) {
+        EMAN::GILAcquire gil;
         call_method< void >(py_self, "set_params", p0);
     }
 
@@ -91,6 +98,7 @@ struct EMAN_Processor_Wrapper: EMAN::Processor
     }
 
     EMAN::TypeDict get_param_types() const {
+        EMAN::GILAcquire gil;
         return call_method< EMAN::TypeDict >(py_self, "get_param_types");
     }
 
@@ -99,6 +107,7 @@ struct EMAN_Processor_Wrapper: EMAN::Processor
     }
 
     std::string get_desc() const {
+        EMAN::GILAcquire gil;
         return call_method< std::string >(py_self, "get_desc");
     }
 
@@ -106,17 +115,39 @@ struct EMAN_Processor_Wrapper: EMAN::Processor
 };
 
 
+void processor_process_inplace_wrapper(EMAN::Processor &ths, EMAN::EMData *image) {
+	EMAN::GILRelease rel;
+
+	ths.process_inplace(image);
+}
+
+EMAN::EMData *processor_process_wrapper(EMAN::Processor &ths, const EMAN::EMData * const image) {
+	EMAN::GILRelease rel;
+
+	return ths.process(image);
+}
+
+void processor_process_list_inplace_wrapper(EMAN::Processor &ths, std::vector<EMAN::EMData*> &images) {
+	EMAN::GILRelease rel;
+
+	ths.process_list_inplace(images);
+}
+
 }// namespace
 
 
 // Module ======================================================================
 BOOST_PYTHON_MODULE(libpyProcessor2)
 {
+    // process and process_list_inplace take their Python-subclass defaults as separate
+    // overloads, since the GIL-releasing wrappers are not members of Processor
     scope* EMAN_Processor_scope = new scope(
     class_< EMAN::Processor, boost::noncopyable, EMAN_Processor_Wrapper >("Processor", init<  >())
-        .def("process_inplace", pure_virtual(&EMAN::Processor::process_inplace))
-        .def("process", &EMAN::Processor::process, &EMAN_Processor_Wrapper::default_process, return_value_policy< manage_new_object >())
-        .def("process_list_inplace", &EMAN::Processor::process_list_inplace, &EMAN_Processor_Wrapper::default_process_list_inplace)
+        .def("process_inplace", pure_virtual(&processor_process_inplace_wrapper))
+        .def("process", &processor_process_wrapper, return_value_policy< manage_new_object >())
+        .def("process", &EMAN_Processor_Wrapper::default_process, return_value_policy< manage_new_object >())
+        .def("process_list_inplace", &processor_process_list_inplace_wrapper)
+        .def("process_list_inplace", &EMAN_Processor_Wrapper::default_process_list_inplace)
         .def("get_name", pure_virtual(&EMAN::Processor::get_name))
         .def("get_params", &EMAN::Processor::get_params, &EMAN_Processor_Wrapper::default_get_params)
         .def("set_params", &EMAN::Processor::set_params, &EMAN_Processor_Wrapper::default_set_params)
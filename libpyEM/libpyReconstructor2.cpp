@@ -34,6 +34,7 @@
 // Includes ====================================================================
 #include <emdata.h>
 #include <emobject.h>
+#include <gilrelease.h>
 #include <reconstructor.h>
 
 // Using =======================================================================
@@ -48,39 +49,31 @@ using std::endl;
 using namespace EMAN;
 
 	int reconstructor_insert_slice2(Reconstructor &self, const EMData* slice, const Transform& euler) {
-		int ret;
-		Py_BEGIN_ALLOW_THREADS
+		GILRelease rel;
 //		printf("wrapper1\n");
-		ret=self.insert_slice(slice,euler);
+		return self.insert_slice(slice,euler);
 //		ret=call_method< int >(py_self, "insert_slice", slice,euler,1.0f);
-		Py_END_ALLOW_THREADS
-		return ret;
 	}
 
  	int reconstructor_insert_slice3(Reconstructor &self, const EMData* slice, const Transform& euler,float weight) {
-		int ret;
-		Py_BEGIN_ALLOW_THREADS
+		GILRelease rel;
 //		printf("wrapper2 %p %p %f\n",&self,slice,weight);
-		ret=self.insert_slice(slice,euler,weight);
+		return self.insert_slice(slice,euler,weight);
 // 		ret=call_method< int >(py_self, "insert_slice", slice,euler,weight);
-		Py_END_ALLOW_THREADS
-		return ret;
  	}
 
  	EMAN::EMData* reconstructor_finish(Reconstructor &self, bool doift) {
-		EMAN::EMData* ret;
-		Py_BEGIN_ALLOW_THREADS
+		GILRelease rel;
 // 		printf("reconfinish2???\n");
-		ret=self.finish(doift);
-		Py_END_ALLOW_THREADS
-		return ret;
+		return self.finish(doift);
  	}
 	int reconstructor_determine_slice_agreement(Reconstructor &self, EMData* slice, const Transform &euler, const float weight=1.0, bool sub=true) {
-		int ret;
-		Py_BEGIN_ALLOW_THREADS
-		ret=self.determine_slice_agreement(slice,euler,weight,sub);
-		Py_END_ALLOW_THREADS
-		return ret;
+		GILRelease rel;
+		return self.determine_slice_agreement(slice,euler,weight,sub);
+	}
+	EMAN::EMData* reconstructor_preprocess_slice(Reconstructor &self, const EMData* slice, const Transform& t) {
+		GILRelease rel;
+		return self.preprocess_slice(slice,t);
 	}
 	
 struct EMAN_Reconstructor_Wrapper: EMAN::Reconstructor
@@ -92,35 +85,33 @@ struct EMAN_Reconstructor_Wrapper: EMAN::Reconstructor
         EMAN::Reconstructor(), py_self(py_self_) {}
 
     void setup() {
+        EMAN::GILAcquire gil;
         call_method< void >(py_self, "setup");
     }
 
     void setup_seed(const EMAN::EMData* seed,float seed_weight) {
+       EMAN::GILAcquire gil;
        call_method< void >(py_self, "setup_seed",seed,seed_weight);
     }
 
 	void setup_seedandweights(const EMAN::EMData* seed,const EMAN::EMData* weight) {
+        EMAN::GILAcquire gil;
         call_method< void >(py_self, "setup_seedandweights",seed,weight);
     }
 
     void clear() {
+        EMAN::GILAcquire gil;
         call_method< void >(py_self, "clear");
     }
     
  	int insert_slice(const EMAN::EMData* const slice, const EMAN::Transform& euler) {
-		int ret;
-		Py_BEGIN_ALLOW_THREADS
-		ret=call_method< int >(py_self, "insert_slice", slice,euler,1.0);
-		Py_END_ALLOW_THREADS
-		return ret;
+		EMAN::GILAcquire gil;
+		return call_method< int >(py_self, "insert_slice", slice,euler,1.0);
 	}
 
  	int insert_slice(const EMAN::EMData* const slice, const EMAN::Transform& euler,float weight) {
-		int ret;
-		Py_BEGIN_ALLOW_THREADS
- 		ret=call_method< int >(py_self, "insert_slice", slice,euler,weight);
-		Py_END_ALLOW_THREADS
-		return ret;
+		EMAN::GILAcquire gil;
+		return call_method< int >(py_self, "insert_slice", slice,euler,weight);
  	}
  	
 // 	int insert_slice2( const EMData* slice, const Transform& euler) {
@@ -144,23 +135,28 @@ struct EMAN_Reconstructor_Wrapper: EMAN::Reconstructor
 //  	}
 
     EMAN::EMData* finish(bool doift) {
+        EMAN::GILAcquire gil;
         return call_method< EMAN::EMData* >(py_self, "finish", doift);
     }
 
     std::string get_name() const {
+        EMAN::GILAcquire gil;
         return call_method< std::string >(py_self, "get_name");
     }
 
     std::string get_desc() const {
+        EMAN::GILAcquire gil;
         return call_method< std::string >(py_self, "get_desc");
     }
 
     EMAN::Dict get_params() const {
 		printf("call goes here!\n");
+        EMAN::GILAcquire gil;
         return call_method< EMAN::Dict >(py_self, "get_params");
     }
 /*
 	void print_params() const {
+        EMAN::GILAcquire gil;
         call_method< void >(py_self, "print_params");
 	}*/
 
@@ -169,6 +165,7 @@ struct EMAN_Reconstructor_Wrapper: EMAN::Reconstructor
     }
 
     void set_params(const EMAN::Dict& p0) {
+        EMAN::GILAcquire gil;
         call_method< void >(py_self, "set_params", p0);
     }
 
@@ -177,6 +174,7 @@ struct EMAN_Reconstructor_Wrapper: EMAN::Reconstructor
     }
 
     EMAN::TypeDict get_param_types() const {
+        EMAN::GILAcquire gil;
         return call_method< EMAN::TypeDict >(py_self, "get_param_types");
     }
 
@@ -202,7 +200,7 @@ BOOST_PYTHON_MODULE(libpyReconstructor2)
 		.def("insert_slice", &reconstructor_insert_slice2)
 		.def("determine_slice_agreement", &reconstructor_determine_slice_agreement)
 //		.def("determine_slice_agreement", (int (EMAN::Reconstructor::*)(EMAN::EMData* , const EMAN::Transform&, const float, bool))&EMAN::Reconstructor::determine_slice_agreement)
-        .def("preprocess_slice", (EMAN::EMData* (EMAN::Reconstructor::*)(const EMAN::EMData* const, const EMAN::Transform&))&EMAN::Reconstructor::preprocess_slice, return_value_policy< manage_new_object >())
+        .def("preprocess_slice", &reconstructor_preprocess_slice, return_value_policy< manage_new_object >())
         .def("projection", (EMAN::EMData* (EMAN::Reconstructor::*)(const EMAN::Transform&, int ret_fourier))&EMAN::Reconstructor::projection, return_value_policy< manage_new_object >())
 //         .def("finish", (EMAN::EMData* (EMAN::Reconstructor::*)(bool))&EMAN::Reconstructor::finish, return_value_policy< manage_new_object >())
         .def("finish", &reconstructor_finish, return_value_policy< manage_new_object >())
@@ -36,6 +36,7 @@
 #include <symmetry.h>
 #include <emdata.h>
 #include <emdata_pickle.h>
+#include <gilrelease.h>
 #include <quaternion.h>
 #include <vec3.h>
 
@@ -53,49 +54,61 @@ struct EMAN_Symmetry3D_Wrapper : public EMAN::Symmetry3D
 			EMAN::Symmetry3D(), py_self(py_self_) {}
 
 	int get_max_csym() const {
+		EMAN::GILAcquire gil;
 		return call_method< int >(py_self, "get_max_csym");
 	}
 
 	int get_nsym() const {
+		EMAN::GILAcquire gil;
 		return call_method< int >(py_self, "get_nsym");
 	}
 
 	EMAN::Transform get_sym(const int n) const {
+		EMAN::GILAcquire gil;
 		return call_method< EMAN::Transform >(py_self, "get_sym", n);
 	}
 
 	EMAN::Transform get_sym_proj(const string s) const {
+		EMAN::GILAcquire gil;
 		return call_method< EMAN::Transform >(py_self, "get_sym_proj", s);
 	}
 
 	EMAN::Dict get_delimiters(const bool b) const {
+		EMAN::GILAcquire gil;
 		return call_method< EMAN::Dict >(py_self, "get_delimiters",b);
 	}
 
 	std::string get_name() const {
+		EMAN::GILAcquire gil;
 		return call_method< std::string >(py_self, "get_name");
 	}
 	std::string get_desc() const {
+		EMAN::GILAcquire gil;
 		return call_method< std::string >(py_self, "get_desc");
 	}
 
 	EMAN::TypeDict get_param_types() const {
+		EMAN::GILAcquire gil;
 		return call_method< EMAN::TypeDict >(py_self, "get_param_types");
 	}
 
 	std::vector<EMAN::Vec3f > get_asym_unit_points(bool b) const {
+		EMAN::GILAcquire gil;
 		return call_method< std::vector<EMAN::Vec3f > >(py_self, "get_asym_unit_points", b);
 	}
 
 	std::vector<std::vector<EMAN::Vec3f > > get_asym_unit_triangles(bool b) const {
+		EMAN::GILAcquire gil;
 		return call_method< std::vector<std::vector<EMAN::Vec3f > > >(py_self, "get_asym_unit_triangles", b);
 	}
 
 	void insert_params(const EMAN::Dict& d) {
+		EMAN::GILAcquire gil;
 		return call_method< void >(py_self, "insert_params", d);
 	}
 
 	bool is_in_asym_unit(const float& altitude, const float& azimuth, const bool inc_mirror) const {
+		EMAN::GILAcquire gil;
 		return call_method< bool >(py_self, "is_in_asymm_init",altitude,azimuth,inc_mirror);
 	}
 
@@ -108,21 +121,26 @@ struct EMAN_OrientationGenerator_Wrapper : public EMAN::OrientationGenerator
 			EMAN::OrientationGenerator(), py_self(py_self_) {}
 
 	std::vector<EMAN::Transform> gen_orientations(const EMAN::Symmetry3D* const sym) const {
+		EMAN::GILAcquire gil;
 		return call_method< std::vector<EMAN::Transform> >(py_self, "gen_orientations", sym);
 	}
 
 	std::string get_name() const {
+		EMAN::GILAcquire gil;
 		return call_method< std::string >(py_self, "get_name");
 	}
 	std::string get_desc() const {
+		EMAN::GILAcquire gil;
 		return call_method< std::string >(py_self, "get_desc");
 	}
 
 	EMAN::TypeDict get_param_types() const {
+		EMAN::GILAcquire gil;
 		return call_method< EMAN::TypeDict >(py_self, "get_param_types");
 	}
 
 	int get_orientations_tally(const EMAN::Symmetry3D* const sym, const float& delta ) const {
+		EMAN::GILAcquire gil;
 		return call_method< int >(py_self, "get_orientations_tally",sym,delta);
 	}
 
@@ -46,20 +46,52 @@ int init_numpy()
     return 0;
 }
 
+// Declarations ================================================================
+namespace {
+
+// the EMData's Python object becomes the array's base, so the image outlives the array
+np::ndarray EMNumPy_em2numpy(object image)
+{
+	return EMAN::EMNumPy::em2numpy(extract<EMAN::EMData *>(image), image);
+}
+
+np::ndarray EMNumPy_stack2numpy(object stack)
+{
+	return EMAN::EMNumPy::stack2numpy(extract<EMAN::EMDataStack *>(stack), stack);
+}
+
+BOOST_PYTHON_FUNCTION_OVERLOADS(EMAN_EMNumPy_numpy2em_overloads_1_2, EMAN::EMNumPy::numpy2em, 1, 2)
+
+BOOST_PYTHON_FUNCTION_OVERLOADS(EMAN_EMNumPy_numpy2em_stack_overloads_1_2, EMAN::EMNumPy::numpy2em_stack, 1, 2)
+
+}// namespace
+
 // Module ======================================================================
 BOOST_PYTHON_MODULE(libpyTypeConverter2)
 {
     class_< EMAN::EMNumPy >("EMNumPy", init<  >())
         .def(init< const EMAN::EMNumPy& >())
-        .def("em2numpy", &EMAN::EMNumPy::em2numpy, "Get an EMData image's pixel data as a numeric numpy array.\n"
-												   "The array and EMData image share the same memory block.")
-        .def("numpy2em", &EMAN::EMNumPy::numpy2em, return_value_policy< manage_new_object >(), "Create an EMData image from a numeric numpy array.\n"
-																							   "Returned EMData object will contain copy of the numpy array data.\n"
-																							   "Note: The array size is (nz,ny,nx) corresponding to image (nx,ny,nz).")
+        .def("em2numpy", &EMNumPy_em2numpy, args("image"), "Get an EMData image's pixel data as a numeric numpy array.\n"
+												   "The array and EMData image share the same memory block, and the array keeps the image alive.\n"
+												   "Resizing the image invalidates the array.")
+        .def("numpy2em", &EMAN::EMNumPy::numpy2em, EMAN_EMNumPy_numpy2em_overloads_1_2(args("array", "copy"), "Create an EMData image from a numeric numpy array.\n"
+																							   "By default the returned EMData object contains a copy of the numpy array data.\n"
+																							   "Note: The array size is (nz,ny,nx) corresponding to image (nx,ny,nz).\n \n"
+																							   "array - the numpy array\n"
+																							   "copy - if False and the array is writable C-contiguous float32, the image uses the array's memory and keeps the array alive(default=True)")[return_value_policy< manage_new_object >()])
+        .def("em2numpy_stack", &EMAN::EMNumPy::em2numpy_stack, args("images"), "Copy a list of equally sized EMData images into one numpy array with the image index as the first axis.")
+        .def("stack2numpy", &EMNumPy_stack2numpy, args("stack"), "Get an EMDataStack's buffer as one numpy array with the image index first, without copying.\n"
+												   "The array keeps the stack alive.")
+        .def("numpy2em_stack", &EMAN::EMNumPy::numpy2em_stack, EMAN_EMNumPy_numpy2em_stack_overloads_1_2(args("array", "copy"), "Split the first axis of a numpy array into a list of EMData images.\n \n"
+																							   "array - 2D to 4D numpy array, image index first\n"
+																							   "copy - if False and the array is writable C-contiguous float32, each image uses its slice of the array's memory(default=True)"))
         .def("register_numpy_to_emdata", &EMAN::EMNumPy::register_numpy_to_emdata, return_value_policy< reference_existing_object >())
         .def("unregister_numpy_from_emdata", &EMAN::EMNumPy::unregister_numpy_from_emdata)
         .staticmethod("em2numpy")
         .staticmethod("numpy2em")
+        .staticmethod("em2numpy_stack")
+        .staticmethod("stack2numpy")
+        .staticmethod("numpy2em_stack")
     ;
 
     init_numpy();
@@ -101,6 +133,7 @@ BOOST_PYTHON_MODULE(libpyTypeConverter2)
 	EMAN::vector_from_python<EMAN::Pixel>();
 	EMAN::vector_from_python<EMAN::EMObject>();
 	EMAN::vector_from_python<EMAN::Vec3f>();
+	EMAN::vector_from_python<EMAN::Vec3i>();
 	EMAN::vector_from_python<std::vector<float> >();
 	EMAN::map_to_python_2<unsigned int, unsigned int>();
 	EMAN::map_to_python<int>();
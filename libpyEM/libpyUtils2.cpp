@@ -43,9 +43,12 @@
 #include <xydata.h>
 #include <emobject.h>
 #include <randnum.h>
+#include <gilrelease.h>
 #include "ctf.h"
 #include "geometry.h"
 #include "portable_fileio.h"
+#include "io/moviestream.h"
+#include "emthreads.h"
 
 // Using =======================================================================
 using namespace boost::python;
@@ -85,7 +88,7 @@ BOOST_PYTHON_FUNCTION_OVERLOADS(EMAN_Util_multiref_polar_ali_helicon_90_local_ov
 
 
 void read_raw_emdata(EMAN::EMData *ths, const char* path, size_t offset, int rw_mode, int image_index, int mode, const EMAN::Region * area=0) { 
-	Py_BEGIN_ALLOW_THREADS
+	EMAN::GILRelease rel;		// also restored on the early return below
 	const char *iomode;
 	if (rw_mode==1) iomode="r";	// 1 is READ_ONLY
 	else iomode="r+";
@@ -125,8 +128,6 @@ void read_raw_emdata(EMAN::EMData *ths, const char* path, size_t offset, int rw_
 	else printf("read_raw_emdata: Unknown mode\n");
 	
 	ths->update();
-	
-	Py_END_ALLOW_THREADS
 }
 
 
@@ -142,6 +143,7 @@ struct EMAN_Util_sincBlackman_Wrapper: EMAN::Util::sincBlackman
         EMAN::Util::sincBlackman(p0, p1, p2), py_self(py_self_) {}
 
     void build_sBtable() {
+        EMAN::GILAcquire gil;
         call_method< void >(py_self, "build_sBtable");
     }
 
@@ -168,6 +170,7 @@ struct EMAN_Util_KaiserBessel_Wrapper: EMAN::Util::KaiserBessel
         EMAN::Util::KaiserBessel(p0, p1, p2, p3, p4, p5, p6), py_self(py_self_) {}
 
     void build_I0table() {
+        EMAN::GILAcquire gil;
         call_method< void >(py_self, "build_I0table");
     }
 
@@ -176,6 +179,7 @@ struct EMAN_Util_KaiserBessel_Wrapper: EMAN::Util::KaiserBessel
     }
 
     float sinhwin(float p0) const {
+        EMAN::GILAcquire gil;
         return call_method< float >(py_self, "sinhwin", p0);
     }
 
@@ -184,6 +188,7 @@ struct EMAN_Util_KaiserBessel_Wrapper: EMAN::Util::KaiserBessel
     }
 
     float i0win(float p0) const {
+        EMAN::GILAcquire gil;
         return call_method< float >(py_self, "i0win", p0);
     }
 
@@ -209,6 +214,7 @@ struct EMAN_Util_FakeKaiserBessel_Wrapper: EMAN::Util::FakeKaiserBessel
         EMAN::Util::FakeKaiserBessel(p0, p1, p2, p3, p4, p5, p6), py_self(py_self_) {}
 
     float sinhwin(float p0) const {
+        EMAN::GILAcquire gil;
         return call_method< float >(py_self, "sinhwin", p0);
     }
 
@@ -217,6 +223,7 @@ struct EMAN_Util_FakeKaiserBessel_Wrapper: EMAN::Util::FakeKaiserBessel
     }
 
     float i0win(float p0) const {
+        EMAN::GILAcquire gil;
         return call_method< float >(py_self, "i0win", p0);
     }
 
@@ -225,6 +232,7 @@ struct EMAN_Util_FakeKaiserBessel_Wrapper: EMAN::Util::FakeKaiserBessel
     }
 
     void build_I0table() {
+        EMAN::GILAcquire gil;
         call_method< void >(py_self, "build_I0table");
     }
 
@@ -256,6 +264,21 @@ BOOST_PYTHON_FUNCTION_OVERLOADS(EMAN_TestUtil_make_image_file2_overloads_2_6, EM
 
 BOOST_PYTHON_FUNCTION_OVERLOADS(EMAN_TestUtil_verify_image_file2_overloads_2_6, EMAN::TestUtil::verify_image_file2, 2, 6)
 
+BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(EMAN_MovieStream_set_gain_overloads_1_2, set_gain, 1, 2)
+
+// summed groups are handed to python as shared_ptr so ownership is unambiguous
+vector<std::shared_ptr<EMAN::EMData>> MovieStream_read_groups(EMAN::MovieStream & ms, const vector<int> & groups)
+{
+	vector<EMAN::EMData*> r = ms.read_groups(groups);
+	return vector<std::shared_ptr<EMAN::EMData>>(r.begin(), r.end());
+}
+
+vector<std::shared_ptr<EMAN::EMData>> MovieStream_sum_groups(EMAN::MovieStream & ms, int groupsize)
+{
+	vector<EMAN::EMData*> r = ms.sum_groups(groupsize);
+	return vector<std::shared_ptr<EMAN::EMData>>(r.begin(), r.end());
+}
+
 }// namespace
 
 /*
@@ -268,6 +291,7 @@ struct EMAN_Util_Wrapper: EMAN::Util
 		EMAN::Util(), py_self(py_self_) {}
 
 	EMAN::Dict get_stats(const std::vector<double,std::allocator<double> >& data) {
+		EMAN::GILAcquire gil;
 		return call_method< EMAN::Dict>(py_self,"get_stats", data);
 	}
 
@@ -431,6 +455,8 @@ BOOST_PYTHON_MODULE(libpyUtils2)
 		.def(init< const EMAN::Util& >())
 		.def("coveig", &EMAN::Util::coveig, args("n", "covmat", "eigval", "eigvec"))
 		.def("coveig_for_py", &EMAN::Util::coveig_for_py, args("ncov", "covmatpy"), "same function than Util::coveig but wrapped to use directly in python code")
+		.def("use_external_blas", &EMAN::Util::use_external_blas, args("use"), "Select the optimized BLAS/LAPACK backend (True) or the bundled routines (False) for sparx linear algebra. Returns the previous setting.")
+		.def("using_external_blas", &EMAN::Util::using_external_blas, "True if sparx linear algebra currently runs on the external BLAS/LAPACK.")
 		.def("WTM", &EMAN::Util::WTM)
 		.def("WTF", &EMAN::Util::WTF)
 		.def("CANG", &EMAN::Util::CANG)
@@ -512,6 +538,7 @@ hyb -- y- mesh spacing above f0\nhya -- y- mesh spacing below f0\n \nInterpolant
 		.def("cml_spin_psi", &EMAN::Util::cml_spin_psi, args("data", "com", "weights", "iprj", "iw", "n_psi", "d_psi", "n_prj"), "new code common-lines\n2009-03-26 11:37:53 JB. This function spin all angle psi and evaluate the partial discrepancy belong common-lines")
 		.def("cml_spin_psi_now", &EMAN::Util::cml_spin_psi_now, args("data", "com", "iprj", "iw", "n_psi", "d_psi", "n_prj"), "new code common-lines\n2009-03-26 11:37:53 JB. This function spin all angle psi and evaluate the partial discrepancy belong common-lines")
 		.def("cml_disc", &EMAN::Util::cml_disc, args("data", "com", "seq", "weights", "n_lines"), "new code common-lines\n2009-03-30 15:44:05 JB. Compute the discrepancy belong all common-lines")
+		.def("cml_disc_batch", &EMAN::Util::cml_disc_batch, args("data", "coms", "seq", "weights", "n_lines"), "new code common-lines\nCompute cml_disc for several candidates at once, coms holds the 2*n_lines common-lines of each candidate back to back")
 		.def("cml_prepare_line", &EMAN::Util::cml_prepare_line, args("sino", "line", "ilf", "ihf", "pos_line", "nblines"), "new code common-lines\nThis function prepare the line from sinogram by cutting off some frequencies,\nand creating the mirror part (complex conjugate of the first part). Then\nboth lines (mirror and without) are drop to the sinogram.\nline is in Fourrier space, ilf low frequency, ihf high frequency, nblines\nnumber of lines of the half sinogram (the non miror part), sino the sinogram,\npos_line the position of the line in the sino.")
 		.def("set_line", &EMAN::Util::set_line, args("img", "posline", "line", "offset", "length"), "new code common-lines\nThis function drop a line (line) to an 2D image (img).\nThe position of the line to the image is defined by (postline).\nThe part of the line paste is defined by (offset), the begin position\nand (length) the size.")
 		.def("compress_image_mask", &EMAN::Util::compress_image_mask, return_value_policy< manage_new_object >(), args("img", "mask"), "")
@@ -681,7 +708,11 @@ hyb -- y- mesh spacing above f0\nhya -- y- mesh spacing below f0\n \nInterpolant
 		.def("nearest_fang", &EMAN::Util::nearest_fang)
 		.def("nearest_fang_select", &EMAN::Util::nearest_fang_select)
 		.def("nearest_fang_sym", &EMAN::Util::nearest_fang_sym)
+		.def("nearest_fang_list", &EMAN::Util::nearest_fang_list)
+		.def("nearest_fang_select_list", &EMAN::Util::nearest_fang_select_list)
+		.def("nearest_fang_sym_list", &EMAN::Util::nearest_fang_sym_list)
 		.def("assign_groups", &EMAN::Util::assign_groups)
+		.def("assign_groups_auction", &EMAN::Util::assign_groups_auction, args("matrix_address", "nref", "nima"), "Same as assign_groups, but the equal size groups maximize the total similarity (auction algorithm)")
 		.def("group_proj_by_phitheta", &EMAN::Util::group_proj_by_phitheta)
 		.def("angle_to_normal", &EMAN::Util::angle_to_normal)
 		.def("angles_to_normals", &EMAN::Util::angles_to_normals)
@@ -767,6 +798,8 @@ hyb -- y- mesh spacing above f0\nhya -- y- mesh spacing below f0\n \nInterpolant
 		.def("twoD_fine_ali_G", &EMAN::Util::twoD_fine_ali_G, args("image", "refim", "mask", "kb", "ang", "sxs", "sys"), "")
 		.def("twoD_fine_ali_SD", &EMAN::Util::twoD_fine_ali_SD, args("image", "refim", "mask", "ang", "sxs", "sys"), "")
 		.def("twoD_fine_ali_SD_G", &EMAN::Util::twoD_fine_ali_SD_G, args("image", "refim", "mask", "kb", "ang", "sxs", "sys"), "")
+		.def("twoD_fine_ali_batch", &EMAN::Util::twoD_fine_ali_batch, args("images", "refims", "mask", "params"), "twoD_fine_ali of all images at once, the objectives evaluated in parallel.\nrefims holds one reference per image or one for all, params ang, sx, sy of every image.\nReturns ang, sx, sy of every image.")
+		.def("twoD_fine_ali_SD_batch", &EMAN::Util::twoD_fine_ali_SD_batch, args("images", "refims", "mask", "params"), "twoD_fine_ali_SD of all images at once, distributed over threads.\nrefims holds one reference per image or one for all, params ang, sx, sy of every image.\nReturns ang, sx, sy and the number of steps of every image.")
 		.def("twoD_to_3D_ali", &EMAN::Util::twoD_to_3D_ali, args("volft", "kb", "refim", "mask", "phi", "theta", "psi", "sxs", "sxy"), "")
 		.def("multi_align_error", (vector<float> (*)(vector<float>, vector<float>, int))&EMAN::Util::multi_align_error, args("args", "all_ali_params", "d"), "")
 		.def("multi_align_error_func", &EMAN::Util::multi_align_error_func, args("args", "all_ali_params", "nima", "num_ali", "d"), "")
@@ -784,6 +817,7 @@ hyb -- y- mesh spacing above f0\nhya -- y- mesh spacing below f0\n \nInterpolant
 		.def("sdot",   &pysdot, args("n", "x", "incx", "y", "incy"), "")
 		.def("readarray", &readarray, args("f", "x", "size"), "")
 		.def("k_means_cont_table", &pyk_means_cont_table, args("group1", "group2", "stb", "s1", "s2", "flag"), "k_means_cont_table_ is locate to util_sparx.cpp\nhelper to create the contengency table for partition matching (k-means)\nflag define is the list of stable obj must be store to stb, but the size st\nmust be know before. The trick is first start without the flag to get number\nof elements stable, then again with the flag to get the list. This avoid to\nhave two different functions for the same thing.")
+		.def("k_means_cont_table_all", &EMAN::Util::k_means_cont_table_all, args("assign1", "assign2", "K1", "K2"), "contingency table of two partitions given as class labels of every object,\nreturns the K1*K2 counts row by row, objects labelled outside [0,K) are ignored")
 		.def("bb_enumerateMPI", &pybb_enumerateMPI, args("parts", "classDims", "nParts", "nClasses", "T", "nguesses", "LARGEST_CLASS","J","max_branching","stmult","branchfunc", "LIM"), "bb_enumerateMPI is locate in util_sparx.cpp\nK is the number of classes in each partition (should be the same for all partitions)\nthe first element of each class is its original index in the partition, and second is dummy var\nMPI: if nTop <= 0, then initial prune is called, and the pruned partitions are returned in a 1D array.\nThe first element is reserved for max_levels (the size of the smallest\npartition after pruning).\nif nTop > 0, then partitions are assumed to have been pruned, where only dummy variables of un-pruned partitions are set to 1, and findTopLargest is called\nto find the top weighted matches. The matches, where each match is preceded by its cost, is returned in a one dimensional vector.\nessentially the same as bb_enumerate but with the option to do mpi version.")
 		.def("Normalize_ring", &EMAN::Util::Normalize_ring, args("ring", "numr", "norm_by_square"), "")
 		.def("image_mutation", &EMAN::Util::image_mutation, args("img", "mutation_rate"), "")
@@ -851,6 +885,7 @@ hyb -- y- mesh spacing above f0\nhya -- y- mesh spacing below f0\n \nInterpolant
 		.staticmethod("cml_line_in3d")
 		.staticmethod("cml_spin_psi")
 		.staticmethod("cml_disc")
+		.staticmethod("cml_disc_batch")
 		.staticmethod("cml_spin_psi_now")
 		.staticmethod("set_line")
 		.staticmethod("cml_prepare_line")
@@ -905,6 +940,8 @@ hyb -- y- mesh spacing above f0\nhya -- y- mesh spacing below f0\n \nInterpolant
 		.staticmethod("WTF")
 		.staticmethod("coveig")
 		.staticmethod("coveig_for_py")
+		.staticmethod("use_external_blas")
+		.staticmethod("using_external_blas")
 		.staticmethod("tf")
 		//.staticmethod("cmp1")
 		.staticmethod("set_freq_sphire")
@@ -1006,7 +1043,11 @@ hyb -- y- mesh spacing above f0\nhya -- y- mesh spacing below f0\n \nInterpolant
 		.staticmethod("nearest_fang")
 		.staticmethod("nearest_fang_select")
 		.staticmethod("nearest_fang_sym")
+		.staticmethod("nearest_fang_list")
+		.staticmethod("nearest_fang_select_list")
+		.staticmethod("nearest_fang_sym_list")
 		.staticmethod("assign_groups")
+		.staticmethod("assign_groups_auction")
 		.staticmethod("assign_projangles")
 		.staticmethod("assign_projangles_f")
 		.staticmethod("assign_projdirs_f")
@@ -1072,6 +1113,8 @@ hyb -- y- mesh spacing above f0\nhya -- y- mesh spacing below f0\n \nInterpolant
 		.staticmethod("twoD_fine_ali")
 		.staticmethod("twoD_fine_ali_G")
 		.staticmethod("twoD_fine_ali_SD")
+		.staticmethod("twoD_fine_ali_batch")
+		.staticmethod("twoD_fine_ali_SD_batch")
 		.staticmethod("twoD_fine_ali_SD_G")
 		.staticmethod("twoD_to_3D_ali")
 		.staticmethod("multi_align_error")
@@ -1090,6 +1133,7 @@ hyb -- y- mesh spacing above f0\nhya -- y- mesh spacing below f0\n \nInterpolant
 		.staticmethod("sdot")
 		.staticmethod("readarray")
 		.staticmethod("k_means_cont_table")
+		.staticmethod("k_means_cont_table_all")
 		.staticmethod("bb_enumerateMPI")
 		.staticmethod("Normalize_ring")
 		.staticmethod("image_mutation")
@@ -1281,6 +1325,7 @@ hyb -- y- mesh spacing above f0\nhya -- y- mesh spacing below f0\n \nInterpolant
         .value("IMAGE_V4L", EMAN::EMUtil::IMAGE_V4L)
         .value("IMAGE_PIF", EMAN::EMUtil::IMAGE_PIF)
         .value("IMAGE_DF3", EMAN::EMUtil::IMAGE_DF3)
+        .value("IMAGE_EMZ", EMAN::EMUtil::IMAGE_EMZ)
     ;
 
     delete EMAN_EMUtil_scope;
@@ -1294,6 +1339,32 @@ hyb -- y- mesh spacing above f0\nhya -- y- mesh spacing below f0\n \nInterpolant
         .def("size", &EMAN::ImageSort::size)
     ;
 
+    class_< EMAN::MovieStream, boost::noncopyable >("MovieStream",
+    		"Sequential movie frame reader with in-loop dark/gain/defect correction,\n"
+    		"frame-group summation and Fourier binning.",
+    		init< const std::string& >())
+        .def("get_nframes", &EMAN::MovieStream::get_nframes)
+        .def("get_xsize", &EMAN::MovieStream::get_xsize)
+        .def("get_ysize", &EMAN::MovieStream::get_ysize)
+        .def("set_gain", &EMAN::MovieStream::set_gain, EMAN_MovieStream_set_gain_overloads_1_2())
+        .def("set_dark", &EMAN::MovieStream::set_dark)
+        .def("set_defects", &EMAN::MovieStream::set_defects)
+        .def("set_binning", &EMAN::MovieStream::set_binning)
+        .def("seek", &EMAN::MovieStream::seek)
+        .def("read_sum", &EMAN::MovieStream::read_sum, return_value_policy< manage_new_object >())
+        .def("read_groups", &MovieStream_read_groups)
+        .def("sum_groups", &MovieStream_sum_groups)
+    ;
+
+    class_< EMAN::EMThreads, boost::noncopyable >("EMThreads",
+    		"Thread count of the multithreaded libEM kernels. Results of kernels that\n"
+    		"document it do not depend on the thread count.", no_init)
+        .def("get_num_threads", &EMAN::EMThreads::get_num_threads, "Get the number of threads used by parallel kernels.")
+        .def("set_num_threads", &EMAN::EMThreads::set_num_threads, args("n"), "Set the number of threads used by parallel kernels.\n \nn - 0 restores the default, 1 disables threading")
+        .staticmethod("get_num_threads")
+        .staticmethod("set_num_threads")
+    ;
+
     class_< EMAN::TestUtil >("TestUtil", "TestUtil defines function assisting testing of EMAN2.", init<  >())
         .def(init< const EMAN::TestUtil& >())
         .add_static_property("EMDATA_HEADER_EXT", make_getter(EMAN::TestUtil::EMDATA_HEADER_EXT))
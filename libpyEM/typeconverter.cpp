@@ -35,13 +35,76 @@
 #include <Python.h>
 #include "typeconverter.h"
 #include "emdata.h"
+#include "embuffer.h"
+#include "emthreads.h"
+#include "gilrelease.h"
 
 namespace python = boost::python;
 namespace np = boost::python::numpy;
 
 using namespace EMAN;
 
-np::ndarray EMNumPy::em2numpy(const EMData *const image)
+namespace {
+	/** Image dimensions of an array, ignoring the first skip axes */
+	bool array_image_size(const np::ndarray& array, int skip, int & nx, int & ny, int & nz)
+	{
+		int ndim = array.get_nd() - skip;
+
+		if (ndim <= 0 || ndim > 3) {
+			LOGERR("%dD numpy array to EMData is not supported.", ndim);
+			return false;
+		}
+
+		nx = ny = nz = 1;
+		switch(ndim) {
+			case 1:
+				nx = array.shape(skip);
+				break;
+			case 2:
+				ny = array.shape(skip);
+				nx = array.shape(skip + 1);
+				break;
+			case 3:
+				nz = array.shape(skip);
+				ny = array.shape(skip + 1);
+				nx = array.shape(skip + 2);
+				break;
+		}
+		return true;
+	}
+
+	/** True if EMData can use the array's memory directly */
+	bool array_is_direct(PyArrayObject * arr)
+	{
+		return PyArray_TYPE(arr) == NPY_FLOAT && PyArray_IS_C_CONTIGUOUS(arr) && PyArray_ISBEHAVED(arr);
+	}
+
+	/** Let an image use memory inside arr, holding a reference to arr until
+	 * the image frees or resizes its data */
+	EMData * borrow_array(PyArrayObject * arr, float * data, int nx, int ny, int nz)
+	{
+		Py_INCREF(arr);
+		ExternalBuffer::add(data, (size_t)nx*ny*nz*sizeof(float), [arr]() {
+			GILAcquire gil;
+			Py_DECREF(arr);
+		});
+		return new EMData(data, nx, ny, nz);
+	}
+
+	/** Convert any array to float32 into dst, in one strided pass */
+	void copy_array(PyArrayObject * src, float * dst)
+	{
+		PyObject * out = PyArray_NewFromDescr(&PyArray_Type, PyArray_DescrFromType(NPY_FLOAT),
+					PyArray_NDIM(src), PyArray_DIMS(src), 0, dst, NPY_ARRAY_CARRAY, 0);
+		if (out == 0) python::throw_error_already_set();
+
+		int err = PyArray_CopyInto((PyArrayObject*)out, src);
+		Py_DECREF(out);
+		if (err < 0) python::throw_error_already_set();
+	}
+}
+
+np::ndarray EMNumPy::em2numpy(const EMData *const image, python::object owner)
 {
 	float * data = image->get_data();
 	int nx = image->get_xsize();
@@ -55,52 +118,144 @@ np::ndarray EMNumPy::em2numpy(const EMData *const image)
 
 	dims.push_back(nx);
 
-	return make_numeric_array(data, dims);
+	return make_numeric_array(data, dims, owner);
 }
 
-EMData* EMNumPy::numpy2em(const np::ndarray& array)
+EMData* EMNumPy::numpy2em(const np::ndarray& array, bool copy)
 {
-	int ndim = array.get_nd();
+	int nx, ny, nz;
+	if (!array_image_size(array, 0, nx, ny, nz)) return 0;
 
-#if defined (__LP64__) //is it a 64-bit platform?
-	long nx=1, ny=1, nz=1;
-#else	//for 32 bit platform
-	int nx=1, ny=1, nz=1;
-#endif // defined (__LP64__)
+	PyArrayObject * arr = (PyArrayObject*) array.ptr();
+	bool direct = array_is_direct(arr);
+	EMData* image;
 
-	if (ndim <= 0 || ndim > 3) {
-		LOGERR("%dD numpy array to EMData is not supported.", ndim);
-		return 0;
+	if (direct && !copy) {
+		image = borrow_array(arr, (float*)PyArray_DATA(arr), nx, ny, nz);
+	}
+	else {
+		size_t size = (size_t)nx*ny*nz*sizeof(float);
+		float * data = (float*)EMUtil::em_malloc(size);
+		if (data == 0) throw BadAllocException("Cannot allocate memory for numpy array copy");
+
+		try {
+			if (direct) EMUtil::em_memcpy(data, PyArray_DATA(arr), size);
+			else copy_array(arr, data);
+		}
+		catch (...) {
+			EMUtil::em_free(data);
+			throw;
+		}
+		image = new EMData(data, nx, ny, nz);
 	}
 
-	switch(ndim) {
-		case 1:
-			nx = array.shape(0);
-			break;
-		case 2:
-			ny = array.shape(0);
-			nx = array.shape(1);
-			break;
-		case 3:
-			nz = array.shape(0);
-			ny = array.shape(1);
-			nx = array.shape(2);
-			break;
+	image->update();
+	return image;
+}
+
+np::ndarray EMNumPy::em2numpy_stack(const python::list& images)
+{
+	size_t n = python::len(images);
+	if (n == 0) throw EmptyContainerException("no images to stack");
+
+	vector<const float *> src(n);
+	int nx = 0, ny = 0, nz = 0;
+	for (size_t i = 0; i < n; i++) {
+		EMData * img = python::extract<EMData *>(images[i]);
+		if (img == 0) throw NullPointerException("None in image list");
+		if (i == 0) {
+			nx = img->get_xsize();
+			ny = img->get_ysize();
+			nz = img->get_zsize();
+		}
+		else if (img->get_xsize() != nx || img->get_ysize() != ny || img->get_zsize() != nz) {
+			throw ImageDimensionException("images to stack must all be the same size");
+		}
+		src[i] = img->get_data();
 	}
 
-	auto arr = array.astype(np::dtype::get_builtin<float>());
-	float * float_array = (float *)arr.get_data();
-	float * temparray = new float[(size_t)nx*ny*nz];
-	std::copy(float_array, float_array + nx * ny * nz, temparray);
+	python::list shape;
+	shape.append(n);
+	if (nz > 1) shape.append(nz);
+	if (ny > 1) shape.append(ny);
+	shape.append(nx);
+
+	np::ndarray out = np::empty(python::tuple(shape), np::dtype::get_builtin<float>());
+	float * dst = (float *)out.get_data();
+	size_t nxyz = (size_t)nx*ny*nz;
+
+	{
+		GILRelease rel;
+		EMThreads::parallel_for(n, [&](size_t b, size_t e, int) {
+			for (size_t i = b; i < e; i++) {
+				EMUtil::em_memcpy(dst + i*nxyz, src[i], nxyz*sizeof(float));
+			}
+		});
+	}
 
-	EMData* image = new EMData((float*)temparray, nx, ny, nz);
+	return out;
+}
 
-	image->set_attr("apix_x", 1.0);
-	image->set_attr("apix_y", 1.0);
-	image->set_attr("apix_z", 1.0);
+np::ndarray EMNumPy::stack2numpy(const EMDataStack *const stack, python::object owner)
+{
+	vector<int> dims;
 
-	image->update();
-	return image;
+	dims.push_back(stack->get_n());
+	if (stack->get_zsize() > 1) dims.push_back(stack->get_zsize());
+	if (stack->get_ysize() > 1) dims.push_back(stack->get_ysize());
+	dims.push_back(stack->get_xsize());
+
+	return make_numeric_array(stack->get_data(), dims, owner);
+}
+
+python::list EMNumPy::numpy2em_stack(const np::ndarray& array, bool copy)
+{
+	int nx, ny, nz;
+	if (array.get_nd() < 2 || !array_image_size(array, 1, nx, ny, nz)) {
+		throw ImageDimensionException("expected a 2D to 4D numpy array with the image index first");
+	}
+
+	size_t n = array.shape(0);
+	size_t nxyz = (size_t)nx*ny*nz;
+	PyArrayObject * arr = (PyArrayObject*) array.ptr();
+	vector<EMData *> images(n, (EMData *)0);
+
+	if (array_is_direct(arr) && !copy) {
+		float * data = (float*)PyArray_DATA(arr);
+		for (size_t i = 0; i < n; i++) images[i] = borrow_array(arr, data + i*nxyz, nx, ny, nz);
+	}
+	else {
+		// a float32 C-contiguous array is used as is, anything else is converted once
+		python::handle<> contig(PyArray_FROM_OTF(array.ptr(), NPY_FLOAT, NPY_ARRAY_IN_ARRAY));
+		const float * data = (const float*)PyArray_DATA((PyArrayObject*)contig.get());
+
+		vector<float *> dst(n, (float *)0);
+		for (size_t i = 0; i < n; i++) {
+			dst[i] = (float*)EMUtil::em_malloc(nxyz*sizeof(float));
+			if (dst[i] == 0) {
+				for (size_t j = 0; j < i; j++) EMUtil::em_free(dst[j]);
+				throw BadAllocException("Cannot allocate memory for numpy array copy");
+			}
+		}
+
+		{
+			GILRelease rel;
+			EMThreads::parallel_for(n, [&](size_t b, size_t e, int) {
+				for (size_t i = b; i < e; i++) {
+					EMUtil::em_memcpy(dst[i], data + i*nxyz, nxyz*sizeof(float));
+				}
+			});
+		}
+
+		for (size_t i = 0; i < n; i++) images[i] = new EMData(dst[i], nx, ny, nz);
+	}
+
+	python::list ret;
+	for (size_t i = 0; i < n; i++) {
+		python::manage_new_object::apply<EMData *>::type convert;
+		ret.append(python::object(python::handle<>(convert(images[i]))));
+	}
+	return ret;
 }
 
 
@@ -39,6 +39,7 @@
 #include "transform.h"
 #include "geometry.h"
 #include "emdata.h"
+#include "emdatastack.h"
 #include "xydata.h"
 #include "exception.h"
 #include "ctf.h"
@@ -68,8 +69,10 @@ using std::endl;
 
 namespace EMAN {
 
+    /** Wrap data in a numpy array without copying. If owner is given, the
+     * array holds a reference to it so the memory outlives the array. */
     template <class T>
-	np::ndarray make_numeric_array(T * data, vector<int> dims)
+	np::ndarray make_numeric_array(T * data, vector<int> dims, python::object owner = python::object())
     {
         python::tuple shape;
         python::tuple stride;
@@ -93,23 +96,53 @@ namespace EMAN {
                                             sizeof(T) * dims[2],
                                             sizeof(T));
                 break;
+
+            case 4:
+                shape  = python::make_tuple(dims[0], dims[1], dims[2], dims[3]);
+                stride = python::make_tuple(sizeof(T) * dims[3] * dims[2] * dims[1],
+                                            sizeof(T) * dims[3] * dims[2],
+                                            sizeof(T) * dims[3],
+                                            sizeof(T));
+                break;
         }
         
-        return np::from_data(data, dt, shape, stride, python::object());
+        return np::from_data(data, dt, shape, stride, owner);
     }
 
 	class EMNumPy {
 	public:
 		/** Get an EMData image's pixel data as a numeric numpy array.
 		 * The array and EMData image share the same memory block.
+		 * Pass the Python object wrapping the image as owner so the array
+		 * keeps the image alive. Resizing the image still invalidates the array.
 		 */
-		static np::ndarray em2numpy(const EMData *const image);
+		static np::ndarray em2numpy(const EMData *const image, python::object owner = python::object());
 
 		/** Create an EMData image from a numeric numpy array.
-		 * Returned EMData object will contain copy of the numpy array data.
 		 * Note: The array size is (nz,ny,nx) corresponding to image (nx,ny,nz).
+		 * @param copy if false and the array is a writable, C-contiguous float32
+		 * array in native byte order, the image uses the array's memory and keeps
+		 * the array alive. Any other array is copied.
+		 */
+		static EMData* numpy2em(const np::ndarray& array, bool copy = true);
+
+		/** Copy a list of equally sized images into one numpy array, with the
+		 * image index as the first axis.
+		 * The copy runs in parallel with the GIL released.
+		 */
+		static np::ndarray em2numpy_stack(const python::list& images);
+
+		/** Get the whole buffer of an EMDataStack as one numpy array, with the
+		 * image index as the first axis. The array shares the stack's memory;
+		 * pass the stack's Python object as owner to keep the stack alive.
+		 */
+		static np::ndarray stack2numpy(const EMDataStack *const stack, python::object owner = python::object());
+
+		/** Split the first axis of a numpy array into a list of EMData images.
+		 * @param copy if false and the array qualifies as in numpy2em(), each
+		 * image uses its slice of the array's memory.
 		 */
-		static EMData* numpy2em(const np::ndarray& array);
+		static python::list numpy2em_stack(const np::ndarray& array, bool copy = true);
 
 		/** Create an EMData image from a numeric numpy array.
 		 * The destructor is necessary to set rdata data member of EMData to 0 (Null)
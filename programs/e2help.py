@@ -152,6 +152,7 @@ act as a filter on the names of the algorithms."""
 			 ["DM4 (Gatan)",   "dm4",      "Y", "N", "Y", "Y", "",      "N"],
 			 ["SER (FEI)",     "ser",      "Y", "N", "N", "Y", "",      "N"],
 			 ["EER (TF)",      "eer",      "Y", "N", "N", "Y", "N",     "N "],
+			 ["EMZ",           "emz",      "Y", "Y", "Y", "Y", "Y",     "Y"],
 			 ["EM",            "em",       "Y", "Y", "Y", "N", "",      "Y"],
 			 ["ICOS",          "icos",     "Y", "Y", "Y", "N", "",      "Y"],
 			 ["Imagic",        "img/hed",  "Y", "Y", "Y", "Y", "Y",     "Y"],
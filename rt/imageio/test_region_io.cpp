@@ -0,0 +1,151 @@
+#include "emdata.h"
+#include "io/imageio.h"
+
+#include <cstdio>
+#include <unistd.h>
+
+using namespace EMAN;
+
+#include <catch2/catch_test_macros.hpp>
+
+static const int NX = 37, NY = 29, NZ = 11;
+
+static vector<Region> test_regions()
+{
+	return {
+		Region(0, 0, 0, 8, 8, 8),
+		Region(5, 3, 2, 16, 16, 4),
+		Region(30, 20, 6, 16, 16, 8),		// hangs over the far edges
+		Region(-6, -4, -3, 12, 12, 12),		// hangs over the near edges
+		Region(5, 3, 2, 16, 16, 4),			// same as an earlier one
+		Region(0, 0, 0, NX, NY, NZ)
+	};
+}
+
+static bool inside(const Region & r, int x, int y, int z)
+{
+	int ix = (int)r.origin[0] + x, iy = (int)r.origin[1] + y, iz = (int)r.origin[2] + z;
+	return ix >= 0 && ix < NX && iy >= 0 && iy < NY && iz >= 0 && iz < NZ;
+}
+
+static void write_test_image(const string & fname, EMUtil::EMDataType dt)
+{
+	EMData img(NX, NY, NZ);
+	float * d = img.get_data();
+
+	for (size_t i = 0; i < (size_t)NX*NY*NZ; i++) d[i] = (float)(i % 251);
+
+	img.update();
+	img.write_image(fname, 0, EMUtil::IMAGE_MRC, false, 0, dt);
+}
+
+/* read_data_regions() must give the same pixels as one read_data() per region */
+static void compare_with_read_data(const string & fname)
+{
+	vector<Region> areas = test_regions();
+	vector<vector<float>> many(areas.size()), one(areas.size());
+	vector<float *> ptrs;
+
+	for (size_t i = 0; i < areas.size(); i++) {
+		size_t n = (size_t)areas[i].get_width()*areas[i].get_height()*areas[i].get_depth();
+		many[i].assign(n, 0.0f);
+		one[i].assign(n, 0.0f);
+		ptrs.push_back(many[i].data());
+	}
+
+	ImageIO * io = EMUtil::get_imageio(fname, ImageIO::READ_ONLY);
+	REQUIRE(io != 0);
+	REQUIRE(io->read_data_regions(ptrs, 0, areas) == 0);
+
+	for (size_t i = 0; i < areas.size(); i++) {
+		REQUIRE(io->read_data(one[i].data(), 0, &areas[i], true) == 0);
+	}
+
+	EMUtil::close_imageio(fname, io);
+
+	for (size_t i = 0; i < areas.size(); i++) {
+		const Region & r = areas[i];
+		int w = (int)r.get_width(), h = (int)r.get_height(), dz = (int)r.get_depth();
+
+		for (int z = 0; z < dz; z++) {
+			for (int y = 0; y < h; y++) {
+				for (int x = 0; x < w; x++) {
+					if (!inside(r, x, y, z)) continue;
+
+					size_t l = ((size_t)z*h + y)*w + x;
+					REQUIRE(many[i][l] == one[i][l]);
+				}
+			}
+		}
+	}
+}
+
+TEST_CASE("region reads of a float MRC return the file's pixels") {
+	string fname = "test_region_io_float.mrc";
+	write_test_image(fname, EMUtil::EM_FLOAT);
+
+	vector<Region> areas = test_regions();
+	vector<vector<float>> bufs(areas.size());
+	vector<float *> ptrs;
+
+	for (size_t i = 0; i < areas.size(); i++) {
+		bufs[i].resize((size_t)areas[i].get_width()*areas[i].get_height()*areas[i].get_depth());
+		ptrs.push_back(bufs[i].data());
+	}
+
+	ImageIO * io = EMUtil::get_imageio(fname, ImageIO::READ_ONLY);
+	REQUIRE(io->read_data_regions(ptrs, 0, areas) == 0);
+	EMUtil::close_imageio(fname, io);
+
+	for (size_t i = 0; i < areas.size(); i++) {
+		const Region & r = areas[i];
+		int w = (int)r.get_width(), h = (int)r.get_height(), dz = (int)r.get_depth();
+
+		for (int z = 0; z < dz; z++) {
+			for (int y = 0; y < h; y++) {
+				for (int x = 0; x < w; x++) {
+					if (!inside(r, x, y, z)) continue;
+
+					size_t l = ((size_t)z*h + y)*w + x;
+					size_t g = ((size_t)(r.origin[2] + z)*NY + (size_t)(r.origin[1] + y))*NX + (size_t)(r.origin[0] + x);
+					REQUIRE(bufs[i][l] == (float)(g % 251));
+				}
+			}
+		}
+	}
+
+	compare_with_read_data(fname);
+	remove(fname.c_str());
+}
+
+TEST_CASE("region reads of 8 and 16 bit MRC match read_data") {
+	for (auto dt : {EMUtil::EM_SHORT, EMUtil::EM_USHORT, EMUtil::EM_UCHAR}) {
+		string fname = "test_region_io_" + std::to_string((int)dt) + ".mrc";
+
+		write_test_image(fname, dt);
+		compare_with_read_data(fname);
+		remove(fname.c_str());
+	}
+}
+
+TEST_CASE("region reads past the end of a truncated file throw") {
+	string fname = "test_region_io_short.mrc";
+	write_test_image(fname, EMUtil::EM_FLOAT);
+
+	FILE * f = fopen(fname.c_str(), "r+b");
+	REQUIRE(f != 0);
+	fseek(f, 0, SEEK_END);
+	long len = ftell(f);
+	fclose(f);
+	REQUIRE(truncate(fname.c_str(), len - NX*NY*sizeof(float)) == 0);
+
+	vector<Region> areas = {Region(0, 0, NZ - 2, NX, NY, 2)};
+	vector<float> buf((size_t)NX*NY*2);
+	vector<float *> ptrs = {buf.data()};
+
+	ImageIO * io = EMUtil::get_imageio(fname, ImageIO::READ_ONLY);
+	REQUIRE_THROWS_AS(io->read_data_regions(ptrs, 0, areas), _ImageReadException);
+	EMUtil::close_imageio(fname, io);
+
+	remove(fname.c_str());
+}
@@ -183,3 +183,55 @@ TEST_CASE("renderbits can't be more than supported datatype bits") {
 	REQUIRE(a.rendered_dt(EMUtil::EM_COMPRESSED, {EMUtil::EM_USHORT, EMUtil::EM_SHORT}) == EMUtil::EM_USHORT);
 	REQUIRE(a.renderbits == 12);
 }
+
+TEMPLATE_TEST_CASE("threaded quantization matches scalar reference", "", unsigned char, unsigned short, short) {
+	size_t n = 1000003;
+	vector<float> data(n);
+	for (size_t i = 0; i < n; i++)
+		data[i] = 12.0f * sinf(i * 0.0137f) + 0.001f * (i % 997);
+
+	a.renderbits = std::is_same<TestType, unsigned char>::value ? 8 : 12;
+	a.rendermin = -9.5;
+	a.rendermax = 10.25;
+
+	float RMIN = std::is_unsigned<TestType>::value ? 0.0f : -(1 << (a.renderbits - 1));
+	float RMAX = std::is_unsigned<TestType>::value ? (1 << a.renderbits) - 1.0f : (1 << (a.renderbits - 1)) - 1;
+
+	vector<TestType> ref(n);
+	size_t refcount = 0;
+	for (size_t i = 0; i < n; i++) {
+		if (data[i] < a.rendermin)      { ref[i] = TestType(RMIN); refcount++; }
+		else if (data[i] > a.rendermax) { ref[i] = TestType(RMAX); refcount++; }
+		else ref[i] = (TestType)roundf((data[i] - a.rendermin) / (a.rendermax - a.rendermin) * (RMAX - RMIN) + RMIN);
+	}
+
+	for (int nt : {1, 3, 8}) {
+		EMThreads::set_num_threads(nt);
+		auto [vi, count] = a.getRenderedDataAndRendertrunc<TestType>(data.data(), data.size());
+		REQUIRE(count == refcount);
+		REQUIRE(vi == ref);
+	}
+	EMThreads::set_num_threads(0);
+}
+
+TEST_CASE("render limits do not depend on the thread count") {
+	size_t nx = 301, ny = 257, nz = 7;
+	vector<float> data(nx*ny*nz);
+	for (size_t i = 0; i < data.size(); i++)
+		data[i] = 3.7f * sinf(i * 0.0213f) + 0.01f * (i % 89) - 1.3f;
+
+	float rmin0 = 0, rmax0 = 0;
+	for (int nt : {1, 2, 3, 8}) {
+		EMThreads::set_num_threads(nt);
+		float rmin = 0, rmax = 0;
+		int bits = 8;
+		EMUtil::getRenderMinMax(data.data(), nx, ny, rmin, rmax, bits, nz);
+		if (nt == 1) {
+			rmin0 = rmin;
+			rmax0 = rmax;
+		}
+		REQUIRE(rmin == rmin0);
+		REQUIRE(rmax == rmax0);
+	}
+	EMThreads::set_num_threads(0);
+}
@@ -79,6 +79,24 @@ class TestAverager(unittest.TestCase):
 
 	test_AbsMaxMinAverager.broken = True
 
+	def test_ImageAverager_stack(self):
+		"""test mean averager on an EMDataStack ............."""
+		imgs = []
+		for i in range(5):
+			e = EMData(16,16)
+			e.process_inplace('testimage.noise.uniform.rand')
+			imgs.append(e)
+		stack = EMDataStack.from_images(imgs)
+
+		avgr = Averagers.get("mean")
+		avgr.add_image_list(imgs)
+		ref = avgr.finish()
+
+		avgr2 = Averagers.get("mean")
+		avgr2.add_image_stack(stack)
+		avg = avgr2.finish()
+		self.assertEqual(avg.get_data_string(), ref.get_data_string())
+
 def test_main():
     p = OptionParser()
     p.add_option('--t', action='store_true', help='test exception', default=False )
@@ -40,6 +40,7 @@ import sys
 import platform
 import math
 import os
+import numpy
 from optparse import OptionParser
 from testlib import exception_type
 
@@ -164,7 +165,46 @@ class TestEMData(unittest.TestCase):
         self.assertEqual(e.equal(e2),True)
 
         self.assertEqual(e.get_attr_dict(), e2.get_attr_dict())
-                    
+
+    def test_half_storage(self):
+        """test set_half_storage() function ................."""
+        e = EMData()
+        e.set_size(32,32,32)
+        e.process_inplace("testimage.noise.gauss")
+        ref = e.copy()
+
+        for mode, tol in ((EMData.HalfStorage.HALF_FLOAT16, 1.0e-3), (EMData.HalfStorage.HALF_BFLOAT16, 8.0e-3)):
+            h = ref.copy()
+            h.set_half_storage(mode)
+            self.assertEqual(h.get_half_storage(), mode)
+            h2 = h.copy()
+            self.assertEqual(h2.get_half_storage(), mode)
+
+            # kernels read the half precision argument without expanding it
+            s = ref.copy()
+            s.sub(h)
+            self.assertEqual(h.get_half_storage(), mode)
+            self.assertTrue(s["maximum"] < tol*4 and s["minimum"] > -tol*4)
+            self.assertAlmostEqual(ref.dot(h)/ref.dot(ref), 1.0, 2)
+            f = h.do_fft()
+            self.assertEqual(h.get_half_storage(), mode)
+            self.assertTrue(f.is_complex())
+
+            # statistics are computed from the half precision data
+            mn, sg = h["minimum"], h["sigma"]
+            h.update()
+            self.assertEqual(h["minimum"], mn)
+            self.assertAlmostEqual(h["sigma"], sg, 5)
+            self.assertAlmostEqual(h["skewness"], ref["skewness"], 2)
+            self.assertEqual(h.get_half_storage(), mode)
+
+            # pixel access converts back to float
+            self.assertAlmostEqual(h[5,6,7], ref[5,6,7], delta=abs(ref[5,6,7])*tol+1.0e-4)
+            self.assertEqual(h.get_half_storage(), EMData.HalfStorage.HALF_NONE)
+
+        c = ref.do_fft()
+        self.assertRaises(RuntimeError, c.set_half_storage, EMData.HalfStorage.HALF_FLOAT16)
+
     def test_get_clip1(self):
         """test get_clip1() function ........................"""
         e = EMData()
@@ -3513,6 +3553,188 @@ class TestEMData(unittest.TestCase):
         self.assertAlmostEqual(img.get_attr('origin_y'), 2.0, 3)
         self.assertAlmostEqual(img.get_attr('origin_z'), 3.0, 3)
 
+    def test_threaded_calls(self):
+        """test process/cmp/do_fft from several threads ......"""
+        import threading
+        sizes = [32, 48, 64, 40]
+        imgs = []
+        for n in sizes:
+            e = EMData()
+            e.set_size(n,n,1)
+            e.process_inplace('testimage.noise.gauss')
+            imgs.append(e)
+
+        def work(e):
+            a = e.process('normalize.circlemean')
+            f = a.do_fft()
+            f.do_ift_inplace()
+            return (a.get_attr('mean'), f.cmp('ccc', a), a.cmp('sqeuclidean', e))
+
+        serial = [work(e) for e in imgs]
+        threaded = [None]*len(imgs)
+        def run(i):
+            for rep in range(5):
+                threaded[i] = work(imgs[i])
+        threads = [threading.Thread(target=run, args=(i,)) for i in range(len(imgs))]
+        for t in threads: t.start()
+        for t in threads: t.join()
+        for s, t in zip(serial, threaded):
+            for x, y in zip(s, t):
+                self.assertAlmostEqual(x, y, 5)
+
+    def test_python_processor_released(self):
+        """test a Python processor run through process_inplace"""
+        class Double(Processor):
+            def process_inplace(self, img):
+                img.mult(2.0)
+            def get_name(self):
+                return "double"
+            def get_desc(self):
+                return "multiply by two"
+
+        e = EMData()
+        e.set_size(8,8,1)
+        e.to_one()
+        e.process_inplace(Double())
+        self.assertAlmostEqual(e.get_value_at(3,3), 2.0, 5)
+
+    def test_pickle_out_of_band(self):
+        """test protocol 5 pickling with out of band data ..."""
+        import pickle
+        e = EMData(16,12,3)
+        e.process_inplace('testimage.noise.uniform.rand')
+        e.set_attr('apix_x', 2.5)
+        buffers = []
+        s = pickle.dumps(e, protocol=5, buffer_callback=buffers.append)
+        self.assertEqual(len(buffers), 1)
+        self.assertTrue(len(s) < 16*12*3*4)
+        e2 = pickle.loads(s, buffers=buffers)
+        self.assertEqual((e2.get_xsize(),e2.get_ysize(),e2.get_zsize()), (16,12,3))
+        self.assertAlmostEqual(e2.get_attr('apix_x'), 2.5, 5)
+        self.assertEqual(e2.get_data_string(), e.get_data_string())
+        e3 = pickle.loads(pickle.dumps(e, protocol=2))
+        self.assertEqual(e3.get_data_string(), e.get_data_string())
+
+    def test_emdatastack(self):
+        """test EMDataStack and its image views ............"""
+        n = 4
+        imgs = [test_image(0, size=(16,12)) for i in range(n)]
+        for i,e in enumerate(imgs):
+            e.mult(float(i+1))
+            e.set_attr("apix_x", 2.0)
+        stack = EMDataStack.from_images(imgs)
+        self.assertEqual(len(stack), n)
+        self.assertEqual((stack.get_xsize(),stack.get_ysize(),stack.get_zsize()), (16,12,1))
+
+        v = stack.get_image(2)
+        self.assertEqual(v.get_data_string(), imgs[2].get_data_string())
+        self.assertAlmostEqual(v["apix_x"], 2.0, 5)
+        v.set_value_at(3,3,-7.0)
+        v2 = stack.get_image(2)
+        self.assertAlmostEqual(v2.get_value_at(3,3), -7.0, 5)
+
+        del stack			# views keep the buffer alive
+        self.assertAlmostEqual(v.get_value_at(3,3), -7.0, 5)
+
+        filename = "test_emdatastack.hdf"
+        for i,e in enumerate(imgs): e.write_image(filename, i)
+        stack = EMDataStack.read_images(filename, [1,3])
+        self.assertEqual(len(stack), 2)
+        self.assertEqual(stack[1].get_data_string(), imgs[3].get_data_string())
+        self.assertEqual(stack.get_header(0)["source_n"], 1)
+        testlib.safe_unlink(filename)
+
+    def test_volume_summary(self):
+        """test the cached VolumeSummary brick pyramid ......"""
+        e = test_image_3d(1, size=(40,36,20))
+        s = e.get_volume_summary(8)
+        self.assertEqual(s.get_brick_size(), 8)
+        self.assertEqual(s.get_level_size(0), (5,5,3))
+        self.assertEqual(s.get_level_size(s.get_num_levels()-1), (1,1,1))
+
+        a = e.numpy()
+        mn, mx, mean, sigma, n = s.get_brick(0, 4, 1, 2)
+        block = a[16:20,8:16,32:40]
+        self.assertEqual(n, block.size)
+        self.assertAlmostEqual(mn, float(block.min()), 5)
+        self.assertAlmostEqual(mx, float(block.max()), 5)
+        self.assertAlmostEqual(mean, float(block.mean()), 4)
+        self.assertAlmostEqual(sigma, float(block.std()), 4)
+
+        mn, mx, mean, sigma, n = s.get_brick(s.get_num_levels()-1, 0, 0, 0)
+        self.assertEqual(n, a.size)
+        self.assertAlmostEqual(mean, float(a.mean()), 4)
+        self.assertAlmostEqual(mx, float(a.max()), 5)
+
+        # bounds contain the true range of any box
+        lo, hi = s.get_range(3, 5, 2, 30, 17, 11)
+        box = a[2:12,5:18,3:31]
+        self.assertTrue(lo <= box.min() and hi >= box.max())
+        self.assertEqual(s.get_range(50, 0, 0, 60, 5, 5), None)
+
+        thr = float(a.mean() + a.std())
+        bs = s.get_level_size(0)
+        for i in s.get_bricks_above(thr):
+            self.assertTrue(s.get_brick(0, i%bs[0], i//bs[0]%bs[1], i//bs[0]//bs[1])[1] > thr)
+        r = s.get_bounding_region(thr)
+        z, y, x = numpy.nonzero(a > thr)
+        self.assertTrue(r.x_origin() <= x.min() and r.x_origin()+r.get_width() > x.max())
+        self.assertTrue(r.z_origin() <= z.min() and r.z_origin()+r.get_depth() > z.max())
+        self.assertEqual(s.get_bounding_region(float(a.max())).get_width(), 0)
+
+        # summaries of other brick sizes are cached alongside
+        s16 = e.get_volume_summary(16)
+        self.assertEqual(s16.get_brick_size(), 16)
+        self.assertEqual(s16.get_level_size(0), (3,3,2))
+        self.assertEqual(e.get_volume_summary(8).get_brick(0, 4, 1, 2), s.get_brick(0, 4, 1, 2))
+
+        # the cached summary follows changes to the image
+        bmax = float(block.max())
+        e.mult(2.0)
+        self.assertAlmostEqual(e.get_volume_summary(8).get_brick(0, 4, 1, 2)[1], 2.0*bmax, 4)
+
+    def test_shared_memory(self):
+        """test moving image data to shared memory ........."""
+        if platform.system() == 'Windows':
+            return
+        e = EMData(8,8,2)
+        e.process_inplace('testimage.noise.uniform.rand')
+        data = e.get_data_string()
+        name = e.to_shared()
+        self.assertEqual(e.get_shared_name(), name)
+        self.assertEqual(e.get_data_string(), data)
+
+        # a default attach is copy-on-write
+        e2 = EMAN2.emdata_from_shared(e._pickle_header(), name)
+        self.assertEqual(e2.get_data_string(), data)
+        self.assertEqual(e2.get_shared_name(), "")
+        e2.set_value_at(1,1,1,42.0)
+        self.assertAlmostEqual(e2.get_value_at(1,1,1), 42.0, 5)
+        self.assertEqual(e.get_data_string(), data)
+
+        # writes through a writable attach reach the creator
+        e3 = EMAN2.emdata_from_shared(e._pickle_header(), name, True)
+        self.assertEqual(e3.get_shared_name(), name)
+        e3.set_value_at(1,1,1,42.0)
+        self.assertAlmostEqual(e.get_value_at(1,1,1), 42.0, 5)
+
+        e.set_size(8,8,2)
+        self.assertEqual(e.get_shared_name(), "")
+
+        # copy_to_shared leaves the original image alone
+        f = EMData(8,8,2)
+        f.process_inplace('testimage.noise.uniform.rand')
+        data = f.get_data_string()
+        c = f.copy_to_shared()
+        self.assertEqual(f.get_shared_name(), "")
+        self.assertNotEqual(c.get_shared_name(), "")
+        f2 = EMAN2.emdata_from_shared(f._pickle_header(), c.get_shared_name())
+        self.assertEqual(f2.get_data_string(), data)
+        f2.mult(2.0)
+        self.assertNotEqual(f2.get_data_string(), data)
+        self.assertEqual(f.get_data_string(), data)
+        self.assertEqual(c.get_data_string(), data)
+
 def test_main():
 	p = OptionParser()
 	p.add_option('--t', action='store_true', help='test exception', default=False )
@@ -689,6 +689,80 @@ class TestHdfIO(ImageIOTester):
 			self.assertEqual(1, f[i])
 		testlib.safe_unlink(file)
 
+class TestEmzIO(ImageIOTester):
+	"""emz file IO test"""
+	def test_read_write_emz(self):
+		"""test write-read emz .............................."""
+		self.do_test_read_write("emz")
+
+	def test_emz_compressed_stack(self):
+		"""test compressed emz stack and region read ........"""
+		file = 'testimage.emz'
+		imgs = []
+		for i in range(3):
+			e = EMData(64, 48)
+			e.process_inplace("testimage.noise.uniform.rand")
+			e.set_attr("render_bits", 12)
+			e.set_attr("ptcl_id", i)
+			e.write_image(file, -1, EMUtil.ImageType.IMAGE_EMZ, False, None, EMUtil.EMDataType.EM_COMPRESSED)
+			imgs.append(e)
+		try:
+			self.assertEqual(EMUtil.get_image_count(file), 3)
+			for i in range(3):
+				f = EMData(file, i)
+				self.assertEqual(f.get_attr("ptcl_id"), i)
+				self.assertEqual(f.get_attr("stored_renderbits"), 12)
+				tol = (imgs[i]["maximum"] - imgs[i]["minimum"]) / 4095.0
+				for j in range(64 * 48):
+					self.assertAlmostEqual(f[j], imgs[i][j], delta=tol)
+
+			r = EMData()
+			r.read_image(file, 1, False, Region(10, 5, 20, 30))
+			self.assertEqual(r.get_xsize(), 20)
+			self.assertEqual(r.get_ysize(), 30)
+			full = EMData(file, 1)
+			for y in range(30):
+				for x in range(20):
+					self.assertEqual(r.get_value_at(x, y), full.get_value_at(x + 10, y + 5))
+		finally:
+			testlib.safe_unlink(file)
+
+	def test_emz_header_update(self):
+		"""test header only rewrite of emz .................."""
+		file = 'testimage.emz'
+		e = EMData(16, 16)
+		e.process_inplace("testimage.noise.uniform.rand")
+		e.write_image(file, 0)
+		e.write_image(file, 1)
+		try:
+			e.set_attr("tag", "updated")
+			e.write_image(file, 0, EMUtil.ImageType.IMAGE_EMZ, True)
+			f = EMData(file, 0)
+			self.assertEqual(f.get_attr("tag"), "updated")
+			self.assertEqual(e.equal(f), True)
+			self.assertEqual(EMUtil.get_image_count(file), 2)
+		finally:
+			testlib.safe_unlink(file)
+
+	def test_emz_gap(self):
+		"""test emz images skipped over are blank ..........."""
+		file = 'testimage.emz'
+		e = EMData(16, 16)
+		e.process_inplace("testimage.noise.uniform.rand")
+		e.set_attr("tag", "written")
+		e.write_image(file, 0)
+		e.write_image(file, 3)
+		try:
+			self.assertEqual(EMUtil.get_image_count(file), 4)
+			for i in (1, 2):
+				f = EMData(file, i)
+				self.assertEqual(f.get_xsize(), 16)
+				self.assertEqual(f.has_attr("tag"), False)
+				self.assertEqual(f["maximum"], 0.0)
+			self.assertEqual(EMData(file, 3).get_attr("tag"), "written")
+		finally:
+			testlib.safe_unlink(file)
+
 class TestMrcIO(ImageIOTester):
 	"""mrc file IO test"""
 	def test_negative_image_index(self):
@@ -1491,6 +1565,9 @@ def test_main():
 	
 	suite14 = unittest.TestLoader().loadTestsFromTestCase(TestDF3IO)	
 	unittest.TextTestRunner(verbosity=2).run(suite14) 
+
+	suite15 = unittest.TestLoader().loadTestsFromTestCase(TestEmzIO)
+	unittest.TextTestRunner(verbosity=2).run(suite15)
 	
 if __name__ == '__main__':
 	test_main()
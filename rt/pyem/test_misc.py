@@ -34,6 +34,9 @@ from EMAN2 import *
 import unittest
 import testlib
 import sys
+import random
+import math
+from array import array
 from optparse import OptionParser
 from testlib import exception_type
 
@@ -152,6 +155,353 @@ class TestRegion(unittest.TestCase):
         e8 = Region(e7)
         self.assertEqual(e8.get_ndim(), 3)
         
+class TestBoxingTools(unittest.TestCase):
+    """tests for batch particle extraction in BoxingTools"""
+
+    def test_extract_boxes(self):
+        """test extract_boxes matches get_clip ..............."""
+        img = test_image(0, (128, 128))
+        centers = [(10, 20, 0), (64, 64, 0), (120, 5, 0), (40, 100, 0)]
+        boxes = BoxingTools.extract_boxes(img, centers, 32)
+        self.assertEqual(len(boxes), len(centers))
+        for (x, y, z), b in zip(centers, boxes):
+            clip = img.get_clip(Region(x - 16, y - 16, 32, 32))
+            self.assertAlmostEqual(b.cmp("sqeuclidean", clip), 0.0, places=6)
+            self.assertEqual(b["ptcl_source_coord"], [x, y])
+
+    def test_extract_boxes_to_file(self):
+        """test extract_boxes_to_file on a volume ..........."""
+        vol = test_image_3d(0, (64, 64, 64))
+        infile = "test_extract_boxes_in.hdf"
+        outfile = "test_extract_boxes_out.hdf"
+        vol.write_image(infile)
+        centers = [(32, 32, 50), (10, 12, 8), (60, 30, 30)]
+        n = BoxingTools.extract_boxes_to_file(infile, 0, centers, 16, outfile, {"batchmem": 0})
+        self.assertEqual(n, len(centers))
+        for i, (x, y, z) in enumerate(centers):
+            b = EMData(outfile, i)
+            clip = vol.get_clip(Region(x - 8, y - 8, z - 8, 16, 16, 16))
+            self.assertAlmostEqual(b.cmp("sqeuclidean", clip), 0.0, places=6)
+        testlib.safe_unlink(infile)
+        testlib.safe_unlink(outfile)
+
+    def test_extract_boxes_to_file_mrc(self):
+        """test extract_boxes_to_file matches extract_boxes ."""
+        img = test_image(0, (128, 96))
+        infile = "test_extract_boxes_in.mrc"
+        outfile = "test_extract_boxes_out.hdf"
+        img.write_image(infile)
+        img = EMData(infile, 0)
+        centers = [(64, 48, 0), (3, 90, 0), (125, 2, 0), (64, 48, 0), (40, 20, 0)]
+        params = {"normproc": "normalize.edgemean", "invert": True, "fill": 1.5}
+        boxes = BoxingTools.extract_boxes(img, centers, 24, params)
+        params["batchmem"] = 0
+        n = BoxingTools.extract_boxes_to_file(infile, 0, centers, 24, outfile, params)
+        self.assertEqual(n, len(centers))
+        for i, b in enumerate(boxes):
+            f = EMData(outfile, i)
+            self.assertAlmostEqual(f.cmp("sqeuclidean", b), 0.0, places=6)
+            self.assertEqual(f["ptcl_source_coord"], list(centers[i][:2]))
+        testlib.safe_unlink(infile)
+        testlib.safe_unlink(outfile)
+
+    def test_extract_boxes_to_file_tiff(self):
+        """test extract_boxes_to_file on tiff matches mrc ..."""
+        tiffile = "test_extract_boxes_in.tiff"
+        mrcfile = "test_extract_boxes_in.mrc"
+        tifout = "test_extract_boxes_tiff.hdf"
+        mrcout = "test_extract_boxes_mrc.hdf"
+        test_image(0, (128, 96)).write_image(tiffile)
+        img = EMData(tiffile, 0)
+        img.write_image(mrcfile)
+        # boxes overhanging every edge and corner
+        centers = [(64, 48, 0), (2, 2, 0), (126, 94, 0), (0, 50, 0), (70, 95, 0), (127, 0, 0)]
+        params = {"fill": 0.0, "batchmem": 0}
+        n = BoxingTools.extract_boxes_to_file(tiffile, 0, centers, 32, tifout, params)
+        self.assertEqual(n, len(centers))
+        n = BoxingTools.extract_boxes_to_file(mrcfile, 0, centers, 32, mrcout, params)
+        self.assertEqual(n, len(centers))
+        for i in range(len(centers)):
+            t = EMData(tifout, i)
+            m = EMData(mrcout, i)
+            self.assertEqual(t.get_data_string(), m.get_data_string())
+        for f in (tiffile, mrcfile, tifout, mrcout):
+            testlib.safe_unlink(f)
+
+class TestKMeans(unittest.TestCase):
+    """tests for the kmeans analyzer"""
+
+    def run_kmeans(self, imgs, params):
+        an = Analyzers.get("kmeans", params)
+        an.insert_images_list(imgs)
+        return an.analyze()
+
+    def test_kmeans_clusters(self):
+        """test kmeans separates well spaced clusters ......"""
+        imgs = []
+        for i in range(60):
+            e = EMData(16, 16)
+            e.process_inplace("testimage.noise.gauss", {"sigma": 1.0})
+            e.add(10.0 * (i % 3))
+            imgs.append(e)
+        for seedmode in (0, 2):
+            centers = self.run_kmeans(imgs, {"ncls": 3, "seedmode": seedmode, "minchange": 1})
+            self.assertEqual(len(centers), 3)
+            for i in range(3):
+                members = [im["class_id"] for im in imgs[i::3]]
+                self.assertEqual(len(set(members)), 1)
+                c = centers[members[0]]
+                self.assertEqual(c["ptcl_repr"], 20)
+                self.assertAlmostEqual(c["mean"], 10.0 * i, delta=0.5)
+
+    def test_kmeans_sigmamean(self):
+        """test kmeans calcsigmamean ........................"""
+        imgs = []
+        for i in range(40):
+            e = EMData(8, 8)
+            e.process_inplace("testimage.noise.gauss", {"sigma": 2.0})
+            e.add(20.0 * (i % 2))
+            imgs.append(e)
+        centers = self.run_kmeans(imgs, {"ncls": 2, "seedmode": 2, "calcsigmamean": 1})
+        self.assertEqual(len(centers), 4)
+        for i in range(2):
+            # std. dev. of the mean of 20 values with sigma 2
+            self.assertAlmostEqual(centers[i + 2]["mean"], 2.0 / 20 ** 0.5, delta=0.15)
+
+class TestSVD(unittest.TestCase):
+    """tests for the approximate modes of the svd_gsl analyzer"""
+
+    def test_svd_modes(self):
+        """test randomized and incremental svd ............."""
+        patterns = [test_image(0, (24, 24)), test_image(1, (24, 24)), test_image(2, (24, 24))]
+        imgs = []
+        for i in range(150):
+            e = EMData(24, 24)
+            e.process_inplace("testimage.noise.gauss", {"sigma": 0.01})
+            for j, p in enumerate(patterns):
+                e.add(p * (((i * (j + 3)) % 7 - 3) / (j + 1.0)))
+            imgs.append(e)
+        mask = EMData(24, 24)
+        mask.to_one()
+
+        vals = {}
+        for mode in ("full", "randomized", "incremental"):
+            an = Analyzers.get("svd_gsl", {"mask": mask, "nvec": 3, "nimg": len(imgs), "mode": mode, "chunk": 40})
+            for e in imgs:
+                an.insert_image(e)
+            vecs = an.analyze()
+            self.assertEqual(len(vecs), 3)
+            vals[mode] = [v["eigval"] for v in vecs]
+            if mode != "full":
+                for v, f in zip(vecs, full):
+                    self.assertAlmostEqual(abs(v.cmp("dot", f, {"normalize": 1, "negative": 0})), 1.0, places=3)
+            else:
+                full = vecs
+        for mode in ("randomized", "incremental"):
+            for a, b in zip(vals[mode], vals["full"]):
+                self.assertAlmostEqual(a / b, 1.0, places=3)
+
+class TestPointArray(unittest.TestCase):
+    """tests for Gaussian projections of a PointArray"""
+
+    def make_points(self, n, seed=1):
+        """n points inside a 5 A cube around the origin, as x,y,z,amplitude"""
+        rng = random.Random(seed)
+        vals = []
+        for i in range(n):
+            vals += [rng.uniform(-5, 5), rng.uniform(-5, 5), rng.uniform(-5, 5), rng.uniform(0.5, 2.0)]
+        pa = PointArray()
+        pa.set_from(vals)
+        return pa, vals
+
+    def make_xforms(self):
+        return [Transform({"type": "eman", "az": 0, "alt": 0, "phi": 0}),
+                Transform({"type": "eman", "az": 30, "alt": 70, "phi": 10}),
+                Transform({"type": "eman", "az": 115, "alt": 25, "phi": 250})]
+
+    def test_projections_by_summation(self):
+        """test projections_by_summation ..................."""
+        pa, vals = self.make_points(40)
+        xforms = self.make_xforms()
+        projs = pa.projections_by_summation(xforms, 32, 1.5, 6.0)
+        self.assertEqual(len(projs), len(xforms))
+        for xf, p in zip(xforms, projs):
+            pc = PointArray()
+            pc.set_from(vals)
+            pc.transform(xf)
+            ref = pc.projection_by_summation(32, 1.5, 6.0)
+            self.assertEqual(p.get_data_string(), ref.get_data_string())
+
+        # the splatting order does not depend on the thread count
+        try:
+            EMThreads.set_num_threads(1)
+            one = pa.projections_by_summation(xforms, 32, 1.5, 6.0)
+            EMThreads.set_num_threads(4)
+            four = pa.projections_by_summation(xforms, 32, 1.5, 6.0)
+        finally:
+            EMThreads.set_num_threads(0)
+        for a, b in zip(one, four):
+            self.assertEqual(a.get_data_string(), b.get_data_string())
+
+    def test_projections_by_fourier(self):
+        """test projections_by_fourier ....................."""
+        pa, vals = self.make_points(20)
+        xforms = self.make_xforms()
+        # res is wide enough that the Gaussians are nearly band limited at this apix
+        for n in (32, 33):
+            ffts = pa.projections_by_fourier(xforms, n, 1.5, 9.0)
+            reals = pa.projections_by_summation(xforms, n, 1.5, 9.0)
+            for f, r in zip(ffts, reals):
+                self.assertTrue(f.is_complex())
+                self.assertEqual(f.is_fftodd(), n % 2 == 1)
+                ift = f.do_ift()
+                self.assertEqual((ift.get_xsize(), ift.get_ysize()), (n, n))
+                a = array("f", ift.get_data_string())
+                b = array("f", r.get_data_string())
+                scale = max(abs(v) for v in b)
+                self.assertTrue(max(abs(x - y) for x, y in zip(a, b)) < 0.01 * scale)
+
+    def fourier_loss(self, vals, xforms, targets, n, apix, res):
+        """0.5*|F-target|^2 over the full Hermitian plane"""
+        pa = PointArray()
+        pa.set_from(vals)
+        nxc = n // 2 + 1
+        loss = 0.0
+        for f, t in zip(pa.projections_by_fourier(xforms, n, apix, res), targets):
+            a = array("f", f.get_data_string())
+            b = array("f", t.get_data_string())
+            for y in range(n):
+                for x in range(nxc):
+                    w = 1.0 if x == 0 or (n % 2 == 0 and x == n // 2) else 2.0
+                    i = 2 * (y * nxc + x)
+                    loss += 0.5 * w * ((a[i] - b[i]) ** 2 + (a[i + 1] - b[i + 1]) ** 2)
+        return loss
+
+    def test_projections_by_fourier_gradient(self):
+        """test projections_by_fourier_gradient ............"""
+        pa, vals = self.make_points(20)
+        xforms = self.make_xforms()
+        apix, res, h = 1.5, 6.0, 0.03
+        for n in (32, 33):
+            ffts = pa.projections_by_fourier(xforms, n, apix, res)
+            targets = []
+            grads = []
+            for f in ffts:
+                t = f.copy()
+                t.mult(0.7)
+                targets.append(t)
+                g = f.copy()
+                g.mult(0.3)		# F - target
+                grads.append(g)
+            grad = pa.projections_by_fourier_gradient(xforms, grads, apix, res)
+            self.assertEqual(len(grad), len(vals))
+            scale = max(abs(v) for v in grad)
+            for i in (0, 7, 19):
+                for c in range(4):
+                    k = 4 * i + c
+                    p = list(vals)
+                    p[k] = vals[k] + h
+                    lp = self.fourier_loss(p, xforms, targets, n, apix, res)
+                    p[k] = vals[k] - h
+                    lm = self.fourier_loss(p, xforms, targets, n, apix, res)
+                    self.assertAlmostEqual((lp - lm) / (2 * h), grad[k], delta=1e-3 * scale)
+
+    def ring_points(self):
+        """a noisy closed chain of 40 points around the centre of a 32^3 map"""
+        rng = random.Random(3)
+        vals = []
+        for i in range(40):
+            t = 2 * math.pi * i / 40
+            vals += [16 + 12 * math.cos(t) + rng.gauss(0, 0.6), 16 + 12 * math.sin(t) + rng.gauss(0, 0.6),
+                     16 + 3 * math.sin(5 * t) + rng.gauss(0, 0.6), 1.0]
+        return vals
+
+    def test_sim_potential_gradient(self):
+        """test sim_potential_gradient ....................."""
+        vals = self.ring_points()
+        pa = PointArray()
+        pa.set_from(vals)
+        pa.sim_set_pot_parms(3.8, 1.0, 0.7, 0.9, 0.5, 0.0, None, 3.0, 2.0)
+        pot, grad = pa.sim_potential_gradient()
+        self.assertEqual(len(grad), 40)
+
+        h = 1e-4
+        for i in range(40):
+            for c in range(3):
+                p = list(vals)
+                p[4 * i + c] = vals[4 * i + c] + h
+                pa.set_from(p)
+                pp = pa.sim_potential_gradient()[0]
+                p[4 * i + c] = vals[4 * i + c] - h
+                pa.set_from(p)
+                pm = pa.sim_potential_gradient()[0]
+                fd = (pp - pm) / (2 * h)
+                self.assertAlmostEqual(fd, grad[i][c], delta=1e-3 * max(1.0, abs(fd)))
+
+    def test_sim_potential_gradient_map(self):
+        """test sim_potential_gradient follows map changes ."""
+        pa = PointArray()
+        pa.set_from(self.ring_points())
+        m = EMData(32, 32, 32)
+        m.process_inplace("testimage.gaussian", {"sigma": 8.0})
+        m.set_attr("apix_x", 1.0)
+        pa.sim_set_pot_parms(3.8, 0.0, 0.0, 0.9, 0.0, 1.0, m, 3.0, 0.0)
+        pot1, grad1 = pa.sim_potential_gradient()
+
+        # changing the map in place must rebuild the cached gradient maps
+        m.mult(2.0)
+        pot2, grad2 = pa.sim_potential_gradient()
+        self.assertAlmostEqual(pot2, 2.0 * pot1, delta=1e-5 * abs(pot1))
+        scale = max(abs(g[c]) for g in grad1 for c in range(3))
+        self.assertTrue(scale > 0)
+        for g1, g2 in zip(grad1, grad2):
+            for c in range(3):
+                self.assertAlmostEqual(g2[c], 2.0 * g1[c], delta=1e-5 * scale)
+
+class TestMarchingCubes(unittest.TestCase):
+    """tests for the brick cache of the marching cubes isosurface"""
+
+    def setUp(self):
+        try:
+            MarchingCubes
+        except NameError:
+            self.skipTest("EMAN2 was built without OpenGL")
+        # one Gaussian blob, so every isosurface is a closed sphere spanning several bricks
+        self.vol = EMData(64, 64, 64)
+        self.vol.process_inplace("testimage.gaussian", {"sigma": 10.0})
+        self.top = self.vol["maximum"]
+
+    def counts(self, vol, frac):
+        mc = MarchingCubes(vol)
+        mc.set_surface_value(frac * self.top)
+        return mc.get_surface_counts()
+
+    def test_surface_cache(self):
+        """test isosurface threshold round trip and edits ..."""
+        mc = MarchingCubes(self.vol)
+        first = {}
+        for frac in (0.5, 0.2, 0.8, 0.5, 0.2):
+            mc.set_surface_value(frac * self.top)
+            c = mc.get_surface_counts()
+            self.assertTrue(c[0] > 0 and c[1] > 0)
+            self.assertEqual(c, first.setdefault(frac, c))
+            self.assertEqual(c, self.counts(self.vol.copy(), frac))
+
+        # editing the data in place must not reuse bricks marched before the edit,
+        # so the counts follow the new data and not the stale ones
+        self.vol.mult(2.0)
+        for frac in (0.2, 0.5, 0.8):
+            mc.set_surface_value(frac * self.top)
+            c = mc.get_surface_counts()
+            self.assertEqual(c, self.counts(self.vol.copy(), frac))
+            self.assertNotEqual(c, first[frac])
+
+        # the same at an unchanged threshold, which used to skip the rebuild entirely
+        self.vol.process_inplace("testimage.gaussian", {"sigma": 6.0})
+        c = mc.get_surface_counts()
+        self.assertEqual(c, self.counts(self.vol.copy(), 0.8))
+        self.assertNotEqual(c, first[0.8])
+
 
 def test_main():
     p = OptionParser()
@@ -165,10 +515,20 @@ def test_main():
     suite2 = unittest.TestLoader().loadTestsFromTestCase(TestBoost)
     suite3 = unittest.TestLoader().loadTestsFromTestCase(TestException)
     suite4 = unittest.TestLoader().loadTestsFromTestCase(TestRegion)
+    suite5 = unittest.TestLoader().loadTestsFromTestCase(TestBoxingTools)
+    suite6 = unittest.TestLoader().loadTestsFromTestCase(TestKMeans)
+    suite7 = unittest.TestLoader().loadTestsFromTestCase(TestSVD)
+    suite8 = unittest.TestLoader().loadTestsFromTestCase(TestPointArray)
+    suite9 = unittest.TestLoader().loadTestsFromTestCase(TestMarchingCubes)
     unittest.TextTestRunner(verbosity=2).run(suite1)
     unittest.TextTestRunner(verbosity=2).run(suite2)
     unittest.TextTestRunner(verbosity=2).run(suite3)
     unittest.TextTestRunner(verbosity=2).run(suite4)
+    unittest.TextTestRunner(verbosity=2).run(suite5)
+    unittest.TextTestRunner(verbosity=2).run(suite6)
+    unittest.TextTestRunner(verbosity=2).run(suite7)
+    unittest.TextTestRunner(verbosity=2).run(suite8)
+    unittest.TextTestRunner(verbosity=2).run(suite9)
 
 if __name__ == '__main__':
     test_main()
@@ -173,7 +173,52 @@ class TestReconstructor(unittest.TestCase):
 		r.insert_slice(e2, Transform({'type':'eman', 'az':0.0, 'alt':0.0, 'phi':0.0}))
 		r.insert_slice(e3, Transform({'type':'eman', 'az':0.0, 'alt':0.0, 'phi':0.0}))
 		result = r.finish()
-	
+
+	def nn4_insert(self, slices, nthreads):
+		"""insert slices into nn4 with nthreads EMThreads, returns (fftvol, weight)"""
+		fftvol = EMData()
+		weight = EMData()
+		saved = EMThreads.get_num_threads()
+		EMThreads.set_num_threads(nthreads)
+		try:
+			r = Reconstructors.get('nn4', {'size':32, 'npad':2, 'symmetry':'c1', 'fftvol':fftvol, 'weight':weight})
+			r.setup()
+			for i, e in enumerate(slices):
+				r.insert_slice(e, Transform({'type':'spider', 'phi':30.0*i, 'theta':15.0*i, 'psi':0.0}))
+			return fftvol.copy(), weight.copy()
+		finally:
+			EMThreads.set_num_threads(saved)
+
+	def test_nn4Reconstructor_insert(self):
+		"""test nn4Reconstructor slice insertion ............"""
+		Log.logger().set_level(-1)    #no log message printed out
+		slices = []
+		for i in range(6):
+			e = EMData()
+			e.set_size(32,32,1)
+			e.process_inplace('testimage.noise.uniform.rand')
+			slices.append(e)
+
+		fftvol, weight = self.nn4_insert(slices, 1)
+		self.assertAlmostEqual(weight.get_value_at(0,0,0), 6.0, 3)
+
+		# threaded insertion must give the serial volume voxel for voxel
+		for n in (2, 3, 4):
+			tfftvol, tweight = self.nn4_insert(slices, n)
+			self.assertTrue(numpy.array_equal(tfftvol.numpy(), fftvol.numpy()))
+			self.assertTrue(numpy.array_equal(tweight.numpy(), weight.numpy()))
+
+		fftvol = EMData()
+		weight = EMData()
+		r = Reconstructors.get('nn4', {'size':32, 'npad':2, 'symmetry':'c1', 'fftvol':fftvol, 'weight':weight})
+		r.setup()
+		for i, e in enumerate(slices):
+			r.insert_slice(e, Transform({'type':'spider', 'phi':30.0*i, 'theta':15.0*i, 'psi':0.0}))
+		r.finish()
+		self.assertEqual(fftvol.get_xsize(), 32)
+		self.assertEqual(fftvol.get_ysize(), 32)
+		self.assertEqual(fftvol.get_zsize(), 32)
+
 	def no_test_ReverseGriddingReconstructor(self):
 		"""test ReverseGriddingReconstructor ................"""
 		e1 = EMData()
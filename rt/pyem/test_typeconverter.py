@@ -323,6 +323,51 @@ class TestTypeConverter(unittest.TestCase):
         diff = numpy.max(numpy.max(n2 - n1))
         self.assertAlmostEqual(diff, 0, 3)
 
+    def test_em2numpy_keeps_image(self):
+        """test em2numpy array keeps its image alive ........"""
+        e = EMData(16,8,1)
+        e.to_one()
+        a = EMNumPy.em2numpy(e)
+        del e
+        self.assertEqual(a.shape, (8,16))
+        self.assertEqual(float(a.sum()), 128.0)
+
+    def test_numpy2em_nocopy(self):
+        """test numpy2em without copying ...................."""
+        a = numpy.zeros((6,5), numpy.float32)
+        e = EMNumPy.numpy2em(a, False)
+        e.set_value_at(2,3,7.0)
+        self.assertEqual(a[3][2], 7.0)
+        e.set_size(10,6,1)			# resizing moves the image off the array
+        e.set_value_at(2,3,1.0)
+        self.assertEqual(a[3][2], 7.0)
+
+        # a strided view or another dtype is copied
+        b = numpy.arange(60, dtype=numpy.float64).reshape(6,10)[:, ::2]
+        e2 = EMNumPy.numpy2em(b, False)
+        self.assertEqual(e2.get_xsize(), 5)
+        self.assertEqual(e2.get_value_at(1,2), b[2][1])
+
+    def test_stack_conversion(self):
+        """test em2numpy_stack and numpy2em_stack ..........."""
+        imgs = [EMData(8,6,1) for i in range(4)]
+        for i,im in enumerate(imgs): im.to_value(float(i))
+        a = EMNumPy.em2numpy_stack(imgs)
+        self.assertEqual(a.shape, (4,6,8))
+        for i in range(4): self.assertEqual(a[i][5][7], float(i))
+
+        back = EMNumPy.numpy2em_stack(a)
+        self.assertEqual(len(back), 4)
+        for i,im in enumerate(back):
+            self.assertEqual(im.get_xsize(), 8)
+            self.assertEqual(im.get_value_at(3,2), float(i))
+
+        views = EMNumPy.numpy2em_stack(a, False)
+        views[2].set_value_at(0,0,-1.0)
+        del a
+        self.assertEqual(EMNumPy.em2numpy(views[2])[0][0], -1.0)
+        self.assertRaises(RuntimeError, EMNumPy.em2numpy_stack, [EMData(4,4,1), EMData(5,4,1)])
+
     def test_em2numpy2(self):
         """test em2numpy again .............................."""
         imgfile1 = "test_em2numpy2_1.mrc"
@@ -316,6 +316,188 @@ class TestUtils(unittest.TestCase):
         #f = Util.quadri(e, 2.0, 3.0)    #test default argument
         f2 = Util.quadri(e, 2.3, 3.4, 2)    #test non-default argument
         
+    def test_multiref_polar_ali_2d(self):
+        """test multiref_polar_ali_2d() functions ............"""
+        numr = []
+        lcirc = 1
+        for k in range(1, 15):
+            ip = 2**int(math.log(int(2*math.pi*1.5*k), 2))
+            numr += [k, lcirc, ip]
+            lcirc += ip
+
+        nref = 7
+        crefim = []
+        images = []
+        for i in range(nref):
+            e = EMData()
+            e.set_size(32,32,1)
+            e.process_inplace('testimage.noise.gauss', {'seed':100+i})
+            ring = Util.Polar2Dm(e, 16.0, 16.0, numr, "F")
+            Util.Normalize_ring(ring, numr, 0)
+            Util.Frngs(ring, numr)
+            crefim.append(ring)
+            images.append(e)
+
+        for k in (0, 3, nref-1):
+            res = Util.multiref_polar_ali_2d(images[k], crefim, [2.0,2.0], [2.0,2.0], 1.0, "F", numr, 16.0, 16.0)
+            self.assertEqual(int(res[4]), k)
+            self.assertEqual(int(res[3]), 0)
+            self.assertAlmostEqual(res[1], 0.0, 3)
+            self.assertAlmostEqual(res[2], 0.0, 3)
+
+            # the best of the per reference peaks is the overall best
+            peaks = Util.multiref_polar_ali_2d_peaklist(images[k], crefim, [2.0,2.0], [2.0,2.0], 1.0, "F", numr, 16.0, 16.0)
+            best = max(range(nref), key=lambda i: peaks[i*5])
+            self.assertEqual(best, k)
+            self.assertAlmostEqual(peaks[best*5], res[5], 3)
+            self.assertAlmostEqual(peaks[best*5+1], res[0], 3)
+
+    def test_Frngs(self):
+        """test Frngs() and Frngs_inv() functions ..........."""
+        numr = []
+        lcirc = 1
+        for k in range(1, 11):
+            ip = 2**int(math.log(int(2*math.pi*1.5*k), 2))
+            numr += [k, lcirc, ip]
+            lcirc += ip
+        e = EMData()
+        e.set_size(32,32,1)
+        e.process_inplace('testimage.noise.gauss', {'seed':7})
+        ring = Util.Polar2Dm(e, 16.0, 16.0, numr, "F")
+        orig = ring.copy()
+        Util.Frngs(ring, numr)
+        for k in range(10):
+            start, n = numr[3*k+1]-1, numr[3*k+2]
+            vals = [orig.get_value_at(start+j) for j in range(n)]
+            # packed layout: R(0), R(n/2), then real and imaginary parts
+            self.assertAlmostEqual(ring.get_value_at(start), sum(vals), 3)
+            self.assertAlmostEqual(ring.get_value_at(start+1), sum(v*(-1)**j for j, v in enumerate(vals)), 3)
+            re1 = sum(v*math.cos(2*math.pi*j/n) for j, v in enumerate(vals))
+            im1 = sum(v*math.sin(2*math.pi*j/n) for j, v in enumerate(vals))
+            self.assertAlmostEqual(ring.get_value_at(start+2), re1, 3)
+            self.assertAlmostEqual(ring.get_value_at(start+3), im1, 3)
+        Util.Frngs_inv(ring, numr)
+        for i in range(lcirc-1):
+            self.assertAlmostEqual(ring.get_value_at(i), orig.get_value_at(i), 4)
+
+    def test_twoD_fine_ali_batch(self):
+        """test twoD_fine_ali_batch() functions .............."""
+        ref = EMData()
+        ref.set_size(32,32,1)
+        ref.process_inplace('testimage.noise.gauss', {'seed':200})
+        ref.process_inplace('filter.lowpass.gauss', {'cutoff_abs':0.2})
+        mask = EMData()
+        mask.set_size(32,32,1)
+        mask.to_one()
+
+        images = []
+        params = []
+        for i in range(5):
+            images.append(ref.rot_scale_trans2D(2.0*i-4.0, 0.3*i, -0.2*i, 1.0))
+            params += [0.0, 0.0, 0.0]
+
+        res = Util.twoD_fine_ali_batch(images, [ref], mask, params)
+        sd = Util.twoD_fine_ali_SD_batch(images, [ref], mask, params)
+        for i in range(5):
+            one = Util.twoD_fine_ali(images[i], ref, mask, 0.0, 0.0, 0.0)
+            self.assertEqual(list(res[3*i:3*i+3]), list(one))
+            one = Util.twoD_fine_ali_SD(images[i], ref, mask, 0.0, 0.0, 0.0)
+            self.assertEqual(list(sd[4*i:4*i+4]), list(one))
+
+        self.assertRaises(RuntimeError, Util.twoD_fine_ali_batch, images, [ref, ref], mask, params)
+
+    def test_assign_projangles(self):
+        """test assign_projangles() functions ................"""
+        random.seed(11)
+        refangles = []
+        for i in range(300):
+            refangles += [random.uniform(0.0, 360.0), random.uniform(0.0, 180.0)]
+        projangles = []
+        for i in range(500):
+            projangles += [random.uniform(0.0, 360.0), random.uniform(0.0, 180.0)]
+
+        def vec(phi, theta):
+            phi = math.radians(phi)
+            theta = math.radians(theta)
+            return [math.sin(theta)*math.cos(phi), math.sin(theta)*math.sin(phi), math.cos(theta)]
+
+        refvec = [vec(refangles[2*i], refangles[2*i+1]) for i in range(300)]
+        asg = Util.assign_projangles(projangles, refangles)
+        for i in range(500):
+            v = vec(projangles[2*i], projangles[2*i+1])
+            best = max(abs(sum(a*b for a, b in zip(r, v))) for r in refvec)
+            r = refvec[asg[i]]
+            self.assertAlmostEqual(abs(sum(a*b for a, b in zip(r, v))), best, 5)
+
+        dirs = [vec(projangles[2*i], projangles[2*i+1]) for i in range(50)]
+        nf = Util.nearest_fang_list(refvec, dirs)
+        ns = Util.nearest_fang_select_list(refvec, dirs, 4)
+        for i in range(50):
+            self.assertEqual(list(nf[2*i:2*i+2]), list(Util.nearest_fang(refvec, dirs[i][0], dirs[i][1], dirs[i][2])))
+            self.assertEqual(list(ns[4*i:4*i+4]), list(Util.nearest_fang_select(refvec, dirs[i][0], dirs[i][1], dirs[i][2], 4)))
+        sym = Util.nearest_fang_sym_list(dirs, refvec, 2, 3)
+        for i in range(25):
+            self.assertEqual(list(sym[3*i:3*i+3]), list(Util.nearest_fang_sym(dirs[2*i:2*i+2], refvec, 2, 3)))
+
+    def test_cml_disc_batch(self):
+        """test cml_disc_batch() function ..................."""
+        random.seed(5)
+        nprj = 6
+        data = []
+        for i in range(nprj):
+            e = EMData()
+            e.set_size(32, 360, 1)
+            e.process_inplace('testimage.noise.uniform.rand')
+            data.append(e)
+        seq = []
+        for i in range(nprj):
+            for j in range(i+1, nprj):
+                seq += [i, j]
+        n_lines = len(seq)//2
+        weights = [random.uniform(0.5, 1.5) for i in range(n_lines)]
+        coms = []
+        discs = []
+        for k in range(4):
+            Ori = []
+            for i in range(nprj):
+                Ori += [random.uniform(0.0, 360.0), random.uniform(0.0, 180.0), random.uniform(0.0, 360.0), 0.0]
+            com = Util.cml_line_insino_all(Util.cml_init_rot(Ori), seq, nprj, n_lines)
+            coms += list(com)
+            discs.append(Util.cml_disc(data, com, seq, weights, n_lines))
+        res = Util.cml_disc_batch(data, coms, seq, weights, n_lines)
+        self.assertEqual(list(res), discs)
+
+    def test_k_means_cont_table_all(self):
+        """test k_means_cont_table_all() function ..........."""
+        random.seed(3)
+        K1, K2 = 4, 5
+        asg1 = [random.randint(-1, K1-1) for i in range(500)]
+        asg2 = [random.randint(0, K2-1) for i in range(500)]
+        table = Util.k_means_cont_table_all(asg1, asg2, K1, K2)
+        for k1 in range(K1):
+            for k2 in range(K2):
+                n = sum(1 for i in range(500) if asg1[i] == k1 and asg2[i] == k2)
+                self.assertEqual(table[k1*K2+k2], n)
+
+    def test_assign_groups_auction(self):
+        """test assign_groups_auction() function ............"""
+        import numpy
+        random.seed(9)
+        nref, nima = 4, 43
+        d = numpy.array([random.random() for i in range(nref*nima)], numpy.float32)
+        address = str(d.__array_interface__['data'][0])
+        maxasi = nima//nref
+
+        def total(ids):
+            return sum(d[k*nima+ids[k*maxasi+j]] for k in range(nref) for j in range(maxasi))
+
+        greedy = Util.assign_groups(address, nref, nima)
+        auction = Util.assign_groups_auction(address, nref, nima)
+        self.assertEqual(len(auction), nima+1)
+        self.assertEqual(sorted(auction[:-1]), list(range(nima)))
+        self.assertTrue(0 <= auction[-1] < nref)
+        self.assertTrue(total(auction) >= total(greedy) - 1.e-4)
+
 class TestEMUtils(unittest.TestCase):
     """test EMUtil class"""
     
@@ -653,7 +835,71 @@ class TestEMUtils(unittest.TestCase):
         self.assertEqual('count' in d, False)
         
         testlib.safe_unlink(file)
-        
+
+    def test_movie_stream(self):
+        """test MovieStream group sums with gain correction ..."""
+        file = 'test_movie.mrcs'
+        frames = [test_image(0, (64, 64)) for i in range(5)]
+        for i, f in enumerate(frames):
+            f.mult(i + 1.0)
+            f.write_image(file, i)
+
+        gain = EMData(64, 64)
+        gain.to_value(2.0)
+
+        ms = MovieStream(file)
+        self.assertEqual(ms.get_nframes(), 5)
+        ms.set_gain(gain)
+        groups = ms.sum_groups(2)
+        self.assertEqual(len(groups), 3)
+
+        for g, idx in zip(groups, ((0, 1), (2, 3), (4,))):
+            ref = EMData(64, 64)
+            ref.to_zero()
+            for i in idx:
+                ref.add(frames[i])
+            ref.mult(2.0)
+            self.assertAlmostEqual(g.cmp("sqeuclidean", ref), 0.0, places=5)
+
+        testlib.safe_unlink(file)
+
+    def test_movie_stream_defects(self):
+        """test MovieStream defect replacement and groups ..."""
+        file = 'test_movie_defects.mrcs'
+        frame = EMData(64, 64)
+        for y in range(64):
+            for x in range(64):
+                frame.set_value_at(x, y, x + 100.0 * y)
+        frame.write_image(file, 0)
+        frame.write_image(file, 1)
+
+        # bad square of radius 3 around (20, 20) except its corner (23, 23), so
+        # the closest good pixel to the center is (24, 20) on the next ring out
+        mask = EMData(64, 64)
+        mask.to_zero()
+        for y in range(17, 24):
+            for x in range(17, 24):
+                mask.set_value_at(x, y, 1.0)
+        mask.set_value_at(23, 23, 0.0)
+        for x, y in ((16, 20), (20, 16), (20, 24)):
+            mask.set_value_at(x, y, 1.0)
+
+        ms = MovieStream(file)
+        ms.set_defects(mask)
+        s = ms.read_groups([1])[0]
+        self.assertAlmostEqual(s.get_value_at(20, 20), frame.get_value_at(24, 20), places=3)
+        self.assertAlmostEqual(s.get_value_at(23, 23), frame.get_value_at(23, 23), places=3)
+        self.assertRaises(RuntimeError, ms.read_groups, [0, 1])
+
+        testlib.safe_unlink(file)
+
+    def test_emthreads(self):
+        """test EMThreads thread count ......................"""
+        EMThreads.set_num_threads(3)
+        self.assertEqual(EMThreads.get_num_threads(), 3)
+        EMThreads.set_num_threads(0)
+        self.assertTrue(EMThreads.get_num_threads() >= 1)
+
 def test_main():
     p = OptionParser()
     p.add_option('--t', action='store_true', help='test exception', default=False )
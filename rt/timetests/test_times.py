@@ -64,6 +64,102 @@ def timetest():
 	
 	print("It took %f seconds to gets the stats (in c++ style) for %d random numbers, %d times" %(dt1,n,it))
 
+def blas_test():
+	"""time the sparx linear algebra (Lanczos PCA, coveig) on the bundled and external BLAS/LAPACK"""
+	n = 64
+	nimg = 500
+	nvec = 20
+	ncov = 800
+
+	mask = EMData()
+	mask.set_size(n,n,1)
+	mask.to_one()
+	imgs = []
+	for i in range(nimg):
+		e = EMData()
+		e.set_size(n,n,1)
+		e.process_inplace("testimage.noise.gauss")
+		imgs.append(e)
+
+	a = [ random() for i in range(ncov*ncov) ]
+	cov = [ 0.0 ] * (ncov*ncov)
+	for i in range(ncov):
+		for j in range(i,ncov):
+			cov[i*ncov+j] = cov[j*ncov+i] = a[i*ncov+j]
+
+	old = Util.use_external_blas(False)
+	for use in (False, True):
+		Util.use_external_blas(use)
+		if use and not Util.using_external_blas():
+			print("EMAN2 was built without ENABLE_EXTERNAL_BLAS, skipping the external backend")
+			break
+		name = "external" if use else "bundled"
+
+		time1 = time()
+		pca = Analyzers.get("pca_large", {"mask":mask, "nvec":nvec})
+		pca.insert_images_list(imgs)
+		eig = pca.analyze()
+		time2 = time()
+		print("%s BLAS: pca_large of %d %dx%d images, %d vectors took %f seconds" %(name,nimg,n,n,nvec,time2-time1))
+
+		time1 = time()
+		res = Util.coveig_for_py(ncov, cov)
+		time2 = time()
+		print("%s BLAS: coveig of a %dx%d matrix took %f seconds (largest eigenvalue %f)" %(name,ncov,ncov,time2-time1,res["eigval"][-1]))
+	Util.use_external_blas(old)
+
+def cml_test():
+	"""time the common-lines engine (cml_spin_psi, cml_disc, cml_disc_batch) on a synthetic projection set"""
+	nprj = 60
+	nx = 64
+	n_psi = 360
+	d_psi = 1
+	ncand = 200
+
+	data = []
+	for i in range(nprj):
+		e = EMData()
+		e.set_size(nx,n_psi,1)
+		e.process_inplace("testimage.noise.gauss")
+		data.append(e)
+	seq = []
+	for i in range(nprj):
+		for j in range(i+1,nprj):
+			seq += [i,j]
+	n_lines = len(seq)//2
+	weights = [ random() for i in range(n_lines) ]
+
+	Ori = []
+	for i in range(nprj):
+		Ori += [ 360.0*random(), 180.0*random(), 360.0*random(), 0.0 ]
+	Rot = Util.cml_init_rot(Ori)
+	com = Util.cml_line_insino_all(Rot, seq, nprj, n_lines)
+
+	time1 = time()
+	for iprj in range(nprj):
+		iw = [ int(random()*n_lines) for i in range(nprj-1) ]
+		res = Util.cml_spin_psi(data, com[:2*(nprj-1)], weights, iprj, iw, n_psi, d_psi, nprj)
+	time2 = time()
+	print("cml_spin_psi over %d projections, %d psi, %d lines of %d took %f seconds" %(nprj,n_psi//d_psi,nprj-1,nx,time2-time1))
+
+	coms = []
+	for j in range(ncand):
+		Ori[0] = 360.0*random()
+		Ori[1] = 180.0*random()
+		Ori[2] = 360.0*random()
+		coms += list(Util.cml_line_insino_all(Util.cml_init_rot(Ori), seq, nprj, n_lines))
+
+	time1 = time()
+	for j in range(ncand):
+		disc = Util.cml_disc(data, coms[2*n_lines*j:2*n_lines*(j+1)], seq, weights, n_lines)
+	time2 = time()
+	print("cml_disc of %d candidates, %d common-lines each took %f seconds" %(ncand,n_lines,time2-time1))
+
+	time1 = time()
+	discs = Util.cml_disc_batch(data, coms, seq, weights, n_lines)
+	time2 = time()
+	print("cml_disc_batch of %d candidates, %d common-lines each took %f seconds" %(ncand,n_lines,time2-time1))
+
 def precision_test():
 	"""test RotateTranslateAligner ....................."""
 		